@@ -27,10 +27,16 @@ static bool ut_asn1_tag_equal(UtObject *object, UtObject *other) {
          tag_matches(self, other_self->class, other_self->number);
 }
 
+static int ut_asn1_tag_hash(UtObject *object) {
+  UtAsn1Tag *self = (UtAsn1Tag *)object;
+  return self->class << 29 | self->number;
+}
+
 static UtObjectInterface object_interface = {.type_name = "UtAsn1Tag",
                                              .to_string =
                                                  ut_asn1_tag_to_object_string,
-                                             .equal = ut_asn1_tag_equal};
+                                             .equal = ut_asn1_tag_equal,
+                                             .hash = ut_asn1_tag_hash};
 
 UtObject *ut_asn1_tag_new(UtAsn1TagClass class, uint32_t number) {
   UtObject *object = ut_object_new(sizeof(UtAsn1Tag), &object_interface);
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Reference implementation that applies the modulo on every byte.
+static uint32_t adler32_simple(const uint8_t *data, size_t data_length) {
+  uint32_t s1 = 1, s2 = 0;
+  for (size_t i = 0; i < data_length; i++) {
+    s1 = (s1 + data[i]) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  return s2 << 16 | s1;
+}
+
+static void test_check_values() {
+  ut_assert_int_equal(ut_adler32_update(1, NULL, 0), 0x00000001);
+  ut_assert_int_equal(ut_adler32_update(1, (const uint8_t *)"a", 1),
+                      0x00620062);
+  ut_assert_int_equal(ut_adler32_update(1, (const uint8_t *)"Wikipedia", 9),
+                      0x11e60398);
+}
+
+static void test_lengths() {
+  // Use large values to check the sums don't overflow before the modulo.
+  size_t data_length = 100000;
+  uint8_t *data = malloc(data_length);
+  for (size_t i = 0; i < data_length; i++) {
+    data[i] = 0xff;
+  }
+  ut_assert_int_equal(ut_adler32_update(1, data, data_length),
+                      adler32_simple(data, data_length));
+
+  for (size_t i = 0; i < data_length; i++) {
+    data[i] = ut_benchmark_get_random();
+  }
+  for (size_t length = 0; length < 100; length++) {
+    ut_assert_int_equal(ut_adler32_update(1, data + 1, length),
+                        adler32_simple(data + 1, length));
+  }
+  ut_assert_int_equal(ut_adler32_update(1, data, data_length),
+                      adler32_simple(data, data_length));
+
+  free(data);
+}
+
+static void test_incremental() {
+  UtObjectRef data = ut_uint8_array_new();
+  for (size_t i = 0; i < 20000; i++) {
+    ut_uint8_list_append(data, (i * 7) ^ (i >> 3));
+  }
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  uint32_t expected = adler32_simple(d, 20000);
+
+  uint32_t checksum = 1;
+  size_t split[] = {0, 1, 15, 16, 5552, 5553, 19999, 20000};
+  for (size_t i = 1; i < 8; i++) {
+    checksum =
+        ut_adler32_update(checksum, d + split[i - 1], split[i] - split[i - 1]);
+  }
+  ut_assert_int_equal(checksum, expected);
+
+  ut_assert_int_equal(ut_adler32_update_list(1, data, 0, 20000), expected);
+
+  // List without contiguous memory.
+  UtObjectRef fds = ut_list_new();
+  UtObjectRef data_with_fds = ut_uint8_array_with_fds_new(data, fds);
+  ut_assert_int_equal(ut_adler32_update_list(1, data_with_fds, 0, 20000),
+                      expected);
+  ut_assert_int_equal(ut_adler32_update_list(1, data_with_fds, 100, 2000),
+                      adler32_simple(d + 100, 2000));
+}
+
+int main(int argc, char **argv) {
+  test_check_values();
+  test_lengths();
+  test_incremental();
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "ut.h"
+
+// https://www.ietf.org/rfc/rfc1950.txt
+
+// Largest prime smaller than 65536.
+#define MODULUS 65521
+
+// Largest number of bytes that can be summed before s2 can overflow 32 bits.
+#define MAX_BLOCK_LENGTH 5552
+
+uint32_t ut_adler32_update(uint32_t checksum, const uint8_t *data,
+                           size_t data_length) {
+  uint32_t s1 = checksum & 0xffff;
+  uint32_t s2 = checksum >> 16;
+
+  // Only apply the modulo once per block, this allows the inner loop to be
+  // unrolled and vectorized.
+  while (data_length > 0) {
+    size_t block_length =
+        data_length < MAX_BLOCK_LENGTH ? data_length : MAX_BLOCK_LENGTH;
+    data_length -= block_length;
+
+    for (; block_length >= 16; block_length -= 16) {
+      for (size_t i = 0; i < 16; i++) {
+        s1 += data[i];
+        s2 += s1;
+      }
+      data += 16;
+    }
+    for (; block_length > 0; block_length--) {
+      s1 += *data++;
+      s2 += s1;
+    }
+
+    s1 %= MODULUS;
+    s2 %= MODULUS;
+  }
+
+  return s2 << 16 | s1;
+}
+
+uint32_t ut_adler32_update_list(uint32_t checksum, UtObject *data,
+                                size_t offset, size_t length) {
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  if (d != NULL) {
+    return ut_adler32_update(checksum, d + offset, length);
+  }
+
+  // Copy non-contiguous data in blocks.
+  uint8_t buffer[1024];
+  while (length > 0) {
+    size_t block_length = length < sizeof(buffer) ? length : sizeof(buffer);
+    for (size_t i = 0; i < block_length; i++) {
+      buffer[i] = ut_uint8_list_get_element(data, offset + i);
+    }
+    checksum = ut_adler32_update(checksum, buffer, block_length);
+    offset += block_length;
+    length -= block_length;
+  }
+
+  return checksum;
+}
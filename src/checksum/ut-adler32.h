@@ -0,0 +1,19 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+/// Returns [checksum] updated with the [data_length] bytes in [data].
+/// This is the Adler-32 checksum used in zlib streams.
+/// Use 1 as the initial value.
+uint32_t ut_adler32_update(uint32_t checksum, const uint8_t *data,
+                           size_t data_length);
+
+/// Returns [checksum] updated with [length] bytes from [data] starting at
+/// [offset].
+///
+/// !arg-type data UtUint8List
+uint32_t ut_adler32_update_list(uint32_t checksum, UtObject *data,
+                                size_t offset, size_t length);
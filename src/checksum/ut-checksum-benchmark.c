@@ -0,0 +1,69 @@
+#include <stdio.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures the throughput of the checksum algorithms.
+
+// Reference CRC-32 processing one byte at a time.
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *data,
+                               size_t data_length) {
+  static uint32_t table[256];
+  if (table[1] == 0) {
+    for (size_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (size_t j = 0; j < 8; j++) {
+        c = (c & 1) != 0 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+
+  uint32_t c = crc ^ 0xffffffff;
+  for (size_t i = 0; i < data_length; i++) {
+    c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffff;
+}
+
+// Reference Adler-32 applying the modulo on every byte.
+static uint32_t adler32_bytewise(uint32_t checksum, const uint8_t *data,
+                                 size_t data_length) {
+  uint32_t s1 = checksum & 0xffff;
+  uint32_t s2 = checksum >> 16;
+  for (size_t i = 0; i < data_length; i++) {
+    s1 = (s1 + data[i]) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  return s2 << 16 | s1;
+}
+
+typedef uint32_t (*ChecksumFunction)(uint32_t checksum, const uint8_t *data,
+                                     size_t data_length);
+
+static void benchmark(const char *name, ChecksumFunction function,
+                      uint32_t initial_value, const uint8_t *data,
+                      size_t data_length, size_t n_iterations) {
+  double start = ut_benchmark_get_time();
+  uint32_t checksum = initial_value;
+  for (size_t i = 0; i < n_iterations; i++) {
+    checksum = function(checksum, data, data_length);
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  printf("%-17s %08x: %8.1f MB/s\n", name, checksum,
+         data_length * n_iterations / duration / 1e6);
+}
+
+int main(int argc, char **argv) {
+  size_t data_length = 1024 * 1024;
+  UtObjectRef data_object = ut_benchmark_make_random(data_length);
+  const uint8_t *data = ut_uint8_list_get_data(data_object);
+
+  benchmark("CRC-32 bytewise", crc32_bytewise, 0, data, data_length, 100);
+  benchmark("CRC-32", ut_crc32_update, 0, data, data_length, 100);
+  benchmark("Adler-32 bytewise", adler32_bytewise, 1, data, data_length, 100);
+  benchmark("Adler-32", ut_adler32_update, 1, data, data_length, 100);
+
+  return 0;
+}
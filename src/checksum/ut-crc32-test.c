@@ -0,0 +1,105 @@
+#include <stdlib.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Reference implementation that processes one bit at a time.
+static uint32_t crc32_bitwise(const uint8_t *data, size_t data_length) {
+  uint32_t c = 0xffffffff;
+  for (size_t i = 0; i < data_length; i++) {
+    c ^= data[i];
+    for (size_t j = 0; j < 8; j++) {
+      c = (c & 1) != 0 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    }
+  }
+  return c ^ 0xffffffff;
+}
+
+static void test_check_values() {
+  ut_assert_int_equal(ut_crc32_update(0, NULL, 0), 0x00000000);
+  ut_assert_int_equal(ut_crc32_update(0, (const uint8_t *)"a", 1),
+                      0xe8b7be43);
+  ut_assert_int_equal(ut_crc32_update(0, (const uint8_t *)"123456789", 9),
+                      0xcbf43926);
+  const char *text = "The quick brown fox jumps over the lazy dog";
+  ut_assert_int_equal(ut_crc32_update(0, (const uint8_t *)text, 43),
+                      0x414fa339);
+}
+
+static void test_lengths() {
+  // Cover all the tails and alignments of the block based implementations.
+  size_t data_length = 4096;
+  uint8_t *data = malloc(data_length);
+  for (size_t i = 0; i < data_length; i++) {
+    data[i] = ut_benchmark_get_random();
+  }
+
+  for (size_t offset = 0; offset < 16; offset++) {
+    for (size_t length = 0; length < 300; length++) {
+      ut_assert_int_equal(ut_crc32_update(0, data + offset, length),
+                          crc32_bitwise(data + offset, length));
+    }
+  }
+  ut_assert_int_equal(ut_crc32_update(0, data, data_length),
+                      crc32_bitwise(data, data_length));
+
+  free(data);
+}
+
+static void test_incremental() {
+  UtObjectRef data = ut_uint8_array_new();
+  for (size_t i = 0; i < 10000; i++) {
+    ut_uint8_list_append(data, (i * 7) ^ (i >> 3));
+  }
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  uint32_t expected = crc32_bitwise(d, 10000);
+
+  uint32_t crc = 0;
+  size_t split[] = {0, 1, 63, 64, 1000, 1017, 9999, 10000};
+  for (size_t i = 1; i < 8; i++) {
+    crc = ut_crc32_update(crc, d + split[i - 1], split[i] - split[i - 1]);
+  }
+  ut_assert_int_equal(crc, expected);
+
+  ut_assert_int_equal(ut_crc32_update_list(0, data, 0, 10000), expected);
+  ut_assert_int_equal(ut_crc32_update_list(0, data, 100, 200),
+                      crc32_bitwise(d + 100, 200));
+
+  // List without contiguous memory.
+  UtObjectRef fds = ut_list_new();
+  UtObjectRef data_with_fds = ut_uint8_array_with_fds_new(data, fds);
+  ut_assert_true(ut_uint8_list_get_data(data_with_fds) == NULL);
+  ut_assert_int_equal(ut_crc32_update_list(0, data_with_fds, 0, 10000),
+                      expected);
+  ut_assert_int_equal(ut_crc32_update_list(0, data_with_fds, 100, 2000),
+                      crc32_bitwise(d + 100, 2000));
+}
+
+static void test_combine() {
+  const uint8_t *text = (const uint8_t *)"123456789";
+  for (size_t split = 0; split <= 9; split++) {
+    uint32_t crc1 = ut_crc32_update(0, text, split);
+    uint32_t crc2 = ut_crc32_update(0, text + split, 9 - split);
+    ut_assert_int_equal(ut_crc32_combine(crc1, crc2, 9 - split), 0xcbf43926);
+  }
+
+  size_t data_length = 300000;
+  uint8_t *data = malloc(data_length);
+  for (size_t i = 0; i < data_length; i++) {
+    data[i] = i * 31 + (i >> 8);
+  }
+  uint32_t crc1 = ut_crc32_update(0, data, 100000);
+  uint32_t crc2 = ut_crc32_update(0, data + 100000, 200000);
+  ut_assert_int_equal(ut_crc32_combine(crc1, crc2, 200000),
+                      ut_crc32_update(0, data, data_length));
+  free(data);
+}
+
+int main(int argc, char **argv) {
+  test_check_values();
+  test_lengths();
+  test_incremental();
+  test_combine();
+
+  return 0;
+}
@@ -0,0 +1,236 @@
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "ut.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#define HAVE_PCLMUL
+#endif
+
+// Reversed form of the polynomial 0x04c11db7.
+#define POLYNOMIAL 0xedb88320
+
+// Tables to process eight bytes at a time ("slicing-by-8").
+// Table 0 is the standard byte at a time table, table n is the CRC of a byte
+// followed by n zero bytes.
+static uint32_t crc_tables[8][256];
+
+// x^(2^n) modulo the polynomial, used to combine CRCs.
+static uint32_t x2n_table[32];
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+#ifdef HAVE_PCLMUL
+static bool have_pclmul = false;
+#endif
+
+// Returns [a] * [b] modulo the polynomial, in the reflected bit order.
+static uint32_t multiply_modp(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  while (true) {
+    if ((a & m) != 0) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) != 0 ? POLYNOMIAL ^ (b >> 1) : b >> 1;
+  }
+  return p;
+}
+
+// Returns x^(n * 2^k) modulo the polynomial.
+static uint32_t x2n_modp(size_t n, size_t k) {
+  uint32_t p = 1u << 31;
+  while (n > 0) {
+    if ((n & 1) != 0) {
+      p = multiply_modp(x2n_table[k & 31], p);
+    }
+    n >>= 1;
+    k++;
+  }
+  return p;
+}
+
+static void init_tables() {
+  for (size_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (size_t j = 0; j < 8; j++) {
+      c = (c & 1) != 0 ? POLYNOMIAL ^ (c >> 1) : c >> 1;
+    }
+    crc_tables[0][i] = c;
+  }
+  for (size_t i = 0; i < 256; i++) {
+    uint32_t c = crc_tables[0][i];
+    for (size_t t = 1; t < 8; t++) {
+      c = crc_tables[0][c & 0xff] ^ (c >> 8);
+      crc_tables[t][i] = c;
+    }
+  }
+
+  uint32_t p = 1u << 30;
+  x2n_table[0] = p;
+  for (size_t n = 1; n < 32; n++) {
+    p = multiply_modp(p, p);
+    x2n_table[n] = p;
+  }
+
+#ifdef HAVE_PCLMUL
+  __builtin_cpu_init();
+  have_pclmul =
+      __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#ifdef HAVE_PCLMUL
+// Fold 16 byte blocks using carry-less multiplication, then reduce to 32 bits.
+// From "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+// Instruction", Intel, 2009.
+// [data_length] must be at least 64 and a multiple of 16.
+__attribute__((target("pclmul,sse4.1"))) static uint32_t
+update_pclmul(uint32_t c, const uint8_t *data, size_t data_length) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i *)(data + 0));
+  __m128i x2 = _mm_loadu_si128((const __m128i *)(data + 16));
+  __m128i x3 = _mm_loadu_si128((const __m128i *)(data + 32));
+  __m128i x4 = _mm_loadu_si128((const __m128i *)(data + 48));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(c));
+  data += 64;
+  data_length -= 64;
+
+  // Fold four blocks in parallel.
+  while (data_length >= 64) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *)(data + 0)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                       _mm_loadu_si128((const __m128i *)(data + 16)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                       _mm_loadu_si128((const __m128i *)(data + 32)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                       _mm_loadu_si128((const __m128i *)(data + 48)));
+    data += 64;
+    data_length -= 64;
+  }
+
+  // Fold the four blocks into one.
+  __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // Fold remaining single blocks.
+  while (data_length >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *)data));
+    data += 16;
+    data_length -= 16;
+  }
+
+  // Fold 128 bits to 64 bits.
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return _mm_extract_epi32(x1, 1);
+}
+#endif
+
+static uint32_t update_slicing_by_8(uint32_t c, const uint8_t *data,
+                                    size_t data_length) {
+  size_t i = 0;
+  for (; i + 8 <= data_length; i += 8) {
+    const uint8_t *d = data + i;
+    uint32_t low = c ^ ((uint32_t)d[0] | (uint32_t)d[1] << 8 |
+                        (uint32_t)d[2] << 16 | (uint32_t)d[3] << 24);
+    c = crc_tables[7][low & 0xff] ^ crc_tables[6][(low >> 8) & 0xff] ^
+        crc_tables[5][(low >> 16) & 0xff] ^ crc_tables[4][low >> 24] ^
+        crc_tables[3][d[4]] ^ crc_tables[2][d[5]] ^ crc_tables[1][d[6]] ^
+        crc_tables[0][d[7]];
+  }
+  for (; i < data_length; i++) {
+    c = crc_tables[0][(c ^ data[i]) & 0xff] ^ (c >> 8);
+  }
+
+  return c;
+}
+
+uint32_t ut_crc32_update(uint32_t crc, const uint8_t *data,
+                         size_t data_length) {
+  pthread_once(&init_once, init_tables);
+
+  uint32_t c = crc ^ 0xffffffff;
+#ifdef HAVE_PCLMUL
+  if (have_pclmul && data_length >= 64) {
+    size_t block_length = data_length & ~(size_t)15;
+    c = update_pclmul(c, data, block_length);
+    data += block_length;
+    data_length -= block_length;
+  }
+#endif
+  c = update_slicing_by_8(c, data, data_length);
+
+  return c ^ 0xffffffff;
+}
+
+uint32_t ut_crc32_update_list(uint32_t crc, UtObject *data, size_t offset,
+                              size_t length) {
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  if (d != NULL) {
+    return ut_crc32_update(crc, d + offset, length);
+  }
+
+  // Copy non-contiguous data in blocks.
+  uint8_t buffer[1024];
+  while (length > 0) {
+    size_t block_length = length < sizeof(buffer) ? length : sizeof(buffer);
+    for (size_t i = 0; i < block_length; i++) {
+      buffer[i] = ut_uint8_list_get_element(data, offset + i);
+    }
+    crc = ut_crc32_update(crc, buffer, block_length);
+    offset += block_length;
+    length -= block_length;
+  }
+
+  return crc;
+}
+
+uint32_t ut_crc32_combine(uint32_t crc1, uint32_t crc2, size_t length2) {
+  pthread_once(&init_once, init_tables);
+
+  // Shift the first CRC by the length of the second data (in bits).
+  return multiply_modp(x2n_modp(length2, 3), crc1) ^ crc2;
+}
@@ -0,0 +1,23 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+/// Returns [crc] updated with the [data_length] bytes in [data].
+/// This is the CRC-32 used in gzip, PNG and ZIP files.
+/// Use 0 as the initial value.
+uint32_t ut_crc32_update(uint32_t crc, const uint8_t *data,
+                         size_t data_length);
+
+/// Returns [crc] updated with [length] bytes from [data] starting at [offset].
+///
+/// !arg-type data UtUint8List
+uint32_t ut_crc32_update_list(uint32_t crc, UtObject *data, size_t offset,
+                              size_t length);
+
+/// Returns the CRC of two blocks of data joined together, given the CRC of
+/// the first block [crc1] and the CRC of the second block [crc2] which is
+/// [length2] bytes long.
+uint32_t ut_crc32_combine(uint32_t crc1, uint32_t crc2, size_t length2);
@@ -5,6 +5,47 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   return ut_list_get_length(data);
 }
 
+// Decode [hex_data] when written one byte at a time.
+static UtObject *decode_short_writes(const char *hex_data) {
+  UtObjectRef data_stream = ut_buffered_input_stream_new();
+  UtObjectRef decoder = ut_deflate_decoder_new(data_stream);
+  UtObjectRef result = ut_uint8_array_new();
+  ut_input_stream_read(decoder, result, read_cb);
+  UtObjectRef data = ut_uint8_list_new_from_hex_string(hex_data);
+  size_t data_length = ut_list_get_length(data);
+  for (size_t i = 0; i < data_length; i++) {
+    UtObjectRef d = ut_list_get_sublist(data, i, 1);
+    ut_buffered_input_stream_write(data_stream, d, i == data_length - 1);
+  }
+  return ut_string_new_from_utf8(result);
+}
+
+// Decode data longer than the window, so old data is removed from the buffer.
+static void test_long_data() {
+  UtObjectRef data = ut_uint8_array_new();
+  for (size_t i = 0; i < 400000; i++) {
+    ut_uint8_list_append(data, (i / 1000) % 7 == 0 ? i * 7919 >> 5 : i % 13);
+  }
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_deflate_encoder_new(data_stream);
+  UtObjectRef encoded_data = ut_input_stream_read_sync(encoder);
+
+  UtObjectRef encoded_data_stream = ut_buffered_input_stream_new();
+  UtObjectRef decoder = ut_deflate_decoder_new(encoded_data_stream);
+  UtObjectRef result = ut_uint8_array_new();
+  ut_input_stream_read(decoder, result, read_cb);
+  size_t encoded_data_length = ut_list_get_length(encoded_data);
+  for (size_t offset = 0; offset < encoded_data_length; offset += 1000) {
+    size_t length = encoded_data_length - offset < 1000
+                        ? encoded_data_length - offset
+                        : 1000;
+    UtObjectRef d = ut_list_get_sublist(encoded_data, offset, length);
+    ut_buffered_input_stream_write(encoded_data_stream, d,
+                                   offset + length == encoded_data_length);
+  }
+  ut_assert_equal(result, data);
+}
+
 int main(int argc, char **argv) {
   UtObjectRef empty_data = ut_uint8_list_new_from_hex_string("0300");
   UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
@@ -127,5 +168,18 @@ int main(int argc, char **argv) {
   ut_assert_cstring_equal(ut_string_get_text(short_write_result_string),
                           "hello");
 
+  UtObjectRef short_write_literal = decode_short_writes("010100feff21");
+  ut_assert_cstring_equal(ut_string_get_text(short_write_literal), "!");
+  UtObjectRef short_write_dynamic_huffman =
+      decode_short_writes("1dc6490100001040c0aca37f883d3c202a979d375e1d0c");
+  ut_assert_cstring_equal(ut_string_get_text(short_write_dynamic_huffman),
+                          "abaabbbabaababbaababaaaabaaabbbbbaa");
+  UtObjectRef short_write_multi_block =
+      decode_short_writes("ca48cdc9c9074801b0f2fca29c1400");
+  ut_assert_cstring_equal(ut_string_get_text(short_write_multi_block),
+                          "hello world");
+
+  test_long_data();
+
   return 0;
 }
@@ -1,7 +1,26 @@
 #include <assert.h>
+#include <string.h>
 
+#include "ut-deflate.h"
 #include "ut.h"
 
+// Maximum distance matches can refer back to.
+#define WINDOW_SIZE 32768
+
+// Longest match that can be encoded.
+#define MAX_MATCH_LENGTH 258
+
+// Most bits used by a literal/length code and a distance code, including
+// extra bits.
+#define MAX_SYMBOL_BITS (15 + 5 + 15 + 13)
+
+// Output space added to the buffer each time it fills in the fast decoding
+// loop.
+#define FAST_OUTPUT_LENGTH 65536
+
+// Remove decoded data from the buffer when this much is no longer required.
+#define TRIM_LENGTH (8 * WINDOW_SIZE)
+
 typedef enum {
   DECODER_STATE_BLOCK_HEADER,
   DECODER_STATE_UNCOMPRESSED_LENGTH,
@@ -26,7 +45,8 @@ typedef struct {
   UtObject *callback_object;
   UtInputStreamCallback callback;
 
-  uint8_t bit_buffer;
+  // Bits read from the input, first bit in the least significant bit.
+  uint64_t bit_buffer;
   uint8_t bit_count;
 
   DecoderState state;
@@ -42,8 +62,6 @@ typedef struct {
   UtObject *code_width_huffman_decoder;
   UtObject *code_widths;
 
-  uint16_t code;
-  uint8_t code_width;
   uint16_t length;
   uint16_t length_symbol;
   uint16_t distance_index;
@@ -59,23 +77,6 @@ typedef struct {
   size_t buffer_read_offset;
 } UtDeflateDecoder;
 
-static uint16_t base_lengths[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
-                                    15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
-                                    67, 83, 99, 115, 131, 163, 195, 227, 258};
-
-static uint8_t extra_length_bits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
-                                        1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
-                                        4, 4, 4, 4, 5, 5, 5, 5, 0};
-
-static uint16_t base_distances[32] = {
-    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,   33,
-    49,   65,   97,   129,  193,  257,   385,   513,   769, 1025, 1537,
-    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0,   0};
-
-static uint8_t distance_bits[32] = {0,  0,  0,  0,  1,  1,  2,  2,  3, 3, 4,
-                                    4,  5,  5,  6,  6,  7,  7,  8,  8, 9, 9,
-                                    10, 10, 11, 11, 12, 12, 13, 13, 0, 0};
-
 static void set_error(UtDeflateDecoder *self, const char *description) {
   if (self->state == DECODER_STATE_ERROR) {
     return;
@@ -85,9 +86,71 @@ static void set_error(UtDeflateDecoder *self, const char *description) {
   self->state = DECODER_STATE_ERROR;
 }
 
+// Fill [bit_buffer] with as many whole bytes from [data] as will fit.
+static void fill_bits(UtDeflateDecoder *self, const uint8_t *data,
+                      size_t data_length, size_t *offset) {
+  while (self->bit_count <= 56 && *offset < data_length) {
+    self->bit_buffer |= (uint64_t)data[*offset] << self->bit_count;
+    self->bit_count += 8;
+    (*offset)++;
+  }
+}
+
+// Return whole bytes in [bit_buffer] to the input, so [offset] is the position
+// of the next unread byte. Only bits from a partially read byte remain.
+static void unread_bytes(UtDeflateDecoder *self, size_t *offset) {
+  size_t n_bytes = self->bit_count / 8;
+  *offset -= n_bytes;
+  self->bit_count -= n_bytes * 8;
+  self->bit_buffer &= ((uint64_t)1 << self->bit_count) - 1;
+}
+
+// Returns true if [length] bits are available.
+static bool have_bits(UtDeflateDecoder *self, const uint8_t *data,
+                      size_t data_length, size_t *offset, size_t length) {
+  if (self->bit_count < length) {
+    fill_bits(self, data, data_length, offset);
+  }
+  return self->bit_count >= length;
+}
+
+// Read an integer of [length] bits, which must be available.
+static uint16_t read_int(UtDeflateDecoder *self, size_t length) {
+  assert(length <= self->bit_count);
+  uint16_t value = self->bit_buffer & ((1 << length) - 1);
+  self->bit_buffer >>= length;
+  self->bit_count -= length;
+  return value;
+}
+
+static bool read_huffman_symbol(UtDeflateDecoder *self, const uint8_t *data,
+                                size_t data_length, size_t *offset,
+                                UtObject *decoder, uint16_t *symbol) {
+  fill_bits(self, data, data_length, offset);
+
+  // Unused bits in the buffer are zero, so a code can be matched with
+  // incomplete data and checked against the number of bits available.
+  size_t code_width =
+      ut_huffman_decoder_lookup_lsb_first(decoder, self->bit_buffer, symbol);
+  if (code_width == 0) {
+    if (self->bit_count >= ut_huffman_decoder_get_max_code_width(decoder)) {
+      set_error(self, "Invalid Huffman code in deflate data");
+    }
+    return false;
+  }
+  if (code_width > self->bit_count) {
+    return false;
+  }
+
+  self->bit_buffer >>= code_width;
+  self->bit_count -= code_width;
+  return true;
+}
+
 // Prepare to decode an uncompressed data block.
-static void start_uncompressed_block(UtDeflateDecoder *self) {
+static void start_uncompressed_block(UtDeflateDecoder *self, size_t *offset) {
   // Clear remaining unused bits
+  unread_bytes(self, offset);
   self->bit_buffer = 0;
   self->bit_count = 0;
   self->state = DECODER_STATE_UNCOMPRESSED_LENGTH;
@@ -95,31 +158,11 @@ static void start_uncompressed_block(UtDeflateDecoder *self) {
 
 // Prepare to decode a compressed data block using fixed Huffman codes.
 static void start_fixed_compressed_block(UtDeflateDecoder *self) {
-  UtObjectRef literal_length_code_widths = ut_uint8_list_new();
-  for (size_t symbol = 0; symbol <= 287; symbol++) {
-    uint8_t code_width;
-    if (symbol <= 143) {
-      code_width = 8;
-    } else if (symbol <= 255) {
-      code_width = 9;
-    } else if (symbol <= 279) {
-      code_width = 7;
-    } else {
-      code_width = 8;
-    }
-    ut_uint8_list_append(literal_length_code_widths, code_width);
-  }
   ut_object_unref(self->literal_length_huffman_decoder);
   self->literal_length_huffman_decoder =
-      ut_huffman_decoder_new_canonical(literal_length_code_widths);
-
-  UtObjectRef distance_code_widths = ut_uint8_list_new();
-  for (size_t symbol = 0; symbol < 32; symbol++) {
-    ut_uint8_list_append(distance_code_widths, 5);
-  }
+      deflate_fixed_literal_length_huffman_decoder_new();
   ut_object_unref(self->distance_huffman_decoder);
-  self->distance_huffman_decoder =
-      ut_huffman_decoder_new_canonical(distance_code_widths);
+  self->distance_huffman_decoder = deflate_fixed_distance_huffman_decoder_new();
 
   self->state = DECODER_STATE_LITERAL_LENGTH;
 }
@@ -129,72 +172,17 @@ static void start_dynamic_compressed_block(UtDeflateDecoder *self) {
   self->state = DECODER_STATE_DYNAMIC_HUFFMAN_LENGTHS;
 }
 
-static size_t get_remaining_bits(UtDeflateDecoder *self, UtObject *data,
-                                 size_t *offset) {
-  return self->bit_count + (ut_list_get_length(data) - *offset) * 8;
-}
-
-static uint8_t read_bit(UtDeflateDecoder *self, UtObject *data,
-                        size_t *offset) {
-  if (self->bit_count == 0) {
-    self->bit_buffer = ut_uint8_list_get_element(data, *offset);
-    self->bit_count = 8;
-    (*offset)++;
-  }
-
-  uint8_t value = self->bit_buffer & 0x01;
-  self->bit_buffer >>= 1;
-  self->bit_count--;
-
-  return value;
-}
-
-static uint16_t read_int(UtDeflateDecoder *self, size_t length, UtObject *data,
-                         size_t *offset) {
-  uint16_t value = 0;
-  for (size_t i = 0; i < length; i++) {
-    value |= read_bit(self, data, offset) << i;
-  }
-
-  return value;
-}
-
-static bool read_huffman_symbol(UtDeflateDecoder *self, UtObject *data,
-                                size_t *offset, UtObject *decoder,
-                                uint16_t *symbol) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-
-  for (size_t i = 0; i < remaining; i++) {
-    self->code = self->code << 1 | read_bit(self, data, offset);
-    self->code_width++;
-
-    if (ut_huffman_decoder_get_symbol(decoder, self->code, self->code_width,
-                                      symbol)) {
-      if (*symbol == 65535) {
-        set_error(self, "Invalid Huffman code in deflate data");
-        return false;
-      }
-      self->code = 0;
-      self->code_width = 0;
-      return true;
-    }
-  }
-
-  return false;
-}
-
-static bool read_block_header(UtDeflateDecoder *self, UtObject *data,
-                              size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 3) {
+static bool read_block_header(UtDeflateDecoder *self, const uint8_t *data,
+                              size_t data_length, size_t *offset) {
+  if (!have_bits(self, data, data_length, offset, 3)) {
     return false;
   }
 
-  self->is_last_block = read_bit(self, data, offset) == 1;
-  uint8_t block_type = read_int(self, 2, data, offset);
+  self->is_last_block = read_int(self, 1) == 1;
+  uint8_t block_type = read_int(self, 2);
   switch (block_type) {
   case 0:
-    start_uncompressed_block(self);
+    start_uncompressed_block(self, offset);
     return true;
   case 1:
     start_fixed_compressed_block(self);
@@ -208,15 +196,17 @@ static bool read_block_header(UtDeflateDecoder *self, UtObject *data,
   }
 }
 
-static bool read_uncompressed_length(UtDeflateDecoder *self, UtObject *data,
+static bool read_uncompressed_length(UtDeflateDecoder *self,
+                                     const uint8_t *data, size_t data_length,
                                      size_t *offset) {
-  size_t remaining = ut_list_get_length(data) - *offset;
+  size_t remaining = data_length - *offset;
   if (remaining < 4) {
     return false;
   }
 
-  self->length = ut_uint8_list_get_uint16_le(data, *offset);
-  uint16_t nlength = ut_uint8_list_get_uint16_le(data, *offset + 2);
+  const uint8_t *d = data + *offset;
+  self->length = d[0] | d[1] << 8;
+  uint16_t nlength = d[2] | d[3] << 8;
 
   if ((self->length ^ nlength) != 0xffff) {
     set_error(self, "Invalid deflate uncompressed length checksum");
@@ -228,16 +218,16 @@ static bool read_uncompressed_length(UtDeflateDecoder *self, UtObject *data,
   return true;
 }
 
-static bool read_dynamic_huffman_lengths(UtDeflateDecoder *self, UtObject *data,
-                                         size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 14) {
+static bool read_dynamic_huffman_lengths(UtDeflateDecoder *self,
+                                         const uint8_t *data,
+                                         size_t data_length, size_t *offset) {
+  if (!have_bits(self, data, data_length, offset, 14)) {
     return false;
   }
 
-  self->n_literal_length_codes = 257 + read_int(self, 5, data, offset);
-  self->n_distance_codes = 1 + read_int(self, 5, data, offset);
-  self->n_code_width_codes = 4 + read_int(self, 4, data, offset);
+  self->n_literal_length_codes = 257 + read_int(self, 5);
+  self->n_distance_codes = 1 + read_int(self, 5);
+  self->n_code_width_codes = 4 + read_int(self, 4);
 
   ut_object_unref(self->code_widths);
   self->code_widths = ut_uint8_list_new();
@@ -252,22 +242,20 @@ static bool read_dynamic_huffman_lengths(UtDeflateDecoder *self, UtObject *data,
 }
 
 static bool read_dynamic_huffman_code_width_code(UtDeflateDecoder *self,
-                                                 UtObject *data,
+                                                 const uint8_t *data,
+                                                 size_t data_length,
                                                  size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 3 * self->n_code_width_codes) {
+  // Up to 57 bits, which always fits in the bit buffer.
+  if (!have_bits(self, data, data_length, offset,
+                 3 * self->n_code_width_codes)) {
     return false;
   }
 
-  // Order that code widths are stored in.
-  const uint8_t code_width_symbol_order[19] = {
-      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
-
   UtObjectRef code_widths = ut_uint8_array_new_sized(19);
   uint8_t *code_widths_data = ut_uint8_list_get_writable_data(code_widths);
   for (size_t i = 0; i < self->n_code_width_codes; i++) {
-    uint8_t code_width_symbol = code_width_symbol_order[i];
-    code_widths_data[code_width_symbol] = read_int(self, 3, data, offset);
+    uint8_t code_width_symbol = deflate_code_width_symbol_order[i];
+    code_widths_data[code_width_symbol] = read_int(self, 3);
   }
   self->code_width_huffman_decoder =
       ut_huffman_decoder_new_canonical(code_widths);
@@ -316,10 +304,12 @@ static void use_code_width(UtDeflateDecoder *self, uint8_t code_width) {
 }
 
 static bool read_dynamic_huffman_code_width(UtDeflateDecoder *self,
-                                            UtObject *data, size_t *offset) {
+                                            const uint8_t *data,
+                                            size_t data_length,
+                                            size_t *offset) {
   uint16_t symbol;
-  if (!read_huffman_symbol(self, data, offset, self->code_width_huffman_decoder,
-                           &symbol)) {
+  if (!read_huffman_symbol(self, data, data_length, offset,
+                           self->code_width_huffman_decoder, &symbol)) {
     return false;
   }
 
@@ -349,14 +339,14 @@ static void repeat_code_width(UtDeflateDecoder *self, uint8_t code_width,
 }
 
 static bool read_dynamic_huffman_code_width_repeat(UtDeflateDecoder *self,
-                                                   UtObject *data,
+                                                   const uint8_t *data,
+                                                   size_t data_length,
                                                    size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 2) {
+  if (!have_bits(self, data, data_length, offset, 2)) {
     return false;
   }
 
-  size_t repeat_count = 3 + read_int(self, 2, data, offset);
+  size_t repeat_count = 3 + read_int(self, 2);
   size_t code_widths_length = ut_list_get_length(self->code_widths);
   if (code_widths_length == 0) {
     set_error(self, "Invalid deflate Huffman code width repeat");
@@ -370,53 +360,143 @@ static bool read_dynamic_huffman_code_width_repeat(UtDeflateDecoder *self,
 }
 
 static bool read_dynamic_huffman_code_width_repeat_zero_short(
-    UtDeflateDecoder *self, UtObject *data, size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 3) {
+    UtDeflateDecoder *self, const uint8_t *data, size_t data_length,
+    size_t *offset) {
+  if (!have_bits(self, data, data_length, offset, 3)) {
     return false;
   }
 
-  size_t repeat_count = 3 + read_int(self, 3, data, offset);
+  size_t repeat_count = 3 + read_int(self, 3);
   repeat_code_width(self, 0, repeat_count);
 
   return true;
 }
 
 static bool read_dynamic_huffman_code_width_repeat_zero_long(
-    UtDeflateDecoder *self, UtObject *data, size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-  if (remaining < 7) {
+    UtDeflateDecoder *self, const uint8_t *data, size_t data_length,
+    size_t *offset) {
+  if (!have_bits(self, data, data_length, offset, 7)) {
     return false;
   }
 
-  size_t repeat_count = 11 + read_int(self, 7, data, offset);
+  size_t repeat_count = 11 + read_int(self, 7);
   repeat_code_width(self, 0, repeat_count);
 
   return true;
 }
 
-static bool read_uncompressed_data(UtDeflateDecoder *self, UtObject *data,
-                                   size_t *offset) {
-  size_t remaining = ut_list_get_length(data) - *offset;
-  if (remaining < self->length) {
+static bool read_uncompressed_data(UtDeflateDecoder *self, const uint8_t *data,
+                                   size_t data_length, size_t *offset) {
+  // Copy as much as is available, rather than waiting for the whole block.
+  size_t length = data_length - *offset;
+  if (length > self->length) {
+    length = self->length;
+  }
+  ut_uint8_list_append_block(self->buffer, data + *offset, length);
+  *offset += length;
+  self->length -= length;
+  if (self->length > 0) {
     return false;
   }
 
-  for (size_t i = 0; i < self->length; i++) {
-    ut_uint8_list_append(self->buffer,
-                         ut_uint8_list_get_element(data, *offset + i));
-  }
-
-  *offset += self->length;
   self->state =
       self->is_last_block ? DECODER_STATE_DONE : DECODER_STATE_BLOCK_HEADER;
   return true;
 }
 
-static bool read_literal_length(UtDeflateDecoder *self, UtObject *data,
-                                size_t *offset) {
+// Copy [length] bytes from [distance] bytes before [output] to [output].
+// The source and destination overlap when [distance] is less than [length], so
+// the data is copied in pieces that have already been written.
+static void copy_match(uint8_t *output, size_t distance, size_t length) {
+  const uint8_t *source = output - distance;
+  if (distance == 1) {
+    memset(output, source[0], length);
+    return;
+  }
+  while (length > 0) {
+    size_t n = distance < length ? distance : length;
+    memcpy(output, source, n);
+    output += n;
+    length -= n;
+  }
+}
+
+// Decode literals and matches directly into the buffer while there is enough
+// input to be sure each symbol is complete. This avoids going through the
+// state machine for every symbol.
+static void decode_fast(UtDeflateDecoder *self, const uint8_t *data,
+                        size_t data_length, size_t *offset) {
+  size_t buffer_length = ut_list_get_length(self->buffer);
+  size_t allocated_length = buffer_length;
+  uint8_t *buffer = NULL;
+  while (true) {
+    fill_bits(self, data, data_length, offset);
+    if (self->bit_count < MAX_SYMBOL_BITS) {
+      break;
+    }
+
+    if (buffer_length + MAX_MATCH_LENGTH > allocated_length) {
+      allocated_length = buffer_length + FAST_OUTPUT_LENGTH;
+      ut_list_resize(self->buffer, allocated_length);
+      buffer = ut_uint8_list_get_writable_data(self->buffer);
+    }
+
+    uint16_t symbol;
+    size_t code_width = ut_huffman_decoder_lookup_lsb_first(
+        self->literal_length_huffman_decoder, self->bit_buffer, &symbol);
+    if (code_width == 0) {
+      set_error(self, "Invalid Huffman code in deflate data");
+      break;
+    }
+    self->bit_buffer >>= code_width;
+    self->bit_count -= code_width;
+
+    if (symbol < 256) {
+      buffer[buffer_length++] = symbol;
+      continue;
+    } else if (symbol == 256) {
+      self->state =
+          self->is_last_block ? DECODER_STATE_DONE : DECODER_STATE_BLOCK_HEADER;
+      break;
+    } else if (symbol > 285) {
+      set_error(self, "Invalid deflate Huffman code");
+      break;
+    }
+    size_t length = deflate_base_lengths[symbol - 257] +
+                    read_int(self, deflate_extra_length_bits[symbol - 257]);
+
+    code_width = ut_huffman_decoder_lookup_lsb_first(
+        self->distance_huffman_decoder, self->bit_buffer, &symbol);
+    if (code_width == 0) {
+      set_error(self, "Invalid Huffman code in deflate data");
+      break;
+    }
+    self->bit_buffer >>= code_width;
+    self->bit_count -= code_width;
+    if (symbol > 29) {
+      set_error(self, "Invalid deflate distance code");
+      break;
+    }
+    size_t distance = deflate_base_distances[symbol] +
+                      read_int(self, deflate_extra_distance_bits[symbol]);
+    if (distance > buffer_length) {
+      set_error(self, "Invalid deflate distance");
+      break;
+    }
+
+    copy_match(buffer + buffer_length, distance, length);
+    buffer_length += length;
+  }
+
+  if (allocated_length != buffer_length) {
+    ut_list_resize(self->buffer, buffer_length);
+  }
+}
+
+static bool read_literal_length(UtDeflateDecoder *self, const uint8_t *data,
+                                size_t data_length, size_t *offset) {
   uint16_t symbol;
-  if (!read_huffman_symbol(self, data, offset,
+  if (!read_huffman_symbol(self, data, data_length, offset,
                            self->literal_length_huffman_decoder, &symbol)) {
     return false;
   }
@@ -438,27 +518,25 @@ static bool read_literal_length(UtDeflateDecoder *self, UtObject *data,
   }
 }
 
-static bool read_length(UtDeflateDecoder *self, UtObject *data,
-                        size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-
-  uint8_t bit_count = extra_length_bits[self->length_symbol - 257];
-  if (remaining < bit_count) {
+static bool read_length(UtDeflateDecoder *self, const uint8_t *data,
+                        size_t data_length, size_t *offset) {
+  uint8_t bit_count = deflate_extra_length_bits[self->length_symbol - 257];
+  if (!have_bits(self, data, data_length, offset, bit_count)) {
     return false;
   }
 
-  uint16_t extra = read_int(self, bit_count, data, offset);
-  self->length = base_lengths[self->length_symbol - 257] + extra;
+  uint16_t extra = read_int(self, bit_count);
+  self->length = deflate_base_lengths[self->length_symbol - 257] + extra;
 
   self->state = DECODER_STATE_DISTANCE;
   return true;
 }
 
-static bool read_distance(UtDeflateDecoder *self, UtObject *data,
-                          size_t *offset) {
+static bool read_distance(UtDeflateDecoder *self, const uint8_t *data,
+                          size_t data_length, size_t *offset) {
   uint16_t symbol;
-  if (!read_huffman_symbol(self, data, offset, self->distance_huffman_decoder,
-                           &symbol)) {
+  if (!read_huffman_symbol(self, data, data_length, offset,
+                           self->distance_huffman_decoder, &symbol)) {
     return false;
   }
 
@@ -475,81 +553,108 @@ static bool read_distance(UtDeflateDecoder *self, UtObject *data,
   return true;
 }
 
-static bool read_distance_extension(UtDeflateDecoder *self, UtObject *data,
+static bool read_distance_extension(UtDeflateDecoder *self,
+                                    const uint8_t *data, size_t data_length,
                                     size_t *offset) {
-  size_t remaining = get_remaining_bits(self, data, offset);
-
-  uint8_t bit_count = distance_bits[self->distance_index];
-  if (remaining < bit_count) {
+  uint8_t bit_count = deflate_extra_distance_bits[self->distance_index];
+  if (!have_bits(self, data, data_length, offset, bit_count)) {
     return false;
   }
 
-  uint16_t extra = read_int(self, bit_count, data, offset);
-  uint16_t distance = base_distances[self->distance_index] + extra;
+  uint16_t extra = read_int(self, bit_count);
+  uint16_t distance = deflate_base_distances[self->distance_index] + extra;
 
   size_t buffer_length = ut_list_get_length(self->buffer);
   if (distance > buffer_length) {
     set_error(self, "Invalid deflate distance");
     return true;
   }
-  size_t start = buffer_length - distance;
-  for (size_t i = 0; i < self->length; i++) {
-    ut_uint8_list_append(self->buffer,
-                         ut_uint8_list_get_element(self->buffer, start + i));
-  }
+  ut_list_resize(self->buffer, buffer_length + self->length);
+  copy_match(ut_uint8_list_get_writable_data(self->buffer) + buffer_length,
+             distance, self->length);
 
   self->state = DECODER_STATE_LITERAL_LENGTH;
 
   return true;
 }
 
+// Remove data from the buffer that has been read and is outside the window.
+static void trim_buffer(UtDeflateDecoder *self) {
+  size_t buffer_length = ut_list_get_length(self->buffer);
+  size_t start = buffer_length > WINDOW_SIZE ? buffer_length - WINDOW_SIZE : 0;
+  if (self->buffer_read_offset < start) {
+    start = self->buffer_read_offset;
+  }
+
+  // Only trim when a significant amount can be removed, to avoid moving the
+  // data too often.
+  if (start >= TRIM_LENGTH) {
+    ut_list_remove(self->buffer, 0, start);
+    self->buffer_read_offset -= start;
+  }
+}
+
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   UtDeflateDecoder *self = (UtDeflateDecoder *)object;
 
+  // Decode from contiguous memory, copying if the data is not stored that way.
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  UtObjectRef data_copy = NULL;
+  if (d == NULL && data_length > 0) {
+    data_copy = ut_list_copy(data);
+    d = ut_uint8_list_get_data(data_copy);
+  }
+
   size_t offset = 0;
   bool decoding = true;
   while (decoding) {
     switch (self->state) {
     case DECODER_STATE_BLOCK_HEADER:
-      decoding = read_block_header(self, data, &offset);
+      decoding = read_block_header(self, d, data_length, &offset);
       break;
     case DECODER_STATE_UNCOMPRESSED_LENGTH:
-      decoding = read_uncompressed_length(self, data, &offset);
+      decoding = read_uncompressed_length(self, d, data_length, &offset);
       break;
     case DECODER_STATE_UNCOMPRESSED_DATA:
-      decoding = read_uncompressed_data(self, data, &offset);
+      decoding = read_uncompressed_data(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_LENGTHS:
-      decoding = read_dynamic_huffman_lengths(self, data, &offset);
+      decoding = read_dynamic_huffman_lengths(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_CODE_WIDTH_CODE:
-      decoding = read_dynamic_huffman_code_width_code(self, data, &offset);
+      decoding =
+          read_dynamic_huffman_code_width_code(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_CODE_WIDTH:
-      decoding = read_dynamic_huffman_code_width(self, data, &offset);
+      decoding = read_dynamic_huffman_code_width(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_CODE_WIDTH_REPEAT:
-      decoding = read_dynamic_huffman_code_width_repeat(self, data, &offset);
+      decoding =
+          read_dynamic_huffman_code_width_repeat(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_CODE_WIDTH_REPEAT_ZERO_SHORT:
-      decoding = read_dynamic_huffman_code_width_repeat_zero_short(self, data,
-                                                                   &offset);
+      decoding = read_dynamic_huffman_code_width_repeat_zero_short(
+          self, d, data_length, &offset);
       break;
     case DECODER_STATE_DYNAMIC_HUFFMAN_CODE_WIDTH_REPEAT_ZERO_LONG:
-      decoding =
-          read_dynamic_huffman_code_width_repeat_zero_long(self, data, &offset);
+      decoding = read_dynamic_huffman_code_width_repeat_zero_long(
+          self, d, data_length, &offset);
       break;
     case DECODER_STATE_LITERAL_LENGTH:
-      decoding = read_literal_length(self, data, &offset);
+      decode_fast(self, d, data_length, &offset);
+      if (self->state == DECODER_STATE_LITERAL_LENGTH) {
+        decoding = read_literal_length(self, d, data_length, &offset);
+      }
       break;
     case DECODER_STATE_LENGTH:
-      decoding = read_length(self, data, &offset);
+      decoding = read_length(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DISTANCE:
-      decoding = read_distance(self, data, &offset);
+      decoding = read_distance(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DISTANCE_EXTENSION:
-      decoding = read_distance_extension(self, data, &offset);
+      decoding = read_distance_extension(self, d, data_length, &offset);
       break;
     case DECODER_STATE_DONE:
       ut_input_stream_close(self->input_stream);
@@ -564,6 +669,10 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
     }
   }
 
+  // Only keep partially read bytes, so whole bytes are read again in the next
+  // call and the data following the end of the deflate stream is left unused.
+  unread_bytes(self, &offset);
+
   size_t buffer_length = ut_list_get_length(self->buffer);
   UtObjectRef unread_buffer =
       ut_list_get_sublist(self->buffer, self->buffer_read_offset,
@@ -574,6 +683,8 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
                       : 0;
   self->buffer_read_offset += n_used;
 
+  trim_buffer(self);
+
   return offset;
 }
 
@@ -631,6 +742,18 @@ UtObject *ut_deflate_decoder_new(UtObject *input_stream) {
   return object;
 }
 
+void ut_deflate_decoder_set_dictionary(UtObject *object, UtObject *dictionary) {
+  assert(ut_object_is_deflate_decoder(object));
+  UtDeflateDecoder *self = (UtDeflateDecoder *)object;
+
+  assert(self->state == DECODER_STATE_BLOCK_HEADER);
+  assert(ut_list_get_length(self->buffer) == 0);
+
+  // The dictionary precedes the decoded data, but is not output.
+  ut_list_append_list(self->buffer, dictionary);
+  self->buffer_read_offset = ut_list_get_length(dictionary);
+}
+
 bool ut_object_is_deflate_decoder(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
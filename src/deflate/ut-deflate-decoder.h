@@ -11,5 +11,12 @@
 /// !return-ref
 UtObject *ut_deflate_decoder_new(UtObject *input_stream);
 
+/// Sets [dictionary] as data that precedes the decoded data, so matches in
+/// data encoded with the same dictionary can refer to it. The dictionary is
+/// not included in the output. Must be called before any data is decoded.
+///
+/// !arg-type dictionary UtUint8List
+void ut_deflate_decoder_set_dictionary(UtObject *object, UtObject *dictionary);
+
 /// Returns [true] if [object] is a [UtDeflateDecoder].
 bool ut_object_is_deflate_decoder(UtObject *object);
@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures compression ratio and speed at each compression level.
+
+static void benchmark(const char *name, UtObject *data,
+                      UtDeflateCompressionLevel compression_level,
+                      const char *level_name) {
+  size_t data_length = ut_list_get_length(data);
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder =
+      ut_deflate_encoder_new_full(compression_level, 32768, data_stream);
+  UtObjectRef encoded_data = ut_input_stream_read_sync(encoder);
+  double duration = ut_benchmark_get_time() - start;
+
+  // Check data is correctly encoded.
+  UtObjectRef encoded_data_stream = ut_list_input_stream_new(encoded_data);
+  UtObjectRef decoder = ut_deflate_decoder_new(encoded_data_stream);
+  UtObjectRef decoded_data = ut_input_stream_read_sync(decoder);
+  ut_assert_equal(decoded_data, data);
+
+  size_t encoded_length = ut_list_get_length(encoded_data);
+  printf("%-6s %-7s %8zi -> %8zi bytes: ratio %5.2f, %6.1f MB/s\n", name,
+         level_name, data_length, encoded_length,
+         (double)data_length / encoded_length, data_length / duration / 1e6);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef text = ut_benchmark_make_text(1024 * 1024);
+  UtObjectRef binary = ut_benchmark_make_binary(1024 * 1024);
+
+  UtDeflateCompressionLevel levels[] = {
+      UT_DEFLATE_COMPRESSION_LEVEL_FASTEST, UT_DEFLATE_COMPRESSION_LEVEL_FAST,
+      UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT,
+      UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM};
+  const char *level_names[] = {"fastest", "fast", "default", "maximum"};
+  for (size_t i = 0; i < 4; i++) {
+    benchmark("text", text, levels[i], level_names[i]);
+  }
+  for (size_t i = 0; i < 4; i++) {
+    benchmark("binary", binary, levels[i], level_names[i]);
+  }
+
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include "ut-benchmark.h"
 #include "ut.h"
 
 static UtObject *get_utf8_data(const char *value) {
@@ -10,6 +11,155 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   return ut_list_get_length(data);
 }
 
+// Compress [data] with [compression_level] and check it decompresses back to
+// the same data. Returns the compressed length.
+static size_t check_round_trip(UtObject *data,
+                               UtDeflateCompressionLevel compression_level) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder =
+      ut_deflate_encoder_new_full(compression_level, 32768, data_stream);
+  UtObjectRef encoded_data = ut_input_stream_read_sync(encoder);
+  ut_assert_is_not_error(encoded_data);
+
+  UtObjectRef encoded_data_stream = ut_list_input_stream_new(encoded_data);
+  UtObjectRef decoder = ut_deflate_decoder_new(encoded_data_stream);
+  UtObjectRef decoded_data = ut_input_stream_read_sync(decoder);
+  ut_assert_is_not_error(decoded_data);
+  ut_assert_equal(decoded_data, data);
+
+  return ut_list_get_length(encoded_data);
+}
+
+static void test_round_trip() {
+  // Text with repeated words and runs, and random data, larger than the window
+  // and block sizes.
+  UtObjectRef text = ut_string_new("");
+  const char *words[] = {"the ", "quick ", "brown ", "fox ", "jumps ",
+                         "over ", "lazy ", "dog ", "\n", "aaaaaaaa"};
+  for (size_t i = 0; i < 40000; i++) {
+    ut_string_append(text, words[ut_benchmark_get_random() % 10]);
+  }
+  UtObjectRef text_data = ut_string_get_utf8(text);
+  UtObjectRef random_data = ut_uint8_array_new();
+  for (size_t i = 0; i < 100000; i++) {
+    ut_uint8_list_append(random_data, ut_benchmark_get_random());
+  }
+
+  size_t text_length = ut_list_get_length(text_data);
+  size_t fastest_length =
+      check_round_trip(text_data, UT_DEFLATE_COMPRESSION_LEVEL_FASTEST);
+  check_round_trip(text_data, UT_DEFLATE_COMPRESSION_LEVEL_FAST);
+  size_t default_length =
+      check_round_trip(text_data, UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT);
+  size_t maximum_length =
+      check_round_trip(text_data, UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM);
+  ut_assert_true(fastest_length < text_length / 4);
+  ut_assert_true(default_length <= fastest_length);
+  ut_assert_true(maximum_length <= default_length);
+
+  // Same result when the data arrives in pieces.
+  UtObjectRef text_data_stream = ut_list_input_stream_new(text_data);
+  UtObjectRef text_encoder = ut_deflate_encoder_new(text_data_stream);
+  UtObjectRef text_result = ut_input_stream_read_sync(text_encoder);
+  UtObjectRef chunked_data_stream = ut_buffered_input_stream_new();
+  UtObjectRef chunked_encoder = ut_deflate_encoder_new(chunked_data_stream);
+  UtObjectRef chunked_result = ut_uint8_array_new();
+  ut_input_stream_read(chunked_encoder, chunked_result, read_cb);
+  for (size_t offset = 0; offset < text_length; offset += 1000) {
+    size_t length = text_length - offset < 1000 ? text_length - offset : 1000;
+    UtObjectRef data = ut_list_get_sublist(text_data, offset, length);
+    ut_buffered_input_stream_write(chunked_data_stream, data,
+                                   offset + length == text_length);
+  }
+  ut_assert_equal(chunked_result, text_result);
+
+  // Random data is stored uncompressed, with a five byte header per block.
+  size_t random_length =
+      check_round_trip(random_data, UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT);
+  ut_assert_true(random_length <= 100000 + 5 * 7);
+}
+
+// Encode [data], using [dictionary] if not NULL.
+static UtObject *encode(UtObject *data, UtObject *dictionary, bool is_final) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_deflate_encoder_new(data_stream);
+  if (dictionary != NULL) {
+    ut_deflate_encoder_set_dictionary(encoder, dictionary);
+  }
+  ut_deflate_encoder_set_final(encoder, is_final);
+  return ut_input_stream_read_sync(encoder);
+}
+
+static void test_dictionary() {
+  // Non-final data ends in an empty uncompressed block.
+  UtObjectRef hello_data = get_utf8_data("hello");
+  UtObjectRef hello_result = encode(hello_data, NULL, false);
+  ut_assert_uint8_list_equal_hex(hello_result, "ca48cdc9c907000000ffff");
+
+  // Data matching the dictionary is encoded as a match.
+  UtObjectRef dictionary = get_utf8_data("hello world ");
+  UtObjectRef data = get_utf8_data("hello world hello world");
+  UtObjectRef result = encode(data, dictionary, true);
+  UtObjectRef result_without_dictionary = encode(data, NULL, true);
+  ut_assert_true(ut_list_get_length(result) <
+                 ut_list_get_length(result_without_dictionary));
+
+  // Joined with the encoded dictionary, it decodes as one stream.
+  UtObjectRef encoded_data = encode(dictionary, NULL, false);
+  ut_list_append_list(encoded_data, result);
+  UtObjectRef encoded_data_stream = ut_list_input_stream_new(encoded_data);
+  UtObjectRef decoder = ut_deflate_decoder_new(encoded_data_stream);
+  UtObjectRef decoded_data = ut_input_stream_read_sync(decoder);
+  ut_assert_is_not_error(decoded_data);
+  UtObjectRef decoded_text = ut_string_new_from_utf8(decoded_data);
+  ut_assert_cstring_equal(ut_string_get_text(decoded_text),
+                          "hello world hello world hello world");
+
+  // Decodes alone when the decoder has the same dictionary.
+  UtObjectRef result_stream = ut_list_input_stream_new(result);
+  UtObjectRef dictionary_decoder = ut_deflate_decoder_new(result_stream);
+  ut_deflate_decoder_set_dictionary(dictionary_decoder, dictionary);
+  UtObjectRef dictionary_decoded_data =
+      ut_input_stream_read_sync(dictionary_decoder);
+  ut_assert_is_not_error(dictionary_decoded_data);
+  ut_assert_equal(dictionary_decoded_data, data);
+}
+
+static void test_reset() {
+  UtObjectRef message1 = get_utf8_data("{\"id\": 1, \"name\": \"first\"}");
+  UtObjectRef message2 = get_utf8_data("{\"id\": 2, \"name\": \"second\"}");
+  UtObjectRef dictionary = get_utf8_data("{\"id\": , \"name\": \"\"}");
+
+  // A reset encoder gives the same result as a new encoder.
+  UtObjectRef message1_stream = ut_list_input_stream_new(message1);
+  UtObjectRef encoder = ut_deflate_encoder_new(message1_stream);
+  UtObjectRef result1 = ut_input_stream_read_sync(encoder);
+  UtObjectRef expected_result1 = encode(message1, NULL, true);
+  ut_assert_equal(result1, expected_result1);
+  for (size_t i = 0; i < 3; i++) {
+    UtObjectRef message2_stream = ut_list_input_stream_new(message2);
+    ut_deflate_encoder_reset(encoder, message2_stream);
+    UtObjectRef result2 = ut_input_stream_read_sync(encoder);
+    UtObjectRef expected_result2 = encode(message2, NULL, true);
+    ut_assert_equal(result2, expected_result2);
+  }
+
+  // Including when using a dictionary.
+  UtObjectRef message1_stream2 = ut_list_input_stream_new(message1);
+  ut_deflate_encoder_reset(encoder, message1_stream2);
+  ut_deflate_encoder_set_dictionary(encoder, dictionary);
+  UtObjectRef dictionary_result = ut_input_stream_read_sync(encoder);
+  UtObjectRef expected_dictionary_result = encode(message1, dictionary, true);
+  ut_assert_equal(dictionary_result, expected_dictionary_result);
+
+  // The dictionary is not used after the next reset.
+  UtObjectRef message2_stream = ut_list_input_stream_new(message2);
+  ut_deflate_encoder_reset(encoder, message2_stream);
+  UtObjectRef result2 = ut_input_stream_read_sync(encoder);
+  UtObjectRef expected_result2 = encode(message2, NULL, true);
+  ut_assert_equal(result2, expected_result2);
+}
+
 int main(int argc, char **argv) {
   UtObjectRef empty_data = ut_uint8_list_new();
   UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
@@ -102,5 +252,9 @@ int main(int argc, char **argv) {
   }
   ut_assert_uint8_list_equal_hex(short_write_result, "cb48cdc9c90700");
 
+  test_round_trip();
+  test_dictionary();
+  test_reset();
+
   return 0;
 }
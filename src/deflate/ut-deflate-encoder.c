@@ -1,12 +1,90 @@
 #include <assert.h>
+#include <stdlib.h>
 
+#include "ut-deflate.h"
 #include "ut.h"
 
-// Code used for blocks that use static Huffman codes.
+// Block types.
+#define BLOCK_UNCOMPRESSED 0
 #define BLOCK_STATIC_HUFFMAN 1
+#define BLOCK_DYNAMIC_HUFFMAN 2
 
-// Symbol used for end of stream.
-#define END_OF_STREAM 256
+// Symbol used for end of block.
+#define END_OF_BLOCK 256
+
+// Number of symbols in each code.
+#define N_LITERAL_LENGTH_SYMBOLS 288
+#define N_DISTANCE_SYMBOLS 30
+#define N_CODE_WIDTH_SYMBOLS 19
+
+// Maximum code widths allowed in dynamic Huffman codes.
+#define MAX_CODE_WIDTH 15
+#define MAX_CODE_WIDTH_CODE_WIDTH 7
+
+// Limits on the lengths of matches.
+#define MIN_MATCH_LENGTH 3
+#define MAX_MATCH_LENGTH 258
+
+// Data required after the current position before matching, so matches are not
+// cut short when more data is to come.
+#define MIN_LOOKAHEAD (MAX_MATCH_LENGTH + 1)
+
+// Minimum length matches further than this are more expensive than literals.
+#define MAX_SHORT_MATCH_DISTANCE 4096
+
+// Size of the hash table used to find matches.
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+
+// Maximum number of symbols in a block.
+#define MAX_BLOCK_SYMBOLS 16384
+
+// Maximum number of bytes in an uncompressed block.
+#define MAX_UNCOMPRESSED_BLOCK_LENGTH 65535
+
+// Parameters for searching for matches.
+typedef struct {
+  // Search less when the previous match is at least this long.
+  size_t good_match_length;
+
+  // Only look for a better match at the next position if the current match is
+  // shorter than this. If zero, matches are used as soon as they are found.
+  size_t max_lazy_match_length;
+
+  // Stop searching when a match this long is found.
+  size_t nice_match_length;
+
+  // Maximum number of previous positions to check for a match.
+  size_t max_chain_length;
+} MatchParameters;
+
+static const MatchParameters match_parameters[] = {
+    [UT_DEFLATE_COMPRESSION_LEVEL_FASTEST] = {4, 0, 8, 4},
+    [UT_DEFLATE_COMPRESSION_LEVEL_FAST] = {4, 0, 32, 32},
+    [UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT] = {8, 16, 128, 128},
+    [UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM] = {32, 258, 258, 4096}};
+
+// Huffman codes, stored with the first bit in the least significant bit so
+// they can be written directly.
+typedef struct {
+  uint16_t codes[N_LITERAL_LENGTH_SYMBOLS];
+  uint8_t widths[N_LITERAL_LENGTH_SYMBOLS];
+} CodeTable;
+
+// Dynamic Huffman codes for a block.
+typedef struct {
+  CodeTable literal_length;
+  CodeTable distance;
+  CodeTable code_width;
+  size_t n_literal_length_codes;
+  size_t n_distance_codes;
+  size_t n_code_width_codes;
+
+  // Run length encoded code widths.
+  uint8_t code_width_symbols[N_LITERAL_LENGTH_SYMBOLS + N_DISTANCE_SYMBOLS];
+  uint8_t code_width_extra[N_LITERAL_LENGTH_SYMBOLS + N_DISTANCE_SYMBOLS];
+  size_t code_width_symbols_length;
+} DynamicCodes;
 
 typedef struct {
   UtObject object;
@@ -15,255 +93,650 @@ typedef struct {
   UtInputStreamCallback callback;
 
   size_t window_size;
+  MatchParameters parameters;
 
-  // Huffman encoder for literal/length codes.
-  UtObject *literal_length_huffman_encoder;
+  // Codes used in blocks with static Huffman codes.
+  CodeTable static_literal_length;
+  CodeTable static_distance;
 
-  // Huffman necoder for distance codes.
-  UtObject *distance_huffman_encoder;
-
-  // Dictionary of sent data.
+  // Data being compressed, containing the previous [window_size] bytes for
+  // matching, the current block, and data not yet encoded.
   UtObject *dictionary;
 
+  // Stream position of the first byte in [dictionary].
+  size_t dictionary_start;
+
+  // Stream position of the next byte to encode.
+  size_t position;
+
+  // Most recent stream position + 1 with each hash, or 0 if none.
+  size_t *hash_head;
+
+  // Previous stream position + 1 with the same hash, indexed by position
+  // modulo [window_size].
+  size_t *hash_previous;
+
+  // Match at the previous position, used if no better match at this position.
+  bool have_previous_match;
+  size_t previous_match_length;
+  size_t previous_match_distance;
+
+  // Symbols in the current block. Literals have a distance of zero.
+  uint16_t *block_lengths;
+  uint16_t *block_distances;
+  size_t block_symbols_length;
+
+  // Stream positions the current block covers.
+  size_t block_start;
+  size_t block_end;
+
+  // Frequency of symbols in the current block.
+  size_t literal_length_counts[N_LITERAL_LENGTH_SYMBOLS];
+  size_t distance_counts[N_DISTANCE_SYMBOLS];
+
+  // Symbol weights used when generating dynamic Huffman codes.
+  UtObject *code_weights;
+
+  // True if the end of the data is written as the final block.
+  bool is_final;
+
   // Encoded data buffer.
-  bool written_header;
+  bool written_last_block;
   UtObject *buffer;
-  size_t partial_byte;
-  size_t partial_byte_length;
+  uint64_t bit_buffer;
+  size_t bit_count;
 } UtDeflateEncoder;
 
-// Write remaining partial byte to the buffer.
-static void end_bits(UtDeflateEncoder *self) {
-  if (self->partial_byte_length != 0) {
-    ut_uint8_list_append(self->buffer, self->partial_byte);
-    self->partial_byte = 0x00;
-    self->partial_byte_length = 0;
+// Returns the index of the highest set bit in [value].
+static size_t log2_floor(size_t value) {
+  size_t n = 0;
+  while (value > 1) {
+    value >>= 1;
+    n++;
   }
+  return n;
 }
 
-// Append a bit to the buffer.
-static void write_bit(UtDeflateEncoder *self, uint8_t value) {
-  self->partial_byte |= value << self->partial_byte_length;
-  self->partial_byte_length++;
-  if (self->partial_byte_length == 8) {
-    ut_uint8_list_append(self->buffer, self->partial_byte);
-    self->partial_byte = 0x00;
-    self->partial_byte_length = 0;
+// Get the symbol and extra bits used to encode a match [length].
+static uint16_t get_length_symbol(size_t length, size_t *extra) {
+  if (length == MAX_MATCH_LENGTH) {
+    *extra = 0;
+    return 285;
   }
+
+  size_t l = length - MIN_MATCH_LENGTH;
+  if (l < 8) {
+    *extra = 0;
+    return 257 + l;
+  }
+  size_t n = log2_floor(l);
+  *extra = l & ((1 << (n - 2)) - 1);
+  return 257 + 4 * (n - 1) + ((l >> (n - 2)) & 0x3);
 }
 
-// Write an integer to the buffer.
-static void write_int(UtDeflateEncoder *self, uint16_t value,
-                      size_t value_length) {
-  for (size_t i = 0; i < value_length; i++) {
-    write_bit(self, value & 0x1);
-    value >>= 1;
+// Get the symbol and extra bits used to encode a match [distance].
+static uint16_t get_distance_symbol(size_t distance, size_t *extra) {
+  size_t d = distance - 1;
+  if (d < 4) {
+    *extra = 0;
+    return d;
+  }
+  size_t n = log2_floor(d);
+  *extra = d & ((1 << (n - 1)) - 1);
+  return 2 * n + ((d >> (n - 1)) & 0x1);
+}
+
+// Reverse the order of the bits in [code] of [code_width] bits.
+static uint16_t reverse_bits(uint16_t code, size_t code_width) {
+  uint16_t value = 0;
+  for (size_t i = 0; i < code_width; i++) {
+    value = value << 1 | (code & 0x1);
+    code >>= 1;
+  }
+  return value;
+}
+
+// Get the codes from [huffman_encoder] for writing.
+static void get_code_table(UtObject *huffman_encoder, size_t n_symbols,
+                           CodeTable *table) {
+  for (size_t i = 0; i < n_symbols; i++) {
+    uint16_t code;
+    size_t code_width;
+    ut_huffman_encoder_get_code(huffman_encoder, i, &code, &code_width);
+    table->codes[i] = reverse_bits(code, code_width);
+    table->widths[i] = code_width;
+  }
+}
+
+// Generate codes for [n_symbols] with [counts].
+static void generate_code_table(UtDeflateEncoder *self, size_t *counts,
+                                size_t n_symbols, size_t max_code_width,
+                                CodeTable *table) {
+  // The weights list is reused for each table, so encoding small messages
+  // doesn't allocate it each time.
+  ut_list_resize(self->code_weights, n_symbols);
+  double *weights = ut_float64_list_get_writable_data(self->code_weights);
+  for (size_t i = 0; i < n_symbols; i++) {
+    weights[i] = counts[i];
+  }
+  UtObjectRef encoder =
+      ut_huffman_encoder_new_length_limited(self->code_weights, max_code_width);
+  get_code_table(encoder, n_symbols, table);
+  for (size_t i = n_symbols; i < N_LITERAL_LENGTH_SYMBOLS; i++) {
+    table->codes[i] = 0;
+    table->widths[i] = 0;
   }
 }
 
+// Append bits to the buffer.
+static void write_bits(UtDeflateEncoder *self, uint32_t value, size_t width) {
+  self->bit_buffer |= (uint64_t)value << self->bit_count;
+  self->bit_count += width;
+  if (self->bit_count >= 32) {
+    uint8_t bytes[4] = {self->bit_buffer, self->bit_buffer >> 8,
+                        self->bit_buffer >> 16, self->bit_buffer >> 24};
+    ut_uint8_list_append_block(self->buffer, bytes, 4);
+    self->bit_buffer >>= 32;
+    self->bit_count -= 32;
+  }
+}
+
+// Write remaining bits to the buffer, padding the last byte with zeros.
+static void end_bits(UtDeflateEncoder *self) {
+  while (self->bit_count > 0) {
+    ut_uint8_list_append(self->buffer, self->bit_buffer & 0xff);
+    self->bit_buffer >>= 8;
+    self->bit_count = self->bit_count > 8 ? self->bit_count - 8 : 0;
+  }
+  self->bit_buffer = 0;
+}
+
 // Write a deflate block header.
 static void write_block_header(UtDeflateEncoder *self, bool is_last_block,
                                uint8_t block_type) {
-  write_bit(self, is_last_block ? 1 : 0);
-  write_int(self, block_type, 2);
+  write_bits(self, is_last_block ? 1 : 0, 1);
+  write_bits(self, block_type, 2);
 }
 
 // Write a Huffman encoded symbol.
-static void write_symbol(UtDeflateEncoder *self, UtObject *huffman_encoder,
+static void write_symbol(UtDeflateEncoder *self, CodeTable *table,
                          uint16_t symbol) {
-  uint16_t code;
-  size_t code_width;
-  ut_huffman_encoder_get_code(huffman_encoder, symbol, &code, &code_width);
-  for (size_t i = 0; i < code_width; i++) {
-    write_bit(self, (code >> (code_width - i - 1)) & 0x1);
+  assert(table->widths[symbol] > 0);
+  write_bits(self, table->codes[symbol], table->widths[symbol]);
+}
+
+// Get the hash of the three bytes at [data].
+static size_t get_hash(const uint8_t *data) {
+  uint32_t value = data[0] | data[1] << 8 | data[2] << 16;
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Add hashes for positions [from] to [to] so they can be matched.
+static void insert_hashes(UtDeflateEncoder *self, const uint8_t *dictionary,
+                          size_t end, size_t from, size_t to) {
+  if (to + MIN_MATCH_LENGTH > end) {
+    to = end >= MIN_MATCH_LENGTH ? end - MIN_MATCH_LENGTH + 1 : 0;
+  }
+  for (size_t position = from; position < to; position++) {
+    size_t hash = get_hash(dictionary + position - self->dictionary_start);
+    self->hash_previous[position % self->window_size] = self->hash_head[hash];
+    self->hash_head[hash] = position + 1;
   }
 }
 
-// Find a match in the dictionary.
-static void find_match(UtDeflateEncoder *self, size_t data_length,
-                       size_t *best_distance, size_t *best_length) {
-  const uint8_t *dictionary = ut_uint8_list_get_data(self->dictionary);
-  size_t dictionary_length = ut_list_get_length(self->dictionary);
-  const uint8_t *data = dictionary + dictionary_length - data_length;
+// Find the longest match for the data at [position], returning the length and
+// setting [distance]. Returns 0 if no useful match.
+static size_t find_match(UtDeflateEncoder *self, const uint8_t *dictionary,
+                         size_t end, size_t position,
+                         size_t previous_match_length, size_t *distance) {
+  size_t max_length = end - position;
+  if (max_length > MAX_MATCH_LENGTH) {
+    max_length = MAX_MATCH_LENGTH;
+  }
+  if (max_length < MIN_MATCH_LENGTH) {
+    return 0;
+  }
+
+  size_t chain_length = self->parameters.max_chain_length;
+  if (previous_match_length >= self->parameters.good_match_length) {
+    chain_length >>= 2;
+  }
+  size_t nice_length = self->parameters.nice_match_length;
+  if (nice_length > max_length) {
+    nice_length = max_length;
+  }
+
+  const uint8_t *data = dictionary + position - self->dictionary_start;
+  size_t best_length = MIN_MATCH_LENGTH - 1;
+  size_t best_distance = 0;
+  size_t candidate = self->hash_head[get_hash(data)];
+  while (candidate != 0 && chain_length > 0) {
+    size_t match_position = candidate - 1;
+    size_t d = position - match_position;
+    if (d > self->window_size || match_position < self->dictionary_start) {
+      break;
+    }
 
-  size_t max_distance = dictionary_length - data_length;
-  if (max_distance >= self->window_size) {
-    max_distance = self->window_size;
+    // Check the byte that would make this match longer first, as that is the
+    // most likely to be different.
+    const uint8_t *match = data - d;
+    if (match[best_length] == data[best_length] && match[0] == data[0] &&
+        match[1] == data[1]) {
+      size_t length = 2;
+      while (length < max_length && match[length] == data[length]) {
+        length++;
+      }
+      if (length > best_length) {
+        best_length = length;
+        best_distance = d;
+        if (length >= nice_length) {
+          break;
+        }
+      }
+    }
+
+    // Stop if the chain has been overwritten by newer positions.
+    size_t next = self->hash_previous[match_position % self->window_size];
+    if (next >= candidate) {
+      break;
+    }
+    candidate = next;
+    chain_length--;
+  }
+
+  if (best_length < MIN_MATCH_LENGTH ||
+      (best_length == MIN_MATCH_LENGTH &&
+       best_distance > MAX_SHORT_MATCH_DISTANCE)) {
+    return 0;
+  }
+
+  *distance = best_distance;
+  return best_length;
+}
+
+// Add a literal [value] to the current block.
+static void add_literal(UtDeflateEncoder *self, uint8_t value) {
+  self->block_lengths[self->block_symbols_length] = value;
+  self->block_distances[self->block_symbols_length] = 0;
+  self->block_symbols_length++;
+  self->block_end++;
+  self->literal_length_counts[value]++;
+}
+
+// Add a match of [length] bytes from [distance] bytes ago to the current block.
+static void add_match(UtDeflateEncoder *self, size_t length, size_t distance) {
+  self->block_lengths[self->block_symbols_length] = length;
+  self->block_distances[self->block_symbols_length] = distance;
+  self->block_symbols_length++;
+  self->block_end += length;
+  size_t extra;
+  self->literal_length_counts[get_length_symbol(length, &extra)]++;
+  self->distance_counts[get_distance_symbol(distance, &extra)]++;
+}
+
+// Returns the number of bits used to encode the current block with [table]s,
+// not including extra bits.
+static size_t get_encoded_length(UtDeflateEncoder *self,
+                                 CodeTable *literal_length_table,
+                                 CodeTable *distance_table) {
+  size_t length = 0;
+  for (size_t i = 0; i < N_LITERAL_LENGTH_SYMBOLS; i++) {
+    length += self->literal_length_counts[i] * literal_length_table->widths[i];
+  }
+  for (size_t i = 0; i < N_DISTANCE_SYMBOLS; i++) {
+    length += self->distance_counts[i] * distance_table->widths[i];
   }
+  return length;
+}
 
-  size_t best_distance_ = 0;
-  size_t best_length_ = 0;
-  for (size_t distance = 1; distance <= max_distance; distance++) {
-    const uint8_t *match = data - distance;
+// Add a run length encoded code width [symbol].
+static void add_code_width_symbol(DynamicCodes *codes, uint8_t symbol,
+                                  uint8_t extra) {
+  codes->code_width_symbols[codes->code_width_symbols_length] = symbol;
+  codes->code_width_extra[codes->code_width_symbols_length] = extra;
+  codes->code_width_symbols_length++;
+}
 
-    // Can't match more than the data we have.
-    size_t max_length = data_length;
-    if (max_length > 285) {
-      max_length = 285;
+// Run length encode [widths].
+static void encode_code_widths(DynamicCodes *codes, const uint8_t *widths,
+                               size_t widths_length) {
+  codes->code_width_symbols_length = 0;
+  size_t i = 0;
+  while (i < widths_length) {
+    uint8_t width = widths[i];
+    size_t run_length = 1;
+    while (i + run_length < widths_length &&
+           widths[i + run_length] == width) {
+      run_length++;
     }
+    i += run_length;
 
-    size_t length;
-    for (length = 0; length < max_length; length++) {
-      if (match[length] != data[length]) {
-        break;
+    if (width == 0) {
+      while (run_length >= 11) {
+        size_t n = run_length < 138 ? run_length : 138;
+        add_code_width_symbol(codes, 18, n - 11);
+        run_length -= n;
+      }
+      if (run_length >= 3) {
+        add_code_width_symbol(codes, 17, run_length - 3);
+        run_length = 0;
+      }
+    } else {
+      add_code_width_symbol(codes, width, 0);
+      run_length--;
+      while (run_length >= 3) {
+        size_t n = run_length < 6 ? run_length : 6;
+        add_code_width_symbol(codes, 16, n - 3);
+        run_length -= n;
       }
     }
+    for (; run_length > 0; run_length--) {
+      add_code_width_symbol(codes, width, 0);
+    }
+  }
+}
+
+// Generate dynamic Huffman codes for the current block, returning the number
+// of bits used to encode the codes and the block symbols, not including extra
+// bits.
+static size_t generate_dynamic_codes(UtDeflateEncoder *self,
+                                     DynamicCodes *codes) {
+  generate_code_table(self, self->literal_length_counts, 286, MAX_CODE_WIDTH,
+                      &codes->literal_length);
+  generate_code_table(self, self->distance_counts, N_DISTANCE_SYMBOLS,
+                      MAX_CODE_WIDTH, &codes->distance);
+
+  // Trim unused codes.
+  codes->n_literal_length_codes = 286;
+  while (codes->n_literal_length_codes > 257 &&
+         codes->literal_length.widths[codes->n_literal_length_codes - 1] == 0) {
+    codes->n_literal_length_codes--;
+  }
+  codes->n_distance_codes = N_DISTANCE_SYMBOLS;
+  while (codes->n_distance_codes > 1 &&
+         codes->distance.widths[codes->n_distance_codes - 1] == 0) {
+    codes->n_distance_codes--;
+  }
+
+  // Code widths are stored together, using run length encoding.
+  uint8_t widths[N_LITERAL_LENGTH_SYMBOLS + N_DISTANCE_SYMBOLS];
+  size_t widths_length = 0;
+  for (size_t i = 0; i < codes->n_literal_length_codes; i++) {
+    widths[widths_length++] = codes->literal_length.widths[i];
+  }
+  for (size_t i = 0; i < codes->n_distance_codes; i++) {
+    widths[widths_length++] = codes->distance.widths[i];
+  }
+  encode_code_widths(codes, widths, widths_length);
+
+  size_t code_width_counts[N_CODE_WIDTH_SYMBOLS] = {0};
+  size_t length = 5 + 5 + 4;
+  for (size_t i = 0; i < codes->code_width_symbols_length; i++) {
+    uint8_t symbol = codes->code_width_symbols[i];
+    code_width_counts[symbol]++;
+    length += symbol == 16 ? 2 : (symbol == 17 ? 3 : (symbol == 18 ? 7 : 0));
+  }
+  generate_code_table(self, code_width_counts, N_CODE_WIDTH_SYMBOLS,
+                      MAX_CODE_WIDTH_CODE_WIDTH, &codes->code_width);
+  codes->n_code_width_codes = N_CODE_WIDTH_SYMBOLS;
+  while (codes->n_code_width_codes > 4 &&
+         codes->code_width.widths[deflate_code_width_symbol_order
+                                      [codes->n_code_width_codes - 1]] == 0) {
+    codes->n_code_width_codes--;
+  }
+  length += 3 * codes->n_code_width_codes;
+  for (size_t i = 0; i < N_CODE_WIDTH_SYMBOLS; i++) {
+    length += code_width_counts[i] * codes->code_width.widths[i];
+  }
 
-    if (length > best_length_) {
-      best_distance_ = distance;
-      best_length_ = length;
+  return length + get_encoded_length(self, &codes->literal_length,
+                                     &codes->distance);
+}
+
+// Write the codes used in a dynamic Huffman block.
+static void write_dynamic_codes(UtDeflateEncoder *self, DynamicCodes *codes) {
+  write_bits(self, codes->n_literal_length_codes - 257, 5);
+  write_bits(self, codes->n_distance_codes - 1, 5);
+  write_bits(self, codes->n_code_width_codes - 4, 4);
+  for (size_t i = 0; i < codes->n_code_width_codes; i++) {
+    uint8_t symbol = deflate_code_width_symbol_order[i];
+    write_bits(self, codes->code_width.widths[symbol], 3);
+  }
+  for (size_t i = 0; i < codes->code_width_symbols_length; i++) {
+    uint8_t symbol = codes->code_width_symbols[i];
+    write_symbol(self, &codes->code_width, symbol);
+    if (symbol == 16) {
+      write_bits(self, codes->code_width_extra[i], 2);
+    } else if (symbol == 17) {
+      write_bits(self, codes->code_width_extra[i], 3);
+    } else if (symbol == 18) {
+      write_bits(self, codes->code_width_extra[i], 7);
     }
   }
+}
 
-  *best_distance = best_distance_;
-  *best_length = best_length_;
-}
-
-static void write_literal(UtDeflateEncoder *self, uint8_t value) {
-  write_symbol(self, self->literal_length_huffman_encoder, value);
-}
-
-// Write a repeat length.
-static void write_length(UtDeflateEncoder *self, size_t length) {
-  if (length <= 2) {
-    assert(false);
-  } else if (length <= 10) {
-    write_symbol(self, self->literal_length_huffman_encoder, 257 + length - 3);
-  } else if (length <= 18) {
-    write_symbol(self, self->literal_length_huffman_encoder,
-                 265 + ((length - 11) >> 1));
-    write_int(self, (length - 11) % 2, 1);
-  } else if (length <= 34) {
-    write_symbol(self, self->literal_length_huffman_encoder,
-                 269 + ((length - 19) >> 2));
-    write_int(self, (length - 19) % 4, 2);
-  } else if (length <= 66) {
-    write_symbol(self, self->literal_length_huffman_encoder,
-                 273 + ((length - 35) >> 3));
-    write_int(self, (length - 35) % 8, 3);
-  } else if (length <= 130) {
-    write_symbol(self, self->literal_length_huffman_encoder,
-                 277 + ((length - 67) >> 4));
-    write_int(self, (length - 67) % 16, 4);
-  } else if (length <= 257) {
-    write_symbol(self, self->literal_length_huffman_encoder,
-                 281 + ((length - 131) >> 5));
-    write_int(self, (length - 131) % 32, 5);
-  } else if (length == 258) {
-    write_symbol(self, self->literal_length_huffman_encoder, 285);
-  } else {
-    assert(false);
-  }
-}
-
-// Write a repeat distance.
-static void write_distance(UtDeflateEncoder *self, size_t distance) {
-  if (distance < 1) {
-    assert(false);
-  } else if (distance <= 4) {
-    write_symbol(self, self->distance_huffman_encoder, distance - 1);
-  } else if (distance <= 8) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 4 + ((distance - 5) >> 1));
-    write_int(self, (distance - 5) % 2, 1);
-  } else if (distance <= 16) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 6 + ((distance - 9) >> 2));
-    write_int(self, (distance - 9) % 4, 2);
-  } else if (distance <= 32) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 8 + ((distance - 17) >> 3));
-    write_int(self, (distance - 17) % 8, 3);
-  } else if (distance <= 64) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 10 + ((distance - 33) >> 4));
-    write_int(self, (distance - 33) % 16, 4);
-  } else if (distance <= 128) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 12 + ((distance - 65) >> 5));
-    write_int(self, (distance - 65) % 32, 5);
-  } else if (distance <= 256) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 14 + ((distance - 129) >> 6));
-    write_int(self, (distance - 129) % 64, 6);
-  } else if (distance <= 512) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 16 + ((distance - 257) >> 7));
-    write_int(self, (distance - 257) % 128, 7);
-  } else if (distance <= 1024) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 18 + ((distance - 513) >> 8));
-    write_int(self, (distance - 513) % 256, 8);
-  } else if (distance <= 2048) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 20 + ((distance - 1025) >> 9));
-    write_int(self, (distance - 1025) % 512, 9);
-  } else if (distance <= 4096) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 22 + ((distance - 2049) >> 10));
-    write_int(self, (distance - 2049) % 1024, 10);
-  } else if (distance <= 8192) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 24 + ((distance - 4097) >> 11));
-    write_int(self, (distance - 4097) % 2048, 11);
-  } else if (distance <= 16384) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 26 + ((distance - 8193) >> 12));
-    write_int(self, (distance - 8193) % 4096, 12);
-  } else if (distance <= 32768) {
-    write_symbol(self, self->distance_huffman_encoder,
-                 28 + ((distance - 16385) >> 13));
-    write_int(self, (distance - 16385) % 8192, 13);
-  } else {
-    assert(false);
+// Write the symbols in the current block.
+static void write_block_symbols(UtDeflateEncoder *self,
+                                CodeTable *literal_length_table,
+                                CodeTable *distance_table) {
+  for (size_t i = 0; i < self->block_symbols_length; i++) {
+    uint16_t length = self->block_lengths[i];
+    uint16_t distance = self->block_distances[i];
+    if (distance == 0) {
+      write_symbol(self, literal_length_table, length);
+      continue;
+    }
+
+    size_t extra;
+    uint16_t symbol = get_length_symbol(length, &extra);
+    write_symbol(self, literal_length_table, symbol);
+    write_bits(self, extra, deflate_extra_length_bits[symbol - 257]);
+    symbol = get_distance_symbol(distance, &extra);
+    write_symbol(self, distance_table, symbol);
+    write_bits(self, extra, deflate_extra_distance_bits[symbol]);
   }
+  write_symbol(self, literal_length_table, END_OF_BLOCK);
 }
 
-static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
-  UtDeflateEncoder *self = (UtDeflateEncoder *)object;
+// Write the current block as uncompressed data.
+static void write_uncompressed_blocks(UtDeflateEncoder *self,
+                                      const uint8_t *dictionary,
+                                      bool is_last_block) {
+  const uint8_t *data = dictionary + self->block_start - self->dictionary_start;
+  size_t data_length = self->block_end - self->block_start;
+  do {
+    size_t length = data_length;
+    if (length > MAX_UNCOMPRESSED_BLOCK_LENGTH) {
+      length = MAX_UNCOMPRESSED_BLOCK_LENGTH;
+    }
+    write_block_header(self, is_last_block && length == data_length,
+                       BLOCK_UNCOMPRESSED);
+    end_bits(self);
+    ut_uint8_list_append_uint16_le(self->buffer, length);
+    ut_uint8_list_append_uint16_le(self->buffer, length ^ 0xffff);
+    ut_uint8_list_append_block(self->buffer, data, length);
+    data += length;
+    data_length -= length;
+  } while (data_length > 0);
+}
+
+// Write the current block using the smallest encoding.
+static void write_block(UtDeflateEncoder *self, const uint8_t *dictionary,
+                        bool is_last_block) {
+  self->literal_length_counts[END_OF_BLOCK]++;
 
-  if (!self->written_header) {
-    write_block_header(self, true, BLOCK_STATIC_HUFFMAN);
-    self->written_header = true;
+  size_t extra_length = 0;
+  for (size_t i = 0; i < 29; i++) {
+    extra_length +=
+        self->literal_length_counts[257 + i] * deflate_extra_length_bits[i];
+  }
+  for (size_t i = 0; i < N_DISTANCE_SYMBOLS; i++) {
+    extra_length += self->distance_counts[i] * deflate_extra_distance_bits[i];
   }
 
-  size_t orig_dictionary_length = ut_list_get_length(self->dictionary);
-  ut_list_append_list(self->dictionary, data);
-  const uint8_t *dictionary_data = ut_uint8_list_get_data(self->dictionary);
-  const uint8_t *new_data = dictionary_data + orig_dictionary_length;
+  size_t static_length = 3 + extra_length +
+                         get_encoded_length(self, &self->static_literal_length,
+                                            &self->static_distance);
+  DynamicCodes codes;
+  size_t dynamic_length =
+      3 + extra_length + generate_dynamic_codes(self, &codes);
+  size_t data_length = self->block_end - self->block_start;
+  size_t n_uncompressed_blocks =
+      data_length / MAX_UNCOMPRESSED_BLOCK_LENGTH + 1;
+  size_t uncompressed_length =
+      n_uncompressed_blocks * (3 + 7 + 32) + data_length * 8;
+
+  if (uncompressed_length < static_length &&
+      uncompressed_length < dynamic_length) {
+    write_uncompressed_blocks(self, dictionary, is_last_block);
+  } else if (dynamic_length < static_length) {
+    write_block_header(self, is_last_block, BLOCK_DYNAMIC_HUFFMAN);
+    write_dynamic_codes(self, &codes);
+    write_block_symbols(self, &codes.literal_length, &codes.distance);
+  } else {
+    write_block_header(self, is_last_block, BLOCK_STATIC_HUFFMAN);
+    write_block_symbols(self, &self->static_literal_length,
+                        &self->static_distance);
+  }
 
-  // TODO: Can trim dictionary to `window_size`
+  self->block_symbols_length = 0;
+  self->block_start = self->block_end;
+  for (size_t i = 0; i < N_LITERAL_LENGTH_SYMBOLS; i++) {
+    self->literal_length_counts[i] = 0;
+  }
+  for (size_t i = 0; i < N_DISTANCE_SYMBOLS; i++) {
+    self->distance_counts[i] = 0;
+  }
+}
 
-  size_t data_length = ut_list_get_length(data);
-  size_t n_used = 0;
-  while (n_used < data_length) {
-    size_t distance, length;
-    find_match(self, data_length - n_used, &distance, &length);
-
-    // If we have a match for all the data, stop here if more data to come - the
-    // match might be longer.
-    if (!complete && length == n_used) {
-      ut_list_remove(self->dictionary, orig_dictionary_length + n_used,
-                     data_length - n_used);
-      break;
+// Encode the data in the dictionary. If not [complete], stop when there is not
+// enough data to be sure of finding the longest match.
+static void encode(UtDeflateEncoder *self, bool complete) {
+  const uint8_t *dictionary = ut_uint8_list_get_data(self->dictionary);
+  size_t end = self->dictionary_start + ut_list_get_length(self->dictionary);
+  bool lazy = self->parameters.max_lazy_match_length > 0;
+
+  size_t position = self->position;
+  while (position < end && (complete || end - position >= MIN_LOOKAHEAD)) {
+    if (self->block_symbols_length >= MAX_BLOCK_SYMBOLS) {
+      write_block(self, dictionary, false);
+    }
+
+    if (!lazy) {
+      size_t distance;
+      size_t length = find_match(self, dictionary, end, position, 0, &distance);
+      if (length > 0) {
+        add_match(self, length, distance);
+      } else {
+        length = 1;
+        add_literal(self, dictionary[position - self->dictionary_start]);
+      }
+      insert_hashes(self, dictionary, end, position, position + length);
+      position += length;
+      continue;
     }
 
-    if (length >= 3) {
-      write_length(self, length);
-      write_distance(self, distance);
-      n_used += length;
+    // Check if there is a longer match at this position than the previous
+    // position. If so the previous position is written as a literal.
+    size_t distance = 0;
+    size_t length = 0;
+    if (!self->have_previous_match ||
+        self->previous_match_length < self->parameters.max_lazy_match_length) {
+      length = find_match(
+          self, dictionary, end, position,
+          self->have_previous_match ? self->previous_match_length : 0,
+          &distance);
+    }
+    insert_hashes(self, dictionary, end, position, position + 1);
+
+    if (self->have_previous_match && self->previous_match_length > 0 &&
+        length <= self->previous_match_length) {
+      add_match(self, self->previous_match_length,
+                self->previous_match_distance);
+      size_t match_end = position - 1 + self->previous_match_length;
+      insert_hashes(self, dictionary, end, position + 1, match_end);
+      position = match_end;
+      self->have_previous_match = false;
     } else {
-      write_literal(self, new_data[n_used]);
-      n_used++;
+      if (self->have_previous_match) {
+        add_literal(self, dictionary[position - 1 - self->dictionary_start]);
+      }
+      self->have_previous_match = true;
+      self->previous_match_length = length;
+      self->previous_match_distance = distance;
+      position++;
     }
   }
 
-  // If complete, use partially filled bytes.
+  // The last byte has no following position to compare with.
+  if (complete && self->have_previous_match) {
+    assert(self->previous_match_length == 0);
+    add_literal(self, dictionary[position - 1 - self->dictionary_start]);
+    self->have_previous_match = false;
+  }
+
+  self->position = position;
+
   if (complete) {
-    write_symbol(self, self->literal_length_huffman_encoder, END_OF_STREAM);
+    if (self->is_final) {
+      write_block(self, dictionary, true);
+    } else {
+      // Align to a byte boundary with an empty uncompressed block, so another
+      // stream can follow this one.
+      if (self->block_end > self->block_start) {
+        write_block(self, dictionary, false);
+      }
+      write_block_header(self, false, BLOCK_UNCOMPRESSED);
+      end_bits(self);
+      ut_uint8_list_append_uint16_le(self->buffer, 0x0000);
+      ut_uint8_list_append_uint16_le(self->buffer, 0xffff);
+    }
     end_bits(self);
+    self->written_last_block = true;
+  }
+}
+
+// Remove data from the dictionary that is no longer required.
+static void trim_dictionary(UtDeflateEncoder *self) {
+  // Keep the window, and the current block in case it is written uncompressed.
+  // The previous byte is needed if there is a pending match.
+  size_t start = self->position > self->window_size
+                     ? self->position - self->window_size
+                     : 0;
+  if (self->block_start < start) {
+    start = self->block_start;
+  }
+
+  // Only trim when a significant amount can be removed, to avoid moving the
+  // data too often.
+  if (start < self->dictionary_start) {
+    return;
+  }
+  size_t n_unused = start - self->dictionary_start;
+  if (n_unused >= self->window_size) {
+    ut_list_remove(self->dictionary, 0, n_unused);
+    self->dictionary_start = start;
+  }
+}
+
+static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
+  UtDeflateEncoder *self = (UtDeflateEncoder *)object;
+
+  if (self->written_last_block) {
+    return 0;
   }
 
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  if (d != NULL) {
+    ut_uint8_list_append_block(self->dictionary, d, data_length);
+  } else {
+    ut_list_append_list(self->dictionary, data);
+  }
+
+  encode(self, complete);
+  trim_dictionary(self);
+
   if (ut_list_get_length(self->buffer) > 0 || complete) {
     size_t n =
         self->callback_object != NULL
@@ -272,13 +745,17 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
     ut_list_remove(self->buffer, 0, n);
   }
 
-  return n_used;
+  return data_length;
 }
 
 static void ut_deflate_encoder_init(UtObject *object) {
   UtDeflateEncoder *self = (UtDeflateEncoder *)object;
   self->dictionary = ut_uint8_array_new();
   self->buffer = ut_uint8_array_new();
+  self->code_weights = ut_float64_array_new();
+  self->hash_head = calloc(HASH_SIZE, sizeof(size_t));
+  self->block_lengths = malloc(sizeof(uint16_t) * (MAX_BLOCK_SYMBOLS + 1));
+  self->block_distances = malloc(sizeof(uint16_t) * (MAX_BLOCK_SYMBOLS + 1));
 
   UtObjectRef literal_length_code_widths = ut_uint8_list_new();
   for (size_t symbol = 0; symbol <= 287; symbol++) {
@@ -294,15 +771,19 @@ static void ut_deflate_encoder_init(UtObject *object) {
     }
     ut_uint8_list_append(literal_length_code_widths, code_width);
   }
-  self->literal_length_huffman_encoder =
+  UtObjectRef literal_length_huffman_encoder =
       ut_huffman_encoder_new_canonical(literal_length_code_widths);
+  get_code_table(literal_length_huffman_encoder, N_LITERAL_LENGTH_SYMBOLS,
+                 &self->static_literal_length);
 
   UtObjectRef distance_code_widths = ut_uint8_list_new();
   for (size_t symbol = 0; symbol < 32; symbol++) {
     ut_uint8_list_append(distance_code_widths, 5);
   }
-  self->distance_huffman_encoder =
+  UtObjectRef distance_huffman_encoder =
       ut_huffman_encoder_new_canonical(distance_code_widths);
+  get_code_table(distance_huffman_encoder, N_DISTANCE_SYMBOLS,
+                 &self->static_distance);
 }
 
 static void ut_deflate_encoder_cleanup(UtObject *object) {
@@ -312,9 +793,12 @@ static void ut_deflate_encoder_cleanup(UtObject *object) {
 
   ut_object_unref(self->input_stream);
   ut_object_weak_unref(&self->callback_object);
-  ut_object_unref(self->literal_length_huffman_encoder);
-  ut_object_unref(self->distance_huffman_encoder);
   ut_object_unref(self->dictionary);
+  free(self->hash_head);
+  free(self->hash_previous);
+  free(self->block_lengths);
+  free(self->block_distances);
+  ut_object_unref(self->code_weights);
   ut_object_unref(self->buffer);
 }
 
@@ -344,19 +828,100 @@ static UtObjectInterface object_interface = {
                    {NULL, NULL}}};
 
 UtObject *ut_deflate_encoder_new(UtObject *input_stream) {
-  return ut_deflate_encoder_new_with_window_size(32768, input_stream);
+  return ut_deflate_encoder_new_full(UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT,
+                                     32768, input_stream);
 }
 
 UtObject *ut_deflate_encoder_new_with_window_size(size_t window_size,
                                                   UtObject *input_stream) {
+  return ut_deflate_encoder_new_full(UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT,
+                                     window_size, input_stream);
+}
+
+UtObject *
+ut_deflate_encoder_new_full(UtDeflateCompressionLevel compression_level,
+                            size_t window_size, UtObject *input_stream) {
+  assert(compression_level <= UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM);
+  assert(window_size > 0 && window_size <= 32768);
   assert(input_stream != NULL);
   UtObject *object = ut_object_new(sizeof(UtDeflateEncoder), &object_interface);
   UtDeflateEncoder *self = (UtDeflateEncoder *)object;
   self->input_stream = ut_object_ref(input_stream);
   self->window_size = window_size;
+  self->parameters = match_parameters[compression_level];
+  self->hash_previous = calloc(window_size, sizeof(size_t));
+  self->is_final = true;
   return object;
 }
 
+void ut_deflate_encoder_set_dictionary(UtObject *object, UtObject *dictionary) {
+  assert(ut_object_is_deflate_encoder(object));
+  UtDeflateEncoder *self = (UtDeflateEncoder *)object;
+
+  // Only valid before any data is encoded.
+  assert(ut_list_get_length(self->dictionary) == 0);
+
+  // Only the end of the dictionary can be referred to.
+  size_t dictionary_length = ut_list_get_length(dictionary);
+  size_t start = dictionary_length > self->window_size
+                     ? dictionary_length - self->window_size
+                     : 0;
+  UtObjectRef window =
+      ut_list_get_sublist(dictionary, start, dictionary_length - start);
+  ut_list_append_list(self->dictionary, window);
+
+  size_t end = self->position + dictionary_length - start;
+  insert_hashes(self, ut_uint8_list_get_data(self->dictionary), end,
+                self->position, end);
+  self->position = end;
+  self->block_start = end;
+  self->block_end = end;
+}
+
+void ut_deflate_encoder_reset(UtObject *object, UtObject *input_stream) {
+  assert(ut_object_is_deflate_encoder(object));
+  UtDeflateEncoder *self = (UtDeflateEncoder *)object;
+
+  assert(input_stream != NULL);
+  assert(input_stream != self->input_stream);
+
+  ut_input_stream_close(self->input_stream);
+  ut_object_unref(self->input_stream);
+  self->input_stream = ut_object_ref(input_stream);
+  ut_object_weak_unref(&self->callback_object);
+  self->callback = NULL;
+
+  // Stream positions continue on from the previous data, so the hash tables
+  // don't need to be cleared - entries before [dictionary_start] are never
+  // matched.
+  size_t end = self->dictionary_start + ut_list_get_length(self->dictionary);
+  ut_list_clear(self->dictionary);
+  self->dictionary_start = end;
+  self->position = end;
+  self->have_previous_match = false;
+
+  self->block_symbols_length = 0;
+  self->block_start = end;
+  self->block_end = end;
+  for (size_t i = 0; i < N_LITERAL_LENGTH_SYMBOLS; i++) {
+    self->literal_length_counts[i] = 0;
+  }
+  for (size_t i = 0; i < N_DISTANCE_SYMBOLS; i++) {
+    self->distance_counts[i] = 0;
+  }
+
+  self->written_last_block = false;
+  ut_list_clear(self->buffer);
+  self->bit_buffer = 0;
+  self->bit_count = 0;
+}
+
+void ut_deflate_encoder_set_final(UtObject *object, bool is_final) {
+  assert(ut_object_is_deflate_encoder(object));
+  UtDeflateEncoder *self = (UtDeflateEncoder *)object;
+  self->is_final = is_final;
+}
+
 size_t ut_deflate_encoder_get_window_size(UtObject *object) {
   assert(ut_object_is_deflate_encoder(object));
   UtDeflateEncoder *self = (UtDeflateEncoder *)object;
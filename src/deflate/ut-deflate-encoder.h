@@ -4,6 +4,18 @@
 
 #pragma once
 
+/// Compression level used in deflate encoding:
+/// - [UT_DEFLATE_COMPRESSION_LEVEL_FASTEST] - fastest compression.
+/// - [UT_DEFLATE_COMPRESSION_LEVEL_FAST] - fast compression.
+/// - [UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT] - default compression.
+/// - [UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM] - maximum compression.
+typedef enum {
+  UT_DEFLATE_COMPRESSION_LEVEL_FASTEST = 0,
+  UT_DEFLATE_COMPRESSION_LEVEL_FAST = 1,
+  UT_DEFLATE_COMPRESSION_LEVEL_DEFAULT = 2,
+  UT_DEFLATE_COMPRESSION_LEVEL_MAXIMUM = 3
+} UtDeflateCompressionLevel;
+
 /// Creates a new encoder to compress [input_stream].
 ///
 /// !arg-type input_stream UtInputStream
@@ -20,6 +32,37 @@ UtObject *ut_deflate_encoder_new(UtObject *input_stream);
 UtObject *ut_deflate_encoder_new_with_window_size(size_t window_size,
                                                   UtObject *input_stream);
 
+/// Creates a new encoder to compress [input_stream] using the given
+/// [compression_level] and [window_size].
+/// Higher compression levels search more of the dictionary for matches.
+///
+/// !arg-type input_stream UtInputStream
+/// !return-type UtDeflateEncoder
+/// !return-ref
+UtObject *
+ut_deflate_encoder_new_full(UtDeflateCompressionLevel compression_level,
+                            size_t window_size, UtObject *input_stream);
+
+/// Sets [dictionary] as data that precedes the data to compress, so matches
+/// can refer to it. The dictionary is not included in the output.
+/// Must be called before reading.
+///
+/// !arg-type dictionary UtUint8List
+void ut_deflate_encoder_set_dictionary(UtObject *object, UtObject *dictionary);
+
+/// Resets the encoder to compress a new [input_stream], as if it was newly
+/// created with the same compression level and window size. The hash tables
+/// and buffers are kept, which makes encoding many small messages faster than
+/// creating a new encoder for each. Any dictionary is cleared.
+///
+/// !arg-type input_stream UtInputStream
+void ut_deflate_encoder_reset(UtObject *object, UtObject *input_stream);
+
+/// Sets if the encoded data ends with the final deflate block, which is the
+/// default. If [is_final] is false, the data instead ends with an empty
+/// uncompressed block, so it can be followed by another deflate stream.
+void ut_deflate_encoder_set_final(UtObject *object, bool is_final);
+
 /// Returns the window size used by this encoder.
 size_t ut_deflate_encoder_get_window_size(UtObject *object);
 
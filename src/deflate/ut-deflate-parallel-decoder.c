@@ -0,0 +1,854 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ut-deflate.h"
+#include "ut.h"
+
+// https://www.ietf.org/rfc/rfc1951.txt
+//
+// Chunks are decoded without knowing the data before them, as described in
+// "Decompressing FASTQ files in parallel" (pugz) and "Rapidgzip: Parallel
+// Decompression and Seeking in Gzip Files Using Cache Prefetching".
+
+// Amount of compressed data decoded by each worker thread.
+#define CHUNK_LENGTH 1048576
+
+// Maximum distance of a back reference.
+#define WINDOW_LENGTH 32768
+
+// Decoded values of [MARKER_BASE] + n refer to byte n of the window before
+// the chunk, which is not known until the previous chunk is decoded.
+#define MARKER_BASE 256
+
+// Maximum length of a length/distance pair.
+#define MAX_MATCH_LENGTH 258
+
+// Longest Huffman code.
+#define MAX_CODE_WIDTH 15
+
+typedef enum {
+  DECODER_STATE_DECODING,
+  DECODER_STATE_DONE,
+  DECODER_STATE_ERROR
+} DecoderState;
+
+typedef struct {
+  UtObject object;
+  UtObject *data;
+  UtObject *callback_object;
+  UtInputStreamCallback callback;
+
+  DecoderState state;
+
+  // Maximum number of chunks to decode at once.
+  size_t n_threads;
+
+  // Huffman decoders for fixed Huffman blocks, shared by all chunks.
+  UtObject *fixed_literal_length_decoder;
+  UtObject *fixed_distance_decoder;
+
+  // Offset of the next chunk to start decoding.
+  size_t next_chunk_offset;
+
+  // Chunks being decoded, in stream order.
+  UtObject *chunks;
+  bool started_last_chunk;
+
+  // Position in bits of the end of the data written.
+  size_t end_bit;
+
+  // Last [window_length] bytes written, at the end of [window].
+  uint8_t window[WINDOW_LENGTH];
+  size_t window_length;
+
+  // Decoded data.
+  UtObject *buffer;
+
+  // Error that occurred during decoding.
+  UtObject *error;
+} UtDeflateParallelDecoder;
+
+// Decodes a range of deflate data. This is used on worker threads, so only
+// uses objects it creates, and the fixed Huffman decoders which are not
+// modified.
+typedef struct {
+  const uint8_t *data;
+  size_t data_length;
+
+  // Offset of the next byte to read into [bits], which contains [n_bits] bits
+  // of unused data.
+  size_t offset;
+  uint64_t bits;
+  size_t n_bits;
+
+  // Decoded values, starting with [WINDOW_LENGTH] markers.
+  uint16_t *output;
+  size_t output_length;
+  size_t output_capacity;
+
+  UtObject *fixed_literal_length_decoder;
+  UtObject *fixed_distance_decoder;
+
+  // Huffman decoders for the current dynamic Huffman block.
+  UtObject *dynamic_literal_length_decoder;
+  UtObject *dynamic_distance_decoder;
+} Inflater;
+
+static Inflater *inflater_new(const uint8_t *data, size_t data_length,
+                              UtObject *fixed_literal_length_decoder,
+                              UtObject *fixed_distance_decoder) {
+  Inflater *self = malloc(sizeof(Inflater));
+  self->data = data;
+  self->data_length = data_length;
+  self->output_capacity = WINDOW_LENGTH * 4;
+  self->output = malloc(sizeof(uint16_t) * self->output_capacity);
+  for (size_t i = 0; i < WINDOW_LENGTH; i++) {
+    self->output[i] = MARKER_BASE + i;
+  }
+  self->fixed_literal_length_decoder = fixed_literal_length_decoder;
+  self->fixed_distance_decoder = fixed_distance_decoder;
+  self->dynamic_literal_length_decoder = NULL;
+  self->dynamic_distance_decoder = NULL;
+  return self;
+}
+
+static void inflater_free(Inflater *self) {
+  free(self->output);
+  ut_object_unref(self->dynamic_literal_length_decoder);
+  ut_object_unref(self->dynamic_distance_decoder);
+  free(self);
+}
+
+static void refill(Inflater *self) {
+  if (self->offset + 8 <= self->data_length) {
+    // Read eight bytes at once, then only keep the whole bytes that fit.
+    const uint8_t *d = self->data + self->offset;
+    uint64_t value = (uint64_t)d[0] | (uint64_t)d[1] << 8 |
+                     (uint64_t)d[2] << 16 | (uint64_t)d[3] << 24 |
+                     (uint64_t)d[4] << 32 | (uint64_t)d[5] << 40 |
+                     (uint64_t)d[6] << 48 | (uint64_t)d[7] << 56;
+    self->bits |= value << self->n_bits;
+    self->offset += (63 - self->n_bits) / 8;
+    self->n_bits |= 56;
+  } else {
+    while (self->n_bits <= 56 && self->offset < self->data_length) {
+      self->bits |= (uint64_t)self->data[self->offset] << self->n_bits;
+      self->n_bits += 8;
+      self->offset++;
+    }
+  }
+}
+
+static void consume(Inflater *self, size_t width) {
+  self->bits >>= width;
+  self->n_bits -= width;
+}
+
+static size_t get_position(Inflater *self) {
+  return self->offset * 8 - self->n_bits;
+}
+
+// Move to [bit] and discard any decoded data.
+static void seek(Inflater *self, size_t bit) {
+  self->offset = bit / 8;
+  self->bits = 0;
+  self->n_bits = 0;
+  refill(self);
+  size_t width = bit % 8;
+  consume(self, width < self->n_bits ? width : self->n_bits);
+  self->output_length = WINDOW_LENGTH;
+}
+
+static bool read_bits(Inflater *self, size_t width, uint32_t *value) {
+  if (self->n_bits < width) {
+    refill(self);
+    if (self->n_bits < width) {
+      return false;
+    }
+  }
+  *value = self->bits & (((uint64_t)1 << width) - 1);
+  consume(self, width);
+  return true;
+}
+
+static void reserve_output(Inflater *self, size_t length) {
+  if (self->output_length + length <= self->output_capacity) {
+    return;
+  }
+  while (self->output_length + length > self->output_capacity) {
+    self->output_capacity *= 2;
+  }
+  self->output =
+      realloc(self->output, sizeof(uint16_t) * self->output_capacity);
+}
+
+// Returns true if [widths] form a complete Huffman code. Incomplete codes are
+// only accepted if [allow_single] is set and they have a single code, as
+// generated by some encoders. Rejecting these quickly discards most incorrect
+// guesses of where a block starts.
+static bool is_complete_code(const uint8_t *widths, size_t n_symbols,
+                             bool allow_single) {
+  size_t counts[MAX_CODE_WIDTH + 1] = {0};
+  for (size_t i = 0; i < n_symbols; i++) {
+    counts[widths[i]]++;
+  }
+
+  int32_t n_unused = 1;
+  size_t max_width = 0;
+  for (size_t width = 1; width <= MAX_CODE_WIDTH; width++) {
+    n_unused = n_unused * 2 - counts[width];
+    if (n_unused < 0) {
+      return false;
+    }
+    if (counts[width] > 0) {
+      max_width = width;
+    }
+  }
+
+  return n_unused == 0 || (allow_single && max_width <= 1);
+}
+
+// Creates a Huffman decoder for the code using [widths], or returns NULL if
+// not a valid code.
+static UtObject *create_huffman_decoder(const uint8_t *widths,
+                                        size_t n_symbols, bool allow_single) {
+  if (!is_complete_code(widths, n_symbols, allow_single)) {
+    return NULL;
+  }
+
+  UtObjectRef code_widths = ut_uint8_array_new_from_data(widths, n_symbols);
+  UtObjectRef decoder = ut_huffman_decoder_new_canonical(code_widths);
+  if (ut_object_implements_error(decoder)) {
+    return NULL;
+  }
+
+  return ut_object_ref(decoder);
+}
+
+static bool decode_symbol(Inflater *self, UtObject *decoder,
+                          uint16_t *symbol) {
+  if (self->n_bits < MAX_CODE_WIDTH) {
+    refill(self);
+  }
+
+  // Unused bits are zero, so a code can be matched with incomplete data and
+  // checked against the number of bits available.
+  size_t width =
+      ut_huffman_decoder_lookup_lsb_first(decoder, self->bits, symbol);
+  if (width == 0 || width > self->n_bits) {
+    return false;
+  }
+  consume(self, width);
+  return true;
+}
+
+static bool decode_stored_block(Inflater *self) {
+  // Skip to the next byte boundary.
+  consume(self, self->n_bits % 8);
+
+  uint32_t length, length_complement;
+  if (!read_bits(self, 16, &length) ||
+      !read_bits(self, 16, &length_complement) ||
+      length != (~length_complement & 0xffff)) {
+    return false;
+  }
+
+  // Copy directly from the input.
+  size_t offset = self->offset - self->n_bits / 8;
+  if (offset + length > self->data_length) {
+    return false;
+  }
+  reserve_output(self, length);
+  uint16_t *output = self->output + self->output_length;
+  for (size_t i = 0; i < length; i++) {
+    output[i] = self->data[offset + i];
+  }
+  self->output_length += length;
+
+  self->offset = offset + length;
+  self->bits = 0;
+  self->n_bits = 0;
+
+  return true;
+}
+
+static bool read_dynamic_decoders(Inflater *self) {
+  ut_object_clear(&self->dynamic_literal_length_decoder);
+  ut_object_clear(&self->dynamic_distance_decoder);
+
+  uint32_t hlit, hdist, hclen;
+  if (!read_bits(self, 5, &hlit) || !read_bits(self, 5, &hdist) ||
+      !read_bits(self, 4, &hclen)) {
+    return false;
+  }
+  size_t n_literal_length_codes = hlit + 257;
+  size_t n_distance_codes = hdist + 1;
+  size_t n_code_width_codes = hclen + 4;
+  if (n_literal_length_codes > 286 || n_distance_codes > 30) {
+    return false;
+  }
+
+  uint8_t code_width_widths[19] = {0};
+  for (size_t i = 0; i < n_code_width_codes; i++) {
+    uint32_t width;
+    if (!read_bits(self, 3, &width)) {
+      return false;
+    }
+    code_width_widths[deflate_code_width_symbol_order[i]] = width;
+  }
+  UtObjectRef code_width_decoder =
+      create_huffman_decoder(code_width_widths, 19, false);
+  if (code_width_decoder == NULL) {
+    return false;
+  }
+
+  uint8_t widths[286 + 30];
+  size_t n_widths = n_literal_length_codes + n_distance_codes;
+  size_t n = 0;
+  while (n < n_widths) {
+    uint16_t symbol;
+    if (!decode_symbol(self, code_width_decoder, &symbol)) {
+      return false;
+    }
+    if (symbol < 16) {
+      widths[n] = symbol;
+      n++;
+      continue;
+    }
+
+    uint8_t width = 0;
+    uint32_t repeat;
+    if (symbol == 16) {
+      if (n == 0 || !read_bits(self, 2, &repeat)) {
+        return false;
+      }
+      width = widths[n - 1];
+      repeat += 3;
+    } else if (symbol == 17) {
+      if (!read_bits(self, 3, &repeat)) {
+        return false;
+      }
+      repeat += 3;
+    } else {
+      if (!read_bits(self, 7, &repeat)) {
+        return false;
+      }
+      repeat += 11;
+    }
+    if (n + repeat > n_widths) {
+      return false;
+    }
+    memset(widths + n, width, repeat);
+    n += repeat;
+  }
+
+  // Must be able to end the block.
+  if (widths[256] == 0) {
+    return false;
+  }
+
+  self->dynamic_literal_length_decoder =
+      create_huffman_decoder(widths, n_literal_length_codes, true);
+  self->dynamic_distance_decoder = create_huffman_decoder(
+      widths + n_literal_length_codes, n_distance_codes, true);
+  return self->dynamic_literal_length_decoder != NULL &&
+         self->dynamic_distance_decoder != NULL;
+}
+
+static bool decode_huffman_block(Inflater *self,
+                                 UtObject *literal_length_decoder,
+                                 UtObject *distance_decoder) {
+  while (true) {
+    reserve_output(self, MAX_MATCH_LENGTH);
+
+    uint16_t symbol;
+    if (!decode_symbol(self, literal_length_decoder, &symbol)) {
+      return false;
+    }
+    if (symbol < 256) {
+      self->output[self->output_length] = symbol;
+      self->output_length++;
+      continue;
+    }
+    if (symbol == 256) {
+      return true;
+    }
+
+    symbol -= 257;
+    uint32_t extra;
+    if (symbol >= 29 ||
+        !read_bits(self, deflate_extra_length_bits[symbol], &extra)) {
+      return false;
+    }
+    size_t length = deflate_base_lengths[symbol] + extra;
+
+    if (!decode_symbol(self, distance_decoder, &symbol) || symbol >= 30 ||
+        !read_bits(self, deflate_extra_distance_bits[symbol], &extra)) {
+      return false;
+    }
+    size_t distance = deflate_base_distances[symbol] + extra;
+    if (distance > self->output_length) {
+      return false;
+    }
+
+    // Copy values, which may overlap and may be markers.
+    uint16_t *output = self->output + self->output_length;
+    const uint16_t *input = output - distance;
+    for (size_t i = 0; i < length; i++) {
+      output[i] = input[i];
+    }
+    self->output_length += length;
+  }
+}
+
+// Decodes blocks until the first block that starts at or after [stop_bit], or
+// the final block.
+static bool decode_blocks(Inflater *self, size_t stop_bit, bool *is_last) {
+  *is_last = false;
+  while (get_position(self) < stop_bit) {
+    uint32_t header;
+    if (!read_bits(self, 3, &header)) {
+      return false;
+    }
+
+    bool valid;
+    switch (header >> 1) {
+    case 0:
+      valid = decode_stored_block(self);
+      break;
+    case 1:
+      valid = decode_huffman_block(self, self->fixed_literal_length_decoder,
+                                   self->fixed_distance_decoder);
+      break;
+    case 2:
+      valid = read_dynamic_decoders(self) &&
+              decode_huffman_block(self, self->dynamic_literal_length_decoder,
+                                   self->dynamic_distance_decoder);
+      break;
+    default:
+      valid = false;
+      break;
+    }
+    if (!valid) {
+      return false;
+    }
+
+    if ((header & 0x1) != 0) {
+      *is_last = true;
+      return true;
+    }
+  }
+
+  return true;
+}
+
+// Part of the data being decoded on a worker thread.
+typedef struct {
+  UtObject object;
+  UtObject *decoder;
+
+  // Data being decoded, kept so it remains valid while the worker is running.
+  UtObject *data_object;
+  const uint8_t *data;
+  size_t data_length;
+
+  // Huffman decoders for fixed Huffman blocks.
+  UtObject *fixed_literal_length_decoder;
+  UtObject *fixed_distance_decoder;
+
+  // If [search] is set, decoding starts at the first block found between
+  // [start_bit] and [stop_bit], otherwise it starts at [start_bit]. Decoding
+  // stops at the first block on or after [stop_bit].
+  size_t start_bit;
+  size_t stop_bit;
+  bool search;
+
+  // True when the worker thread has completed.
+  bool decoded;
+
+  // True if decoding succeeded. The data is valid if the previous chunk ends
+  // between [first_start_bit] and [last_start_bit].
+  bool valid;
+  size_t first_start_bit;
+  size_t last_start_bit;
+  size_t end_bit;
+  bool is_last;
+
+  // Decoded values, starting with [WINDOW_LENGTH] markers.
+  uint16_t *output;
+  size_t output_length;
+} Chunk;
+
+static void chunk_cleanup(UtObject *object) {
+  Chunk *self = (Chunk *)object;
+  ut_object_weak_unref(&self->decoder);
+  ut_object_unref(self->data_object);
+  ut_object_unref(self->fixed_literal_length_decoder);
+  ut_object_unref(self->fixed_distance_decoder);
+  free(self->output);
+}
+
+static UtObjectInterface chunk_object_interface = {.type_name = "Chunk",
+                                                   .cleanup = chunk_cleanup};
+
+static UtObject *chunk_new(UtDeflateParallelDecoder *decoder, size_t start_bit,
+                           size_t stop_bit, bool search) {
+  UtObject *object = ut_object_new(sizeof(Chunk), &chunk_object_interface);
+  Chunk *self = (Chunk *)object;
+  ut_object_weak_ref((UtObject *)decoder, &self->decoder);
+  self->data_object = ut_object_ref(decoder->data);
+  self->data = ut_uint8_list_get_data(decoder->data);
+  self->data_length = ut_list_get_length(decoder->data);
+  self->fixed_literal_length_decoder =
+      ut_object_ref(decoder->fixed_literal_length_decoder);
+  self->fixed_distance_decoder = ut_object_ref(decoder->fixed_distance_decoder);
+  self->start_bit = start_bit;
+  self->stop_bit = stop_bit;
+  self->search = search;
+  return object;
+}
+
+// Returns 64 bits of data starting at byte [offset], padded with zeros.
+static uint64_t get_bits_at(Chunk *self, size_t offset) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < 8 && offset + i < self->data_length; i++) {
+    value |= (uint64_t)self->data[offset + i] << (i * 8);
+  }
+  return value;
+}
+
+// Try decoding from each position in the chunk that could be the start of a
+// non-final stored or dynamic Huffman block. Fixed Huffman blocks are too
+// common a bit pattern to be worth trying.
+static bool find_start(Chunk *self, Inflater *inflater) {
+  for (size_t offset = self->start_bit / 8;
+       offset < self->data_length && offset * 8 < self->stop_bit; offset++) {
+    uint64_t bits = get_bits_at(self, offset);
+    for (size_t shift = 0; shift < 8; shift++) {
+      size_t bit = offset * 8 + shift;
+      if (bit < self->start_bit) {
+        continue;
+      }
+      if (bit >= self->stop_bit) {
+        return false;
+      }
+
+      uint64_t value = bits >> shift;
+      if ((value & 0x7) == 0x4) {
+        // Dynamic Huffman block with valid code counts.
+        if (((value >> 3) & 0x1f) > 29 || ((value >> 8) & 0x1f) > 29) {
+          continue;
+        }
+        seek(inflater, bit);
+        if (decode_blocks(inflater, self->stop_bit, &self->is_last)) {
+          self->first_start_bit = self->last_start_bit = bit;
+          return true;
+        }
+      } else if ((value & 0x7) == 0x0) {
+        // Stored block with zero padding and a valid length. The block could
+        // start anywhere in the padding.
+        size_t padding = (8 - (bit + 3) % 8) % 8;
+        if (((value >> 3) & ((1 << padding) - 1)) != 0) {
+          continue;
+        }
+        size_t length_offset = (bit + 3 + padding) / 8;
+        if (length_offset + 4 > self->data_length) {
+          continue;
+        }
+        const uint8_t *d = self->data + length_offset;
+        if ((d[0] ^ d[2]) != 0xff || (d[1] ^ d[3]) != 0xff) {
+          continue;
+        }
+        seek(inflater, bit);
+        if (decode_blocks(inflater, self->stop_bit, &self->is_last)) {
+          self->first_start_bit = bit;
+          self->last_start_bit = length_offset * 8 - 3;
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+// Decode a chunk. This runs on a worker thread, so only uses objects it
+// creates.
+static UtObject *chunk_thread_cb(UtObject *object) {
+  Chunk *self = (Chunk *)object;
+
+  Inflater *inflater =
+      inflater_new(self->data, self->data_length,
+                   self->fixed_literal_length_decoder,
+                   self->fixed_distance_decoder);
+  if (self->search) {
+    self->valid = find_start(self, inflater);
+  } else {
+    seek(inflater, self->start_bit);
+    self->valid = decode_blocks(inflater, self->stop_bit, &self->is_last);
+    self->first_start_bit = self->last_start_bit = self->start_bit;
+  }
+  if (self->valid) {
+    self->end_bit = get_position(inflater);
+    self->output = inflater->output;
+    self->output_length = inflater->output_length;
+    inflater->output = NULL;
+  }
+  inflater_free(inflater);
+
+  return NULL;
+}
+
+static void chunk_result_cb(UtObject *object, UtObject *result);
+
+static void start_chunk(Chunk *chunk) {
+  ut_event_loop_add_worker_thread(chunk_thread_cb,
+                                  ut_object_ref((UtObject *)chunk),
+                                  (UtObject *)chunk, chunk_result_cb);
+}
+
+static void set_error(UtDeflateParallelDecoder *self, const char *description) {
+  if (self->state == DECODER_STATE_ERROR) {
+    return;
+  }
+
+  self->error = ut_deflate_error_new(description);
+  self->state = DECODER_STATE_ERROR;
+  ut_list_clear(self->chunks);
+
+  if (self->callback_object != NULL) {
+    self->callback(self->callback_object, self->error, true);
+  }
+}
+
+// Start decoding chunks while worker threads are available.
+static void start_chunks(UtDeflateParallelDecoder *self) {
+  size_t data_length = ut_list_get_length(self->data);
+  while (!self->started_last_chunk &&
+         ut_list_get_length(self->chunks) < self->n_threads) {
+    // Chunks have to search for the start of a block, unless all the previous
+    // chunks have been decoded.
+    size_t start_bit = self->next_chunk_offset * 8;
+    bool search = true;
+    if (ut_list_get_length(self->chunks) == 0 && self->end_bit >= start_bit) {
+      start_bit = self->end_bit;
+      search = false;
+    }
+    size_t stop_bit = SIZE_MAX;
+    if (data_length - self->next_chunk_offset > CHUNK_LENGTH) {
+      self->next_chunk_offset += CHUNK_LENGTH;
+      stop_bit = self->next_chunk_offset * 8;
+    } else {
+      self->next_chunk_offset = data_length;
+      self->started_last_chunk = true;
+    }
+
+    UtObjectRef chunk = chunk_new(self, start_bit, stop_bit, search);
+    ut_list_append(self->chunks, chunk);
+    start_chunk((Chunk *)chunk);
+  }
+}
+
+// Replace markers in [chunk] with data from the window and write to the
+// buffer.
+static bool write_chunk(UtDeflateParallelDecoder *self, Chunk *chunk) {
+  size_t length = chunk->output_length - WINDOW_LENGTH;
+  size_t buffer_length = ut_list_get_length(self->buffer);
+  ut_list_resize(self->buffer, buffer_length + length);
+  uint8_t *output =
+      ut_uint8_list_get_writable_data(self->buffer) + buffer_length;
+  const uint16_t *input = chunk->output + WINDOW_LENGTH;
+  size_t window_start = WINDOW_LENGTH - self->window_length;
+  for (size_t i = 0; i < length; i++) {
+    uint16_t value = input[i];
+    if (value < MARKER_BASE) {
+      output[i] = value;
+    } else {
+      size_t index = value - MARKER_BASE;
+      if (index < window_start) {
+        ut_list_resize(self->buffer, buffer_length);
+        set_error(self, "Invalid deflate distance");
+        return false;
+      }
+      output[i] = self->window[index];
+    }
+  }
+
+  // Keep the end of the data as the window for the next chunk.
+  if (length >= WINDOW_LENGTH) {
+    memcpy(self->window, output + length - WINDOW_LENGTH, WINDOW_LENGTH);
+  } else {
+    memmove(self->window, self->window + length, WINDOW_LENGTH - length);
+    memcpy(self->window + WINDOW_LENGTH - length, output, length);
+  }
+  self->window_length += length;
+  if (self->window_length > WINDOW_LENGTH) {
+    self->window_length = WINDOW_LENGTH;
+  }
+
+  return true;
+}
+
+// Pass decoded data to the consumer.
+static void write_buffer(UtDeflateParallelDecoder *self) {
+  bool complete = self->state == DECODER_STATE_DONE;
+  if (ut_list_get_length(self->buffer) == 0 && !complete) {
+    return;
+  }
+
+  size_t buffer_length = ut_list_get_length(self->buffer);
+  size_t n_used =
+      self->callback_object != NULL
+          ? self->callback(self->callback_object, self->buffer, complete)
+          : 0;
+  assert(n_used <= buffer_length);
+  ut_list_remove(self->buffer, 0, n_used);
+}
+
+// Write decoded chunks in order, checking each starts where the previous one
+// ended.
+static void write_chunks(UtDeflateParallelDecoder *self) {
+  if (self->state != DECODER_STATE_DECODING) {
+    return;
+  }
+
+  while (ut_list_get_length(self->chunks) > 0) {
+    Chunk *chunk = (Chunk *)ut_object_list_get_element(self->chunks, 0);
+    if (!chunk->decoded) {
+      break;
+    }
+
+    if (!chunk->valid || self->end_bit < chunk->first_start_bit ||
+        self->end_bit > chunk->last_start_bit) {
+      if (!chunk->search) {
+        set_error(self, "Invalid deflate data");
+        return;
+      }
+
+      // The previous chunk may have ended after this one.
+      if (self->end_bit >= chunk->stop_bit) {
+        ut_list_remove(self->chunks, 0, 1);
+        continue;
+      }
+
+      // The speculative start was wrong, so decode again from the end of the
+      // previous chunk.
+      free(chunk->output);
+      chunk->output = NULL;
+      chunk->start_bit = self->end_bit;
+      chunk->search = false;
+      chunk->decoded = false;
+      start_chunk(chunk);
+      break;
+    }
+
+    if (!write_chunk(self, chunk)) {
+      return;
+    }
+    self->end_bit = chunk->end_bit;
+    if (chunk->is_last) {
+      self->state = DECODER_STATE_DONE;
+      ut_list_clear(self->chunks);
+      break;
+    }
+
+    ut_list_remove(self->chunks, 0, 1);
+  }
+
+  start_chunks(self);
+  write_buffer(self);
+}
+
+static void chunk_result_cb(UtObject *object, UtObject *result) {
+  Chunk *chunk = (Chunk *)object;
+  chunk->decoded = true;
+  if (chunk->decoder != NULL) {
+    write_chunks((UtDeflateParallelDecoder *)chunk->decoder);
+  }
+}
+
+static void ut_deflate_parallel_decoder_init(UtObject *object) {
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  self->state = DECODER_STATE_DECODING;
+
+  // The Huffman decoders build their lookup tables on first use, which is
+  // not safe to do in the worker threads.
+  self->fixed_literal_length_decoder =
+      deflate_fixed_literal_length_huffman_decoder_new();
+  self->fixed_distance_decoder = deflate_fixed_distance_huffman_decoder_new();
+  uint16_t symbol;
+  ut_huffman_decoder_lookup_lsb_first(self->fixed_literal_length_decoder, 0,
+                                      &symbol);
+  ut_huffman_decoder_lookup_lsb_first(self->fixed_distance_decoder, 0,
+                                      &symbol);
+
+  self->chunks = ut_object_list_new();
+  self->buffer = ut_uint8_array_new();
+}
+
+static void ut_deflate_parallel_decoder_cleanup(UtObject *object) {
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  ut_object_unref(self->data);
+  ut_object_weak_unref(&self->callback_object);
+  ut_object_unref(self->fixed_literal_length_decoder);
+  ut_object_unref(self->fixed_distance_decoder);
+  ut_object_unref(self->chunks);
+  ut_object_unref(self->buffer);
+  ut_object_unref(self->error);
+}
+
+static void ut_deflate_parallel_decoder_read(UtObject *object,
+                                             UtObject *callback_object,
+                                             UtInputStreamCallback callback) {
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  assert(callback != NULL);
+  assert(self->callback == NULL);
+  ut_object_weak_ref(callback_object, &self->callback_object);
+  self->callback = callback;
+  start_chunks(self);
+}
+
+static void ut_deflate_parallel_decoder_close(UtObject *object) {
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  ut_list_clear(self->chunks);
+  ut_object_weak_unref(&self->callback_object);
+}
+
+static UtInputStreamInterface input_stream_interface = {
+    .read = ut_deflate_parallel_decoder_read,
+    .close = ut_deflate_parallel_decoder_close};
+
+static UtObjectInterface object_interface = {
+    .type_name = "UtDeflateParallelDecoder",
+    .init = ut_deflate_parallel_decoder_init,
+    .cleanup = ut_deflate_parallel_decoder_cleanup,
+    .interfaces = {{&ut_input_stream_id, &input_stream_interface},
+                   {NULL, NULL}}};
+
+UtObject *ut_deflate_parallel_decoder_new(size_t n_threads, UtObject *data,
+                                          size_t offset) {
+  assert(n_threads > 0);
+  assert(ut_uint8_list_get_data(data) != NULL);
+  assert(offset <= ut_list_get_length(data));
+  UtObject *object =
+      ut_object_new(sizeof(UtDeflateParallelDecoder), &object_interface);
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  self->data = ut_object_ref(data);
+  self->n_threads = n_threads;
+  self->next_chunk_offset = offset;
+  self->end_bit = offset * 8;
+  return object;
+}
+
+size_t ut_deflate_parallel_decoder_get_end_offset(UtObject *object) {
+  assert(ut_object_is_deflate_parallel_decoder(object));
+  UtDeflateParallelDecoder *self = (UtDeflateParallelDecoder *)object;
+  assert(self->state == DECODER_STATE_DONE);
+  return (self->end_bit + 7) / 8;
+}
+
+bool ut_object_is_deflate_parallel_decoder(UtObject *object) {
+  return ut_object_is_type(object, &object_interface);
+}
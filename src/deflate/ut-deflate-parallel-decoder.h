@@ -0,0 +1,29 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+/// Creates a new decoder to read the deflate data starting at [offset] in
+/// [data], using up to [n_threads] worker threads.
+///
+/// [data] must be stored in contiguous memory, e.g. a [UtMemoryMappedFile].
+/// The data is split into chunks, and each chunk is decoded speculatively from
+/// the first position that looks like the start of a deflate block. Chunks are
+/// checked in order to ensure they start where the previous chunk ended, and
+/// are decoded again if they do not. The output is identical to
+/// [ut_deflate_decoder_new].
+///
+/// !arg-type data UtUint8List
+/// !return-type UtDeflateParallelDecoder
+/// !return-ref
+UtObject *ut_deflate_parallel_decoder_new(size_t n_threads, UtObject *data,
+                                          size_t offset);
+
+/// Returns the offset in the data after the end of the deflate data.
+/// Only valid once all the data has been decoded.
+size_t ut_deflate_parallel_decoder_get_end_offset(UtObject *object);
+
+/// Returns [true] if [object] is a [UtDeflateParallelDecoder].
+bool ut_object_is_deflate_parallel_decoder(UtObject *object);
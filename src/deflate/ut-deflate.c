@@ -0,0 +1,48 @@
+#include "ut-deflate.h"
+#include "ut.h"
+
+const uint16_t deflate_base_lengths[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+
+const uint8_t deflate_extra_length_bits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                               1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                               4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+const uint16_t deflate_base_distances[30] = {
+    1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+    33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+const uint8_t deflate_extra_distance_bits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+const uint8_t deflate_code_width_symbol_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+UtObject *deflate_fixed_literal_length_huffman_decoder_new() {
+  UtObjectRef code_widths = ut_uint8_array_new_sized(288);
+  uint8_t *code_widths_data = ut_uint8_list_get_writable_data(code_widths);
+  for (size_t symbol = 0; symbol <= 287; symbol++) {
+    if (symbol <= 143) {
+      code_widths_data[symbol] = 8;
+    } else if (symbol <= 255) {
+      code_widths_data[symbol] = 9;
+    } else if (symbol <= 279) {
+      code_widths_data[symbol] = 7;
+    } else {
+      code_widths_data[symbol] = 8;
+    }
+  }
+  return ut_huffman_decoder_new_canonical(code_widths);
+}
+
+UtObject *deflate_fixed_distance_huffman_decoder_new() {
+  UtObjectRef code_widths = ut_uint8_array_new_sized(32);
+  uint8_t *code_widths_data = ut_uint8_list_get_writable_data(code_widths);
+  for (size_t symbol = 0; symbol < 32; symbol++) {
+    code_widths_data[symbol] = 5;
+  }
+  return ut_huffman_decoder_new_canonical(code_widths);
+}
@@ -0,0 +1,23 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+// Base length and number of extra bits for length symbols 257-285.
+extern const uint16_t deflate_base_lengths[29];
+extern const uint8_t deflate_extra_length_bits[29];
+
+// Base distance and number of extra bits for distance symbols 0-29.
+extern const uint16_t deflate_base_distances[30];
+extern const uint8_t deflate_extra_distance_bits[30];
+
+// Order that code widths are stored in dynamic Huffman block headers.
+extern const uint8_t deflate_code_width_symbol_order[19];
+
+// Creates a Huffman decoder for the fixed literal/length code.
+UtObject *deflate_fixed_literal_length_huffman_decoder_new();
+
+// Creates a Huffman decoder for the fixed distance code.
+UtObject *deflate_fixed_distance_huffman_decoder_new();
@@ -0,0 +1,94 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures how gzip decoding scales with the number of worker threads.
+// Decodes the file given on the command line, or generated data if none.
+
+// Write gzip compressed text to a temporary file and return its path.
+static char *make_file() {
+  UtObjectRef data = ut_benchmark_make_log_text(64 * 1024 * 1024);
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_gzip_encoder_new(data_stream);
+  UtObjectRef encoded_data = ut_input_stream_read_sync(encoder);
+
+  char *path = ut_cstring_new("/tmp/ut-gzip-decoder-benchmark-XXXXXX");
+  int fd = mkstemp(path);
+  const uint8_t *d = ut_uint8_list_get_data(encoded_data);
+  size_t d_length = ut_list_get_length(encoded_data);
+  while (d_length > 0) {
+    ssize_t n_written = write(fd, d, d_length);
+    ut_assert_true(n_written > 0);
+    d += n_written;
+    d_length -= n_written;
+  }
+  close(fd);
+
+  return path;
+}
+
+static size_t decoded_length = 0;
+
+static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
+  ut_assert_is_not_error(data);
+  size_t data_length = ut_list_get_length(data);
+  decoded_length += data_length;
+  if (complete) {
+    ut_event_loop_return(NULL);
+  }
+  return data_length;
+}
+
+static void benchmark(UtObject *file, size_t n_threads, size_t serial_length,
+                      double serial_rate) {
+  size_t file_length = ut_list_get_length(file);
+  UtObjectRef dummy_object = ut_null_new();
+
+  decoded_length = 0;
+  double start = ut_benchmark_get_time();
+  UtObjectRef decoder = ut_gzip_decoder_new_parallel(n_threads, file);
+  ut_input_stream_read(decoder, dummy_object, read_cb);
+  UtObjectRef result = ut_event_loop_run();
+  double duration = ut_benchmark_get_time() - start;
+  ut_assert_int_equal(decoded_length, serial_length);
+
+  double rate = decoded_length / duration / 1e6;
+  printf("%2zi threads: %9zi -> %9zi bytes, %6.1f MB/s (%.2fx)\n", n_threads,
+         file_length, decoded_length, rate, rate / serial_rate);
+}
+
+int main(int argc, char **argv) {
+  ut_cstring_ref temporary_path = argc > 1 ? NULL : make_file();
+  const char *path = argc > 1 ? argv[1] : temporary_path;
+
+  UtObjectRef file = ut_memory_mapped_file_new(path);
+  ut_file_open_read(file);
+  size_t file_length = ut_list_get_length(file);
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef file_stream = ut_list_input_stream_new(file);
+  UtObjectRef decoder = ut_gzip_decoder_new(file_stream);
+  UtObjectRef result = ut_input_stream_read_sync(decoder);
+  ut_assert_is_not_error(result);
+  double duration = ut_benchmark_get_time() - start;
+  size_t result_length = ut_list_get_length(result);
+  double serial_rate = result_length / duration / 1e6;
+  printf("    serial: %9zi -> %9zi bytes, %6.1f MB/s\n", file_length,
+         result_length, serial_rate);
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (size_t n_threads = 1; n_threads < (size_t)n_cpus; n_threads *= 2) {
+    benchmark(file, n_threads, result_length, serial_rate);
+  }
+  benchmark(file, n_cpus, result_length, serial_rate);
+
+  if (temporary_path != NULL) {
+    unlink(temporary_path);
+  }
+
+  return 0;
+}
@@ -1,7 +1,106 @@
 #include <stdio.h>
 
+#include "ut-benchmark.h"
 #include "ut.h"
 
+// Number of parallel decodings still running.
+static size_t n_parallel_running = 0;
+
+typedef struct {
+  UtObject object;
+  UtObject *data;
+  bool expect_error;
+  UtObject *decoder;
+} ParallelTest;
+
+static void parallel_test_cleanup(UtObject *object) {
+  ParallelTest *self = (ParallelTest *)object;
+  ut_object_unref(self->data);
+  ut_object_unref(self->decoder);
+}
+
+static UtObjectInterface parallel_test_object_interface = {
+    .type_name = "ParallelTest", .cleanup = parallel_test_cleanup};
+
+static size_t parallel_read_cb(UtObject *object, UtObject *data,
+                               bool complete) {
+  ParallelTest *self = (ParallelTest *)object;
+  if (!complete) {
+    return 0;
+  }
+
+  if (self->expect_error) {
+    ut_assert_is_error(data);
+  } else {
+    ut_assert_is_not_error(data);
+    ut_assert_equal(data, self->data);
+  }
+
+  n_parallel_running--;
+  if (n_parallel_running == 0) {
+    ut_event_loop_return(NULL);
+  }
+
+  return ut_object_implements_error(data) ? 0 : ut_list_get_length(data);
+}
+
+static UtObject *start_parallel_test(UtObject *encoded_data, UtObject *data,
+                                     size_t n_threads) {
+  UtObject *object = ut_object_new(sizeof(ParallelTest),
+                                   &parallel_test_object_interface);
+  ParallelTest *self = (ParallelTest *)object;
+  self->data = data != NULL ? ut_object_ref(data) : NULL;
+  self->expect_error = data == NULL;
+  self->decoder = ut_gzip_decoder_new_parallel(n_threads, encoded_data);
+  ut_input_stream_read(self->decoder, object, parallel_read_cb);
+  n_parallel_running++;
+  return object;
+}
+
+static void test_parallel() {
+  UtObjectRef hello_data = ut_uint8_list_new_from_hex_string(
+      "1f8b0800000000000003cb48cdc9c9070086a6103605000000");
+  UtObjectRef hello_string = ut_string_new("hello");
+  UtObjectRef hello_result = ut_string_get_utf8(hello_string);
+
+  // Random lines with repeats of earlier lines, so the data is large enough
+  // to cover multiple chunks and contains references across chunks.
+  UtObjectRef text_data = ut_uint8_array_new();
+  for (size_t line = 0; line < 120000; line++) {
+    size_t line_length = 48;
+    size_t text_length = ut_list_get_length(text_data);
+    if (ut_benchmark_get_random() % 2 == 0 &&
+        text_length > line_length * 600) {
+      size_t start =
+          text_length - line_length * (1 + ut_benchmark_get_random() % 600);
+      for (size_t i = 0; i < line_length; i++) {
+        ut_uint8_list_append(text_data,
+                             ut_uint8_list_get_element(text_data, start + i));
+      }
+    } else {
+      for (size_t i = 0; i < line_length - 1; i++) {
+        ut_uint8_list_append(text_data, 'a' + ut_benchmark_get_random() % 26);
+      }
+      ut_uint8_list_append(text_data, '\n');
+    }
+  }
+  UtObjectRef text_stream = ut_list_input_stream_new(text_data);
+  UtObjectRef text_encoder = ut_gzip_encoder_new(text_stream);
+  UtObjectRef text_encoded_data = ut_input_stream_read_sync(text_encoder);
+  ut_assert_is_not_error(text_encoded_data);
+
+  // Missing the end of the data.
+  UtObjectRef truncated_data = ut_list_get_sublist(
+      text_encoded_data, 0, ut_list_get_length(text_encoded_data) - 100000);
+
+  UtObjectRef hello_test = start_parallel_test(hello_data, hello_result, 4);
+  UtObjectRef text_test1 = start_parallel_test(text_encoded_data, text_data, 1);
+  UtObjectRef text_test4 = start_parallel_test(text_encoded_data, text_data, 4);
+  UtObjectRef truncated_test = start_parallel_test(truncated_data, NULL, 4);
+  ut_event_loop_run();
+  ut_assert_int_equal(n_parallel_running, 0);
+}
+
 int main(int argc, char **argv) {
   UtObjectRef empty_data = ut_uint8_list_new_from_hex_string(
       "1f8b080000000000000303000000000000000000");
@@ -54,5 +153,7 @@ int main(int argc, char **argv) {
   ut_assert_cstring_equal(ut_string_get_text(dynamic_huffman_result_string),
                           "abaabbbabaababbaababaaaabaaabbbbbaa");
 
+  test_parallel();
+
   return 0;
 }
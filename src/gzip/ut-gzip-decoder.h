@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "ut-object.h"
 
@@ -11,5 +12,14 @@
 /// !return-type UtGzipDecoder
 UtObject *ut_gzip_decoder_new(UtObject *input_stream);
 
+/// Creates a new GZip decoder to decode [data] using up to [n_threads] worker
+/// threads. [data] must be stored in contiguous memory, e.g. a
+/// [UtMemoryMappedFile]. See [ut_deflate_parallel_decoder_new] for details.
+///
+/// !arg-type data UtUint8List
+/// !return-ref
+/// !return-type UtGzipDecoder
+UtObject *ut_gzip_decoder_new_parallel(size_t n_threads, UtObject *data);
+
 /// Returns [true] if [object] is a [UtGzipDecoder].
 bool ut_object_is_gzip_decoder(UtObject *object);
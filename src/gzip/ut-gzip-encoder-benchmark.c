@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures how gzip encoding scales with the number of worker threads.
+
+static size_t encoded_length = 0;
+
+static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
+  if (complete) {
+    encoded_length = ut_list_get_length(data);
+    ut_event_loop_return(NULL);
+  }
+  return complete ? ut_list_get_length(data) : 0;
+}
+
+static void benchmark(UtObject *data, size_t n_threads, double serial_rate) {
+  size_t data_length = ut_list_get_length(data);
+  UtObjectRef dummy_object = ut_null_new();
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_gzip_encoder_new_parallel(n_threads, data_stream);
+  ut_input_stream_read(encoder, dummy_object, read_cb);
+  UtObjectRef result = ut_event_loop_run();
+  double duration = ut_benchmark_get_time() - start;
+
+  double rate = data_length / duration / 1e6;
+  printf("%2zi threads: %8zi -> %8zi bytes, %6.1f MB/s (%.2fx)\n", n_threads,
+         data_length, encoded_length, rate, rate / serial_rate);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef data = ut_benchmark_make_log_text(16 * 1024 * 1024);
+  size_t data_length = ut_list_get_length(data);
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_gzip_encoder_new(data_stream);
+  UtObjectRef result = ut_input_stream_read_sync(encoder);
+  double duration = ut_benchmark_get_time() - start;
+  double serial_rate = data_length / duration / 1e6;
+  printf("    serial: %8zi -> %8zi bytes, %6.1f MB/s\n", data_length,
+         ut_list_get_length(result), serial_rate);
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (size_t n_threads = 1; n_threads < (size_t)n_cpus; n_threads *= 2) {
+    benchmark(data, n_threads, serial_rate);
+  }
+  benchmark(data, n_cpus, serial_rate);
+
+  return 0;
+}
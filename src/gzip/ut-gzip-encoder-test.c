@@ -1,5 +1,107 @@
+#include "ut-benchmark.h"
 #include "ut.h"
 
+// Number of parallel encodings still running.
+static size_t n_parallel_running = 0;
+
+typedef struct {
+  UtObject object;
+  UtObject *data;
+  UtObject *encoder;
+} ParallelTest;
+
+static void parallel_test_cleanup(UtObject *object) {
+  ParallelTest *self = (ParallelTest *)object;
+  ut_object_unref(self->data);
+  ut_object_unref(self->encoder);
+}
+
+static UtObjectInterface parallel_test_object_interface = {
+    .type_name = "ParallelTest", .cleanup = parallel_test_cleanup};
+
+static size_t parallel_read_cb(UtObject *object, UtObject *data,
+                               bool complete) {
+  ParallelTest *self = (ParallelTest *)object;
+  if (!complete) {
+    return 0;
+  }
+
+  // Result is the same as encoding in serial for data that fits in one chunk.
+  if (ut_list_get_length(self->data) <= 131072) {
+    UtObjectRef data_stream = ut_list_input_stream_new(self->data);
+    UtObjectRef encoder = ut_gzip_encoder_new(data_stream);
+    UtObjectRef result = ut_input_stream_read_sync(encoder);
+    ut_assert_equal(data, result);
+  }
+
+  UtObjectRef encoded_data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_gzip_decoder_new(encoded_data_stream);
+  UtObjectRef decoded_data = ut_input_stream_read_sync(decoder);
+  ut_assert_is_not_error(decoded_data);
+  ut_assert_equal(decoded_data, self->data);
+
+  n_parallel_running--;
+  if (n_parallel_running == 0) {
+    ut_event_loop_return(NULL);
+  }
+
+  return ut_list_get_length(data);
+}
+
+// Encode [data] provided by [data_stream].
+static UtObject *start_parallel_stream_test(UtObject *data_stream,
+                                            UtObject *data, size_t n_threads) {
+  UtObject *object = ut_object_new(sizeof(ParallelTest),
+                                   &parallel_test_object_interface);
+  ParallelTest *self = (ParallelTest *)object;
+  self->data = ut_object_ref(data);
+  self->encoder = ut_gzip_encoder_new_parallel(n_threads, data_stream);
+  ut_input_stream_read(self->encoder, object, parallel_read_cb);
+  n_parallel_running++;
+  return object;
+}
+
+static UtObject *start_parallel_test(UtObject *data, size_t n_threads) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  return start_parallel_stream_test(data_stream, data, n_threads);
+}
+
+static void test_parallel() {
+  UtObjectRef empty_data = ut_uint8_list_new();
+
+  UtObjectRef hello3_string = ut_string_new("hello hello hello");
+  UtObjectRef hello3_data = ut_string_get_utf8(hello3_string);
+
+  // Text covering multiple chunks, which matches text in previous chunks.
+  const char *words[] = {"gzip ", "chunk ", "thread ", "data ", "parallel "};
+  UtObjectRef text = ut_string_new("");
+  for (size_t i = 0; i < 100000; i++) {
+    ut_string_append(text, words[ut_benchmark_get_random() % 5]);
+  }
+  UtObjectRef text_data = ut_string_get_utf8(text);
+
+  UtObjectRef empty_test = start_parallel_test(empty_data, 4);
+  UtObjectRef hello3_test = start_parallel_test(hello3_data, 4);
+  UtObjectRef text_test1 = start_parallel_test(text_data, 1);
+  UtObjectRef text_test4 = start_parallel_test(text_data, 4);
+
+  // Input is only taken as fast as it can be compressed, the rest is taken
+  // when the stream completes.
+  UtObjectRef text_stream = ut_writable_input_stream_new();
+  UtObjectRef text_stream_test =
+      start_parallel_stream_test(text_stream, text_data, 1);
+  size_t text_length = ut_list_get_length(text_data);
+  size_t n_used = ut_writable_input_stream_write(text_stream, text_data, false);
+  ut_assert_true(n_used < text_length);
+  UtObjectRef remaining_data =
+      ut_list_get_sublist(text_data, n_used, text_length - n_used);
+  ut_assert_int_equal(
+      ut_writable_input_stream_write(text_stream, remaining_data, true),
+      text_length - n_used);
+  ut_event_loop_run();
+  ut_assert_int_equal(n_parallel_running, 0);
+}
+
 int main(int argc, char **argv) {
   UtObjectRef empty_data = ut_uint8_list_new();
   UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
@@ -36,5 +138,7 @@ int main(int argc, char **argv) {
   ut_assert_uint8_list_equal_hex(
       hello3_result, "1f8b0800000000000003cb48cdc9c9574022018088f9e511000000");
 
+  test_parallel();
+
   return 0;
 }
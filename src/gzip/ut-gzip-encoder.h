@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "ut-object.h"
 
@@ -11,5 +12,18 @@
 /// !return-type UtGzipEncoder
 UtObject *ut_gzip_encoder_new(UtObject *input_stream);
 
+/// Creates a new GZip encoder to encode the data from [input_stream], using
+/// up to [n_threads] worker threads.
+/// The data is split into chunks that are compressed independently, each
+/// using the end of the previous chunk as a dictionary. The result is a single
+/// gzip member, slightly larger than from [ut_gzip_encoder_new].
+/// The encoded data is returned from the event loop.
+///
+/// !arg-type input_stream UtInputStream
+/// !return-ref
+/// !return-type UtGzipEncoder
+UtObject *ut_gzip_encoder_new_parallel(size_t n_threads,
+                                       UtObject *input_stream);
+
 /// Returns [true] if [object] is a [UtGzipEncoder].
 bool ut_object_is_gzip_encoder(UtObject *object);
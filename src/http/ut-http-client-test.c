@@ -1,13 +1,42 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "ut.h"
 
 static UtObject *listen_sockets = NULL;
+static size_t n_responses = 0;
+
+static void send_gzip_reply(UtObject *socket) {
+  UtObjectRef body = ut_string_new("{\"text\": \"Hello World!\"}");
+  UtObjectRef body_data = ut_string_get_utf8(body);
+  UtObjectRef body_stream = ut_list_input_stream_new(body_data);
+  UtObjectRef encoder = ut_gzip_encoder_new(body_stream);
+  UtObjectRef encoded_body = ut_input_stream_read_sync(encoder);
+
+  UtObjectRef reply = ut_string_new("");
+  ut_string_append_printf(reply, "HTTP/1.1 200 OK\r\n");
+  ut_string_append_printf(reply, "Content-Type: application/json\r\n");
+  ut_string_append_printf(reply, "Content-Encoding: gzip\r\n");
+  ut_string_append_printf(reply, "Content-Length: %zi\r\n",
+                          ut_list_get_length(encoded_body));
+  ut_string_append_printf(reply, "\r\n");
+  UtObjectRef reply_data = ut_string_get_utf8(reply);
+  ut_tcp_socket_send(socket, reply_data);
+  ut_tcp_socket_send(socket, encoded_body);
+}
 
 static size_t http_read_cb(UtObject *object, UtObject *data, bool complete) {
   UtObject *socket = object;
   UtObjectRef text = ut_string_new_from_utf8(data);
 
+  // Client accepts compressed responses.
+  ut_assert_true(strstr(ut_string_get_text(text),
+                        "Accept-Encoding: gzip, deflate\r\n") != NULL);
+  if (ut_cstring_starts_with(ut_string_get_text(text), "GET /gzip ")) {
+    send_gzip_reply(socket);
+    return ut_list_get_length(data);
+  }
+
   UtObjectRef reply = ut_string_new("");
   ut_string_append_printf(reply, "HTTP/1.1 200 OK\r\n");
   ut_string_append_printf(reply, "Content-Type: application/json\r\n");
@@ -31,7 +60,10 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   ut_assert_cstring_equal(ut_string_get_text(text),
                           "{\"text\": \"Hello World!\"}");
 
-  ut_event_loop_return(NULL);
+  n_responses++;
+  if (n_responses == 2) {
+    ut_event_loop_return(NULL);
+  }
   return ut_list_get_length(data);
 }
 
@@ -47,6 +79,10 @@ static void http_response_cb(UtObject *object, UtObject *response) {
     }
   }
   ut_assert_cstring_equal(content_type, "application/json");
+
+  // Compressed body is decoded.
+  ut_assert_true(ut_http_response_get_header(response, "Content-Encoding") ==
+                 NULL);
   ut_input_stream_read_all(ut_http_response_get_body(response), object,
                            read_cb);
 }
@@ -64,6 +100,10 @@ int main(int argc, char **argv) {
   ut_cstring_ref uri = ut_cstring_new_printf("http://127.0.0.1:%d", http_port);
   ut_http_client_send_request(http_client, "GET", uri, NULL, dummy_object,
                               http_response_cb);
+  ut_cstring_ref gzip_uri =
+      ut_cstring_new_printf("http://127.0.0.1:%d/gzip", http_port);
+  ut_http_client_send_request(http_client, "GET", gzip_uri, NULL, dummy_object,
+                              http_response_cb);
 
   ut_event_loop_run();
 
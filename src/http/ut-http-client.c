@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <sys/types.h>
 
 #include "ut-http-message-decoder.h"
@@ -86,6 +87,67 @@ static void ut_http_client_cleanup(UtObject *object) {
   ut_object_unref(self->requests);
 }
 
+// Returns a copy of [headers] without the headers that describe the encoded
+// body.
+static UtObject *get_decoded_headers(UtObject *headers) {
+  UtObject *decoded_headers = ut_list_new();
+  size_t headers_length = ut_list_get_length(headers);
+  for (size_t i = 0; i < headers_length; i++) {
+    UtObject *header = ut_object_list_get_element(headers, i);
+    const char *name = ut_http_header_get_name(header);
+    if (strcasecmp(name, "Content-Encoding") != 0 &&
+        strcasecmp(name, "Content-Length") != 0) {
+      ut_list_append(decoded_headers, header);
+    }
+  }
+
+  return decoded_headers;
+}
+
+// Returns a stream that decodes [body] encoded with [content_encoding] or
+// NULL if this encoding is not supported.
+static UtObject *make_body_decoder(const char *content_encoding,
+                                   UtObject *body) {
+  if (strcasecmp(content_encoding, "gzip") == 0 ||
+      strcasecmp(content_encoding, "x-gzip") == 0) {
+    return ut_gzip_decoder_new(body);
+  } else if (strcasecmp(content_encoding, "deflate") == 0) {
+    return ut_zlib_decoder_new(body);
+  } else {
+    return NULL;
+  }
+}
+
+static UtObject *make_response(HttpRequest *request) {
+  unsigned int status_code =
+      ut_http_message_decoder_get_status_code(request->message_decoder);
+  const char *reason_phrase =
+      ut_http_message_decoder_get_reason_phrase(request->message_decoder);
+  UtObject *headers =
+      ut_http_message_decoder_get_headers(request->message_decoder);
+  UtObject *body = ut_http_message_decoder_get_body(request->message_decoder);
+
+  // Transparently decode compressed bodies.
+  const char *content_encoding = NULL;
+  size_t headers_length = ut_list_get_length(headers);
+  for (size_t i = 0; i < headers_length; i++) {
+    UtObject *header = ut_object_list_get_element(headers, i);
+    if (strcasecmp(ut_http_header_get_name(header), "Content-Encoding") == 0) {
+      content_encoding = ut_http_header_get_value(header);
+    }
+  }
+  UtObjectRef decoder = content_encoding != NULL
+                            ? make_body_decoder(content_encoding, body)
+                            : NULL;
+  if (decoder == NULL) {
+    return ut_http_response_new(status_code, reason_phrase, headers, body);
+  }
+
+  UtObjectRef decoded_headers = get_decoded_headers(headers);
+  return ut_http_response_new(status_code, reason_phrase, decoded_headers,
+                              decoder);
+}
+
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   HttpRequest *request = (HttpRequest *)object;
 
@@ -95,11 +157,7 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
       request->message_decoder_input_stream, data, complete);
   if (!headers_done &&
       ut_http_message_decoder_get_headers_done(request->message_decoder)) {
-    UtObjectRef response = ut_http_response_new(
-        ut_http_message_decoder_get_status_code(request->message_decoder),
-        ut_http_message_decoder_get_reason_phrase(request->message_decoder),
-        ut_http_message_decoder_get_headers(request->message_decoder),
-        ut_http_message_decoder_get_body(request->message_decoder));
+    UtObjectRef response = make_response(request);
     if (request->callback_object != NULL && request->callback != NULL) {
       request->callback(request->callback_object, response);
     }
@@ -120,6 +178,8 @@ static void connect_cb(UtObject *object, UtObject *error) {
 
   UtObjectRef headers = ut_list_new();
   ut_list_append_take(headers, ut_http_header_new("Host", request->host));
+  ut_list_append_take(headers,
+                      ut_http_header_new("Accept-Encoding", "gzip, deflate"));
   request->message_encoder = ut_http_message_encoder_new_request(
       request->tcp_socket, request->method, request->path, headers,
       request->body);
@@ -34,6 +34,14 @@ UtObject *ut_http_header_new(const char *name, const char *value) {
   return object;
 }
 
+UtObject *ut_http_header_new_take(char *name, char *value) {
+  UtObject *object = ut_object_new(sizeof(UtHttpHeader), &object_interface);
+  UtHttpHeader *self = (UtHttpHeader *)object;
+  self->name = name;
+  self->value = value;
+  return object;
+}
+
 const char *ut_http_header_get_name(UtObject *object) {
   assert(ut_object_is_http_header(object));
   UtHttpHeader *self = (UtHttpHeader *)object;
@@ -10,6 +10,14 @@
 /// !return-type UtHttpHeader
 UtObject *ut_http_header_new(const char *name, const char *value);
 
+/// Creates a new HTTP header with [name] and [value].
+/// [name] and [value] must be allocated for this call, e.g. with
+/// [ut_cstring_new].
+///
+/// !return-ref
+/// !return-type UtHttpHeader
+UtObject *ut_http_header_new_take(char *name, char *value);
+
 /// Returns the name of the header.
 const char *ut_http_header_get_name(UtObject *object);
 
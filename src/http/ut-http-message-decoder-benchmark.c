@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+#include "ut-benchmark.h"
+#include "ut-http-message-decoder.h"
+#include "ut.h"
+
+// Measures how many HTTP requests can be decoded per second.
+
+static UtObject *make_typical_request() {
+  UtObjectRef text = ut_string_new(
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 "
+      "Firefox/120.0\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"
+      "\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "Accept-Encoding: gzip, deflate\r\n"
+      "Connection: keep-alive\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "\r\n");
+  return ut_string_get_utf8(text);
+}
+
+static UtObject *make_large_request() {
+  UtObjectRef text = ut_string_new("GET /index.html HTTP/1.1\r\n"
+                                   "Host: www.example.com\r\n");
+  for (size_t i = 0; i < 64; i++) {
+    ut_string_append_printf(text, "X-Header-%03zi: ", i);
+    for (size_t j = 0; j < 112; j++) {
+      ut_string_append(text, "x");
+    }
+    ut_string_append(text, "\r\n");
+  }
+  ut_string_append(text, "\r\n");
+  return ut_string_get_utf8(text);
+}
+
+// Decode [request] [n_requests] times, with the data arriving in blocks of
+// [block_size] bytes.
+static void benchmark(const char *name, UtObject *request, size_t n_requests,
+                      size_t block_size) {
+  UtObjectRef data_stream = ut_writable_input_stream_new();
+  UtObjectRef decoder = ut_http_message_decoder_new_request(data_stream);
+  ut_http_message_decoder_read(decoder);
+
+  size_t request_length = ut_list_get_length(request);
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < n_requests; i++) {
+    size_t offset = 0;
+    for (size_t length = block_size; offset < request_length;
+         length += block_size) {
+      if (length > request_length) {
+        length = request_length;
+      }
+      UtObjectRef data = ut_list_get_sublist(request, offset, length - offset);
+      offset += ut_writable_input_stream_write(data_stream, data, false);
+    }
+    ut_assert_true(ut_http_message_decoder_get_done(decoder));
+    ut_http_message_decoder_reset(decoder);
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  printf("%-28s %6zi bytes: %10.0f requests/s\n", name, request_length,
+         n_requests / duration);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef typical_request = make_typical_request();
+  UtObjectRef large_request = make_large_request();
+
+  size_t typical_length = ut_list_get_length(typical_request);
+  size_t large_length = ut_list_get_length(large_request);
+  benchmark("typical", typical_request, 200000, typical_length);
+  benchmark("8KB headers", large_request, 20000, large_length);
+  benchmark("8KB headers, 1KB reads", large_request, 20000, 1024);
+
+  return 0;
+}
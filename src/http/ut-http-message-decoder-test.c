@@ -202,10 +202,17 @@ static void test_headers() {
 }
 
 static void test_body() {
-  UtObjectRef eof_headers = test_decode_request("GET / HTTP/1.1\r\n"
-                                                "\r\n"
-                                                "Hello World!",
-                                                "GET", "/", "Hello World!");
+  // Requests without a length have no body.
+  UtObjectRef no_length_headers = test_decode_request("GET / HTTP/1.1\r\n"
+                                                      "\r\n"
+                                                      "Hello World!",
+                                                      "GET", "/", "");
+  ut_assert_non_null_object(no_length_headers);
+
+  UtObjectRef eof_headers = test_decode_response("HTTP/1.1 200 OK\r\n"
+                                                 "\r\n"
+                                                 "Hello World!",
+                                                 200, "OK", "Hello World!");
   ut_assert_non_null_object(eof_headers);
 
   UtObjectRef content_length_headers =
@@ -317,11 +324,120 @@ static void test_body() {
       "Invalid HTTP chunk");
 }
 
+static void test_keep_alive() {
+  UtObjectRef http_1_1_decoder = decode_request("GET / HTTP/1.1\r\n"
+                                                "\r\n");
+  ut_assert_true(ut_http_message_decoder_get_keep_alive(http_1_1_decoder));
+
+  UtObjectRef close_decoder = decode_request("GET / HTTP/1.1\r\n"
+                                             "Connection: Close\r\n"
+                                             "\r\n");
+  ut_assert_false(ut_http_message_decoder_get_keep_alive(close_decoder));
+
+  UtObjectRef http_1_0_decoder = decode_request("GET / HTTP/1.0\r\n"
+                                                "\r\n");
+  ut_assert_false(ut_http_message_decoder_get_keep_alive(http_1_0_decoder));
+
+  UtObjectRef keep_alive_decoder =
+      decode_request("GET / HTTP/1.0\r\n"
+                     "Connection: upgrade, keep-alive\r\n"
+                     "\r\n");
+  ut_assert_true(ut_http_message_decoder_get_keep_alive(keep_alive_decoder));
+}
+
+static void test_multiple_requests() {
+  UtObjectRef data_stream = ut_writable_input_stream_new();
+  UtObjectRef decoder = ut_http_message_decoder_new_request(data_stream);
+  ut_http_message_decoder_read(decoder);
+
+  UtObjectRef data_string = ut_string_new("GET /one HTTP/1.1\r\n"
+                                          "\r\n"
+                                          "POST /two HTTP/1.1\r\n"
+                                          "Content-Length: 5\r\n"
+                                          "\r\n"
+                                          "Hello"
+                                          "GET /thr");
+  UtObjectRef data = ut_string_get_utf8(data_string);
+  size_t data_length = ut_list_get_length(data);
+
+  size_t offset = ut_writable_input_stream_write(data_stream, data, false);
+  ut_assert_int_equal(offset, 21);
+  ut_assert_true(ut_http_message_decoder_get_done(decoder));
+  ut_assert_cstring_equal(ut_http_message_decoder_get_path(decoder), "/one");
+
+  ut_http_message_decoder_reset(decoder);
+  ut_assert_false(ut_http_message_decoder_get_done(decoder));
+  UtObjectRef data2 = ut_list_get_sublist(data, offset, data_length - offset);
+  offset += ut_writable_input_stream_write(data_stream, data2, false);
+  ut_assert_int_equal(offset, 67);
+  ut_assert_true(ut_http_message_decoder_get_done(decoder));
+  ut_assert_cstring_equal(ut_http_message_decoder_get_method(decoder), "POST");
+  ut_assert_cstring_equal(ut_http_message_decoder_get_path(decoder), "/two");
+  UtObjectRef body =
+      ut_input_stream_read_sync(ut_http_message_decoder_get_body(decoder));
+  check_body(body, "Hello");
+
+  // Partial request waits for more data.
+  ut_http_message_decoder_reset(decoder);
+  UtObjectRef data3 = ut_list_get_sublist(data, offset, data_length - offset);
+  ut_assert_int_equal(ut_writable_input_stream_write(data_stream, data3, false),
+                      0);
+  ut_assert_false(ut_http_message_decoder_get_done(decoder));
+  ut_assert_false(ut_http_message_decoder_get_headers_done(decoder));
+}
+
+static void test_partial() {
+  UtObjectRef data_stream = ut_writable_input_stream_new();
+  UtObjectRef decoder = ut_http_message_decoder_new_request(data_stream);
+  ut_http_message_decoder_read(decoder);
+
+  UtObjectRef data_string = ut_string_new("GET /path HTTP/1.1\r\n"
+                                          "Host: example.com\r\n"
+                                          "Content-Length: 4\r\n"
+                                          "\r\n"
+                                          "BODY");
+  UtObjectRef data = ut_string_get_utf8(data_string);
+  size_t data_length = ut_list_get_length(data);
+
+  // Data arrives one byte at a time, unused data is provided again.
+  size_t offset = 0;
+  for (size_t length = 1; length <= data_length; length++) {
+    UtObjectRef d = ut_list_get_sublist(data, offset, length - offset);
+    offset += ut_writable_input_stream_write(data_stream, d, false);
+  }
+  ut_assert_int_equal(offset, data_length);
+  ut_assert_true(ut_http_message_decoder_get_done(decoder));
+  ut_assert_cstring_equal(ut_http_message_decoder_get_path(decoder), "/path");
+  UtObject *headers = ut_http_message_decoder_get_headers(decoder);
+  ut_assert_int_equal(ut_list_get_length(headers), 2);
+  UtObject *header = ut_object_list_get_element(headers, 0);
+  ut_assert_cstring_equal(ut_http_header_get_name(header), "Host");
+  ut_assert_cstring_equal(ut_http_header_get_value(header), "example.com");
+}
+
+static void test_iso_8859_1() {
+  UtObjectRef data = ut_uint8_array_new_from_elements(
+      24, 'G', 'E', 'T', ' ', '/', ' ', 'H', 'T', 'T', 'P', '/', '1', '.', '1',
+      '\r', '\n', 'X', ':', ' ', 0xe9, '\r', '\n', '\r', '\n');
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_http_message_decoder_new_request(data_stream);
+  ut_http_message_decoder_read(decoder);
+  ut_assert_null_object(ut_http_message_decoder_get_error(decoder));
+  UtObject *headers = ut_http_message_decoder_get_headers(decoder);
+  ut_assert_int_equal(ut_list_get_length(headers), 1);
+  UtObject *header = ut_object_list_get_element(headers, 0);
+  ut_assert_cstring_equal(ut_http_header_get_value(header), "\xc3\xa9");
+}
+
 int main(int argc, char **argv) {
   test_request_line();
   test_response_line();
   test_headers();
   test_body();
+  test_keep_alive();
+  test_multiple_requests();
+  test_partial();
+  test_iso_8859_1();
 
   return 0;
 }
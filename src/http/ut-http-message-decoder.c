@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <string.h>
+#include <strings.h>
 
 #include "ut-http-message-decoder.h"
 #include "ut.h"
@@ -25,9 +27,15 @@ typedef struct {
   // Stream reading HTTP messages from.
   UtObject *input_stream;
 
+  // True if decoding requests, false if responses.
+  bool is_request;
+
   // State of decoding.
   DecoderState state;
 
+  // True if the message uses HTTP/1.0.
+  bool is_http_1_0;
+
   // Requested method.
   char *method;
 
@@ -60,6 +68,9 @@ typedef struct {
 
   // Error that occurred during decoding.
   UtObject *error;
+
+  // Number of bytes already searched for the end of the current line.
+  size_t scan_offset;
 } UtHttpMessageDecoder;
 
 static void set_error(UtHttpMessageDecoder *self, const char *description) {
@@ -72,77 +83,109 @@ static void set_error(UtHttpMessageDecoder *self, const char *description) {
 }
 
 // Finds the first line end sequence (\r\n) in [data] and returns the offset to
-// it.
-static ssize_t find_line_end(UtObject *data) {
-  size_t data_length = ut_list_get_length(data);
-  if (data_length < 2) {
-    return -1;
-  }
-
-  for (size_t i = 0; i < data_length - 1; i++) {
-    if (ut_uint8_list_get_element(data, i) == '\r' &&
-        ut_uint8_list_get_element(data, i + 1) == '\n') {
-      return i;
+// it. Data up to [self->scan_offset] has already been checked.
+static ssize_t find_line_end(UtHttpMessageDecoder *self, const uint8_t *data,
+                             size_t data_length) {
+  size_t offset = self->scan_offset <= data_length ? self->scan_offset : 0;
+  while (offset < data_length) {
+    const uint8_t *newline =
+        memchr(data + offset, '\n', data_length - offset);
+    if (newline == NULL) {
+      break;
+    }
+    size_t i = newline - data;
+    if (i > 0 && data[i - 1] == '\r') {
+      self->scan_offset = 0;
+      return i - 1;
     }
+    offset = i + 1;
   }
 
+  // Remember how far was checked so the search continues from here when more
+  // data arrives.
+  self->scan_offset = data_length;
   return -1;
 }
 
-static UtObject *get_line(UtObject *data, size_t *offset) {
-  ssize_t line_end = find_line_end(data);
-  if (line_end < 0) {
-    return NULL;
+static ssize_t find_character(const uint8_t *data, size_t start, size_t end,
+                              char character) {
+  const uint8_t *c = memchr(data + start, character, end - start);
+  return c != NULL ? c - data : -1;
+}
+
+// Returns the ISO 8859-1 text in [data] from [start] to [end] as UTF-8 with
+// surrounding whitespace removed.
+static char *get_string(const uint8_t *data, size_t start, size_t end) {
+  while (start < end && data[start] == ' ') {
+    start++;
+  }
+  while (end > start && data[end - 1] == ' ') {
+    end--;
   }
 
-  *offset = line_end + 2;
-  return ut_list_get_sublist(data, 0, line_end);
-}
+  size_t length = end - start;
+  size_t utf8_length = length;
+  for (size_t i = start; i < end; i++) {
+    if (data[i] >= 0x80) {
+      utf8_length++;
+    }
+  }
 
-static ssize_t find_character(UtObject *data, size_t offset, char character) {
-  size_t data_length = ut_list_get_length(data);
-  for (size_t i = offset; i < data_length; i++) {
-    if (ut_uint8_list_get_element(data, i) == character) {
-      return i;
+  char *string = malloc(utf8_length + 1);
+  if (utf8_length == length) {
+    memcpy(string, data + start, length);
+  } else {
+    size_t j = 0;
+    for (size_t i = start; i < end; i++) {
+      uint8_t c = data[i];
+      if (c < 0x80) {
+        string[j++] = c;
+      } else {
+        string[j++] = 0xc0 | (c >> 6);
+        string[j++] = 0x80 | (c & 0x3f);
+      }
     }
   }
+  string[utf8_length] = '\0';
 
-  return -1;
+  return string;
 }
 
-static char *get_string(UtObject *data, size_t start, size_t end) {
-  while (start < end && ut_uint8_list_get_element(data, start) == ' ') {
-    start++;
-  }
-  while (end > start && ut_uint8_list_get_element(data, end - 1) == ' ') {
-    end--;
+static bool parse_protocol_version(UtHttpMessageDecoder *self,
+                                   const char *protocol_version) {
+  if (ut_cstring_equal(protocol_version, "HTTP/1.1")) {
+    self->is_http_1_0 = false;
+  } else if (ut_cstring_equal(protocol_version, "HTTP/1.0")) {
+    self->is_http_1_0 = true;
+  } else {
+    set_error(self, "Invalid HTTP version");
+    return false;
   }
-  UtObjectRef string_data = ut_list_get_sublist(data, start, end - start);
-  UtObjectRef string = ut_string_new_from_iso_8859_1(string_data);
-  return ut_string_take_text(string);
+
+  return true;
 }
 
-static bool parse_request_line(UtHttpMessageDecoder *self, UtObject *data) {
+static bool parse_request_line(UtHttpMessageDecoder *self,
+                               const uint8_t *data, size_t data_length) {
   size_t method_start = 0;
-  ssize_t method_end = find_character(data, method_start, ' ');
+  ssize_t method_end = find_character(data, method_start, data_length, ' ');
   if (method_end < 0) {
     set_error(self, "Invalid HTTP request line");
     return false;
   }
 
   size_t path_start = method_end + 1;
-  ssize_t path_end = find_character(data, path_start, ' ');
+  ssize_t path_end = find_character(data, path_start, data_length, ' ');
   if (path_end < 0) {
     set_error(self, "Invalid HTTP request line");
     return false;
   }
 
   size_t protocol_version_start = path_end + 1;
-  size_t protocol_version_end = ut_list_get_length(data);
+  size_t protocol_version_end = data_length;
   ut_cstring_ref protocol_version =
       get_string(data, protocol_version_start, protocol_version_end);
-  if (!ut_cstring_equal(protocol_version, "HTTP/1.1")) {
-    set_error(self, "Invalid HTTP version");
+  if (!parse_protocol_version(self, protocol_version)) {
     return false;
   }
 
@@ -152,30 +195,31 @@ static bool parse_request_line(UtHttpMessageDecoder *self, UtObject *data) {
   return true;
 }
 
-static bool parse_status_line(UtHttpMessageDecoder *self, UtObject *data) {
+static bool parse_status_line(UtHttpMessageDecoder *self, const uint8_t *data,
+                              size_t data_length) {
   size_t protocol_version_start = 0;
   ssize_t protocol_version_end =
-      find_character(data, protocol_version_start, ' ');
+      find_character(data, protocol_version_start, data_length, ' ');
   if (protocol_version_end < 0) {
     set_error(self, "Invalid HTTP status line");
     return false;
   }
   ut_cstring_ref protocol_version =
       get_string(data, protocol_version_start, protocol_version_end);
-  if (!ut_cstring_equal(protocol_version, "HTTP/1.1")) {
-    set_error(self, "Invalid HTTP version");
+  if (!parse_protocol_version(self, protocol_version)) {
     return false;
   }
 
   size_t status_code_start = protocol_version_end + 1;
-  ssize_t status_code_end = find_character(data, status_code_start, ' ');
+  ssize_t status_code_end =
+      find_character(data, status_code_start, data_length, ' ');
   if (status_code_end < 0) {
     set_error(self, "Invalid HTTP status line");
     return false;
   }
 
   size_t reason_phrase_start = status_code_end + 1;
-  size_t reason_phrase_end = ut_list_get_length(data);
+  size_t reason_phrase_end = data_length;
 
   ut_cstring_ref status_code =
       get_string(data, status_code_start, status_code_end);
@@ -186,53 +230,53 @@ static bool parse_status_line(UtHttpMessageDecoder *self, UtObject *data) {
   return true;
 }
 
-static size_t decode_request_line(UtHttpMessageDecoder *self, UtObject *data) {
-  size_t offset = 0;
-  UtObjectRef line = get_line(data, &offset);
-  if (line == NULL) {
+static size_t decode_request_line(UtHttpMessageDecoder *self,
+                                  const uint8_t *data, size_t data_length) {
+  ssize_t line_end = find_line_end(self, data, data_length);
+  if (line_end < 0) {
     return 0;
   }
 
-  if (!parse_request_line(self, line)) {
+  if (!parse_request_line(self, data, line_end)) {
     return 0;
   }
 
   self->state = DECODER_STATE_HEADER;
 
-  return offset;
+  return line_end + 2;
 }
 
-static size_t decode_status_line(UtHttpMessageDecoder *self, UtObject *data) {
-  size_t offset = 0;
-  UtObjectRef line = get_line(data, &offset);
-  if (line == NULL) {
+static size_t decode_status_line(UtHttpMessageDecoder *self,
+                                 const uint8_t *data, size_t data_length) {
+  ssize_t line_end = find_line_end(self, data, data_length);
+  if (line_end < 0) {
     return 0;
   }
 
-  if (!parse_status_line(self, line)) {
+  if (!parse_status_line(self, data, line_end)) {
     return 0;
   }
 
   self->state = DECODER_STATE_HEADER;
 
-  return offset;
+  return line_end + 2;
 }
 
-static bool parse_header(UtHttpMessageDecoder *self, UtObject *data) {
+static bool parse_header(UtHttpMessageDecoder *self, const uint8_t *data,
+                         size_t data_length) {
   size_t name_start = 0;
-  ssize_t name_end = find_character(data, name_start, ':');
+  ssize_t name_end = find_character(data, name_start, data_length, ':');
   if (name_end < 0) {
     return false;
   }
 
   size_t value_start = name_end + 1;
-  size_t value_end = ut_list_get_length(data);
-
-  ut_cstring_ref name = get_string(data, name_start, name_end);
-  ut_cstring_ref value = get_string(data, value_start, value_end);
-  UtObjectRef header = ut_http_header_new(name, value);
+  size_t value_end = data_length;
 
-  ut_list_append(self->headers, header);
+  ut_list_append_take(
+      self->headers,
+      ut_http_header_new_take(get_string(data, name_start, name_end),
+                              get_string(data, value_start, value_end)));
 
   return true;
 }
@@ -241,8 +285,7 @@ static UtObject *find_header(UtHttpMessageDecoder *self, const char *name) {
   size_t headers_length = ut_list_get_length(self->headers);
   for (size_t i = 0; i < headers_length; i++) {
     UtObject *header = ut_object_list_get_element(self->headers, i);
-    // FIXME: Case insensiive
-    if (ut_cstring_equal(ut_http_header_get_name(header), name)) {
+    if (strcasecmp(ut_http_header_get_name(header), name) == 0) {
       return header;
     }
   }
@@ -250,15 +293,40 @@ static UtObject *find_header(UtHttpMessageDecoder *self, const char *name) {
   return NULL;
 }
 
-static size_t decode_header(UtHttpMessageDecoder *self, UtObject *data) {
-  size_t offset = 0;
-  UtObjectRef line = get_line(data, &offset);
-  if (line == NULL) {
+// Returns true if the Connection header [value] contains [option].
+static bool has_connection_option(const char *value, const char *option) {
+  size_t option_length = strlen(option);
+  const char *start = value;
+  while (true) {
+    while (*start == ' ' || *start == ',') {
+      start++;
+    }
+    if (*start == '\0') {
+      return false;
+    }
+
+    const char *end = start;
+    while (*end != '\0' && *end != ',' && *end != ' ') {
+      end++;
+    }
+    if ((size_t)(end - start) == option_length &&
+        strncasecmp(start, option, option_length) == 0) {
+      return true;
+    }
+    start = end;
+  }
+}
+
+static size_t decode_header(UtHttpMessageDecoder *self, const uint8_t *data,
+                            size_t data_length) {
+  ssize_t line_end = find_line_end(self, data, data_length);
+  if (line_end < 0) {
     return 0;
   }
+  size_t offset = line_end + 2;
 
   // Ends on empty line.
-  if (ut_list_get_length(line) == 0) {
+  if (line_end == 0) {
     self->headers_done = true;
 
     // Determine length of body.
@@ -284,6 +352,14 @@ static size_t decode_header(UtHttpMessageDecoder *self, UtObject *data) {
                    "chunked")) {
       self->body_length_format = BODY_LENGTH_FORMAT_CHUNKED;
       self->state = DECODER_STATE_CHUNK_HEADER;
+    } else if (self->is_request) {
+      // Requests without a length have no body, so the connection can be
+      // used for further requests.
+      self->body_length_format = BODY_LENGTH_FORMAT_FIXED;
+      self->content_length = 0;
+      UtObjectRef d = ut_uint8_list_new();
+      ut_buffered_input_stream_write(self->body, d, true);
+      self->state = DECODER_STATE_DONE;
     } else {
       self->body_length_format = BODY_LENGTH_FORMAT_EOF;
       self->state = DECODER_STATE_BODY;
@@ -292,7 +368,7 @@ static size_t decode_header(UtHttpMessageDecoder *self, UtObject *data) {
     return offset;
   }
 
-  if (!parse_header(self, line)) {
+  if (!parse_header(self, data, line_end)) {
     set_error(self, "Invalid HTTP header");
     return 0;
   }
@@ -300,8 +376,9 @@ static size_t decode_header(UtHttpMessageDecoder *self, UtObject *data) {
   return offset;
 }
 
-static size_t decode_chunk_header(UtHttpMessageDecoder *self, UtObject *data) {
-  ssize_t line_end = find_line_end(data);
+static size_t decode_chunk_header(UtHttpMessageDecoder *self,
+                                  const uint8_t *data, size_t data_length) {
+  ssize_t line_end = find_line_end(self, data, data_length);
   if (line_end < 0) {
     // FIXME: Abort on invalid characters
     return 0;
@@ -394,28 +471,39 @@ static size_t decode_body(UtHttpMessageDecoder *self, UtObject *data,
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
 
+  // Parse from contiguous memory, copying if the data is not stored that way.
   size_t data_length = ut_list_get_length(data);
+  const uint8_t *buffer = ut_uint8_list_get_data(data);
+  UtObjectRef data_copy = NULL;
+  if (buffer == NULL && data_length > 0) {
+    data_copy = ut_list_copy(data);
+    buffer = ut_uint8_list_get_data(data_copy);
+  }
+
   size_t offset = 0;
   while (true) {
     size_t n_used;
-    UtObjectRef d = ut_list_get_sublist(data, offset, data_length - offset);
+    const uint8_t *d = buffer + offset;
+    size_t d_length = data_length - offset;
     DecoderState old_state = self->state;
     switch (self->state) {
     case DECODER_STATE_REQUEST_LINE:
-      n_used = decode_request_line(self, d);
+      n_used = decode_request_line(self, d, d_length);
       break;
     case DECODER_STATE_STATUS_LINE:
-      n_used = decode_status_line(self, d);
+      n_used = decode_status_line(self, d, d_length);
       break;
     case DECODER_STATE_HEADER:
-      n_used = decode_header(self, d);
+      n_used = decode_header(self, d, d_length);
       break;
     case DECODER_STATE_CHUNK_HEADER:
-      n_used = decode_chunk_header(self, d);
+      n_used = decode_chunk_header(self, d, d_length);
       break;
-    case DECODER_STATE_BODY:
-      n_used = decode_body(self, d, complete);
+    case DECODER_STATE_BODY: {
+      UtObjectRef body_data = ut_list_get_sublist(data, offset, d_length);
+      n_used = decode_body(self, body_data, complete);
       break;
+    }
     case DECODER_STATE_ERROR:
     case DECODER_STATE_DONE:
       return offset;
@@ -464,6 +552,7 @@ UtObject *ut_http_message_decoder_new_request(UtObject *input_stream) {
       ut_object_new(sizeof(UtHttpMessageDecoder), &object_interface);
   UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
   self->input_stream = ut_object_ref(input_stream);
+  self->is_request = true;
   self->state = DECODER_STATE_REQUEST_LINE;
   return object;
 }
@@ -477,6 +566,28 @@ UtObject *ut_http_message_decoder_new_response(UtObject *input_stream) {
   return object;
 }
 
+void ut_http_message_decoder_reset(UtObject *object) {
+  assert(ut_object_is_http_message_decoder(object));
+  UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
+
+  self->state = self->is_request ? DECODER_STATE_REQUEST_LINE
+                                 : DECODER_STATE_STATUS_LINE;
+  self->is_http_1_0 = false;
+  ut_cstring_clear(&self->method);
+  ut_cstring_clear(&self->path);
+  self->status_code = 0;
+  ut_cstring_clear(&self->reason_phrase);
+  ut_object_unref(self->headers);
+  self->headers = ut_list_new();
+  self->headers_done = false;
+  self->content_length = 0;
+  self->body_length = 0;
+  ut_object_unref(self->body);
+  self->body = ut_buffered_input_stream_new();
+  ut_object_clear(&self->error);
+  self->scan_offset = 0;
+}
+
 void ut_http_message_decoder_read(UtObject *object) {
   assert(ut_object_is_http_message_decoder(object));
   UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
@@ -527,7 +638,32 @@ UtObject *ut_http_message_decoder_get_body(UtObject *object) {
 
 bool ut_http_message_decoder_get_done(UtObject *object) {
   assert(ut_object_is_http_message_decoder(object));
-  return false;
+  UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
+  return self->state == DECODER_STATE_DONE;
+}
+
+bool ut_http_message_decoder_get_is_http_1_0(UtObject *object) {
+  assert(ut_object_is_http_message_decoder(object));
+  UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
+  return self->is_http_1_0;
+}
+
+bool ut_http_message_decoder_get_keep_alive(UtObject *object) {
+  assert(ut_object_is_http_message_decoder(object));
+  UtHttpMessageDecoder *self = (UtHttpMessageDecoder *)object;
+
+  // HTTP/1.1 connections are persistent unless the close option is given,
+  // HTTP/1.0 connections need the keep-alive option.
+  UtObject *connection_header = find_header(self, "Connection");
+  if (connection_header == NULL) {
+    return !self->is_http_1_0;
+  }
+  const char *value = ut_http_header_get_value(connection_header);
+  if (self->is_http_1_0) {
+    return has_connection_option(value, "keep-alive");
+  } else {
+    return !has_connection_option(value, "close");
+  }
 }
 
 UtObject *ut_http_message_decoder_get_error(UtObject *object) {
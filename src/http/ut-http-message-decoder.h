@@ -8,6 +8,8 @@ UtObject *ut_http_message_decoder_new_request(UtObject *input_stream);
 
 UtObject *ut_http_message_decoder_new_response(UtObject *input_stream);
 
+void ut_http_message_decoder_reset(UtObject *object);
+
 void ut_http_message_decoder_read(UtObject *object);
 
 const char *ut_http_message_decoder_get_method(UtObject *object);
@@ -26,6 +28,10 @@ UtObject *ut_http_message_decoder_get_body(UtObject *object);
 
 bool ut_http_message_decoder_get_done(UtObject *object);
 
+bool ut_http_message_decoder_get_is_http_1_0(UtObject *object);
+
+bool ut_http_message_decoder_get_keep_alive(UtObject *object);
+
 UtObject *ut_http_message_decoder_get_error(UtObject *object);
 
 /// Returns [true] if [object] is a [UtHttpMessageDecoder].
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <strings.h>
 
 #include "ut-http-message-encoder.h"
 #include "ut.h"
@@ -41,14 +42,20 @@ typedef struct {
 
   // Number of bytes written from [body].
   size_t body_length;
+
+  // True once the whole body has been written.
+  bool done;
+
+  // Callback to notify when the message is written.
+  UtObject *callback_object;
+  UtHttpMessageEncoderDoneCallback callback;
 } UtHttpMessageEncoder;
 
 static UtObject *find_header(UtHttpMessageEncoder *self, const char *name) {
   size_t headers_length = ut_list_get_length(self->headers);
   for (size_t i = 0; i < headers_length; i++) {
     UtObject *header = ut_object_list_get_element(self->headers, i);
-    // FIXME: Case insensiive
-    if (ut_cstring_equal(ut_http_header_get_name(header), name)) {
+    if (strcasecmp(ut_http_header_get_name(header), name) == 0) {
       return header;
     }
   }
@@ -106,18 +113,33 @@ static size_t write_body_chunked(UtHttpMessageEncoder *self, UtObject *data,
 static size_t body_read_cb(UtObject *object, UtObject *data, bool complete) {
   UtHttpMessageEncoder *self = (UtHttpMessageEncoder *)object;
 
+  // Callback may drop the last reference to this encoder.
+  UtObjectRef ref = ut_object_ref(object);
+
+  size_t n_used = 0;
   switch (self->body_length_format) {
   case BODY_LENGTH_FORMAT_EOF:
-    return write_body_eof(self, data);
+    n_used = write_body_eof(self, data);
+    break;
   case BODY_LENGTH_FORMAT_FIXED:
-    return write_body_fixed(self, data);
+    n_used = write_body_fixed(self, data);
+    if (self->body_length == self->content_length) {
+      complete = true;
+    }
     break;
   case BODY_LENGTH_FORMAT_CHUNKED:
-    return write_body_chunked(self, data, complete);
+    n_used = write_body_chunked(self, data, complete);
     break;
-  default:
-    return 0;
   }
+
+  if (complete && !self->done) {
+    self->done = true;
+    if (self->callback_object != NULL && self->callback != NULL) {
+      self->callback(self->callback_object);
+    }
+  }
+
+  return n_used;
 }
 
 static void ut_http_message_encoder_cleanup(UtObject *object) {
@@ -133,6 +155,7 @@ static void ut_http_message_encoder_cleanup(UtObject *object) {
   free(self->reason_phrase);
   ut_object_unref(self->headers);
   ut_object_unref(self->body);
+  ut_object_weak_unref(&self->callback_object);
 }
 
 static UtObjectInterface object_interface = {
@@ -172,9 +195,18 @@ UtObject *ut_http_message_encoder_new_response(UtObject *output_stream,
 }
 
 void ut_http_message_encoder_encode(UtObject *object) {
+  ut_http_message_encoder_encode_full(object, NULL, NULL);
+}
+
+void ut_http_message_encoder_encode_full(
+    UtObject *object, UtObject *callback_object,
+    UtHttpMessageEncoderDoneCallback callback) {
   assert(ut_object_is_http_message_encoder(object));
   UtHttpMessageEncoder *self = (UtHttpMessageEncoder *)object;
 
+  ut_object_weak_ref(callback_object, &self->callback_object);
+  self->callback = callback;
+
   UtObjectRef header = ut_string_new("");
   if (self->method != NULL) {
     ut_string_append(header, self->method);
@@ -4,6 +4,8 @@
 
 #pragma once
 
+typedef void (*UtHttpMessageEncoderDoneCallback)(UtObject *object);
+
 UtObject *ut_http_message_encoder_new_request(UtObject *output_stream,
                                               const char *method,
                                               const char *path,
@@ -18,5 +20,10 @@ UtObject *ut_http_message_encoder_new_response(UtObject *output_stream,
 
 void ut_http_message_encoder_encode(UtObject *object);
 
+/// Encodes the message, calling [callback] once the whole body is written.
+void ut_http_message_encoder_encode_full(
+    UtObject *object, UtObject *callback_object,
+    UtHttpMessageEncoderDoneCallback callback);
+
 /// Returns [true] if [object] is a [UtHttpMessageEncoder].
 bool ut_object_is_http_message_encoder(UtObject *object);
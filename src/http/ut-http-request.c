@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <strings.h>
 
 #include "ut.h"
 
@@ -7,6 +8,7 @@ typedef struct {
 
   char *method;
   char *path;
+  char *version;
   UtObject *headers;
   UtObject *body;
 } UtHttpRequest;
@@ -22,6 +24,7 @@ static void ut_http_request_cleanup(UtObject *object) {
   UtHttpRequest *self = (UtHttpRequest *)object;
   free(self->method);
   free(self->path);
+  free(self->version);
   ut_object_unref(self->headers);
   ut_object_unref(self->body);
 }
@@ -33,10 +36,17 @@ static UtObjectInterface object_interface = {
 
 UtObject *ut_http_request_new(const char *method, const char *path,
                               UtObject *headers, UtObject *body) {
+  return ut_http_request_new_full(method, path, "HTTP/1.1", headers, body);
+}
+
+UtObject *ut_http_request_new_full(const char *method, const char *path,
+                                   const char *version, UtObject *headers,
+                                   UtObject *body) {
   UtObject *object = ut_object_new(sizeof(UtHttpRequest), &object_interface);
   UtHttpRequest *self = (UtHttpRequest *)object;
   self->method = ut_cstring_new(method);
   self->path = ut_cstring_new(path);
+  self->version = ut_cstring_new(version);
   self->headers = ut_object_ref(headers);
   self->body = ut_object_ref(body);
   return object;
@@ -54,12 +64,33 @@ const char *ut_http_request_get_path(UtObject *object) {
   return self->path;
 }
 
+const char *ut_http_request_get_version(UtObject *object) {
+  assert(ut_object_is_http_request(object));
+  UtHttpRequest *self = (UtHttpRequest *)object;
+  return self->version;
+}
+
 UtObject *ut_http_request_get_headers(UtObject *object) {
   assert(ut_object_is_http_request(object));
   UtHttpRequest *self = (UtHttpRequest *)object;
   return self->headers;
 }
 
+const char *ut_http_request_get_header(UtObject *object, const char *name) {
+  assert(ut_object_is_http_request(object));
+  UtHttpRequest *self = (UtHttpRequest *)object;
+  assert(name != NULL);
+  size_t headers_length = ut_list_get_length(self->headers);
+  for (size_t i = 0; i < headers_length; i++) {
+    UtObject *header = ut_object_list_get_element(self->headers, i);
+    if (strcasecmp(ut_http_header_get_name(header), name) == 0) {
+      return ut_http_header_get_value(header);
+    }
+  }
+
+  return NULL;
+}
+
 UtObject *ut_http_request_get_body(UtObject *object) {
   assert(ut_object_is_http_request(object));
   UtHttpRequest *self = (UtHttpRequest *)object;
@@ -14,16 +14,34 @@
 UtObject *ut_http_request_new(const char *method, const char *path,
                               UtObject *headers, UtObject *body);
 
+/// Creates a new HTTP request with [method], [path], HTTP [version],
+/// [headers] and [body].
+///
+/// !arg-type headers UtList
+/// !arg-type body UtUint8List
+/// !return-ref
+/// !return-type UtHttpRequest
+UtObject *ut_http_request_new_full(const char *method, const char *path,
+                                   const char *version, UtObject *headers,
+                                   UtObject *body);
+
 /// Returns the method in this request, e.g. "GET".
 const char *ut_http_request_get_method(UtObject *object);
 
 /// Returns the path in this request, e.g. "/".
 const char *ut_http_request_get_path(UtObject *object);
 
+/// Returns the HTTP version of this request, e.g. "HTTP/1.1".
+const char *ut_http_request_get_version(UtObject *object);
+
 /// Returns the headers ([UtHttpHeader]) in this request.
 /// !return-type UtObjectList
 UtObject *ut_http_request_get_headers(UtObject *object);
 
+/// Returns the value of the header with [name] or [NULL] if no header in this
+/// request.
+const char *ut_http_request_get_header(UtObject *object, const char *name);
+
 /// Returns the body of this request.
 /// !return-type UtUint8List
 UtObject *ut_http_request_get_body(UtObject *object);
@@ -1,10 +1,29 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <strings.h>
 
 #include "ut-http-message-decoder.h"
 #include "ut-http-message-encoder.h"
 #include "ut-http-server-client.h"
 #include "ut.h"
 
+typedef struct _PendingRequest PendingRequest;
+
+// Request received on this connection. Responses are sent in the order the
+// requests were received.
+struct _PendingRequest {
+  UtObject *request;
+  UtObject *response;
+
+  // True if the request used HTTP/1.0.
+  bool is_http_1_0;
+
+  // True if the client wants the connection kept open after the response.
+  bool keep_alive;
+
+  PendingRequest *next;
+};
+
 typedef struct {
   UtObject object;
 
@@ -13,28 +32,293 @@ typedef struct {
   // Callback to notify when requests come in.
   UtObject *callback_object;
   UtHttpServerClientRequestCallback callback;
+  UtHttpServerClientClosedCallback closed_callback;
 
   UtObject *message_input_stream;
   UtObject *message_decoder;
+
+  // True if the request being decoded has been reported.
+  bool message_started;
+
+  // Requests waiting for responses.
+  PendingRequest *requests;
+  PendingRequest *last_request;
+
+  // Response being sent, only one is sent at a time.
+  UtObject *message_encoder;
+
+  // True if the connection is closed once the current response is sent.
+  bool close_after_response;
+
+  // Time to wait for data before closing the connection.
+  uint64_t idle_timeout;
+  UtObject *idle_timer;
+
+  // True if no more requests will be accepted, either due to the remote end
+  // stopping sending or a request asking for the connection to be closed.
+  bool read_complete;
+
+  // True once [input_stream] has been closed.
+  bool input_closed;
+
+  // True once closing has started.
+  bool closing;
 } UtHttpServerClient;
 
+static void free_pending_request(PendingRequest *pending_request) {
+  ut_object_unref(pending_request->request);
+  ut_object_unref(pending_request->response);
+  free(pending_request);
+}
+
+static void notify_closed(UtHttpServerClient *self) {
+  if (self->idle_timer != NULL) {
+    ut_event_loop_cancel_timer(self->idle_timer);
+    ut_object_clear(&self->idle_timer);
+  }
+  if (!self->input_closed) {
+    self->input_closed = true;
+    ut_input_stream_close(self->input_stream);
+  }
+  if (self->callback_object != NULL && self->closed_callback != NULL) {
+    self->closed_callback(self->callback_object, (UtObject *)self);
+  }
+}
+
+static void flush_cb(UtObject *object, UtObject *error) {
+  UtHttpServerClient *self = (UtHttpServerClient *)object;
+  notify_closed(self);
+}
+
+// Close the connection once any queued data has been sent.
+static void close_connection(UtHttpServerClient *self) {
+  if (self->closing) {
+    return;
+  }
+  self->closing = true;
+
+  // Writes complete in order, so this empty write completes once everything
+  // before it is sent.
+  UtObjectRef empty = ut_uint8_array_new();
+  ut_output_stream_write_full(self->input_stream, empty, (UtObject *)self,
+                              flush_cb);
+}
+
+static void idle_timeout_cb(UtObject *object) {
+  UtHttpServerClient *self = (UtHttpServerClient *)object;
+  ut_object_clear(&self->idle_timer);
+  if (!self->closing) {
+    self->closing = true;
+    notify_closed(self);
+  }
+}
+
+static void restart_idle_timer(UtHttpServerClient *self) {
+  if (self->idle_timer != NULL) {
+    ut_event_loop_cancel_timer(self->idle_timer);
+    ut_object_clear(&self->idle_timer);
+  }
+  // Wait while there are no requests, or a request body is still being
+  // received.
+  bool waiting_for_data =
+      (self->requests == NULL && self->message_encoder == NULL) ||
+      (self->message_started &&
+       !ut_http_message_decoder_get_done(self->message_decoder));
+  if (self->idle_timeout > 0 && waiting_for_data && !self->closing) {
+    self->idle_timer = ut_event_loop_add_delay_ms(
+        self->idle_timeout, (UtObject *)self, idle_timeout_cb);
+  }
+}
+
+// Stop accepting requests and close once all responses are sent.
+static void stop_reading(UtHttpServerClient *self) {
+  self->read_complete = true;
+  if (self->requests == NULL && self->message_encoder == NULL) {
+    close_connection(self);
+  }
+}
+
+// Returns true if the length of [response] is known to the client, otherwise
+// the end of the body is indicated by closing the connection.
+static bool response_has_length(UtObject *response) {
+  if (ut_http_response_get_content_length(response) >= 0) {
+    return true;
+  }
+  const char *transfer_encoding =
+      ut_http_response_get_header(response, "Transfer-Encoding");
+  return transfer_encoding != NULL &&
+         strcasecmp(transfer_encoding, "chunked") == 0;
+}
+
+// Returns the headers to send in response to [pending_request], adding a
+// Connection header if the client doesn't otherwise know if the connection
+// will be kept open.
+static UtObject *get_response_headers(PendingRequest *pending_request,
+                                      bool keep_alive) {
+  UtObject *response = pending_request->response;
+  UtObject *response_headers = ut_http_response_get_headers(response);
+
+  // HTTP/1.0 connections close unless keep-alive is confirmed, HTTP/1.1
+  // connections stay open unless the server says otherwise.
+  bool needs_connection_header =
+      keep_alive ? pending_request->is_http_1_0
+                 : pending_request->keep_alive && !pending_request->is_http_1_0;
+  if (ut_http_response_get_header(response, "Connection") != NULL ||
+      !needs_connection_header) {
+    return ut_object_ref(response_headers);
+  }
+
+  UtObject *headers = ut_list_new();
+  size_t response_headers_length = ut_list_get_length(response_headers);
+  for (size_t i = 0; i < response_headers_length; i++) {
+    ut_list_append(headers,
+                   ut_object_list_get_element(response_headers, i));
+  }
+  ut_list_append_take(
+      headers,
+      ut_http_header_new("Connection", keep_alive ? "keep-alive" : "close"));
+  return headers;
+}
+
+static void send_next_response(UtHttpServerClient *self);
+
+static void response_done_cb(UtObject *object) {
+  UtHttpServerClient *self = (UtHttpServerClient *)object;
+  ut_object_clear(&self->message_encoder);
+  if (self->close_after_response) {
+    close_connection(self);
+  } else {
+    send_next_response(self);
+  }
+}
+
+// Send the next response if it is ready. Responses are sent in the order the
+// requests were received.
+static void send_next_response(UtHttpServerClient *self) {
+  if (self->message_encoder != NULL || self->closing) {
+    return;
+  }
+
+  PendingRequest *r = self->requests;
+  if (r == NULL || r->response == NULL) {
+    if (r == NULL && self->read_complete) {
+      close_connection(self);
+    } else {
+      restart_idle_timer(self);
+    }
+    return;
+  }
+
+  self->requests = r->next;
+  if (self->requests == NULL) {
+    self->last_request = NULL;
+  }
+
+  // Close the connection if the client asked for it, or the end of the
+  // response is marked by closing the connection. Any further requests are
+  // dropped.
+  const char *connection =
+      ut_http_response_get_header(r->response, "Connection");
+  bool keep_alive =
+      r->keep_alive && response_has_length(r->response) &&
+      (connection == NULL || strcasecmp(connection, "close") != 0);
+  if (!keep_alive) {
+    self->read_complete = true;
+    self->close_after_response = true;
+  }
+
+  UtObjectRef headers = get_response_headers(r, keep_alive);
+  self->message_encoder = ut_http_message_encoder_new_response(
+      self->input_stream, ut_http_response_get_status_code(r->response),
+      ut_http_response_get_reason_phrase(r->response), headers,
+      ut_http_response_get_body(r->response));
+  free_pending_request(r);
+  restart_idle_timer(self);
+  ut_http_message_encoder_encode_full(self->message_encoder, (UtObject *)self,
+                                      response_done_cb);
+}
+
 static size_t http_read_cb(UtObject *object, UtObject *data, bool complete) {
   UtHttpServerClient *self = (UtHttpServerClient *)object;
 
-  size_t n_read = ut_writable_input_stream_write(self->message_input_stream,
-                                                 data, complete);
-  if (ut_http_message_decoder_get_headers_done(self->message_decoder)) {
-    if (self->callback_object != NULL && self->callback != NULL) {
-      UtObjectRef request = ut_http_request_new(
+  // Callbacks may drop the last reference to this client.
+  UtObjectRef ref = ut_object_ref(object);
+
+  // Ignore anything after the last request.
+  size_t data_length = ut_list_get_length(data);
+  if (self->read_complete) {
+    return data_length;
+  }
+
+  // Decode as many requests as are available, clients may send further
+  // requests without waiting for responses.
+  size_t offset = 0;
+  while (true) {
+    UtObjectRef d = ut_list_get_sublist(data, offset, data_length - offset);
+    offset += ut_writable_input_stream_write(self->message_input_stream, d,
+                                             complete);
+
+    if (!self->message_started &&
+        ut_http_message_decoder_get_headers_done(self->message_decoder)) {
+      self->message_started = true;
+
+      PendingRequest *pending_request = malloc(sizeof(PendingRequest));
+      pending_request->request = ut_http_request_new_full(
           ut_http_message_decoder_get_method(self->message_decoder),
           ut_http_message_decoder_get_path(self->message_decoder),
+          ut_http_message_decoder_get_is_http_1_0(self->message_decoder)
+              ? "HTTP/1.0"
+              : "HTTP/1.1",
           ut_http_message_decoder_get_headers(self->message_decoder),
           ut_http_message_decoder_get_body(self->message_decoder));
-      self->callback(self->callback_object, request);
+      pending_request->response = NULL;
+      pending_request->is_http_1_0 =
+          ut_http_message_decoder_get_is_http_1_0(self->message_decoder);
+      pending_request->keep_alive =
+          ut_http_message_decoder_get_keep_alive(self->message_decoder);
+      pending_request->next = NULL;
+      if (self->last_request != NULL) {
+        self->last_request->next = pending_request;
+      } else {
+        self->requests = pending_request;
+      }
+      self->last_request = pending_request;
+
+      if (self->callback_object != NULL && self->callback != NULL) {
+        self->callback(self->callback_object, object,
+                       pending_request->request);
+      }
     }
+
+    if (ut_http_message_decoder_get_error(self->message_decoder) != NULL) {
+      stop_reading(self);
+      return data_length;
+    }
+
+    if (!ut_http_message_decoder_get_done(self->message_decoder)) {
+      break;
+    }
+
+    if (!ut_http_message_decoder_get_keep_alive(self->message_decoder)) {
+      stop_reading(self);
+      return data_length;
+    }
+
+    // Start the next request.
+    ut_http_message_decoder_reset(self->message_decoder);
+    self->message_started = false;
+    if (offset == data_length) {
+      break;
+    }
+  }
+
+  if (complete) {
+    stop_reading(self);
   }
 
-  return n_read;
+  restart_idle_timer(self);
+
+  return offset;
 }
 
 static void ut_http_server_client_client_init(UtObject *object) {
@@ -44,10 +328,21 @@ static void ut_http_server_client_client_init(UtObject *object) {
 
 static void ut_http_server_client_client_cleanup(UtObject *object) {
   UtHttpServerClient *self = (UtHttpServerClient *)object;
+  if (self->idle_timer != NULL) {
+    ut_event_loop_cancel_timer(self->idle_timer);
+  }
   ut_object_unref(self->input_stream);
   ut_object_weak_unref(&self->callback_object);
   ut_object_unref(self->message_input_stream);
   ut_object_unref(self->message_decoder);
+  ut_object_unref(self->message_encoder);
+  PendingRequest *next_request;
+  for (PendingRequest *r = self->requests; r != NULL; r = next_request) {
+    next_request = r->next;
+    free_pending_request(r);
+  }
+  self->requests = NULL;
+  ut_object_unref(self->idle_timer);
 }
 
 static UtObjectInterface object_interface = {
@@ -57,7 +352,8 @@ static UtObjectInterface object_interface = {
 
 UtObject *
 ut_http_server_client_new(UtObject *input_stream, UtObject *callback_object,
-                          UtHttpServerClientRequestCallback callback) {
+                          UtHttpServerClientRequestCallback callback,
+                          UtHttpServerClientClosedCallback closed_callback) {
   UtObject *object =
       ut_object_new(sizeof(UtHttpServerClient), &object_interface);
   UtHttpServerClient *self = (UtHttpServerClient *)object;
@@ -65,6 +361,7 @@ ut_http_server_client_new(UtObject *input_stream, UtObject *callback_object,
   self->input_stream = ut_object_ref(input_stream);
   ut_object_weak_ref(callback_object, &self->callback_object);
   self->callback = callback;
+  self->closed_callback = closed_callback;
   self->message_decoder =
       ut_http_message_decoder_new_request(self->message_input_stream);
   ut_http_message_decoder_read(self->message_decoder);
@@ -72,22 +369,47 @@ ut_http_server_client_new(UtObject *input_stream, UtObject *callback_object,
   return object;
 }
 
+void ut_http_server_client_set_idle_timeout(UtObject *object,
+                                            uint64_t milliseconds) {
+  assert(ut_object_is_http_server_client(object));
+  UtHttpServerClient *self = (UtHttpServerClient *)object;
+  self->idle_timeout = milliseconds;
+  restart_idle_timer(self);
+}
+
 void ut_http_server_client_read(UtObject *object) {
   assert(ut_object_is_http_server_client(object));
   UtHttpServerClient *self = (UtHttpServerClient *)object;
   ut_input_stream_read(self->input_stream, object, http_read_cb);
 }
 
-void ut_http_server_client_send_response(UtObject *object, UtObject *response) {
+void ut_http_server_client_send_response(UtObject *object, UtObject *request,
+                                         UtObject *response) {
   assert(ut_object_is_http_server_client(object));
   UtHttpServerClient *self = (UtHttpServerClient *)object;
 
-  UtObjectRef message_encoder = ut_http_message_encoder_new_response(
-      self->input_stream, ut_http_response_get_status_code(response),
-      ut_http_response_get_reason_phrase(response),
-      ut_http_response_get_headers(response),
-      ut_http_response_get_body(response));
-  ut_http_message_encoder_encode(message_encoder);
+  PendingRequest *pending_request = self->requests;
+  while (pending_request != NULL && pending_request->request != request) {
+    pending_request = pending_request->next;
+  }
+  assert(pending_request != NULL);
+  assert(pending_request->response == NULL);
+  pending_request->response = ut_object_ref(response);
+
+  send_next_response(self);
+}
+
+UtObject *ut_http_server_client_get_unanswered_requests(UtObject *object) {
+  assert(ut_object_is_http_server_client(object));
+  UtHttpServerClient *self = (UtHttpServerClient *)object;
+
+  UtObject *requests = ut_object_list_new();
+  for (PendingRequest *r = self->requests; r != NULL; r = r->next) {
+    if (r->response == NULL) {
+      ut_list_append(requests, r->request);
+    }
+  }
+  return requests;
 }
 
 bool ut_object_is_http_server_client(UtObject *object) {
@@ -1,18 +1,30 @@
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "ut-object.h"
 
 #pragma once
 
 typedef void (*UtHttpServerClientRequestCallback)(UtObject *object,
+                                                  UtObject *client,
                                                   UtObject *request);
+typedef void (*UtHttpServerClientClosedCallback)(UtObject *object,
+                                                 UtObject *client);
 
-UtObject *ut_http_server_client_new(UtObject *input_stream,
-                                    UtObject *callback_object,
-                                    UtHttpServerClientRequestCallback callback);
+UtObject *
+ut_http_server_client_new(UtObject *input_stream, UtObject *callback_object,
+                          UtHttpServerClientRequestCallback callback,
+                          UtHttpServerClientClosedCallback closed_callback);
+
+void ut_http_server_client_set_idle_timeout(UtObject *object,
+                                            uint64_t milliseconds);
 
 void ut_http_server_client_read(UtObject *object);
 
-void ut_http_server_client_send_response(UtObject *object, UtObject *response);
+void ut_http_server_client_send_response(UtObject *object, UtObject *request,
+                                         UtObject *response);
+
+// Returns the requests received that have not been given a response.
+UtObject *ut_http_server_client_get_unanswered_requests(UtObject *object);
 
 bool ut_object_is_http_server_client(UtObject *object);
@@ -1,38 +1,507 @@
 #include <stdio.h>
 
+#include "ut-benchmark.h"
+#include "ut-http-message-decoder.h"
 #include "ut.h"
 
+static UtObject *http_server = NULL;
+static UtObject *client_socket = NULL;
+static UtObject *first_request = NULL;
+
+static UtObject *limit_http_server = NULL;
+static UtObject *limit_socket1 = NULL;
+static UtObject *limit_socket2 = NULL;
+static bool limit_socket1_closed = false;
+static bool limit_socket2_closed = false;
+
+static UtObject *compression_callback_object = NULL;
+static UtObject *compression_http_server = NULL;
+static UtObject *compression_socket = NULL;
+static UtObject *compression_body = NULL;
+static UtObject *compression_http_1_0_socket = NULL;
+
+static UtObject *stalled_callback_object = NULL;
+static UtObject *stalled_http_server = NULL;
+static UtObject *stalled_socket = NULL;
+static UtObject *stalled_request = NULL;
+
+static UtObject *pipeline_callback_object = NULL;
+static UtObject *pipeline_http_server = NULL;
+static UtObject *pipeline_socket = NULL;
+static UtObject *http_1_0_socket = NULL;
+static UtObject *lowercase_socket = NULL;
+
+static size_t lowercase_read_cb(UtObject *object, UtObject *data,
+                                bool complete) {
+  // Server closes the connection after the first request.
+  if (!complete) {
+    return 0;
+  }
+
+  UtObjectRef text = ut_string_new_from_utf8(data);
+  ut_assert_cstring_equal(ut_string_get_text(text), "HTTP/1.1 200 OK\r\n"
+                                                    "Content-Length: 3\r\n"
+                                                    "\r\n"
+                                                    "one");
+
+  ut_event_loop_return(NULL);
+
+  return ut_list_get_length(data);
+}
+
+static void start_lowercase_test(uint16_t port) {
+  // Header names are case insensitive, so the second request is dropped.
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  lowercase_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(lowercase_socket, lowercase_socket, NULL);
+  UtObjectRef data_string = ut_string_new("GET /one HTTP/1.1\r\n"
+                                          "connection: close\r\n"
+                                          "\r\n"
+                                          "GET /two HTTP/1.1\r\n"
+                                          "\r\n");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(lowercase_socket, data_utf8);
+  ut_input_stream_read(lowercase_socket, lowercase_socket, lowercase_read_cb);
+}
+
+static size_t http_1_0_read_cb(UtObject *object, UtObject *data,
+                               bool complete) {
+  // Server closes the connection after the second request.
+  if (!complete) {
+    return 0;
+  }
+
+  UtObjectRef text = ut_string_new_from_utf8(data);
+  ut_assert_cstring_equal(ut_string_get_text(text),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Length: 3\r\n"
+                          "Connection: keep-alive\r\n"
+                          "\r\n"
+                          "one"
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Length: 3\r\n"
+                          "\r\n"
+                          "two");
+
+  start_lowercase_test(ut_tcp_socket_get_port(http_1_0_socket));
+
+  return ut_list_get_length(data);
+}
+
+static void start_http_1_0_test(uint16_t port) {
+  // Second request doesn't ask for keep-alive.
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  http_1_0_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(http_1_0_socket, http_1_0_socket, NULL);
+  UtObjectRef data_string = ut_string_new("GET /one HTTP/1.0\r\n"
+                                          "Connection: keep-alive\r\n"
+                                          "\r\n"
+                                          "GET /two HTTP/1.0\r\n"
+                                          "\r\n");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(http_1_0_socket, data_utf8);
+  ut_input_stream_read(http_1_0_socket, http_1_0_socket, http_1_0_read_cb);
+}
+
+static size_t pipeline_read_cb(UtObject *object, UtObject *data,
+                               bool complete) {
+  // Server closes the connection to mark the end of the first response.
+  if (!complete) {
+    return 0;
+  }
+
+  // Second request is dropped.
+  UtObjectRef text = ut_string_new_from_utf8(data);
+  ut_assert_cstring_equal(ut_string_get_text(text), "HTTP/1.1 200 OK\r\n"
+                                                    "Connection: close\r\n"
+                                                    "\r\n"
+                                                    "no length");
+
+  start_http_1_0_test(ut_tcp_socket_get_port(pipeline_socket));
+
+  return ut_list_get_length(data);
+}
+
+static void pipeline_request_cb(UtObject *object, UtObject *request) {
+  const char *path = ut_http_request_get_path(request);
+  UtObjectRef response_headers = ut_list_new();
+  const char *body_text;
+  if (ut_cstring_equal(path, "/no-length")) {
+    body_text = "no length";
+  } else {
+    ut_list_append_take(response_headers,
+                        ut_http_header_new("Content-Length", "3"));
+    body_text = path + 1;
+  }
+  UtObjectRef body_string = ut_string_new(body_text);
+  UtObjectRef body_data = ut_string_get_utf8(body_string);
+  UtObjectRef body = ut_list_input_stream_new(body_data);
+  UtObjectRef response =
+      ut_http_response_new(200, "OK", response_headers, body);
+  ut_http_server_respond(pipeline_http_server, request, response);
+}
+
+static void start_pipeline_test() {
+  pipeline_callback_object = ut_null_new();
+  pipeline_http_server =
+      ut_http_server_new(pipeline_callback_object, pipeline_request_cb);
+  uint16_t port;
+  UtObjectRef error = NULL;
+  ut_http_server_listen_ipv4_any(pipeline_http_server, &port, &error);
+  ut_assert_null_object(error);
+
+  // First response has no length, so the connection is closed after it.
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  pipeline_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(pipeline_socket, pipeline_socket, NULL);
+  UtObjectRef data_string = ut_string_new("GET /no-length HTTP/1.1\r\n"
+                                          "\r\n"
+                                          "GET /two HTTP/1.1\r\n"
+                                          "\r\n");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(pipeline_socket, data_utf8);
+  ut_input_stream_read(pipeline_socket, pipeline_socket, pipeline_read_cb);
+}
+
+static size_t stalled_read_cb(UtObject *object, UtObject *data,
+                              bool complete) {
+  if (!complete) {
+    return 0;
+  }
+
+  // Closed due to the idle timeout, responding now does nothing.
+  ut_assert_int_equal(ut_list_get_length(data), 0);
+  ut_assert_int_equal(ut_http_server_get_n_connections(stalled_http_server),
+                      0);
+  ut_assert_non_null_object(stalled_request);
+  UtObjectRef response_headers = ut_list_new();
+  UtObjectRef response =
+      ut_http_response_new(200, "OK", response_headers, NULL);
+  ut_http_server_respond(stalled_http_server, stalled_request, response);
+
+  start_pipeline_test();
+
+  return ut_list_get_length(data);
+}
+
+static void stalled_request_cb(UtObject *object, UtObject *request) {
+  // Don't respond until the client has gone.
+  stalled_request = ut_object_ref(request);
+}
+
+static void start_stalled_test() {
+  stalled_callback_object = ut_null_new();
+  stalled_http_server =
+      ut_http_server_new(stalled_callback_object, stalled_request_cb);
+  ut_http_server_set_idle_timeout_ms(stalled_http_server, 100);
+  uint16_t port;
+  UtObjectRef error = NULL;
+  ut_http_server_listen_ipv4_any(stalled_http_server, &port, &error);
+  ut_assert_null_object(error);
+
+  // Send only part of the request body.
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  stalled_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(stalled_socket, stalled_socket, NULL);
+  UtObjectRef data_string = ut_string_new("POST / HTTP/1.1\r\n"
+                                          "Content-Length: 10\r\n"
+                                          "\r\n"
+                                          "abc");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(stalled_socket, data_utf8);
+  ut_input_stream_read(stalled_socket, stalled_socket, stalled_read_cb);
+}
+
+static size_t compression_http_1_0_read_cb(UtObject *object, UtObject *data,
+                                           bool complete) {
+  // Server closes the connection after the request.
+  if (!complete) {
+    return 0;
+  }
+
+  // HTTP/1.0 doesn't support chunked encoding, so not compressed.
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_http_message_decoder_new_response(data_stream);
+  ut_http_message_decoder_read(decoder);
+  ut_assert_null_object(ut_http_message_decoder_get_error(decoder));
+  ut_assert_int_equal(ut_http_message_decoder_get_status_code(decoder), 200);
+
+  UtObject *headers = ut_http_message_decoder_get_headers(decoder);
+  ut_assert_int_equal(ut_list_get_length(headers), 2);
+  const char *expected_headers[][2] = {{"Content-Type", "text/plain"},
+                                       {"Content-Length", "1000"}};
+  for (size_t i = 0; i < 2; i++) {
+    UtObject *header = ut_object_list_get_element(headers, i);
+    ut_assert_cstring_equal(ut_http_header_get_name(header),
+                            expected_headers[i][0]);
+    ut_assert_cstring_equal(ut_http_header_get_value(header),
+                            expected_headers[i][1]);
+  }
+
+  UtObjectRef body =
+      ut_input_stream_read_sync(ut_http_message_decoder_get_body(decoder));
+  ut_assert_equal(body, compression_body);
+
+  start_stalled_test();
+
+  return ut_list_get_length(data);
+}
+
+static void start_compression_http_1_0_test(uint16_t port) {
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  compression_http_1_0_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(compression_http_1_0_socket,
+                        compression_http_1_0_socket, NULL);
+  UtObjectRef data_string = ut_string_new("GET / HTTP/1.0\r\n"
+                                          "Accept-Encoding: gzip\r\n"
+                                          "\r\n");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(compression_http_1_0_socket, data_utf8);
+  ut_input_stream_read(compression_http_1_0_socket,
+                       compression_http_1_0_socket,
+                       compression_http_1_0_read_cb);
+}
+
+static size_t compression_read_cb(UtObject *object, UtObject *data,
+                                  bool complete) {
+  // Server closes the connection after the request.
+  if (!complete) {
+    return 0;
+  }
+
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_http_message_decoder_new_response(data_stream);
+  ut_http_message_decoder_read(decoder);
+  ut_assert_null_object(ut_http_message_decoder_get_error(decoder));
+  ut_assert_int_equal(ut_http_message_decoder_get_status_code(decoder), 200);
+
+  UtObject *headers = ut_http_message_decoder_get_headers(decoder);
+  ut_assert_int_equal(ut_list_get_length(headers), 4);
+  const char *expected_headers[][2] = {{"Content-Type", "text/plain"},
+                                       {"Content-Encoding", "gzip"},
+                                       {"Transfer-Encoding", "chunked"},
+                                       {"Vary", "Accept-Encoding"}};
+  for (size_t i = 0; i < 4; i++) {
+    UtObject *header = ut_object_list_get_element(headers, i);
+    ut_assert_cstring_equal(ut_http_header_get_name(header),
+                            expected_headers[i][0]);
+    ut_assert_cstring_equal(ut_http_header_get_value(header),
+                            expected_headers[i][1]);
+  }
+
+  UtObjectRef body =
+      ut_input_stream_read_sync(ut_http_message_decoder_get_body(decoder));
+  UtObjectRef body_stream = ut_list_input_stream_new(body);
+  UtObjectRef gzip_decoder = ut_gzip_decoder_new(body_stream);
+  UtObjectRef decoded_body = ut_input_stream_read_sync(gzip_decoder);
+  ut_assert_equal(decoded_body, compression_body);
+
+  start_compression_http_1_0_test(ut_tcp_socket_get_port(compression_socket));
+
+  return ut_list_get_length(data);
+}
+
+static void compression_request_cb(UtObject *object, UtObject *request) {
+  const char *expected_accept_encoding =
+      ut_cstring_equal(ut_http_request_get_version(request), "HTTP/1.0")
+          ? "gzip"
+          : "deflate;q=0.5, gzip";
+  ut_assert_cstring_equal(
+      ut_http_request_get_header(request, "accept-encoding"),
+      expected_accept_encoding);
+
+  UtObjectRef response_headers = ut_list_new_from_elements_take(
+      ut_http_header_new("Content-Type", "text/plain"),
+      ut_http_header_new("Content-Length", "1000"), NULL);
+  UtObjectRef body = ut_list_input_stream_new(compression_body);
+  UtObjectRef response =
+      ut_http_response_new(200, "OK", response_headers, body);
+  ut_http_server_respond(compression_http_server, request, response);
+}
+
+static void start_compression_test() {
+  compression_body = ut_benchmark_make_text(1000);
+  compression_callback_object = ut_null_new();
+  compression_http_server =
+      ut_http_server_new(compression_callback_object, compression_request_cb);
+  UtObjectRef content_types =
+      ut_string_list_new_from_elements("text/html", "text/plain", NULL);
+  ut_http_server_set_compression(compression_http_server, content_types, 100);
+  uint16_t port;
+  UtObjectRef error = NULL;
+  ut_http_server_listen_ipv4_any(compression_http_server, &port, &error);
+  ut_assert_null_object(error);
+
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  compression_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(compression_socket, compression_socket, NULL);
+  UtObjectRef data_string =
+      ut_string_new("GET / HTTP/1.1\r\n"
+                    "Accept-Encoding: deflate;q=0.5, gzip\r\n"
+                    "Connection: close\r\n"
+                    "\r\n");
+  UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
+  ut_tcp_socket_send(compression_socket, data_utf8);
+  ut_input_stream_read(compression_socket, compression_socket,
+                       compression_read_cb);
+}
+
+static size_t limit_read1_cb(UtObject *object, UtObject *data, bool complete) {
+  if (complete) {
+    // Closed due to the idle timeout, after the refused connection.
+    ut_assert_true(limit_socket2_closed);
+    limit_socket1_closed = true;
+    ut_assert_int_equal(ut_http_server_get_n_connections(limit_http_server),
+                        0);
+    start_compression_test();
+  }
+  return ut_list_get_length(data);
+}
+
+static size_t limit_read2_cb(UtObject *object, UtObject *data, bool complete) {
+  if (complete) {
+    // Closed due to being over the connection limit.
+    ut_assert_int_equal(ut_list_get_length(data), 0);
+    ut_assert_false(limit_socket1_closed);
+    limit_socket2_closed = true;
+    ut_assert_int_equal(ut_http_server_get_n_connections(limit_http_server),
+                        1);
+  }
+  return ut_list_get_length(data);
+}
+
+static void limit_connect2_cb(UtObject *object, UtObject *error) {
+  ut_assert_null_object(error);
+  ut_input_stream_read(limit_socket2, limit_socket2, limit_read2_cb);
+}
+
+static void limit_connect1_cb(UtObject *object, UtObject *error) {
+  ut_assert_null_object(error);
+  ut_input_stream_read(limit_socket1, limit_socket1, limit_read1_cb);
+
+  // Second connection once the first is established.
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  limit_socket2 = ut_tcp_socket_new(address, ut_tcp_socket_get_port(object));
+  ut_tcp_socket_connect(limit_socket2, limit_socket2, limit_connect2_cb);
+}
+
+static void start_limit_test() {
+  limit_http_server = ut_http_server_new(NULL, NULL);
+  ut_http_server_set_max_connections(limit_http_server, 1);
+  ut_http_server_set_idle_timeout_ms(limit_http_server, 200);
+  uint16_t port;
+  UtObjectRef error = NULL;
+  ut_http_server_listen_ipv4_any(limit_http_server, &port, &error);
+  ut_assert_null_object(error);
+
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  limit_socket1 = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(limit_socket1, limit_socket1, limit_connect1_cb);
+}
+
+static size_t response_cb(UtObject *object, UtObject *data, bool complete) {
+  // Server closes the connection after the second request.
+  if (!complete) {
+    return 0;
+  }
+
+  UtObjectRef text = ut_string_new_from_utf8(data);
+  ut_assert_cstring_equal(ut_string_get_text(text), "HTTP/1.1 200 OK\r\n"
+                                                    "Content-Length: 3\r\n"
+                                                    "\r\n"
+                                                    "one"
+                                                    "HTTP/1.1 200 OK\r\n"
+                                                    "Content-Length: 3\r\n"
+                                                    "\r\n"
+                                                    "two");
+  ut_assert_int_equal(ut_http_server_get_n_connections(http_server), 0);
+
+  start_limit_test();
+
+  return ut_list_get_length(data);
+}
+
+static void respond(UtObject *request, const char *body_text) {
+  UtObjectRef response_headers = ut_list_new_from_elements_take(
+      ut_http_header_new("Content-Length", "3"), NULL);
+  UtObjectRef body_string = ut_string_new(body_text);
+  UtObjectRef body_data = ut_string_get_utf8(body_string);
+  UtObjectRef body = ut_list_input_stream_new(body_data);
+  UtObjectRef response =
+      ut_http_response_new(200, "OK", response_headers, body);
+  ut_http_server_respond(http_server, request, response);
+}
+
 static void request_cb(UtObject *object, UtObject *request) {
   ut_assert_cstring_equal(ut_http_request_get_method(request), "GET");
-  ut_assert_cstring_equal(ut_http_request_get_path(request), "/example/path");
+  ut_assert_cstring_equal(ut_http_request_get_version(request), "HTTP/1.1");
   UtObject *headers = ut_http_request_get_headers(request);
   ut_assert_int_equal(ut_list_get_length(headers), 1);
   UtObject *header = ut_object_list_get_element(headers, 0);
-  ut_assert_cstring_equal(ut_http_header_get_name(header), "X-Test-Header");
-  ut_assert_cstring_equal(ut_http_header_get_value(header),
-                          "Test Header Value");
+  ut_assert_int_equal(ut_http_server_get_n_connections(http_server), 1);
 
-  ut_event_loop_return(NULL);
+  if (first_request == NULL) {
+    ut_assert_cstring_equal(ut_http_request_get_path(request),
+                            "/example/path");
+    ut_assert_cstring_equal(ut_http_header_get_name(header), "X-Test-Header");
+    ut_assert_cstring_equal(ut_http_header_get_value(header),
+                            "Test Header Value");
+    first_request = ut_object_ref(request);
+  } else {
+    ut_assert_cstring_equal(ut_http_request_get_path(request), "/second");
+    ut_assert_cstring_equal(ut_http_header_get_name(header), "Connection");
+    ut_assert_cstring_equal(ut_http_header_get_value(header), "close");
+
+    // Respond in the opposite order, the responses are still sent in request
+    // order.
+    respond(request, "two");
+    respond(first_request, "one");
+  }
 }
 
 int main(int argc, char **argv) {
   UtObjectRef dummy_object = ut_null_new();
 
-  UtObjectRef http_server = ut_http_server_new(dummy_object, request_cb);
+  http_server = ut_http_server_new(dummy_object, request_cb);
   uint16_t port;
   UtObjectRef error = NULL;
   ut_http_server_listen_ipv4_any(http_server, &port, &error);
 
   UtObjectRef address = ut_ipv4_address_new_loopback();
-  UtObjectRef socket = ut_tcp_socket_new(address, port);
-  ut_tcp_socket_connect(socket, dummy_object, NULL);
+  client_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_connect(client_socket, dummy_object, NULL);
   UtObjectRef data_string = ut_string_new("GET /example/path HTTP/1.1\r\n"
                                           "X-Test-Header: Test Header Value\r\n"
+                                          "\r\n"
+                                          "GET /second HTTP/1.1\r\n"
+                                          "Connection: close\r\n"
                                           "\r\n");
   UtObjectRef data_utf8 = ut_string_get_utf8(data_string);
-  ut_tcp_socket_send(socket, data_utf8);
+  ut_tcp_socket_send(client_socket, data_utf8);
+  ut_input_stream_read(client_socket, dummy_object, response_cb);
 
   ut_event_loop_run();
 
+  ut_object_unref(http_server);
+  ut_object_unref(client_socket);
+  ut_object_unref(first_request);
+  ut_object_unref(limit_http_server);
+  ut_object_unref(limit_socket1);
+  ut_object_unref(limit_socket2);
+  ut_object_unref(compression_callback_object);
+  ut_object_unref(compression_http_server);
+  ut_object_unref(compression_socket);
+  ut_object_unref(compression_body);
+  ut_object_unref(compression_http_1_0_socket);
+  ut_object_unref(stalled_callback_object);
+  ut_object_unref(stalled_http_server);
+  ut_object_unref(stalled_socket);
+  ut_object_unref(stalled_request);
+  ut_object_unref(pipeline_callback_object);
+  ut_object_unref(pipeline_http_server);
+  ut_object_unref(pipeline_socket);
+  ut_object_unref(http_1_0_socket);
+  ut_object_unref(lowercase_socket);
+
   return 0;
 }
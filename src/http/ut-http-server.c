@@ -1,4 +1,7 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "ut-http-server-client.h"
 #include "ut.h"
@@ -9,48 +12,232 @@ typedef struct {
   // Sockets being listened on.
   UtObject *sockets;
 
-  // Connected clients.
+  // Connected clients, stored as keys.
   UtObject *clients;
 
+  // Client each request waiting for a response came from.
+  UtObject *request_clients;
+
+  // Maximum number of connected clients, or 0 if unlimited.
+  size_t max_connections;
+
+  // Time to wait before closing idle connections, or 0 if never closed.
+  uint64_t idle_timeout;
+
+  // Media types of responses to compress, or NULL if compression disabled.
+  UtObject *compression_content_types;
+
+  // Smallest response body to compress.
+  size_t compression_min_length;
+
   // Callback to notify when requests come in.
   UtObject *callback_object;
   UtHttpServerRequestCallback callback;
-
-  // Request in progress.
-  UtObject *request;
 } UtHttpServer;
 
-static void request_cb(UtObject *object, UtObject *request) {
+// Returns the quality the Accept-Encoding header [value] gives to [coding].
+// Returns 0 if [coding] is not acceptable.
+static double get_coding_quality(const char *value, const char *coding) {
+  size_t coding_length = strlen(coding);
+  double wildcard_quality = 0;
+  const char *start = value;
+  while (true) {
+    while (*start == ' ' || *start == ',') {
+      start++;
+    }
+    if (*start == '\0') {
+      return wildcard_quality;
+    }
+
+    const char *end = start;
+    while (*end != '\0' && *end != ',' && *end != ';' && *end != ' ') {
+      end++;
+    }
+    size_t name_length = end - start;
+
+    // Quality defaults to 1 if not set.
+    double quality = 1;
+    while (*end == ' ') {
+      end++;
+    }
+    if (*end == ';') {
+      end++;
+      while (*end == ' ') {
+        end++;
+      }
+      if (strncasecmp(end, "q=", 2) == 0) {
+        quality = strtod(end + 2, NULL);
+      }
+    }
+    while (*end != '\0' && *end != ',') {
+      end++;
+    }
+
+    if (name_length == coding_length &&
+        strncasecmp(start, coding, coding_length) == 0) {
+      return quality;
+    } else if (name_length == 1 && *start == '*') {
+      wildcard_quality = quality;
+    }
+    start = end;
+  }
+}
+
+// Returns true if the media type in the Content-Type header [value] is in
+// [content_types].
+static bool has_content_type(UtObject *content_types, const char *value) {
+  size_t type_length = 0;
+  while (value[type_length] != '\0' && value[type_length] != ';' &&
+         value[type_length] != ' ') {
+    type_length++;
+  }
+
+  size_t content_types_length = ut_list_get_length(content_types);
+  for (size_t i = 0; i < content_types_length; i++) {
+    const char *content_type = ut_string_list_get_element(content_types, i);
+    if (strlen(content_type) == type_length &&
+        strncasecmp(value, content_type, type_length) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Returns the content coding to use for [response] to [request] or NULL if
+// it should not be compressed.
+static const char *get_content_coding(UtHttpServer *self, UtObject *request,
+                                      UtObject *response) {
+  // Compressed bodies are sent in chunks, which HTTP/1.0 doesn't support.
+  if (self->compression_content_types == NULL ||
+      ut_cstring_equal(ut_http_request_get_version(request), "HTTP/1.0") ||
+      ut_http_response_get_body(response) == NULL ||
+      ut_http_response_get_header(response, "Content-Encoding") != NULL) {
+    return NULL;
+  }
+
+  const char *content_type =
+      ut_http_response_get_header(response, "Content-Type");
+  if (content_type == NULL ||
+      !has_content_type(self->compression_content_types, content_type)) {
+    return NULL;
+  }
+
+  // Bodies of unknown length are assumed to be large enough.
+  ssize_t content_length = ut_http_response_get_content_length(response);
+  if (content_length >= 0 &&
+      (size_t)content_length < self->compression_min_length) {
+    return NULL;
+  }
+
+  const char *accept_encoding =
+      ut_http_request_get_header(request, "Accept-Encoding");
+  if (accept_encoding == NULL) {
+    return NULL;
+  }
+  double gzip_quality = get_coding_quality(accept_encoding, "gzip");
+  double deflate_quality = get_coding_quality(accept_encoding, "deflate");
+  if (gzip_quality > 0 && gzip_quality >= deflate_quality) {
+    return "gzip";
+  } else if (deflate_quality > 0) {
+    return "deflate";
+  } else {
+    return NULL;
+  }
+}
+
+// Returns a copy of [response] with the body compressed using [coding].
+static UtObject *compress_response(UtObject *response, const char *coding) {
+  UtObjectRef headers = ut_list_new();
+  const char *vary = NULL;
+  UtObject *response_headers = ut_http_response_get_headers(response);
+  size_t response_headers_length = ut_list_get_length(response_headers);
+  for (size_t i = 0; i < response_headers_length; i++) {
+    UtObject *header = ut_object_list_get_element(response_headers, i);
+    const char *name = ut_http_header_get_name(header);
+    if (strcasecmp(name, "Vary") == 0) {
+      vary = ut_http_header_get_value(header);
+    } else if (strcasecmp(name, "Content-Length") != 0 &&
+               strcasecmp(name, "Transfer-Encoding") != 0) {
+      ut_list_append(headers, header);
+    }
+  }
+  ut_list_append_take(headers, ut_http_header_new("Content-Encoding", coding));
+  // Length of the compressed data is not known, so send it in chunks.
+  ut_list_append_take(headers,
+                      ut_http_header_new("Transfer-Encoding", "chunked"));
+  if (vary != NULL) {
+    ut_cstring_ref value = ut_cstring_new_printf("%s, Accept-Encoding", vary);
+    ut_list_append_take(headers, ut_http_header_new("Vary", value));
+  } else {
+    ut_list_append_take(headers, ut_http_header_new("Vary", "Accept-Encoding"));
+  }
+
+  UtObject *body = ut_http_response_get_body(response);
+  UtObjectRef encoder = ut_cstring_equal(coding, "gzip")
+                            ? ut_gzip_encoder_new(body)
+                            : ut_zlib_encoder_new(body);
+
+  return ut_http_response_new(ut_http_response_get_status_code(response),
+                              ut_http_response_get_reason_phrase(response),
+                              headers, encoder);
+}
+
+static void request_cb(UtObject *object, UtObject *client,
+                       UtObject *request) {
   UtHttpServer *self = (UtHttpServer *)object;
 
-  ut_object_unref(self->request);
-  self->request = ut_object_ref(request);
+  ut_map_insert(self->request_clients, request, client);
 
   if (self->callback_object != NULL && self->callback != NULL) {
     self->callback(self->callback_object, request);
   }
 }
 
+static void closed_cb(UtObject *object, UtObject *client) {
+  UtHttpServer *self = (UtHttpServer *)object;
+
+  // Responses can no longer be sent for requests from this client.
+  UtObjectRef requests = ut_http_server_client_get_unanswered_requests(client);
+  size_t requests_length = ut_list_get_length(requests);
+  for (size_t i = 0; i < requests_length; i++) {
+    ut_map_remove(self->request_clients,
+                  ut_object_list_get_element(requests, i));
+  }
+
+  ut_map_remove(self->clients, client);
+}
+
 static void http_listen_cb(UtObject *object, UtObject *socket) {
   UtHttpServer *self = (UtHttpServer *)object;
 
-  UtObjectRef client = ut_http_server_client_new(socket, object, request_cb);
-  ut_list_append(self->clients, client);
+  // Refuse connections over the limit, the socket is closed when dropped.
+  if (self->max_connections > 0 &&
+      ut_map_get_length(self->clients) >= self->max_connections) {
+    return;
+  }
+
+  UtObjectRef client =
+      ut_http_server_client_new(socket, object, request_cb, closed_cb);
+  ut_map_insert(self->clients, client, client);
+  ut_http_server_client_set_idle_timeout(client, self->idle_timeout);
   ut_http_server_client_read(client);
 }
 
 static void ut_http_server_init(UtObject *object) {
   UtHttpServer *self = (UtHttpServer *)object;
   self->sockets = ut_list_new();
-  self->clients = ut_object_list_new();
+  self->clients = ut_map_new_unordered();
+  self->request_clients = ut_map_new_unordered();
 }
 
 static void ut_http_server_cleanup(UtObject *object) {
   UtHttpServer *self = (UtHttpServer *)object;
   ut_object_unref(self->sockets);
   ut_object_unref(self->clients);
+  ut_object_unref(self->request_clients);
+  ut_object_unref(self->compression_content_types);
   ut_object_weak_unref(&self->callback_object);
-  ut_object_unref(self->request);
 }
 
 static UtObjectInterface object_interface = {.type_name = "UtHttpServer",
@@ -122,18 +309,56 @@ bool ut_http_server_listen_ipv6_any(UtObject *object, uint16_t *port,
   return true;
 }
 
-void ut_http_server_respond(UtObject *object, UtObject *request,
-                            UtObject *response) {
+void ut_http_server_set_max_connections(UtObject *object,
+                                        size_t max_connections) {
   assert(ut_object_is_http_server(object));
   UtHttpServer *self = (UtHttpServer *)object;
+  self->max_connections = max_connections;
+}
 
-  // FIXME: Could be multiple requests.
-  assert(request == self->request);
+void ut_http_server_set_idle_timeout_ms(UtObject *object,
+                                        uint64_t milliseconds) {
+  assert(ut_object_is_http_server(object));
+  UtHttpServer *self = (UtHttpServer *)object;
+  self->idle_timeout = milliseconds;
+}
 
-  // FIXME: Could be multiple clients.
-  UtObject *client = ut_object_list_get_element(self->clients, 0);
+void ut_http_server_set_compression(UtObject *object, UtObject *content_types,
+                                    size_t min_length) {
+  assert(ut_object_is_http_server(object));
+  UtHttpServer *self = (UtHttpServer *)object;
+  ut_object_unref(self->compression_content_types);
+  self->compression_content_types =
+      content_types != NULL ? ut_object_ref(content_types) : NULL;
+  self->compression_min_length = min_length;
+}
+
+size_t ut_http_server_get_n_connections(UtObject *object) {
+  assert(ut_object_is_http_server(object));
+  UtHttpServer *self = (UtHttpServer *)object;
+  return ut_map_get_length(self->clients);
+}
 
-  ut_http_server_client_send_response(client, response);
+void ut_http_server_respond(UtObject *object, UtObject *request,
+                            UtObject *response) {
+  assert(ut_object_is_http_server(object));
+  UtHttpServer *self = (UtHttpServer *)object;
+
+  // Nothing to do if the client has disconnected.
+  UtObject *request_client = ut_map_lookup(self->request_clients, request);
+  if (request_client == NULL) {
+    return;
+  }
+  UtObjectRef client = ut_object_ref(request_client);
+  ut_map_remove(self->request_clients, request);
+
+  const char *coding = get_content_coding(self, request, response);
+  if (coding != NULL) {
+    UtObjectRef compressed_response = compress_response(response, coding);
+    ut_http_server_client_send_response(client, request, compressed_response);
+  } else {
+    ut_http_server_client_send_response(client, request, response);
+  }
 }
 
 bool ut_object_is_http_server(UtObject *object) {
@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "ut-object.h"
 
@@ -35,7 +37,41 @@ bool ut_http_server_listen_ipv6(UtObject *object, uint16_t port,
 bool ut_http_server_listen_ipv6_any(UtObject *object, uint16_t *port,
                                     UtObject **error);
 
+/// Sets the maximum number of clients that can be connected at once.
+/// Connections over this limit are closed immediately. If [max_connections]
+/// is 0 (the default) there is no limit.
+void ut_http_server_set_max_connections(UtObject *object,
+                                        size_t max_connections);
+
+/// Sets the time in [milliseconds] a client can be idle before its connection
+/// is closed. Clients are not idle while waiting for a response, but are if
+/// they stop sending a request body. If [milliseconds] is 0 (the default)
+/// connections are never closed.
+/// Only affects clients that connect after this is set.
+void ut_http_server_set_idle_timeout_ms(UtObject *object,
+                                        uint64_t milliseconds);
+
+/// Enables compression of responses to clients that accept the gzip or deflate
+/// content codings. Only responses with a Content-Type in [content_types]
+/// (e.g. "text/html") and a body of at least [min_length] bytes are
+/// compressed. Responses without a Content-Length are compressed regardless of
+/// [min_length].
+/// Compressed responses are sent using chunked transfer encoding, so responses
+/// to HTTP/1.0 requests are not compressed.
+/// If [content_types] is [NULL] (the default) compression is disabled.
+///
+/// !arg-type content_types UtStringList
+void ut_http_server_set_compression(UtObject *object, UtObject *content_types,
+                                    size_t min_length);
+
+/// Returns the number of clients currently connected.
+size_t ut_http_server_get_n_connections(UtObject *object);
+
 /// Sends the [response] to [request].
+/// Connections are kept open for further requests unless the client asks for
+/// them to be closed. Clients may send multiple requests without waiting, the
+/// responses are sent in the order the requests were received.
+/// If the client has disconnected the response is dropped.
 ///
 /// !arg-type request UtHttpRequest
 /// !arg-type response UtHttpResponse
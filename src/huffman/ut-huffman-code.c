@@ -86,6 +86,138 @@ void ut_huffman_code_generate(UtObject *symbol_weights, uint16_t *codes,
   free(nodes);
 }
 
+// Symbol and weight, used to sort symbols.
+typedef struct {
+  uint16_t symbol;
+  double weight;
+} WeightedSymbol;
+
+// Sort by highest weight first, then by symbol.
+static int compare_weighted_symbols(const void *a, const void *b) {
+  const WeightedSymbol *symbol_a = a;
+  const WeightedSymbol *symbol_b = b;
+  if (symbol_a->weight != symbol_b->weight) {
+    return symbol_a->weight > symbol_b->weight ? -1 : 1;
+  }
+  return symbol_a->symbol - symbol_b->symbol;
+}
+
+void ut_huffman_code_generate_limited_widths(UtObject *symbol_weights,
+                                             size_t max_code_width,
+                                             size_t *code_widths) {
+  size_t symbols_length = ut_list_get_length(symbol_weights);
+
+  // We only support up to 16 bit symbols.
+  assert(symbols_length <= 0xffff);
+  assert(max_code_width <= 16);
+
+  // Only code symbols with a weight, and at least two so the code is
+  // complete.
+  WeightedSymbol *symbols = malloc(sizeof(WeightedSymbol) * symbols_length);
+  size_t n_symbols = 0;
+  for (size_t i = 0; i < symbols_length; i++) {
+    double weight = ut_float64_list_get_element(symbol_weights, i);
+    code_widths[i] = 0;
+    if (weight > 0) {
+      symbols[n_symbols].symbol = i;
+      symbols[n_symbols].weight = weight;
+      n_symbols++;
+    }
+  }
+  for (size_t i = 0; i < symbols_length && n_symbols < 2; i++) {
+    if (ut_float64_list_get_element(symbol_weights, i) <= 0) {
+      symbols[n_symbols].symbol = i;
+      symbols[n_symbols].weight = 0;
+      n_symbols++;
+    }
+  }
+  if (n_symbols < 2) {
+    if (n_symbols == 1) {
+      code_widths[symbols[0].symbol] = 1;
+    }
+    free(symbols);
+    return;
+  }
+  assert(n_symbols <= (size_t)1 << max_code_width);
+
+  // Build a Huffman tree, combining the two nodes with the smallest weights.
+  Node *nodes = malloc(sizeof(Node) * (n_symbols * 2 - 1));
+  for (size_t i = 0; i < n_symbols; i++) {
+    nodes[i].parent = -1;
+    nodes[i].weight = symbols[i].weight;
+  }
+  size_t n_nodes = n_symbols;
+  for (size_t i = 0; i < n_symbols - 1; i++) {
+    size_t smallest_node = -1, second_smallest_node = -1;
+    for (size_t j = 0; j < n_nodes; j++) {
+      if (nodes[j].parent != -1) {
+        continue;
+      }
+      if (smallest_node == -1 ||
+          nodes[j].weight < nodes[smallest_node].weight) {
+        second_smallest_node = smallest_node;
+        smallest_node = j;
+      } else if (second_smallest_node == -1 ||
+                 nodes[j].weight < nodes[second_smallest_node].weight) {
+        second_smallest_node = j;
+      }
+    }
+
+    size_t parent_node = n_nodes;
+    n_nodes++;
+    nodes[parent_node].parent = -1;
+    nodes[parent_node].weight =
+        nodes[smallest_node].weight + nodes[second_smallest_node].weight;
+    nodes[smallest_node].parent = parent_node;
+    nodes[second_smallest_node].parent = parent_node;
+  }
+
+  // Count the number of codes of each width.
+  size_t *width_counts = calloc(n_symbols, sizeof(size_t));
+  size_t max_width = 0;
+  for (size_t i = 0; i < n_symbols; i++) {
+    size_t width = 0;
+    for (size_t n = i; nodes[n].parent != -1; n = nodes[n].parent) {
+      width++;
+    }
+    width_counts[width]++;
+    if (width > max_width) {
+      max_width = width;
+    }
+  }
+  free(nodes);
+
+  // Shorten codes longer than the maximum. Two codes of the longest width are
+  // removed and their parent used in place of a shorter code, which then gains
+  // two children. This is the method used in JPEG (ITU T.81 K.3).
+  for (size_t width = max_width; width > max_code_width; width--) {
+    while (width_counts[width] > 0) {
+      size_t w = width - 2;
+      while (width_counts[w] == 0) {
+        w--;
+      }
+      width_counts[width] -= 2;
+      width_counts[width - 1]++;
+      width_counts[w + 1] += 2;
+      width_counts[w]--;
+    }
+  }
+
+  // Assign the shortest codes to the highest weighted symbols.
+  qsort(symbols, n_symbols, sizeof(WeightedSymbol), compare_weighted_symbols);
+  size_t width = 1;
+  for (size_t i = 0; i < n_symbols; i++) {
+    while (width_counts[width] == 0) {
+      width++;
+    }
+    code_widths[symbols[i].symbol] = width;
+    width_counts[width]--;
+  }
+
+  free(width_counts);
+  free(symbols);
+}
+
 bool ut_huffman_code_generate_canonical(UtObject *code_widths,
                                         uint16_t *codes) {
   size_t symbols_length = ut_list_get_length(code_widths);
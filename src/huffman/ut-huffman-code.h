@@ -8,4 +8,8 @@
 void ut_huffman_code_generate(UtObject *symbol_weights, uint16_t *codes,
                               size_t *code_widths);
 
+void ut_huffman_code_generate_limited_widths(UtObject *symbol_weights,
+                                             size_t max_code_width,
+                                             size_t *code_widths);
+
 bool ut_huffman_code_generate_canonical(UtObject *code_widths, uint16_t *codes);
@@ -223,9 +223,116 @@ static void test_decode_canonical_single_symbol() {
   ut_assert_int_equal(symbol, 65535);
 }
 
+// Decode [bits] using the lookup table API and return the symbol indexes.
+static UtObject *lookup_symbols(UtObject *decoder, UtObject *bits,
+                                bool lsb_first) {
+  UtObjectRef symbols = ut_uint16_list_new();
+  size_t bits_length = ut_list_get_length(bits);
+  size_t offset = 0;
+  while (offset < bits_length) {
+    // Take the next 16 bits, padded with zeros.
+    uint16_t code_bits = 0;
+    for (size_t i = 0; i < 16 && offset + i < bits_length; i++) {
+      uint16_t bit = ut_uint8_list_get_element(bits, offset + i);
+      code_bits |= lsb_first ? bit << i : bit << (15 - i);
+    }
+
+    uint16_t symbol;
+    size_t code_width =
+        lsb_first
+            ? ut_huffman_decoder_lookup_lsb_first(decoder, code_bits, &symbol)
+            : ut_huffman_decoder_lookup_msb_first(decoder, code_bits, &symbol);
+    ut_assert_true(code_width > 0);
+    ut_uint16_list_append(symbols, symbol);
+    offset += code_width;
+  }
+  ut_assert_int_equal(offset, bits_length);
+
+  return ut_object_ref(symbols);
+}
+
+static void test_lookup() {
+  // Same code as test_decode_canonical.
+  UtObjectRef code_widths = ut_uint8_list_new_from_elements(
+      16, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5);
+  UtObjectRef bits = ut_uint8_list_new_from_elements(22, 1, 1, 0, 0, // 't'
+                                                     0, 1, 1, 1,     // 'h'
+                                                     0, 0, 0,        // ' '
+                                                     1, 1, 1, 1, 1,  // 'x'
+                                                     0, 0, 1,        // 'a'
+                                                     0, 1, 0         // 'e'
+  );
+  UtObjectRef decoder = ut_huffman_decoder_new_canonical(code_widths);
+  ut_assert_int_equal(ut_huffman_decoder_get_max_code_width(decoder), 5);
+
+  uint16_t expected_symbols[] = {9, 4, 0, 15, 1, 2};
+  UtObjectRef msb_symbols = lookup_symbols(decoder, bits, false);
+  ut_assert_uint16_list_equal(msb_symbols, expected_symbols, 6);
+  UtObjectRef lsb_symbols = lookup_symbols(decoder, bits, true);
+  ut_assert_uint16_list_equal(lsb_symbols, expected_symbols, 6);
+}
+
+static void test_lookup_long_codes() {
+  // Codes longer than the primary lookup table, up to the maximum of 16 bits.
+  // Symbol n has code width n + 1, apart from the last two that are 16 bits.
+  UtObjectRef code_widths = ut_uint8_list_new();
+  for (size_t i = 0; i < 15; i++) {
+    ut_uint8_list_append(code_widths, i + 1);
+  }
+  ut_uint8_list_append(code_widths, 16);
+  ut_uint8_list_append(code_widths, 16);
+  UtObjectRef decoder = ut_huffman_decoder_new_canonical(code_widths);
+  ut_assert_is_not_error(decoder);
+  ut_assert_int_equal(ut_huffman_decoder_get_max_code_width(decoder), 16);
+
+  // Codes are 0, 10, 110, ... 1111111111111110, 1111111111111111.
+  UtObjectRef bits = ut_uint8_list_new();
+  UtObjectRef expected_symbols = ut_uint16_list_new();
+  uint16_t symbol_order[] = {16, 0, 9, 10, 15, 1, 12, 8};
+  for (size_t i = 0; i < 8; i++) {
+    uint16_t symbol = symbol_order[i];
+    size_t n_ones = symbol < 16 ? symbol : 16;
+    for (size_t j = 0; j < n_ones; j++) {
+      ut_uint8_list_append(bits, 1);
+    }
+    if (symbol < 16) {
+      ut_uint8_list_append(bits, 0);
+    }
+    ut_uint16_list_append(expected_symbols, symbol);
+  }
+
+  UtObjectRef msb_symbols = lookup_symbols(decoder, bits, false);
+  ut_assert_equal(msb_symbols, expected_symbols);
+  UtObjectRef lsb_symbols = lookup_symbols(decoder, bits, true);
+  ut_assert_equal(lsb_symbols, expected_symbols);
+}
+
+static void test_lookup_single_symbol() {
+  UtObjectRef code_widths = ut_uint8_list_new_from_elements(1, 1);
+  UtObjectRef decoder = ut_huffman_decoder_new_canonical(code_widths);
+  ut_assert_is_not_error(decoder);
+
+  uint16_t symbol;
+  ut_assert_int_equal(
+      ut_huffman_decoder_lookup_msb_first(decoder, 0x0000, &symbol), 1);
+  ut_assert_int_equal(symbol, 0);
+  ut_assert_int_equal(
+      ut_huffman_decoder_lookup_lsb_first(decoder, 0x0000, &symbol), 1);
+  ut_assert_int_equal(symbol, 0);
+
+  // Unused code.
+  ut_assert_int_equal(
+      ut_huffman_decoder_lookup_msb_first(decoder, 0x8000, &symbol), 0);
+  ut_assert_int_equal(
+      ut_huffman_decoder_lookup_lsb_first(decoder, 0x0001, &symbol), 0);
+}
+
 int main(int argc, char **argv) {
   test_decode();
   test_decode_canonical();
   test_decode_canonical_zero_lengths();
   test_decode_canonical_single_symbol();
+  test_lookup();
+  test_lookup_long_codes();
+  test_lookup_single_symbol();
 }
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut-huffman-code.h"
 #include "ut.h"
@@ -9,8 +10,33 @@ typedef struct {
   uint16_t *code_table_data;
   uint16_t **code_tables;
   size_t max_code_width;
+
+  // Codes and widths for each symbol, used to build lookup tables.
+  size_t symbols_length;
+  uint16_t *codes;
+  uint8_t *code_widths;
+
+  // Number of bits used to index the primary lookup tables.
+  size_t primary_bits;
+
+  // Lookup tables for codes read most and least significant bit first.
+  // Generated on first use.
+  uint32_t *msb_first_table;
+  uint32_t *lsb_first_table;
 } UtHuffmanDecoder;
 
+// Number of bits used in the primary lookup table. Longer codes are decoded
+// using subtables.
+#define MAX_PRIMARY_BITS 9
+
+// Lookup table entries contain either a symbol and the width of its code, or
+// the location and number of index bits of a subtable. An entry of zero is an
+// invalid code.
+#define ENTRY_VALUE_MASK 0xffffff
+#define ENTRY_WIDTH_SHIFT 24
+#define ENTRY_WIDTH_MASK 0x1f
+#define ENTRY_SUBTABLE 0x80000000
+
 static void allocate_tables(UtHuffmanDecoder *self) {
   size_t code_table_data_length = 1 << (self->max_code_width + 1);
   self->code_table_data = malloc(sizeof(uint16_t) * code_table_data_length);
@@ -27,10 +53,124 @@ static void allocate_tables(UtHuffmanDecoder *self) {
   }
 }
 
+// Returns [code] of [code_width] bits with the bits in reverse order.
+static uint16_t reverse_bits(uint16_t code, size_t code_width) {
+  uint16_t value = 0;
+  for (size_t i = 0; i < code_width; i++) {
+    value = value << 1 | (code & 0x1);
+    code >>= 1;
+  }
+  return value;
+}
+
+// Set all entries in [table] of [table_bits] index bits that start with [code]
+// of [code_width] bits to [entry]. If [lsb_first] the first code bit is the
+// least significant index bit, otherwise the most significant.
+static void fill_entries(uint32_t *table, size_t table_bits, bool lsb_first,
+                         uint16_t code, size_t code_width, uint32_t entry) {
+  size_t n_entries = 1 << (table_bits - code_width);
+  for (size_t i = 0; i < n_entries; i++) {
+    size_t index = lsb_first ? code | i << code_width
+                             : (size_t)code << (table_bits - code_width) | i;
+    table[index] = entry;
+  }
+}
+
+// Build a lookup table for reading codes in the given bit order.
+static uint32_t *build_table(UtHuffmanDecoder *self, bool lsb_first) {
+  size_t primary_bits = self->primary_bits;
+  size_t primary_length = 1 << primary_bits;
+
+  // Codes in the order they are read, first bit in the least significant bit
+  // for LSB first.
+  uint16_t codes[self->symbols_length];
+  for (size_t i = 0; i < self->symbols_length; i++) {
+    codes[i] = lsb_first ? reverse_bits(self->codes[i], self->code_widths[i])
+                         : self->codes[i];
+  }
+
+  // Find the subtables required for codes longer than the primary table.
+  uint8_t subtable_bits[primary_length];
+  memset(subtable_bits, 0, primary_length);
+  for (size_t i = 0; i < self->symbols_length; i++) {
+    size_t code_width = self->code_widths[i];
+    if (code_width <= primary_bits) {
+      continue;
+    }
+    size_t suffix_width = code_width - primary_bits;
+    size_t prefix = lsb_first ? codes[i] & (primary_length - 1)
+                              : codes[i] >> suffix_width;
+    if (suffix_width > subtable_bits[prefix]) {
+      subtable_bits[prefix] = suffix_width;
+    }
+  }
+
+  size_t table_length = primary_length;
+  for (size_t i = 0; i < primary_length; i++) {
+    if (subtable_bits[i] > 0) {
+      table_length += 1 << subtable_bits[i];
+    }
+  }
+  uint32_t *table = calloc(table_length, sizeof(uint32_t));
+
+  size_t offset = primary_length;
+  for (size_t i = 0; i < primary_length; i++) {
+    if (subtable_bits[i] > 0) {
+      table[i] =
+          ENTRY_SUBTABLE | subtable_bits[i] << ENTRY_WIDTH_SHIFT | offset;
+      offset += 1 << subtable_bits[i];
+    }
+  }
+
+  for (size_t i = 0; i < self->symbols_length; i++) {
+    size_t code_width = self->code_widths[i];
+    if (code_width == 0) {
+      continue;
+    }
+    uint32_t entry = code_width << ENTRY_WIDTH_SHIFT | i;
+    if (code_width <= primary_bits) {
+      fill_entries(table, primary_bits, lsb_first, codes[i], code_width, entry);
+    } else {
+      size_t suffix_width = code_width - primary_bits;
+      size_t prefix, suffix;
+      if (lsb_first) {
+        prefix = codes[i] & (primary_length - 1);
+        suffix = codes[i] >> primary_bits;
+      } else {
+        prefix = codes[i] >> suffix_width;
+        suffix = codes[i] & ((1 << suffix_width) - 1);
+      }
+      uint32_t subtable_entry = table[prefix];
+      fill_entries(table + (subtable_entry & ENTRY_VALUE_MASK),
+                   subtable_bits[prefix], lsb_first, suffix, suffix_width,
+                   entry);
+    }
+  }
+
+  return table;
+}
+
+// Returns the code width and sets [symbol] from [entry], or returns 0 if an
+// invalid code.
+static size_t decode_entry(uint32_t entry, uint16_t *symbol) {
+  if (entry == 0) {
+    return 0;
+  }
+
+  if (symbol != NULL) {
+    *symbol = entry & ENTRY_VALUE_MASK;
+  }
+  return entry >> ENTRY_WIDTH_SHIFT;
+}
+
 static void ut_huffman_decoder_cleanup(UtObject *object) {
   UtHuffmanDecoder *self = (UtHuffmanDecoder *)object;
   free(self->code_table_data);
   free(self->code_tables);
+  free(self->codes);
+  free(self->code_widths);
+  free(self->msb_first_table);
+  free(self->lsb_first_table);
 }
 
 static UtObjectInterface object_interface = {
@@ -50,6 +190,17 @@ static UtObject *create_decoder(size_t symbols_length, uint16_t *codes,
     }
   }
 
+  self->symbols_length = symbols_length;
+  self->codes = malloc(sizeof(uint16_t) * symbols_length);
+  self->code_widths = malloc(sizeof(uint8_t) * symbols_length);
+  for (size_t i = 0; i < symbols_length; i++) {
+    self->codes[i] = codes[i];
+    self->code_widths[i] = code_widths[i];
+  }
+  self->primary_bits = self->max_code_width < MAX_PRIMARY_BITS
+                           ? self->max_code_width
+                           : MAX_PRIMARY_BITS;
+
   // Populate mapping tables.
   allocate_tables(self);
   for (size_t code_width = 1; code_width <= self->max_code_width;
@@ -126,6 +277,53 @@ bool ut_huffman_decoder_get_symbol(UtObject *object, uint16_t code,
   return true;
 }
 
+size_t ut_huffman_decoder_get_max_code_width(UtObject *object) {
+  assert(ut_object_is_huffman_decoder(object));
+  UtHuffmanDecoder *self = (UtHuffmanDecoder *)object;
+  return self->max_code_width;
+}
+
+size_t ut_huffman_decoder_lookup_msb_first(UtObject *object, uint16_t bits,
+                                           uint16_t *symbol) {
+  assert(ut_object_is_huffman_decoder(object));
+  UtHuffmanDecoder *self = (UtHuffmanDecoder *)object;
+
+  if (self->msb_first_table == NULL) {
+    self->msb_first_table = build_table(self, false);
+  }
+
+  size_t primary_bits = self->primary_bits;
+  uint32_t entry = self->msb_first_table[bits >> (16 - primary_bits)];
+  if ((entry & ENTRY_SUBTABLE) != 0) {
+    size_t subtable_bits = entry >> ENTRY_WIDTH_SHIFT & ENTRY_WIDTH_MASK;
+    size_t index = (bits >> (16 - primary_bits - subtable_bits)) &
+                   ((1 << subtable_bits) - 1);
+    entry = self->msb_first_table[(entry & ENTRY_VALUE_MASK) + index];
+  }
+
+  return decode_entry(entry, symbol);
+}
+
+size_t ut_huffman_decoder_lookup_lsb_first(UtObject *object, uint16_t bits,
+                                           uint16_t *symbol) {
+  assert(ut_object_is_huffman_decoder(object));
+  UtHuffmanDecoder *self = (UtHuffmanDecoder *)object;
+
+  if (self->lsb_first_table == NULL) {
+    self->lsb_first_table = build_table(self, true);
+  }
+
+  size_t primary_bits = self->primary_bits;
+  uint32_t entry = self->lsb_first_table[bits & ((1 << primary_bits) - 1)];
+  if ((entry & ENTRY_SUBTABLE) != 0) {
+    size_t subtable_bits = entry >> ENTRY_WIDTH_SHIFT & ENTRY_WIDTH_MASK;
+    size_t index = (bits >> primary_bits) & ((1 << subtable_bits) - 1);
+    entry = self->lsb_first_table[(entry & ENTRY_VALUE_MASK) + index];
+  }
+
+  return decode_entry(entry, symbol);
+}
+
 bool ut_object_is_huffman_decoder(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
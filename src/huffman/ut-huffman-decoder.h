@@ -24,5 +24,26 @@ UtObject *ut_huffman_decoder_new_canonical(UtObject *code_widths);
 bool ut_huffman_decoder_get_symbol(UtObject *object, uint16_t code,
                                    size_t code_width, uint16_t *symbol);
 
+/// Returns the width of the longest code in [object].
+size_t ut_huffman_decoder_get_max_code_width(UtObject *object);
+
+/// Decodes the code at the start of [bits] using a lookup table, where the
+/// first bit of the code is the most significant bit of [bits].
+/// Returns the width of the code and sets [symbol], or returns 0 if [bits]
+/// doesn't start with a valid code.
+/// If fewer than 16 bits are available the unused bits should be zero, and the
+/// result is only valid if the code width is not more than the available bits.
+size_t ut_huffman_decoder_lookup_msb_first(UtObject *object, uint16_t bits,
+                                           uint16_t *symbol);
+
+/// Decodes the code at the start of [bits] using a lookup table, where the
+/// first bit of the code is the least significant bit of [bits].
+/// Returns the width of the code and sets [symbol], or returns 0 if [bits]
+/// doesn't start with a valid code.
+/// If fewer than 16 bits are available the unused bits should be zero, and the
+/// result is only valid if the code width is not more than the available bits.
+size_t ut_huffman_decoder_lookup_lsb_first(UtObject *object, uint16_t bits,
+                                           uint16_t *symbol);
+
 /// Returns [true] if [object] is a [UtHuffmanDecoder].
 bool ut_object_is_huffman_decoder(UtObject *object);
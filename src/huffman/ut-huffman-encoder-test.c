@@ -198,8 +198,63 @@ static void test_encode_canonical_zero_lengths() {
   ut_assert_uint8_list_equal(bits, expected_bits, 135);
 }
 
+static void test_encode_length_limited() {
+  // Fibonacci weights generate the longest possible codes.
+  UtObjectRef symbol_weights = ut_float64_list_new_from_elements(
+      11, 1.0, 1.0, 2.0, 3.0, 5.0, 8.0, 13.0, 21.0, 34.0, 0.0, 55.0);
+  UtObjectRef unlimited_encoder =
+      ut_huffman_encoder_new_length_limited(symbol_weights, 16);
+  UtObjectRef encoder =
+      ut_huffman_encoder_new_length_limited(symbol_weights, 5);
+
+  uint16_t code;
+  size_t code_width;
+  ut_huffman_encoder_get_code(unlimited_encoder, 0, &code, &code_width);
+  ut_assert_int_equal(code_width, 9);
+  ut_huffman_encoder_get_code(unlimited_encoder, 10, &code, &code_width);
+  ut_assert_int_equal(code_width, 1);
+
+  // All codes fit in the limit, and form a complete code.
+  size_t code_space = 0;
+  for (size_t i = 0; i < 11; i++) {
+    ut_huffman_encoder_get_code(encoder, i, &code, &code_width);
+    if (i == 9) {
+      ut_assert_int_equal(code_width, 0);
+      continue;
+    }
+    ut_assert_true(code_width >= 1 && code_width <= 5);
+    code_space += 1 << (5 - code_width);
+  }
+  ut_assert_int_equal(code_space, 32);
+
+  // Heaviest symbol still has the shortest code.
+  ut_huffman_encoder_get_code(encoder, 10, &code, &code_width);
+  ut_assert_int_equal(code_width, 1);
+  ut_assert_int_equal(code, 0x0);
+}
+
+static void test_encode_length_limited_single_symbol() {
+  // A second code is added to make a complete code.
+  UtObjectRef symbol_weights =
+      ut_float64_list_new_from_elements(4, 0.0, 0.0, 7.0, 0.0);
+  UtObjectRef encoder =
+      ut_huffman_encoder_new_length_limited(symbol_weights, 7);
+  uint16_t code;
+  size_t code_width;
+  ut_huffman_encoder_get_code(encoder, 0, &code, &code_width);
+  ut_assert_int_equal(code_width, 1);
+  ut_assert_int_equal(code, 0x0);
+  ut_huffman_encoder_get_code(encoder, 1, &code, &code_width);
+  ut_assert_int_equal(code_width, 0);
+  ut_huffman_encoder_get_code(encoder, 2, &code, &code_width);
+  ut_assert_int_equal(code_width, 1);
+  ut_assert_int_equal(code, 0x1);
+}
+
 int main(int argc, char **argv) {
   test_encode();
   test_encode_canonical();
   test_encode_canonical_zero_lengths();
+  test_encode_length_limited();
+  test_encode_length_limited_single_symbol();
 }
@@ -54,6 +54,24 @@ UtObject *ut_huffman_encoder_new_canonical(UtObject *code_widths) {
   return object;
 }
 
+UtObject *ut_huffman_encoder_new_length_limited(UtObject *symbol_weights,
+                                                size_t max_code_width) {
+  size_t symbols_length = ut_list_get_length(symbol_weights);
+
+  UtObject *object = create_encoder(symbols_length);
+  UtHuffmanEncoder *self = (UtHuffmanEncoder *)object;
+  ut_huffman_code_generate_limited_widths(symbol_weights, max_code_width,
+                                          self->code_widths);
+  UtObjectRef code_widths = ut_uint8_array_new_sized(symbols_length);
+  uint8_t *code_widths_data = ut_uint8_list_get_writable_data(code_widths);
+  for (size_t i = 0; i < symbols_length; i++) {
+    code_widths_data[i] = self->code_widths[i];
+  }
+  ut_huffman_code_generate_canonical(code_widths, self->codes);
+
+  return object;
+}
+
 void ut_huffman_encoder_get_code(UtObject *object, uint16_t symbol,
                                  uint16_t *code, size_t *code_width) {
   assert(ut_object_is_huffman_encoder(object));
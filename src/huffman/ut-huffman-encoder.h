@@ -19,6 +19,17 @@ UtObject *ut_huffman_encoder_new(UtObject *symbol_weights);
 /// !return-type UtHuffmanEncoder
 UtObject *ut_huffman_encoder_new_canonical(UtObject *code_widths);
 
+/// Creates a new Huffman encoder with canonical encoding using code widths
+/// generated from [symbol_weights] that are no more than [max_code_width] bits.
+/// Symbols with zero weight have no code, unless required to make a code with
+/// at least two symbols.
+///
+/// !arg-type symbol_weights UtFloat64List
+/// !return-ref
+/// !return-type UtHuffmanEncoder
+UtObject *ut_huffman_encoder_new_length_limited(UtObject *symbol_weights,
+                                                size_t max_code_width);
+
 /// Gets the code for [symbol] returning the value in [code] and [code_width].
 void ut_huffman_encoder_get_code(UtObject *object, uint16_t symbol,
                                  uint16_t *code, size_t *code_width);
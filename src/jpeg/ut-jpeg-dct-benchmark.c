@@ -0,0 +1,82 @@
+#include <stdio.h>
+
+#include "ut-benchmark.h"
+#include "ut-jpeg.h"
+#include "ut.h"
+
+// Measures the speed of the forward and inverse DCT in megapixels per second.
+
+#define N_DATA_UNITS 4096
+#define N_ITERATIONS 100
+
+// Make coefficients with [n_coefficients] non-zero AC values, with the low
+// frequencies most likely to be used as in typical images.
+static void make_coefficients(int16_t *data_units, size_t n_coefficients) {
+  for (size_t i = 0; i < N_DATA_UNITS; i++) {
+    int16_t *encoded_data_unit = data_units + i * 64;
+    for (size_t j = 0; j < 64; j++) {
+      encoded_data_unit[j] = 0;
+    }
+    encoded_data_unit[0] = ut_benchmark_get_random() % 2048 - 1024;
+    for (size_t j = 0; j < n_coefficients; j++) {
+      size_t u = ut_benchmark_get_random() % 4;
+      size_t v = ut_benchmark_get_random() % 4;
+      encoded_data_unit[v * 8 + u] = ut_benchmark_get_random() % 256 - 128;
+    }
+  }
+}
+
+static void print_result(const char *name, double duration) {
+  printf("%-16s %7.1f megapixels/s\n", name,
+         N_DATA_UNITS * N_ITERATIONS * 64 / duration / 1e6);
+}
+
+static void benchmark_inverse_dct(const char *name, size_t n_coefficients) {
+  static int16_t data_units[N_DATA_UNITS * 64];
+  make_coefficients(data_units, n_coefficients);
+
+  int16_t data_unit[64];
+  int32_t total = 0;
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_ITERATIONS; i++) {
+    for (size_t j = 0; j < N_DATA_UNITS; j++) {
+      jpeg_inverse_dct(data_units + j * 64, 8, data_unit);
+      total += data_unit[0];
+    }
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  // Use the result so the transform isn't optimized away.
+  ut_assert_true(total != 0x7fffffff);
+  print_result(name, duration);
+}
+
+static void benchmark_dct() {
+  static int16_t data_units[N_DATA_UNITS * 64];
+  for (size_t i = 0; i < N_DATA_UNITS * 64; i++) {
+    data_units[i] = ut_benchmark_get_random() % 256 - 128;
+  }
+
+  int32_t encoded_data_unit[64];
+  int32_t total = 0;
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_ITERATIONS; i++) {
+    for (size_t j = 0; j < N_DATA_UNITS; j++) {
+      jpeg_dct(data_units + j * 64, 8, encoded_data_unit);
+      total += encoded_data_unit[0];
+    }
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  ut_assert_true(total != 0x7fffffff);
+  print_result("DCT", duration);
+}
+
+int main(int argc, char **argv) {
+  benchmark_inverse_dct("IDCT (DC only)", 0);
+  benchmark_inverse_dct("IDCT (sparse)", 4);
+  benchmark_inverse_dct("IDCT (dense)", 64);
+  benchmark_dct();
+
+  return 0;
+}
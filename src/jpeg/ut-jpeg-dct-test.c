@@ -0,0 +1,186 @@
+#include <math.h>
+
+#include "ut-benchmark.h"
+#include "ut-jpeg.h"
+#include "ut.h"
+
+#define PI 3.14159265358979323846
+
+// 1/√2
+#define SQRT1_2 0.70710678118654752440
+
+// Reference DCT, using the formula in ITU T.81 A.3.3.
+static void reference_dct(const int16_t *data_unit, double *encoded_data_unit) {
+  for (size_t v = 0; v < 8; v++) {
+    for (size_t u = 0; u < 8; u++) {
+      double sum = 0.0;
+      for (size_t y = 0; y < 8; y++) {
+        for (size_t x = 0; x < 8; x++) {
+          sum += data_unit[(y * 8) + x] * cos((2 * x + 1) * u * PI / 16) *
+                 cos((2 * y + 1) * v * PI / 16);
+        }
+      }
+      double cu = u == 0 ? SQRT1_2 : 1.0;
+      double cv = v == 0 ? SQRT1_2 : 1.0;
+      encoded_data_unit[(v * 8) + u] = 0.25 * cu * cv * sum;
+    }
+  }
+}
+
+// Reference inverse DCT, using the formula in ITU T.81 A.3.3.
+static void reference_inverse_dct(const int16_t *encoded_data_unit,
+                                  double *data_unit) {
+  for (size_t y = 0; y < 8; y++) {
+    for (size_t x = 0; x < 8; x++) {
+      double sum = 0.0;
+      for (size_t v = 0; v < 8; v++) {
+        for (size_t u = 0; u < 8; u++) {
+          double cu = u == 0 ? SQRT1_2 : 1.0;
+          double cv = v == 0 ? SQRT1_2 : 1.0;
+          sum += cu * cv * encoded_data_unit[(v * 8) + u] *
+                 cos((2 * x + 1) * u * PI / 16) *
+                 cos((2 * y + 1) * v * PI / 16);
+        }
+      }
+      data_unit[(y * 8) + x] = 0.25 * sum;
+    }
+  }
+}
+
+// Reference inverse DCT producing [size]x[size] samples from the low frequency
+// coefficients.
+static void reference_scaled_inverse_dct(const int16_t *encoded_data_unit,
+                                         size_t size, double *data_unit) {
+  for (size_t y = 0; y < size; y++) {
+    for (size_t x = 0; x < size; x++) {
+      double sum = 0.0;
+      for (size_t v = 0; v < size; v++) {
+        for (size_t u = 0; u < size; u++) {
+          double cu = u == 0 ? SQRT1_2 : 1.0;
+          double cv = v == 0 ? SQRT1_2 : 1.0;
+          sum += cu * cv * encoded_data_unit[(v * 8) + u] *
+                 cos((2 * x + 1) * u * PI / (2 * size)) *
+                 cos((2 * y + 1) * v * PI / (2 * size));
+        }
+      }
+      data_unit[(y * size) + x] = 0.25 * sum;
+    }
+  }
+}
+
+static void check_dct(const int16_t *data_unit, size_t precision) {
+  int32_t encoded_data_unit[64];
+  jpeg_dct(data_unit, precision, encoded_data_unit);
+  double expected_data_unit[64];
+  reference_dct(data_unit, expected_data_unit);
+  for (size_t i = 0; i < 64; i++) {
+    ut_assert_true(fabs(encoded_data_unit[i] / 8.0 - expected_data_unit[i]) <=
+                   1.0);
+  }
+}
+
+static void check_inverse_dct(const int16_t *encoded_data_unit,
+                              size_t precision) {
+  int16_t data_unit[64];
+  jpeg_inverse_dct(encoded_data_unit, precision, data_unit);
+  double expected_data_unit[64];
+  reference_inverse_dct(encoded_data_unit, expected_data_unit);
+  for (size_t i = 0; i < 64; i++) {
+    ut_assert_true(fabs(data_unit[i] - round(expected_data_unit[i])) <= 1.0);
+  }
+}
+
+static void check_scaled_inverse_dct(const int16_t *encoded_data_unit,
+                                     size_t size, size_t precision) {
+  int16_t data_unit[64];
+  jpeg_inverse_dct_scaled(encoded_data_unit, size, precision, data_unit);
+  double expected_data_unit[64];
+  reference_scaled_inverse_dct(encoded_data_unit, size, expected_data_unit);
+  for (size_t i = 0; i < size * size; i++) {
+    ut_assert_true(fabs(data_unit[i] - round(expected_data_unit[i])) <= 1.0);
+  }
+}
+
+// Check the transform and its inverse return [data_unit]. Higher precisions
+// keep fewer bits between the passes, so have slightly larger errors.
+static void check_round_trip(const int16_t *data_unit, size_t precision) {
+  int max_error = precision > 8 ? 2 : 1;
+  int32_t encoded_data_unit[64];
+  jpeg_dct(data_unit, precision, encoded_data_unit);
+  int16_t coefficients[64];
+  for (size_t i = 0; i < 64; i++) {
+    coefficients[i] = (encoded_data_unit[i] + 4) >> 3;
+  }
+  int16_t decoded_data_unit[64];
+  jpeg_inverse_dct(coefficients, precision, decoded_data_unit);
+  for (size_t i = 0; i < 64; i++) {
+    ut_assert_true(abs(decoded_data_unit[i] - data_unit[i]) <= max_error);
+  }
+}
+
+static void test_precision(size_t precision) {
+  int32_t range = 1 << precision;
+
+  // Samples over the full range.
+  for (size_t i = 0; i < 1000; i++) {
+    int16_t data_unit[64];
+    for (size_t j = 0; j < 64; j++) {
+      data_unit[j] = ut_benchmark_get_random() % range - range / 2;
+    }
+    check_dct(data_unit, precision);
+    check_round_trip(data_unit, precision);
+  }
+
+  // Samples only at the limits of the range, which give the largest
+  // intermediate values.
+  for (size_t i = 0; i < 1000; i++) {
+    int16_t data_unit[64];
+    for (size_t j = 0; j < 64; j++) {
+      data_unit[j] =
+          ut_benchmark_get_random() % 2 == 0 ? -range / 2 : range / 2 - 1;
+    }
+    check_dct(data_unit, precision);
+    check_round_trip(data_unit, precision);
+  }
+
+  // Coefficients with varying numbers of non-zero values, including only DC.
+  int32_t dc_range = range * 8;
+  int32_t ac_range = range * 2;
+  for (size_t i = 0; i < 1000; i++) {
+    int16_t encoded_data_unit[64] = {0};
+    encoded_data_unit[0] = ut_benchmark_get_random() % dc_range - dc_range / 2;
+    size_t n_coefficients = i % 64;
+    for (size_t j = 0; j < n_coefficients; j++) {
+      encoded_data_unit[ut_benchmark_get_random() % 64] =
+          ut_benchmark_get_random() % ac_range - ac_range / 2;
+    }
+    check_inverse_dct(encoded_data_unit, precision);
+    check_scaled_inverse_dct(encoded_data_unit, 4, precision);
+    check_scaled_inverse_dct(encoded_data_unit, 2, precision);
+    check_scaled_inverse_dct(encoded_data_unit, 1, precision);
+  }
+
+  // Coefficients of the largest magnitude, as decoded from corrupt images
+  // using quantization values of 255. The samples are meaningless, but the
+  // transforms must not overflow.
+  int16_t large_coefficients[] = {INT16_MIN, -128 * 255, 128 * 255,
+                                  INT16_MAX};
+  for (size_t i = 0; i < 1000; i++) {
+    int16_t encoded_data_unit[64];
+    for (size_t j = 0; j < 64; j++) {
+      encoded_data_unit[j] = large_coefficients[ut_benchmark_get_random() % 4];
+    }
+    int16_t data_unit[64];
+    jpeg_inverse_dct(encoded_data_unit, precision, data_unit);
+    jpeg_inverse_dct_scaled(encoded_data_unit, 4, precision, data_unit);
+    jpeg_inverse_dct_scaled(encoded_data_unit, 2, precision, data_unit);
+    jpeg_inverse_dct_scaled(encoded_data_unit, 1, precision, data_unit);
+  }
+}
+
+int main(int argc, char **argv) {
+  test_precision(8);
+  test_precision(12);
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures how JPEG decoding scales with the number of worker threads.
+// Decodes the file given on the command line, or a generated 24 megapixel
+// image with a restart marker every MCU row if none.
+
+#define WIDTH 6000
+#define HEIGHT 4000
+
+// Generate a greyscale image with smooth areas, edges and noise.
+static UtObject *make_jpeg() {
+  UtObjectRef image_data = ut_uint8_array_new_sized(WIDTH * HEIGHT);
+  uint8_t *d = ut_uint8_list_get_writable_data(image_data);
+  for (size_t y = 0; y < HEIGHT; y++) {
+    for (size_t x = 0; x < WIDTH; x++) {
+      size_t value = (x / 4 + y / 8) % 192 + ((x / 64 + y / 64) % 2) * 32;
+      d[y * WIDTH + x] = value + ut_benchmark_get_random() % 16;
+    }
+  }
+  UtObjectRef image = ut_jpeg_image_new(
+      WIDTH, HEIGHT, UT_JPEG_DENSITY_UNITS_NONE, 1, 1, 1, image_data);
+
+  UtObject *data = ut_uint8_array_new();
+  UtObjectRef encoder = ut_jpeg_encoder_new(image, data);
+  ut_jpeg_encoder_set_restart_interval(encoder, (WIDTH + 7) / 8);
+  ut_jpeg_encoder_encode(encoder);
+  return data;
+}
+
+static void done_cb(UtObject *object) { ut_event_loop_return(NULL); }
+
+static void benchmark(UtObject *data, size_t n_threads, UtObject *serial_image,
+                      double serial_rate) {
+  UtObjectRef dummy_object = ut_null_new();
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef decoder = ut_jpeg_decoder_new_parallel(n_threads, data);
+  ut_jpeg_decoder_decode(decoder, dummy_object, done_cb);
+  UtObjectRef result = ut_event_loop_run();
+  double duration = ut_benchmark_get_time() - start;
+  ut_assert_null_object(ut_jpeg_decoder_get_error(decoder));
+  UtObject *image = ut_jpeg_decoder_get_image(decoder);
+  ut_assert_equal(ut_jpeg_image_get_data(image),
+                  ut_jpeg_image_get_data(serial_image));
+
+  double rate = ut_jpeg_image_get_width(image) *
+                ut_jpeg_image_get_height(image) / duration / 1e6;
+  printf("%2zi threads: %7.1f megapixels/s (%.2fx)\n", n_threads, rate,
+         rate / serial_rate);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef data = NULL;
+  if (argc > 1) {
+    data = ut_memory_mapped_file_new(argv[1]);
+    ut_file_open_read(data);
+  } else {
+    data = make_jpeg();
+  }
+
+  double start = ut_benchmark_get_time();
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_jpeg_decoder_new(data_stream);
+  UtObjectRef image = ut_jpeg_decoder_decode_sync(decoder);
+  ut_assert_is_not_error(image);
+  double duration = ut_benchmark_get_time() - start;
+  size_t width = ut_jpeg_image_get_width(image);
+  size_t height = ut_jpeg_image_get_height(image);
+  double serial_rate = width * height / duration / 1e6;
+  printf("%zix%zi image, %zi bytes\n", width, height,
+         ut_list_get_length(data));
+  printf("    serial: %7.1f megapixels/s\n", serial_rate);
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (size_t n_threads = 1; n_threads < (size_t)n_cpus; n_threads *= 2) {
+    benchmark(data, n_threads, image, serial_rate);
+  }
+  benchmark(data, n_cpus, image, serial_rate);
+
+  return 0;
+}
@@ -73,3 +73,126 @@ const char *ange_albertini_image_data =
     "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"
     "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff";
 // clang-format on
+
+// Python logo from the CPython test suite (Lib/test/imghdrdata/python.jpg)
+
+const char *python_logo_data =
+    "ffd8ffe000104a46494600010101000100010000ffdb0043000302020202020302020203"
+    "03030304060404040404080606050609080a0a090809090a0c0f0c0a0b0e0b09090d110d"
+    "0e0f101011100a0c12131210130f101010ffdb00430103030304030408040408100b090b"
+    "101010101010101010101010101010101010101010101010101010101010101010101010"
+    "1010101010101010101010101010ffc00011080010001003012200021101031101ffc400"
+    "160001010100000000000000000000000000070405ffc400241000010401040202030000"
+    "0000000000000102030406050708121311220014093132ffc40015010101000000000000"
+    "00000000000000000006ffc4002311000102050305000000000000000000000102110304"
+    "05062100123115166181e1ffda000c03010002110311003f0014a6d26a1b73c1e61312d4"
+    "951cf31163e42565beba5aec694540b1e520b254a51fd2cab8faf220ab963d976c9335e6"
+    "9b77d7e66da71781a5571c7f1cea71e24b39d7e32253f21a69ded4714a38b482e84b892a"
+    "71691ecd2d213bf1efb91a74aceea15a758ed548ac655b858b81857b21299867a96b94b9"
+    "49654fb9c88529114b812af07ad9f23c807e55be0df662a140cce8e69a3d5cb743b3d77a"
+    "6558b1d9512188bf64b8d3f1c3680429c0d0febb3c02e03c5407b4bdd97b54e627fb6edf"
+    "9460148262138db8529828370589727960e432896fc3828ea7528cea208dbe78191f07ad"
+    "7fffd9";
+
+// clang-format off
+const char *python_logo_image_data =
+    "0002080000050100040004106582a05884ab4f7fad497bac4976af436b9c41637e000613000106030000000200000200"
+    "00050d00030b0001090003126586a5d8ffff5083ae4074a33f6da1436c9a4d6c89000413000105010000000100010600"
+    "00030b00040e00091900071e5782a24b7fa4427a9f437aa13b6b99456b98405d7f000219000309030804000200000501"
+    "000b1f6a8aa15f84a15782a54d7fa4427a9f336f942b668e396e9a3c66904a6286000713010300070300090700050200"
+    "5590b85288b45684b6507eb2447aa83a77a33675a131709c2a67933e6e9449617d000200efde8ef6de7ee5d194110000"
+    "4a8dc24d8cc14f84ba4a7db24176a8427ba838729a346b92386e944169824d5d5c0f0900fbde69fbd856e9ce77180000"
+    "578bc54b83b64882a8437ba04070a1446f9c3e6a8741677e43627e45585c080600ddcb69f6d44cfcd64ff0d375190100"
+    "4e80b54e82b1427b9947799047677e1c323f000700000a00000700060800d2c463f7db56ffdb44f3ce41eacd671c0300"
+    "4983ab437ba0487999456771000600e3dea6f1e696f0e482f1e67aeee065f8dd52fcd941f8d231f2ce3aecd0621b0400"
+    "467f9d4b7e9d49708d223634dfde9efbe882ffe46cffe35af8dd48fddf43f9d235ffd737fad12bf4d03ed6be541a0800"
+    "497894466e88506880000400f4ec97ffec6fffdf5affda4fffd847ffd743ffd239fbc628fbcb29f3cd44ae99460f0300"
+    "00061b000a1c000212090900f5e784f7dd52ffdd4ef0c133efc034eebf33edbc33e9bb34dfb837b89b35120100140600"
+    "00000b000209000306070300efdd71ffe755ffdc46fdd542f7d148f1cf51e8c8571e05001103001105001402000e0000"
+    "070000040000040301080200f6e27ff9dc5af4d24df8d553efd155ffff95d9c56e0e04000404000001000700020d0006"
+    "060201030200010000070100dccb85e4cd6feed175ebcc6fe7ce6ad5c067aa9b5a090400000300010707000004010005"
+    "0001000000000100020701001405001704001b01001d02001b03001906000f0200060200000300000304000105000106";
+// clang-format on
+
+const char *python_logo_half_image_data =
+    "00030c0005176f97ba5483ad4e759e193451000207020300"
+    "0922362a4a63527fa63d6d95466985263d450104000f0800"
+    "5d8db55e8fb84377a64a789a5a777b1f290ee9dda16a5506"
+    "4e83ad48799a365c6f163027262f029b934afff99c715400"
+    "5c85a13c5a5c9da373fef098ffe76eebcd4bffeb7a735400"
+    "233d4c202d1ce8d88aeacc52e7c235e0bb36d4b8573c2500"
+    "0002050a0800f9e697fff184fffb90917b250f01000a0000"
+    "0302000d0600695202705700705800332300070000030104";
+
+const char *python_logo_quarter_image_data =
+    "002447618295485649010600"
+    "6484933e5656616648928f62"
+    "4d573fd1d5b0efe4a68b792f"
+    "0908009790598673261c0300";
+
+const char *python_logo_eighth_image_data =
+    "585d3d4f5434"
+    "6c7151707555";
+
+const char *ange_albertini_eighth_image_data =
+    "fffffffffffffffffffffffffe"
+    "ffffff00ff0000fefefe0000ff"
+    "ffffff00ff00ff00ff00ffffff"
+    "ffffff00ff0000ffff000000ff"
+    "ff01ff00ff00ffffff00ff00ff"
+    "fffe00ffff00ffffffff0000ff"
+    "ffffffffffffffffffffffffff";
+
+// Generated 4:2:0 image with a restart marker every two MCUs.
+
+const char *restart_data =
+    "ffd8ffe000104a46494600010100000100010000ffdb008400100b0c0e0c0a100e0d0e12"
+    "11101318281a181616183123251d283a333d3c3933383740485c4e404457453738506d51"
+    "575f626768673e4d71797064785c656763011112121815182f1a1a2f6342384263636363"
+    "636363636363636363636363636363636363636363636363636363636363636363636363"
+    "63636363636363636363ffdd00040002ffc00011080018002803012200021101031101ff"
+    "c401a20000010501010101010100000000000000000102030405060708090a0b10000201"
+    "0303020403050504040000017d01020300041105122131410613516107227114328191a1"
+    "082342b1c11552d1f02433627282090a161718191a25262728292a3435363738393a4344"
+    "45464748494a535455565758595a636465666768696a737475767778797a838485868788"
+    "898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8"
+    "c9cad2d3d4d5d6d7d8d9dae1e2e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9fa0100030101"
+    "010101010101010000000000000102030405060708090a0b110002010204040304070504"
+    "0400010277000102031104052131061241510761711322328108144291a1b1c109233352"
+    "f0156272d10a162434e125f11718191a262728292a35363738393a434445464748494a53"
+    "5455565758595a636465666768696a737475767778797a82838485868788898a92939495"
+    "969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5"
+    "d6d7d8d9dae2e3e4e5e6e7e8e9eaf2f3f4f5f6f7f8f9faffda000c03010002110311003f"
+    "00d85e6a45150a1ab095f3d430ded0e45a0f54f6a90474d322a1c753e940676ef8fa5753"
+    "c3d183e5b5df91bc6e7fffd0ea3cb00738146c4fef0fce9802afde38a5dd1ff7bf4af1fd"
+    "8c16f14bd595a9951355832ec518ea6aac552cbfc15d343dcc3b9477ff00827325a9ffd1"
+    "da8ba734f1292709c0f5a8d7ee37d3fa51175ae2e451e58474b9515d49832a71d4fa52f9"
+    "dfec7eb5137fad34b595acdc63a24dad97ea6d63ffd9";
+
+// clang-format off
+const char *restart_image_data =
+    "82e80082e80085e70086e80089e6018be6028de6028fe40292e40496e40598e4089ce3099fe50ba2e50ca4e50da6e705a5e500a7e600aae700abe800afe700b1e900b5e800b7e700bae704bce609c0e412c0e219c3e121c4e127c6df2cc8df2cc8d81dcbda1bcddd1bcfdf1dd0e01dd1e11cd0e01bd0e119"
+    "82e80084e80085e70086e70189e6018be6038de5038fe40392e40696e30998e30a9ce30d9fe40fa2e410a4e411a6e60ca8e502abe600ace700aee800b1e904b4e907b6e809b9e80ebbe612bde515bfe41bc2e322c3e225c4e22cc6e22ec9e02dd0e329d3e426d6e528d6e729d7e629d5e628d5e427d3e426"
+    "83e60083e60085e60086e70289e6028be6058ee60890e40893e40b97e30d99e3109de313a0e415a1e516a4e519a6e51cabe423ade427aee528b1e529b4e62bb6e72cb9e72dbbe72ebbe52cbde52dc0e32fc2e330c3e431c5e431c7e432c8e42fd5e932d7ea30daea32d8ea34dae938d6e739d7e43cd4e43c"
+    "83e40083e40084e50286e5038ae6078ce60a8fe60c91e40e94e41397e21599e2179ce31b9fe31ea2e420a5e423a5e32aaae13babe143aee144b0e147b4e24bb6e24db8e24ebbe34fbce24fbfe34fc0e24dc2e34ac5e449c5e448c7e545cae445d2e347d4e34ad5e44dd7e550d7e554d7e359d6e25cd5e05d"
+    "83e20083e20085e40488e4078ae50a8ce50f90e61392e41695e31b98e11e9ae1219de227a0e229a2e32da4e330a6e137a8e049aadf53acde57adde5eb1df65b3de6ab6de6eb8dd73bde177bfe075c1e174c3e171c5e26ec7e36cc9e368cbe26dceda74d3da7dd6dd80d8de84dae08adbe08cdbe090dbe090"
+    "84e00384e00386e10688e30a8be4108fe41592e51b93e31e95e22497e1289ae12d9ce0319fe137a2e13aa3e23ca5e145a7e051a8e05babdf61adde69afde76b1dd7eb5db86b8da8dbfdf96c0de96c3de97c4de94c7df91c9e08ec9e18dcde091d4dca0d7dca6d9dea8dce1abdde2acdee3addde2acdde2aa"
+    "84de0385df0486df0789e20e8de21390e41c92e32294e32896e12e98e0349bdf3a9ddf419fe046a1e04ba2e04da5e050aae557abe55bade465aee36fb2e27fb4e08bb6de98b9dca2c0ddadc1dcb3c3dcb4c6dcb5c7dcb3cadcb2cbdeb1cddcb1d9e1bcdbdfbcdce0bbdce1b8dae0b2d8dfacd6dda7d5dda2"
+    "85dc0484dd0788de0b8be0138de11991e22394e22a95e23296df3897de4099de479cdd4d9ede54a0de59a1de5da3de5eabe666ace769afe573b1e67eb5e38bb6e297bae0a3bcdeacbfddb7c2ddbcc4dbbec5dcbfc9dcbec9dcbcccddbbcddeb4dae4b2dbe4abdae4a8d7e1a2d4df9bcfdb91cbd889c9d684"
+    "85d90785db0a88db0f8adc158cdd1e8ede2591de3092dd3896dd4397dc4d9adc569cdd5f9ede66a2de6ca4df71a6df76a9e07babe181b0e289b2e391b7e29ab7e1a1b8dea5b9dba9bfdfb0c1deb2c4ddb3c5dfb0cae0b1cbe2aecee3abd0e69ebfd16dc1d461c2d561c4d761c6da61c8dc61cadf60cbe061"
+    "85d80a86d90d88da138adb1a8cdc238edd2c91dc3791db4096db4d97da579ada629cda6d9edb74a0dc7ca2dd81a5dc8babdc9baddaa3afdaa4b1dca6b5dda8b9e0a9bde3aac1e4aac5e4a8c4e2a2c3e19bc2de94c0db8cc0d985bdd780bed771c1d854c4da47c5db4ac6dc4bc8de4fc9de51cadf54cadf54"
+    "85d60b86d70e88d8158ad91c8cda268eda3092d93d93d84996d95697d86299d86f9bd8799dd8849fd98ca1db91a5d7a2b0d7c4b0d3cdb1d2c7b3d4bfb6d9b8bbdfb1c3e5a9c8eaa0bee08abee07fbdde73bbdc67b9d95eb7d655b4d351b6d249c6dc49c8dc45c9dd48cbde50ccde56cdde5ecedd66cfdd6b"
+    "87d50d86d71089d61689d71f8cd92b8ed93691d74392d64f96d75f97d66d99d6799bd6869dd6919fd79aa1d89fa5d4b2b3d4d9b6d1e4b7d2d9b7d5cbbad8bcbcdcabbfe099c1e488afd367b2d65cb3d753b6d84db8d94abada49bddb49bed94ac9db55cdd959cfdb5fd1dc66d4dd70d7df7cd8de86d9de8a"
+    "87d30e87d41289d4188ad5228dd62d8fd63a90d54791d35594d76695d57497d48499d4909bd59b9dd5a49fd6aca3d3bbb5d3ddb8d2e3bcd6d7bdd8c7bdd9b0b9d895b5d67bb4d666accf51b0d24ab3d449b8d74bbeda51c1dd55c4dd5bc9dc68cdd379d0d386d2d489d6d791d9d999dcdba2dfddaae0deae"
+    "86d20e87d21389d31a8bd4238cd5308ed43d90d44b91d25a94d66c95d47b97d38b99d3989bd3a49dd4ad9ed5b5a3d3bdb5d5d0bad3cfbad6c0b9d5acb6d592b1d277aed05fabce4eb6d84eb8d94ebcd752bfd859c1d864c5d86fc8d77acad587d1d098d3cfa2d7d0a4d6d2a5dbd4a8dad6a9ded7abddd9ac"
+    "88d11088d11288d2198ad3248cd2318ed23d8fd24e90d15d94d57195d38097d29099d29d9ad3aa9cd3b49ed4bca3d3b9b7dab9b9d6a6b2d293accd7ca9cc64aace54acd048b0d343bcdc4dbfda55c1d864c4d575c7d389c8d19acacea9cecdafd7d0b4d8cfb2d8cdadd5cda6d4cc9dd2cd93d1cc8ad0ce84"
+    "88cf1389d0148ad2168cd2218cd2348ed1468fd15390d06296d27a97d08c99cea29ccdaf9ecfb1a0d0b8a2d1c1a9d2b2bee096b9d976adce63a3c652a1c34aa6c949b0d14eb7d655b9d55ebcd369c1d179c6d08bcbce9fcfceafd3cebbd7cfb8ded7a3ded695dbd28dd5ce88d1c887cbc480c8c077c5bf71"
+    "84c41585c61086cd0788ce148bcc3a8dcd528ecf5990ce6995cd8497c79d99c2bc9ec4c7a7ccbbaed1bdb0cfcab6d2aca5c349aaca29adcc33aecd41b0cf50b0ce5eb1cc6bb2c977b5c984b9c88dc1c998c9caa0d2cca8d8cdadddd0b0e0d597c3bf42c7c82ecdcc34d1ce49d5cb6ad4c87ed4c486d2c388"
+    "84c21784c51187cb0488ce148bc9408ec95b8fcd6290cb6f96ca8c98c4a99cc0cea3c2d4aacbbaaeccb4b1c8c2b4cb9fa7c139acc919afcb2bb0cd3fb1cc57b2cb6db3c980b4c88db8c89bbdc8a0c5c9a6cdcba5d2caa3d5c89ed5c496d5c879c9c337cbca20cecd25d2cd3ed6c96dd9c68cdcc6a1ddc5a9"
+    "83c11883c41286ca0586cb168ac7468dc7638dc9698fc87794c69198c3afa0c1d2a6c3d1a9c9b1a9c9a2a8c2a9aac290a5bc47aac230aec541afc853b2ca6ab4cb7db5c98ab6c992bfcd9cc3cc9dc6cc9ccaca96cbc68ecac083c8ba7bc6b96bcdc15dcec451cfc651d2c565d7c391dcc2b3e0c3c8e3c4d4"
+    "81bf1683c21384c70686c81c89c44e8bc36a8ec5728dc48092c29898c2b4a1c2d3a6c4cea5c7a2a2c38c9fbc8ea1bb7ea3b754a9bc49adbf5bb0c26cb4c57fb6c88eb8c995b9c99ac2ce9cc3cc95c2c88ac1c27ec1bd74c2bb6dc3b869c4b66bd0be7cd2c17bd5c671d7c77cdac49ddbc1b4dcbfc3dcbeca"
+    "82bd1781bf1283c50b84c52187c0578ac0758cc17d8ec08b91bea198bfbaa1c2d3a4c3c6a1c3909abf7298b9729bb76da3b464a9b667adba75b0bd85b5c095b8c49ebac6a2bcc79dc1cb97bec788b8be74b6b865b7b55ebeb95dc5be63ccbe75d2bc95d6be9adac782ddcb7fdcc88dd8c291d3bc92cfb88f"
+    "80bb1582bd1382c20c85c22687bd5f89bb808cbc8a8cbc968fbaa997bdbea0bfd3a0bebc9abe7e95ba5b94b8589ab65fa4b56faab37caeb78ab2b998b7bca5babfa9bbc1a7bcc49fb9c28db7be7ab3b866b1b459b5b555bfba5ccac368d3c481d4bba7d7bca7d8c581d9c972d6c575d0be74cbb874c7b472"
+    "80b81580bb1381c00f84c02c85b96688b7898bb9948cb8a18fb6b198bac39fbbd09cbab295ba6d90b84693b9429bba53a6b773abb487afb697b3b8a4b6b9aeb9bbb0babdaabcc09db0b57db2b66cb4b760b6b759bbba5dc4be66cac271d0c188d7bbafd5b9a4d1be71cdbe57cabb56cab95fcbb76ecbb673"
+    "7fb71480bb1382be1183be2e87b76b88b58e8ab79a8bb6a58eb5b497b9c59db9ce99b7ad91b7648eb63c93ba399ebb4da8b975adb58eb0b59eb3b7a9b7b8b3b8b9b3babbabbcbd9ba9ac75afb166b5b85fbdbf5ec4c065c6c26bc8bf74caba87d8bbb3d3b7a2c9b765c1b442c0b245c5b553cdba6dd3be7b";
+// clang-format on
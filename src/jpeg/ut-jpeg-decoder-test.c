@@ -14,8 +14,104 @@ static void check_jpeg(const char *hex_data, size_t width, size_t height,
   ut_assert_uint8_list_equal_hex(ut_jpeg_image_get_data(image), hex_image_data);
 }
 
+static void check_scaled_jpeg(const char *hex_data, size_t scale, size_t width,
+                              size_t height, size_t n_components,
+                              const char *hex_image_data) {
+  UtObjectRef data = ut_uint8_list_new_from_hex_string(hex_data);
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_jpeg_decoder_new_with_scale(scale, data_stream);
+  UtObjectRef image = ut_jpeg_decoder_decode_sync(decoder);
+  ut_assert_is_not_error(image);
+  ut_assert_int_equal(ut_jpeg_image_get_width(image), width);
+  ut_assert_int_equal(ut_jpeg_image_get_height(image), height);
+  ut_assert_int_equal(ut_jpeg_image_get_n_components(image), n_components);
+  ut_assert_uint8_list_equal_hex(ut_jpeg_image_get_data(image), hex_image_data);
+}
+
+static size_t next_row = 0;
+
+static void row_cb(UtObject *object, size_t row, UtObject *data) {
+  ut_assert_int_equal(row, next_row);
+  next_row++;
+  ut_list_append_list(object, data);
+}
+
+static void check_jpeg_rows(const char *hex_data, size_t width, size_t height,
+                            size_t n_components, const char *hex_image_data) {
+  UtObjectRef data = ut_uint8_list_new_from_hex_string(hex_data);
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_jpeg_decoder_new(data_stream);
+  UtObjectRef rows = ut_uint8_array_new();
+  next_row = 0;
+  ut_jpeg_decoder_set_row_callback(decoder, rows, row_cb);
+  UtObjectRef image = ut_jpeg_decoder_decode_sync(decoder);
+  ut_assert_is_not_error(image);
+  ut_assert_int_equal(ut_jpeg_image_get_width(image), width);
+  ut_assert_int_equal(ut_jpeg_image_get_height(image), height);
+  ut_assert_int_equal(ut_jpeg_image_get_n_components(image), n_components);
+  ut_assert_int_equal(ut_list_get_length(ut_jpeg_image_get_data(image)), 0);
+  ut_assert_int_equal(next_row, height);
+  ut_assert_uint8_list_equal_hex(rows, hex_image_data);
+}
+
+// Number of parallel decodings still running.
+static size_t n_parallel_running = 0;
+
+static void parallel_done_cb(UtObject *object) {
+  n_parallel_running--;
+  if (n_parallel_running == 0) {
+    ut_event_loop_return(NULL);
+  }
+}
+
+static UtObject *start_parallel_jpeg(const char *hex_data, size_t n_threads) {
+  UtObjectRef data = ut_uint8_list_new_from_hex_string(hex_data);
+  UtObject *decoder = ut_jpeg_decoder_new_parallel(n_threads, data);
+  ut_jpeg_decoder_decode(decoder, decoder, parallel_done_cb);
+  n_parallel_running++;
+  return decoder;
+}
+
+static void check_parallel_jpeg(UtObject *decoder, size_t width, size_t height,
+                                size_t n_components,
+                                const char *hex_image_data) {
+  ut_assert_null_object(ut_jpeg_decoder_get_error(decoder));
+  UtObject *image = ut_jpeg_decoder_get_image(decoder);
+  ut_assert_int_equal(ut_jpeg_image_get_width(image), width);
+  ut_assert_int_equal(ut_jpeg_image_get_height(image), height);
+  ut_assert_int_equal(ut_jpeg_image_get_n_components(image), n_components);
+  ut_assert_uint8_list_equal_hex(ut_jpeg_image_get_data(image), hex_image_data);
+}
+
+static void test_parallel() {
+  UtObjectRef restart_decoder1 = start_parallel_jpeg(restart_data, 1);
+  UtObjectRef restart_decoder4 = start_parallel_jpeg(restart_data, 4);
+  UtObjectRef python_logo_decoder = start_parallel_jpeg(python_logo_data, 2);
+  ut_event_loop_run();
+  ut_assert_int_equal(n_parallel_running, 0);
+
+  check_parallel_jpeg(restart_decoder1, 40, 24, 3, restart_image_data);
+  check_parallel_jpeg(restart_decoder4, 40, 24, 3, restart_image_data);
+  check_parallel_jpeg(python_logo_decoder, 16, 16, 3, python_logo_image_data);
+}
+
 int main(int argc, char **argv) {
   check_jpeg(ange_albertini_data, 104, 56, 1, ange_albertini_image_data);
+  check_jpeg(python_logo_data, 16, 16, 3, python_logo_image_data);
+  check_jpeg(restart_data, 40, 24, 3, restart_image_data);
+
+  check_scaled_jpeg(ange_albertini_data, 8, 13, 7, 1,
+                    ange_albertini_eighth_image_data);
+  check_scaled_jpeg(python_logo_data, 2, 8, 8, 3, python_logo_half_image_data);
+  check_scaled_jpeg(python_logo_data, 4, 4, 4, 3,
+                    python_logo_quarter_image_data);
+  check_scaled_jpeg(python_logo_data, 8, 2, 2, 3,
+                    python_logo_eighth_image_data);
+
+  check_jpeg_rows(ange_albertini_data, 104, 56, 1, ange_albertini_image_data);
+  check_jpeg_rows(python_logo_data, 16, 16, 3, python_logo_image_data);
+
+  test_parallel();
 
   return 0;
 }
@@ -1,6 +1,7 @@
 #include <assert.h>
-#include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ut-jpeg.h"
 #include "ut.h"
@@ -12,6 +13,10 @@
 
 #define MAX_SCAN_COMPONENTS 4
 
+// Number of tasks to split the work for each worker thread into, so threads
+// that finish early have more work to do.
+#define TASKS_PER_THREAD 4
+
 typedef enum {
   DECODER_STATE_MARKER,
   DECODER_STATE_DEFINE_QUANTIZATION_TABLE,
@@ -23,6 +28,7 @@ typedef enum {
   DECODER_STATE_DEFINE_ARITHMETIC_CODING,
   DECODER_STATE_START_OF_SCAN,
   DECODER_STATE_SCAN,
+  DECODER_STATE_PARALLEL_SCAN,
   DECODER_STATE_APP0,
   DECODER_STATE_APPLICATION_DATA,
   DECODER_STATE_COMMENT,
@@ -43,6 +49,12 @@ typedef enum {
   DECODE_MODE_LOSSLESS
 } DecodeMode;
 
+// Location of the entropy coded data between restart markers.
+typedef struct {
+  size_t start;
+  size_t end;
+} ScanInterval;
+
 typedef struct {
   // ID assigned to this component.
   uint8_t id;
@@ -69,8 +81,23 @@ typedef struct {
   // Number of data units decoded in the current MCU.
   size_t data_unit_count;
 
+  // Quantization table values, in data unit order.
+  const uint8_t *quantization_table;
+
   // Encoded image coefficients.
-  UtObject *coefficients;
+  int16_t coefficients[64];
+
+  // Size of this component in samples.
+  size_t width;
+  size_t height;
+
+  // Samples decoded in the current MCU row. The first row contains the last
+  // row of samples from the previous MCU row.
+  UtObject *samples;
+  size_t samples_stride;
+
+  // Row of samples upsampled to the image size.
+  UtObject *upsampled_row;
 } JpegComponent;
 
 typedef struct {
@@ -83,13 +110,27 @@ typedef struct {
   UtObject *callback_object;
   UtJpegDecodeCallback callback;
 
-  // Current bits being read.
-  uint8_t bit_buffer;
+  // Callback to notify when a row is decoded.
+  UtObject *row_callback_object;
+  UtJpegDecodeRowCallback row_callback;
+
+  // Current bits being read, first bit in the most significant bit.
+  uint32_t bit_buffer;
   uint8_t bit_count;
 
   // Current state of the decoder.
   DecoderState state;
 
+  // Amount the image is scaled down by (1, 2, 4 or 8).
+  size_t scale;
+
+  // Width and height of a decoded data unit in samples.
+  size_t data_unit_size;
+
+  // Maximum number of worker threads to decode with, or 0 to decode in the
+  // event loop thread.
+  size_t n_threads;
+
   // Current state of the scan decoder.
   ScanDecoderState scan_decoder_state;
 
@@ -141,14 +182,6 @@ typedef struct {
   // Order that data unit values are written.
   uint8_t data_unit_order[64];
 
-  // Precalculated cosines for DCT.
-  float dct_alpha[8];
-  float dct_cos[64];
-
-  // Last read Huffman code.
-  uint16_t code;
-  uint8_t code_width;
-
   // Magnitude of coefficient.
   uint8_t coefficient_magnitude;
 
@@ -173,6 +206,49 @@ typedef struct {
   // Number of MCUs processed.
   size_t mcu_count;
 
+  // Number of MCUs between restart markers, or 0 if not used.
+  uint16_t restart_interval;
+
+  // Number of restart markers received in the current scan.
+  size_t restart_count;
+
+  // Scan data being decoded by worker threads, and the data after it to
+  // process when complete.
+  UtObject *scan_data;
+  UtObject *remaining_data;
+
+  // Restart intervals in [scan_data].
+  ScanInterval *intervals;
+  size_t n_intervals;
+
+  // Restart intervals are decoded in segments on worker threads.
+  // [n_decoded_segments] is the number of segments from the start of the scan
+  // that have all been decoded.
+  size_t intervals_per_segment;
+  size_t n_segments;
+  size_t next_segment;
+  bool *segment_decoded;
+  size_t n_decoded_segments;
+
+  // Decoded MCU rows are converted to pixels in bands on worker threads.
+  size_t mcu_rows_per_band;
+  size_t n_bands;
+  size_t next_band;
+  size_t n_written_bands;
+
+  // Number of tasks running on worker threads.
+  size_t n_running_tasks;
+
+  // True if any component is interpolated vertically, and so needs the first
+  // row of samples from the next MCU row.
+  bool vertical_upsampling;
+
+  // Next image row to be output.
+  size_t row;
+
+  // Pixels for the current row when not writing into the image.
+  UtObject *row_data;
+
   // Density information;
   UtJpegDensityUnits density_units;
   uint16_t horizontal_pixel_density;
@@ -234,17 +310,21 @@ static JpegComponent *find_component(UtJpegDecoder *self, uint8_t id) {
   return NULL;
 }
 
+// Get the number of MCUs in the current scan.
+static size_t get_n_mcus(UtJpegDecoder *self) {
+  return self->width_in_mcus * self->height_in_mcus;
+}
+
 // Read a the next scan byte from [data] and write it to [value].
-static bool read_scan_byte(UtJpegDecoder *self, UtObject *data, size_t *offset,
+static bool read_scan_byte(UtJpegDecoder *self, const uint8_t *data,
+                           size_t data_length, size_t *offset,
                            uint8_t *value) {
-  size_t data_length = ut_list_get_length(data);
-
   size_t o = *offset;
   if (o >= data_length) {
     return false;
   }
 
-  uint8_t byte1 = ut_uint8_list_get_element(data, o++);
+  uint8_t byte1 = data[o++];
 
   // Scan data terminates on a marker. If 0xff is in the scan data, 0x00 is
   // after it so it can't be a valid marker. The 0x00 is dropped.
@@ -252,7 +332,7 @@ static bool read_scan_byte(UtJpegDecoder *self, UtObject *data, size_t *offset,
     if (o >= data_length) {
       return false;
     }
-    uint8_t byte2 = ut_uint8_list_get_element(data, o++);
+    uint8_t byte2 = data[o++];
     if (byte2 != 0x00) {
       self->state = DECODER_STATE_MARKER;
       return false;
@@ -264,161 +344,244 @@ static bool read_scan_byte(UtJpegDecoder *self, UtObject *data, size_t *offset,
   return true;
 }
 
-// Read the next bit from [data] and write it to [value].
-static bool read_scan_bit(UtJpegDecoder *self, UtObject *data, size_t *offset,
-                          uint8_t *value) {
-  if (self->bit_count == 0) {
-    if (!read_scan_byte(self, data, offset, &self->bit_buffer)) {
+// Read scan bytes from [data] until [bit_buffer] has at least [length] bits.
+static bool fill_scan_bits(UtJpegDecoder *self, const uint8_t *data,
+                           size_t data_length, size_t *offset, size_t length) {
+  while (self->bit_count < length) {
+    uint8_t byte;
+    if (!read_scan_byte(self, data, data_length, offset, &byte)) {
       return false;
     }
-    self->bit_count = 8;
+    self->bit_buffer |= (uint32_t)byte << (24 - self->bit_count);
+    self->bit_count += 8;
   }
 
-  *value = self->bit_buffer >> 7;
-  self->bit_buffer <<= 1;
-  self->bit_count--;
-
   return true;
 }
 
 // Read the next Huffman symbol from [data] using [decoder] and write it to
 // [symbol].
-static bool read_huffman_symbol(UtJpegDecoder *self, UtObject *data,
-                                size_t *offset, UtObject *decoder,
-                                uint16_t *symbol) {
-  while (true) {
-    uint8_t bit;
-    if (!read_scan_bit(self, data, offset, &bit)) {
-      return false;
-    }
-    self->code = self->code << 1 | bit;
-    self->code_width++;
-    if (ut_huffman_decoder_get_symbol(decoder, self->code, self->code_width,
-                                      symbol)) {
-      self->code = 0;
-      self->code_width = 0;
-      return true;
+static bool read_huffman_symbol(UtJpegDecoder *self, const uint8_t *data,
+                                size_t data_length, size_t *offset,
+                                UtObject *decoder, uint16_t *symbol) {
+  // Codes may be matched with fewer than 16 bits, as unused bits are zero.
+  fill_scan_bits(self, data, data_length, offset, 16);
+
+  size_t code_width = ut_huffman_decoder_lookup_msb_first(
+      decoder, self->bit_buffer >> 16, symbol);
+  if (code_width == 0) {
+    if (self->bit_count >= ut_huffman_decoder_get_max_code_width(decoder)) {
+      set_error(self, "Invalid Huffman code in JPEG scan");
     }
+    return false;
   }
+  if (code_width > self->bit_count) {
+    return false;
+  }
+
+  self->bit_buffer <<= code_width;
+  self->bit_count -= code_width;
+  return true;
 }
 
 // Read an integer of [length] bits from [data].
-static bool read_int(UtJpegDecoder *self, UtObject *data, size_t *offset,
-                     size_t length, uint16_t *value) {
-  while (self->code_width < length) {
-    uint8_t bit;
-    if (!read_scan_bit(self, data, offset, &bit)) {
-      return false;
-    }
-    // FIXME: Use bit_buffer instead of self->code
-    self->code = self->code << 1 | bit;
-    self->code_width++;
+static bool read_int(UtJpegDecoder *self, const uint8_t *data,
+                     size_t data_length, size_t *offset, size_t length,
+                     uint16_t *value) {
+  if (!fill_scan_bits(self, data, data_length, offset, length)) {
+    return false;
   }
 
-  *value = self->code;
-  self->code = 0;
-  self->code_width = 0;
+  *value = self->bit_buffer >> (32 - length);
+  self->bit_buffer <<= length;
+  self->bit_count -= length;
 
   return true;
 }
 
-static uint8_t clamp(float value) {
-  if (value < 0.0) {
-    return 0;
-  } else if (value > 255.0) {
-    return 255;
-  } else {
-    return floor(value);
+// Get the row of samples from [component] that makes up image row [y], using
+// [upsampled_row] if the samples need to be upsampled.
+static const uint8_t *get_component_row(UtJpegDecoder *self,
+                                        JpegComponent *component, size_t y,
+                                        size_t mcu_row,
+                                        uint8_t *upsampled_row) {
+  size_t horizontal_scale =
+      self->mcu_width / component->horizontal_sampling_factor;
+  size_t vertical_scale =
+      self->mcu_height / component->vertical_sampling_factor;
+
+  // The samples buffer starts with the last row from the previous MCU row.
+  size_t first_row =
+      mcu_row * component->vertical_sampling_factor * self->data_unit_size;
+  const uint8_t *samples = ut_uint8_list_get_data(component->samples);
+  size_t component_y = y / vertical_scale;
+  const uint8_t *row =
+      samples + (component_y + 1 - first_row) * component->samples_stride;
+
+  if (horizontal_scale == 1 && vertical_scale == 1) {
+    return row;
+  }
+
+  // Interpolate between this row and the nearest row in the direction of the
+  // image row.
+  const uint8_t *neighbour_row = NULL;
+  if (vertical_scale == 2) {
+    size_t neighbour_y = component_y;
+    if (y % 2 == 0 && component_y > 0) {
+      neighbour_y--;
+    } else if (y % 2 == 1 && component_y < component->height - 1) {
+      neighbour_y++;
+    }
+    neighbour_row =
+        samples + (neighbour_y + 1 - first_row) * component->samples_stride;
   }
+
+  jpeg_upsample_row(row, neighbour_row, component->width, horizontal_scale,
+                    upsampled_row);
+  return upsampled_row;
 }
 
-static void ycbcr_to_rgb(uint8_t *pixel) {
-  float Y = pixel[0];
-  float Cb = pixel[1] - 128.0;
-  float Cr = pixel[2] - 128.0;
+// Convert image row [y] of [image] that has been decoded in [mcu_row] to
+// pixels in [row]. [upsampled_rows] is space to upsample each component into.
+static void convert_row(UtJpegDecoder *self, UtObject *image, size_t y,
+                        size_t mcu_row, uint8_t **upsampled_rows,
+                        uint8_t *row) {
+  uint16_t image_width = ut_jpeg_image_get_width(image);
+  size_t n_components = ut_jpeg_image_get_n_components(image);
 
-  pixel[0] = clamp(Y + 1.402 * Cr);
-  pixel[1] = clamp(Y - 0.344136 * Cb - 0.714136 * Cr);
-  pixel[2] = clamp(Y + 1.772 * Cb);
+  const uint8_t *component_rows[MAX_SCAN_COMPONENTS];
+  for (size_t i = 0; i < n_components; i++) {
+    component_rows[i] = get_component_row(self, &self->components[i], y,
+                                          mcu_row, upsampled_rows[i]);
+  }
+
+  if (n_components == 1) {
+    memcpy(row, component_rows[0], image_width);
+  } else if (n_components == 3) {
+    jpeg_ycbcr_to_rgb(component_rows[0], component_rows[1], component_rows[2],
+                      row, image_width);
+  } else {
+    for (size_t x = 0; x < image_width; x++) {
+      for (size_t i = 0; i < n_components; i++) {
+        row[(x * n_components) + i] = component_rows[i][x];
+      }
+    }
+  }
 }
 
-// Process a received data unit.
-static void process_data_unit(UtJpegDecoder *self) {
+// Write image row [y] that has been decoded in [mcu_row].
+static void write_row(UtJpegDecoder *self, size_t y, size_t mcu_row) {
   uint16_t image_width = ut_jpeg_image_get_width(self->image);
-  uint16_t image_height = ut_jpeg_image_get_height(self->image);
   size_t n_components = ut_jpeg_image_get_n_components(self->image);
   size_t row_stride = image_width * n_components;
-  uint8_t *image_data =
-      ut_uint8_list_get_writable_data(ut_jpeg_image_get_data(self->image));
 
-  // Get position of current MCU in image.
-  size_t mcu_x = (self->mcu_count % self->width_in_mcus) * self->mcu_width * 8;
-  size_t mcu_y = (self->mcu_count / self->width_in_mcus) * self->mcu_height * 8;
+  uint8_t *row;
+  if (self->row_callback != NULL) {
+    row = ut_uint8_list_get_writable_data(self->row_data);
+  } else {
+    row = ut_uint8_list_get_writable_data(
+              ut_jpeg_image_get_data(self->image)) +
+          y * row_stride;
+  }
+
+  uint8_t *upsampled_rows[MAX_SCAN_COMPONENTS];
+  for (size_t i = 0; i < n_components; i++) {
+    upsampled_rows[i] =
+        ut_uint8_list_get_writable_data(self->components[i].upsampled_row);
+  }
+  convert_row(self, self->image, y, mcu_row, upsampled_rows, row);
 
-  // Get position of current data unit in image.
-  JpegComponent *component = self->scan_components[self->scan_component_index];
-  size_t data_unit_x =
-      mcu_x +
-      (component->data_unit_count % component->horizontal_sampling_factor) * 8;
-  size_t data_unit_y =
-      mcu_y +
-      (component->data_unit_count / component->horizontal_sampling_factor) * 8;
+  if (self->row_callback != NULL) {
+    self->row_callback(self->row_callback_object, y, self->row_data);
+  }
+}
 
-  // Do inverse DCT on data unit.
-  int16_t *encoded_data_unit =
-      ut_int16_list_get_writable_data(component->coefficients);
-  int16_t decoded_data_unit[64];
-  jpeg_inverse_dct(self->dct_alpha, self->dct_cos, encoded_data_unit,
-                   decoded_data_unit);
+// Write the image rows that have been decoded in [mcu_row].
+static void write_mcu_row(UtJpegDecoder *self, size_t mcu_row) {
+  uint16_t image_height = ut_jpeg_image_get_height(self->image);
+  size_t n_components = ut_jpeg_image_get_n_components(self->image);
 
-  // Check if this is the final component being written.
-  bool last_component =
-      self->scan_component_index == n_components - 1 ||
-      self->scan_components[self->scan_component_index + 1] == NULL;
+  // The last row may need samples from the next MCU row.
+  size_t end_row = (mcu_row + 1) * self->mcu_height * self->data_unit_size;
+  if (mcu_row == self->height_in_mcus - 1) {
+    end_row = image_height;
+  } else if (self->vertical_upsampling) {
+    end_row--;
+  }
 
-  size_t sample_offset = 1 << (self->precision - 1);
-  size_t sample_max = (1 << self->precision) - 1;
+  for (; self->row < end_row; self->row++) {
+    write_row(self, self->row, mcu_row);
+  }
+
+  // Keep the last row of samples for the next MCU row.
+  for (size_t i = 0; i < n_components; i++) {
+    JpegComponent *component = &self->components[i];
+    uint8_t *samples = ut_uint8_list_get_writable_data(component->samples);
+    memcpy(samples,
+           samples + component->vertical_sampling_factor *
+                         self->data_unit_size * component->samples_stride,
+           component->samples_stride);
+  }
+}
+
+// Do the inverse DCT on [coefficients] and write the samples to [samples],
+// which has rows [stride] bytes apart.
+static void write_data_unit(UtJpegDecoder *self, const int16_t *coefficients,
+                            uint8_t *samples, size_t stride) {
+  int16_t decoded_data_unit[64];
+  size_t data_unit_size = self->data_unit_size;
+  jpeg_inverse_dct_scaled(coefficients, data_unit_size, self->precision,
+                          decoded_data_unit);
+
+  int16_t sample_offset = 1 << (self->precision - 1);
+  int16_t sample_max = (1 << self->precision) - 1;
 
   // For now convert 12 bit samples to 8 bit.
   size_t sample_shift = self->precision - 8;
 
-  // Write values into image.
-  size_t sample_width = self->mcu_width / component->horizontal_sampling_factor;
-  size_t sample_height = self->mcu_height / component->vertical_sampling_factor;
-  for (size_t y = 0; y < 8; y++) {
-    size_t sy = data_unit_y + y * sample_height;
-    for (size_t x = 0; x < 8; x++) {
-      size_t sx = data_unit_x + x * sample_width;
-
-      int16_t sample = decoded_data_unit[(y * 8) + x] + sample_offset;
+  for (size_t y = 0; y < data_unit_size; y++) {
+    for (size_t x = 0; x < data_unit_size; x++) {
+      int16_t sample =
+          decoded_data_unit[(y * data_unit_size) + x] + sample_offset;
       if (sample < 0) {
         sample = 0;
       } else if (sample > sample_max) {
         sample = sample_max;
       }
+      samples[x] = sample >> sample_shift;
+    }
+    samples += stride;
+  }
+}
 
-      for (size_t v = 0; v < sample_height; v++) {
-        size_t py = sy + v;
-        if (py >= image_height) {
-          break;
-        }
-        for (size_t u = 0; u < sample_width; u++) {
-          size_t px = sx + u;
-          if (px >= image_width) {
-            break;
-          }
+// Process a received data unit.
+static void process_data_unit(UtJpegDecoder *self) {
+  size_t n_components = ut_jpeg_image_get_n_components(self->image);
 
-          size_t pixel_index = (py * row_stride) + (px * n_components);
-          image_data[pixel_index + component->index] = sample >> sample_shift;
-          // Last channel placed - do color conversion.
-          if (last_component && n_components == 3) {
-            ycbcr_to_rgb(image_data + pixel_index);
-          }
-        }
-      }
-    }
+  if (self->mcu_count >= get_n_mcus(self)) {
+    set_error(self, "Too many data units in JPEG scan");
+    return;
   }
 
+  JpegComponent *component = self->scan_components[self->scan_component_index];
+  size_t data_unit_size = self->data_unit_size;
+
+  // Get position of current data unit in the MCU row, skipping the first row
+  // which is from the previous MCU row.
+  size_t mcu_x = self->mcu_count % self->width_in_mcus;
+  size_t data_unit_x =
+      (mcu_x * component->horizontal_sampling_factor +
+       component->data_unit_count % component->horizontal_sampling_factor) *
+      data_unit_size;
+  size_t data_unit_y =
+      1 + (component->data_unit_count / component->horizontal_sampling_factor) *
+              data_unit_size;
+  uint8_t *samples = ut_uint8_list_get_writable_data(component->samples) +
+                     data_unit_y * component->samples_stride + data_unit_x;
+  write_data_unit(self, component->coefficients, samples,
+                  component->samples_stride);
+  memset(component->coefficients, 0, sizeof(component->coefficients));
+
   component->data_unit_count++;
 
   // All data units for this component in this MCU complete, move to the next
@@ -433,6 +596,11 @@ static void process_data_unit(UtJpegDecoder *self) {
         self->scan_components[self->scan_component_index] == NULL) {
       self->scan_component_index = 0;
       self->mcu_count++;
+
+      // Output rows when an MCU row is complete.
+      if (self->mcu_count % self->width_in_mcus == 0) {
+        write_mcu_row(self, self->mcu_count / self->width_in_mcus - 1);
+      }
     }
   }
 
@@ -445,35 +613,18 @@ static void add_coefficient(UtJpegDecoder *self, size_t run_length,
                             int16_t value) {
   JpegComponent *component = self->scan_components[self->scan_component_index];
 
-  UtObject *quantization_table =
-      self->quantization_tables[component->quantization_table_selector];
-  if (quantization_table == NULL) {
-    set_error(self, "Missing JPEG quantization table %zi",
-              component->quantization_table_selector);
-    return;
-  }
-  const uint8_t *quantization_table_data =
-      ut_uint8_list_get_data(quantization_table);
-
   if (self->data_unit_coefficient_index + run_length >
       self->scan_coefficient_end) {
     set_error(self, "Too many coefficients in data unit");
     return;
   }
 
-  int16_t *encoded_data_unit =
-      ut_int16_list_get_writable_data(component->coefficients);
-
-  // Pad with zeros.
-  for (size_t i = 0; i < run_length; i++) {
-    uint8_t index = self->data_unit_order[self->data_unit_coefficient_index];
-    encoded_data_unit[index] = 0;
-    self->data_unit_coefficient_index++;
-  }
+  // Skip zeros, the coefficients are cleared after each data unit.
+  self->data_unit_coefficient_index += run_length;
 
   // Put cofficient into data unit in zig-zag order.
   uint8_t index = self->data_unit_order[self->data_unit_coefficient_index];
-  encoded_data_unit[index] = value * quantization_table_data[index];
+  component->coefficients[index] = value * component->quantization_table[index];
 
   if (self->data_unit_coefficient_index < self->scan_coefficient_end) {
     self->data_unit_coefficient_index++;
@@ -482,13 +633,40 @@ static void add_coefficient(UtJpegDecoder *self, size_t run_length,
   }
 }
 
+// Get the number of MCUs decoded when the current restart interval ends.
+static size_t get_restart_mcu(UtJpegDecoder *self) {
+  size_t n_mcus = get_n_mcus(self);
+  if (self->restart_interval == 0) {
+    return n_mcus;
+  }
+  size_t restart_mcu = (self->restart_count + 1) * self->restart_interval;
+  return restart_mcu < n_mcus ? restart_mcu : n_mcus;
+}
+
 static void handle_restart(UtJpegDecoder *self, uint8_t count) {
-  if (true) {
-    set_error(self, "JPEG restart not supported");
+  // Restart markers are only valid between restart intervals in a scan.
+  if (self->restart_interval == 0 || self->mcu_count >= get_n_mcus(self) ||
+      self->mcu_count != get_restart_mcu(self)) {
+    set_error(self, "Unexpected JPEG restart marker");
+    return;
+  }
+  if (count != self->restart_count % 8) {
+    set_error(self, "Invalid JPEG restart marker %d, expected %zi", count,
+              self->restart_count % 8);
     return;
   }
+  self->restart_count++;
 
-  self->state = DECODER_STATE_MARKER;
+  // Decoding starts again from the next byte, with no DC prediction.
+  self->bit_buffer = 0;
+  self->bit_count = 0;
+  size_t n_components = ut_jpeg_image_get_n_components(self->image);
+  for (size_t i = 0; i < n_components; i++) {
+    self->components[i].previous_dc = 0;
+  }
+  self->data_unit_coefficient_index = self->scan_coefficient_start;
+  self->scan_decoder_state = SCAN_DECODER_STATE_COEFFICIENT_MAGNITUDE;
+  self->state = DECODER_STATE_SCAN;
 }
 
 static void handle_start_of_image(UtJpegDecoder *self) {
@@ -757,13 +935,53 @@ static size_t decode_start_of_frame(UtJpegDecoder *self, UtObject *data) {
     self->components[i].quantization_table_selector =
         quantization_table_selector;
 
-    self->components[i].coefficients = ut_int16_array_new_sized(64);
   }
+
+  // Single component images are not interleaved, so each MCU is one data unit.
+  if (n_components == 1) {
+    self->components[0].horizontal_sampling_factor = 1;
+    self->components[0].vertical_sampling_factor = 1;
+    mcu_width = 1;
+    mcu_height = 1;
+  }
+
   self->mcu_width = mcu_width;
   self->mcu_height = mcu_height;
   self->width_in_mcus = (width + (mcu_width * 8) - 1) / (mcu_width * 8);
   self->height_in_mcus = (height + (mcu_height * 8) - 1) / (mcu_height * 8);
 
+  // Output image is reduced if scaling.
+  width = (width + self->scale - 1) / self->scale;
+  height = (height + self->scale - 1) / self->scale;
+  size_t data_unit_size = self->data_unit_size;
+
+  // Allocate space to decode one MCU row, and an extra row for the last row
+  // of samples from the previous MCU row. When using worker threads all the
+  // MCU rows are decoded at once.
+  size_t n_mcu_rows = self->n_threads > 0 ? self->height_in_mcus : 1;
+  self->vertical_upsampling = false;
+  for (size_t i = 0; i < n_components; i++) {
+    JpegComponent *component = &self->components[i];
+    size_t horizontal_sampling_factor = component->horizontal_sampling_factor;
+    size_t vertical_sampling_factor = component->vertical_sampling_factor;
+    component->width =
+        ((width * horizontal_sampling_factor) + mcu_width - 1) / mcu_width;
+    component->height =
+        ((height * vertical_sampling_factor) + mcu_height - 1) / mcu_height;
+    component->samples_stride =
+        self->width_in_mcus * horizontal_sampling_factor * data_unit_size;
+    ut_object_unref(component->samples);
+    component->samples = ut_uint8_array_new_sized(
+        component->samples_stride *
+        (n_mcu_rows * vertical_sampling_factor * data_unit_size + 1));
+    ut_object_unref(component->upsampled_row);
+    component->upsampled_row = ut_uint8_array_new_sized(
+        self->width_in_mcus * mcu_width * data_unit_size);
+    if (mcu_height / vertical_sampling_factor == 2) {
+      self->vertical_upsampling = true;
+    }
+  }
+
   if (!supported_precision(self, precision)) {
     set_error(self, "Unsupported JPEG precision %d", precision);
     return length;
@@ -775,8 +993,15 @@ static size_t decode_start_of_frame(UtJpegDecoder *self, UtObject *data) {
     return length;
   }
 
-  UtObjectRef image_data =
-      ut_uint8_array_new_sized(height * width * n_components);
+  // Image data is not stored if it is being passed to the row callback.
+  UtObjectRef image_data = NULL;
+  if (self->row_callback != NULL) {
+    image_data = ut_uint8_list_new();
+    ut_object_unref(self->row_data);
+    self->row_data = ut_uint8_array_new_sized(width * n_components);
+  } else {
+    image_data = ut_uint8_array_new_sized(height * width * n_components);
+  }
   self->image = ut_jpeg_image_new(
       width, height, self->density_units, self->horizontal_pixel_density,
       self->vertical_pixel_density, n_components, image_data);
@@ -1035,12 +1260,7 @@ static size_t decode_define_restart_interval(UtJpegDecoder *self,
     return 0;
   }
 
-  /*uint16_t restart_interval =*/ut_uint8_list_get_uint16_be(data, 2);
-
-  if (true) {
-    set_error(self, "JPEG restart interval not supported");
-    return 0;
-  }
+  self->restart_interval = ut_uint8_list_get_uint16_be(data, 2);
 
   self->state = DECODER_STATE_MARKER;
 
@@ -1197,6 +1417,10 @@ static size_t decode_start_of_scan(UtJpegDecoder *self, UtObject *data) {
   for (size_t i = n_scan_components; i < MAX_SCAN_COMPONENTS; i++) {
     self->scan_components[i] = NULL;
   }
+  if (n_scan_components != ut_jpeg_image_get_n_components(self->image)) {
+    set_error(self, "Non-interleaved JPEG scans not supported");
+    return length;
+  }
   uint8_t selection_start = ut_uint8_list_get_element(data, offset++);
   uint8_t selection_end = ut_uint8_list_get_element(data, offset++);
   uint8_t successive_approximation = ut_uint8_list_get_element(data, offset++);
@@ -1232,8 +1456,18 @@ static size_t decode_start_of_scan(UtJpegDecoder *self, UtObject *data) {
     return length;
   }
 
-  // Check have required decoders.
+  // Check have required decoders and quantization tables.
   for (size_t i = 0; i < n_scan_components; i++) {
+    JpegComponent *component = self->scan_components[i];
+    UtObject *quantization_table =
+        self->quantization_tables[component->quantization_table_selector];
+    if (quantization_table == NULL) {
+      set_error(self, "Missing JPEG quantization table %zi",
+                component->quantization_table_selector);
+      return length;
+    }
+    component->quantization_table = ut_uint8_list_get_data(quantization_table);
+
     if (selection_start == 0 && self->scan_components[i]->dc_decoder == NULL) {
       set_error(self, "Missing DC table in JPEG start of scan");
       return length;
@@ -1248,6 +1482,8 @@ static size_t decode_start_of_scan(UtJpegDecoder *self, UtObject *data) {
   self->scan_coefficient_end = selection_end;
   self->data_unit_coefficient_index = self->scan_coefficient_start;
   self->mcu_count = 0;
+  self->restart_count = 0;
+  self->row = 0;
   self->scan_component_index = 0;
   for (size_t i = 0; i < n_scan_components; i++) {
     self->scan_components[i]->previous_dc = 0;
@@ -1255,16 +1491,31 @@ static size_t decode_start_of_scan(UtJpegDecoder *self, UtObject *data) {
   }
   self->bit_buffer = 0;
   self->bit_count = 0;
-  self->code = 0;
-  self->code_width = 0;
   self->state = DECODER_STATE_SCAN;
   self->scan_decoder_state = SCAN_DECODER_STATE_COEFFICIENT_MAGNITUDE;
 
   return length;
 }
 
-static bool decode_coefficient_magnitude(UtJpegDecoder *self, UtObject *data,
-                                         size_t *offset) {
+// Get the amplitude encoded in [value] with [magnitude] bits.
+static int16_t get_amplitude(uint16_t value, uint8_t magnitude) {
+  // Upper half of values are positive, lower half are negative, i.e.
+  // 0 bits:  0
+  // 1 bit:  -1, 1
+  // 2 bits: -3,-2, 2, 3
+  // 3 bits: -7,-6,-5,-4, 4, 5, 6, 7
+  // ...
+  int16_t min_amplitude = 1 << (magnitude - 1);
+  if (value >= min_amplitude) {
+    return value;
+  } else {
+    return value - (min_amplitude * 2) + 1;
+  }
+}
+
+static bool decode_coefficient_magnitude(UtJpegDecoder *self,
+                                         const uint8_t *data,
+                                         size_t data_length, size_t *offset) {
   JpegComponent *component = self->scan_components[self->scan_component_index];
 
   UtObject *decoder, *table;
@@ -1277,7 +1528,8 @@ static bool decode_coefficient_magnitude(UtJpegDecoder *self, UtObject *data,
   }
 
   uint16_t symbol;
-  if (!read_huffman_symbol(self, data, offset, decoder, &symbol)) {
+  if (!read_huffman_symbol(self, data, data_length, offset, decoder,
+                           &symbol)) {
     return false;
   }
   if (symbol >= ut_list_get_length(table)) {
@@ -1304,8 +1556,9 @@ static bool decode_coefficient_magnitude(UtJpegDecoder *self, UtObject *data,
   return true;
 }
 
-static bool decode_coefficient_amplitude(UtJpegDecoder *self, UtObject *data,
-                                         size_t *offset) {
+static bool decode_coefficient_amplitude(UtJpegDecoder *self,
+                                         const uint8_t *data,
+                                         size_t data_length, size_t *offset) {
   JpegComponent *component = self->scan_components[self->scan_component_index];
 
   int16_t amplitude;
@@ -1313,22 +1566,11 @@ static bool decode_coefficient_amplitude(UtJpegDecoder *self, UtObject *data,
     amplitude = 0;
   } else {
     uint16_t value;
-    if (!read_int(self, data, offset, self->coefficient_magnitude, &value)) {
+    if (!read_int(self, data, data_length, offset, self->coefficient_magnitude,
+                  &value)) {
       return false;
     }
-
-    // Upper half of values are positive, lower half are negative, i.e.
-    // 0 bits:  0
-    // 1 bit:  -1, 1
-    // 2 bits: -3,-2, 2, 3
-    // 3 bits: -7,-6,-5,-4, 4, 5, 6, 7
-    // ...
-    int16_t min_amplitude = 1 << (self->coefficient_magnitude - 1);
-    if (value >= min_amplitude) {
-      amplitude = value;
-    } else {
-      amplitude = value - (min_amplitude * 2) + 1;
-    }
+    amplitude = get_amplitude(value, self->coefficient_magnitude);
   }
 
   size_t run_length;
@@ -1350,7 +1592,8 @@ static bool decode_coefficient_amplitude(UtJpegDecoder *self, UtObject *data,
 }
 
 static bool decode_coefficient_end_of_block_count(UtJpegDecoder *self,
-                                                  UtObject *data,
+                                                  const uint8_t *data,
+                                                  size_t data_length,
                                                   size_t *offset) {
   size_t length = self->run_length;
 
@@ -1359,7 +1602,7 @@ static bool decode_coefficient_end_of_block_count(UtJpegDecoder *self,
     count = 1;
   } else {
     uint16_t value;
-    if (!read_int(self, data, offset, length, &value)) {
+    if (!read_int(self, data, data_length, offset, length, &value)) {
       return false;
     }
     count = (1 << length) + value;
@@ -1380,20 +1623,516 @@ static bool decode_coefficient_end_of_block_count(UtJpegDecoder *self,
   return true;
 }
 
+// Reads entropy coded data between restart markers on a worker thread.
+typedef struct {
+  const uint8_t *data;
+  size_t data_length;
+  size_t offset;
+
+  // Current bits being read, first bit in the most significant bit.
+  uint32_t bit_buffer;
+  size_t bit_count;
+
+  // Number of zero bits added after the end of the data.
+  size_t n_padding_bits;
+} IntervalReader;
+
+// Fill the bit buffer with at least 25 bits, padding with zeros after the end
+// of the data.
+static void interval_reader_fill(IntervalReader *reader) {
+  while (reader->bit_count <= 24) {
+    uint8_t byte = 0;
+    if (reader->offset < reader->data_length) {
+      byte = reader->data[reader->offset];
+
+      // The interval contains no markers, so 0xff is always followed by a
+      // stuffed 0x00.
+      reader->offset += byte == 0xff ? 2 : 1;
+    } else {
+      reader->n_padding_bits += 8;
+    }
+    reader->bit_buffer |= (uint32_t)byte << (24 - reader->bit_count);
+    reader->bit_count += 8;
+  }
+}
+
+// Read an integer of [length] bits, which must be between 1 and 16.
+static uint16_t interval_reader_read_int(IntervalReader *reader,
+                                         size_t length) {
+  interval_reader_fill(reader);
+  uint16_t value = reader->bit_buffer >> (32 - length);
+  reader->bit_buffer <<= length;
+  reader->bit_count -= length;
+  return value;
+}
+
+// Read the next Huffman symbol using [decoder] and write the value it maps to
+// in [table] to [value].
+static bool interval_reader_read_value(IntervalReader *reader,
+                                       UtObject *decoder, UtObject *table,
+                                       uint8_t *value) {
+  interval_reader_fill(reader);
+  uint16_t symbol;
+  size_t code_width = ut_huffman_decoder_lookup_msb_first(
+      decoder, reader->bit_buffer >> 16, &symbol);
+  if (code_width == 0 || symbol >= ut_list_get_length(table)) {
+    return false;
+  }
+  reader->bit_buffer <<= code_width;
+  reader->bit_count -= code_width;
+  *value = ut_uint8_list_get_data(table)[symbol];
+  return true;
+}
+
+// Decode the coefficients for the next data unit of [component] into
+// [coefficients], which must be zeroed.
+static bool interval_reader_read_data_unit(UtJpegDecoder *self,
+                                           IntervalReader *reader,
+                                           JpegComponent *component,
+                                           int16_t *coefficients) {
+  const uint8_t *quantization_table = component->quantization_table;
+
+  uint8_t magnitude;
+  if (!interval_reader_read_value(reader, component->dc_decoder,
+                                  component->dc_table, &magnitude) ||
+      magnitude > 16) {
+    return false;
+  }
+  int16_t dc = component->previous_dc;
+  if (magnitude > 0) {
+    dc += get_amplitude(interval_reader_read_int(reader, magnitude),
+                        magnitude);
+  }
+  component->previous_dc = dc;
+  coefficients[0] = dc * quantization_table[0];
+
+  for (size_t i = 1; i < 64; i++) {
+    uint8_t value;
+    if (!interval_reader_read_value(reader, component->ac_decoder,
+                                    component->ac_table, &value)) {
+      return false;
+    }
+    magnitude = value & 0xf;
+    size_t run_length = value >> 4;
+    if (magnitude == 0) {
+      // End of block, or a run of 16 zeros.
+      if (run_length < 15) {
+        break;
+      }
+      i += 15;
+      continue;
+    }
+    i += run_length;
+    if (i >= 64) {
+      return false;
+    }
+    uint8_t index = self->data_unit_order[i];
+    coefficients[index] =
+        get_amplitude(interval_reader_read_int(reader, magnitude), magnitude) *
+        quantization_table[index];
+  }
+
+  return true;
+}
+
+// Work done on a worker thread when decoding a scan in parallel.
+typedef enum {
+  TASK_DECODE_SEGMENT,
+  TASK_WRITE_BAND
+} TaskType;
+
+typedef struct {
+  UtObject object;
+
+  // Decoder being used, which is kept alive while the task is running.
+  UtJpegDecoder *decoder;
+
+  TaskType type;
+
+  // Index of the segment or band.
+  size_t index;
+
+  // Image being written by a band, which remains valid if the decoder fails.
+  UtObject *image;
+
+  // Error that occurred, or NULL.
+  const char *error;
+} ParallelTask;
+
+static void parallel_task_cleanup(UtObject *object) {
+  ParallelTask *self = (ParallelTask *)object;
+  ut_object_unref((UtObject *)self->decoder);
+  ut_object_unref(self->image);
+}
+
+static UtObjectInterface parallel_task_object_interface = {
+    .type_name = "JpegParallelTask", .cleanup = parallel_task_cleanup};
+
+// Decode the restart intervals in a segment into the component samples.
+static void decode_segment(UtJpegDecoder *self, ParallelTask *task) {
+  size_t mcus_per_interval =
+      self->restart_interval > 0 ? self->restart_interval : get_n_mcus(self);
+  size_t first_interval = task->index * self->intervals_per_segment;
+  size_t end_interval = first_interval + self->intervals_per_segment;
+  if (end_interval > self->n_intervals) {
+    end_interval = self->n_intervals;
+  }
+
+  // Use copies of the components, as other threads are decoding too.
+  JpegComponent components[MAX_SCAN_COMPONENTS];
+  size_t n_components = 0;
+  while (n_components < MAX_SCAN_COMPONENTS &&
+         self->scan_components[n_components] != NULL) {
+    components[n_components] = *self->scan_components[n_components];
+    n_components++;
+  }
+
+  size_t data_unit_size = self->data_unit_size;
+  const uint8_t *data = ut_uint8_list_get_data(self->scan_data);
+  for (size_t interval = first_interval; interval < end_interval;
+       interval++) {
+    IntervalReader reader = {
+        .data = data + self->intervals[interval].start,
+        .data_length =
+            self->intervals[interval].end - self->intervals[interval].start};
+    for (size_t i = 0; i < n_components; i++) {
+      components[i].previous_dc = 0;
+    }
+
+    size_t first_mcu = interval * mcus_per_interval;
+    size_t end_mcu = first_mcu + mcus_per_interval;
+    if (end_mcu > get_n_mcus(self)) {
+      end_mcu = get_n_mcus(self);
+    }
+    for (size_t mcu = first_mcu; mcu < end_mcu; mcu++) {
+      size_t mcu_x = mcu % self->width_in_mcus;
+      size_t mcu_y = mcu / self->width_in_mcus;
+      for (size_t i = 0; i < n_components; i++) {
+        JpegComponent *component = &components[i];
+        size_t horizontal_sampling_factor =
+            component->horizontal_sampling_factor;
+        size_t vertical_sampling_factor = component->vertical_sampling_factor;
+        uint8_t *samples = ut_uint8_list_get_writable_data(component->samples);
+        for (size_t y = 0; y < vertical_sampling_factor; y++) {
+          for (size_t x = 0; x < horizontal_sampling_factor; x++) {
+            int16_t coefficients[64] = {0};
+            if (!interval_reader_read_data_unit(self, &reader, component,
+                                                coefficients)) {
+              task->error = "Invalid data in JPEG restart interval";
+              return;
+            }
+
+            // The first row of samples is not used when decoding the whole
+            // image.
+            size_t data_unit_x = (mcu_x * horizontal_sampling_factor + x) *
+                                 data_unit_size;
+            size_t data_unit_y =
+                1 + (mcu_y * vertical_sampling_factor + y) * data_unit_size;
+            write_data_unit(self, coefficients,
+                            samples + data_unit_y * component->samples_stride +
+                                data_unit_x,
+                            component->samples_stride);
+          }
+        }
+      }
+    }
+
+    if (reader.n_padding_bits > reader.bit_count) {
+      task->error = "Insufficient data in JPEG restart interval";
+      return;
+    }
+  }
+}
+
+// Convert the MCU rows in a band to pixels in the image.
+static void write_band(UtJpegDecoder *self, ParallelTask *task) {
+  uint16_t image_width = ut_jpeg_image_get_width(task->image);
+  uint16_t image_height = ut_jpeg_image_get_height(task->image);
+  size_t n_components = ut_jpeg_image_get_n_components(task->image);
+  size_t row_stride = image_width * n_components;
+  size_t rows_per_band =
+      self->mcu_rows_per_band * self->mcu_height * self->data_unit_size;
+  size_t start_row = task->index * rows_per_band;
+  size_t end_row = start_row + rows_per_band;
+  if (end_row > image_height) {
+    end_row = image_height;
+  }
+
+  uint8_t *upsampled_rows[MAX_SCAN_COMPONENTS];
+  for (size_t i = 0; i < n_components; i++) {
+    upsampled_rows[i] = malloc(
+        self->width_in_mcus * self->mcu_width * self->data_unit_size);
+  }
+
+  uint8_t *image_data =
+      ut_uint8_list_get_writable_data(ut_jpeg_image_get_data(task->image));
+  for (size_t y = start_row; y < end_row; y++) {
+    convert_row(self, task->image, y, 0, upsampled_rows,
+                image_data + y * row_stride);
+  }
+
+  for (size_t i = 0; i < n_components; i++) {
+    free(upsampled_rows[i]);
+  }
+}
+
+// Run a task. This runs on a worker thread, so only reads from the decoder.
+static UtObject *parallel_task_thread_cb(UtObject *object) {
+  ParallelTask *task = (ParallelTask *)object;
+  switch (task->type) {
+  case TASK_DECODE_SEGMENT:
+    decode_segment(task->decoder, task);
+    break;
+  case TASK_WRITE_BAND:
+    write_band(task->decoder, task);
+    break;
+  }
+  return NULL;
+}
+
+static void parallel_task_result_cb(UtObject *object, UtObject *result);
+
+static void start_task(UtJpegDecoder *self, TaskType type, size_t index) {
+  UtObject *object =
+      ut_object_new(sizeof(ParallelTask), &parallel_task_object_interface);
+  ParallelTask *task = (ParallelTask *)object;
+  task->decoder = (UtJpegDecoder *)ut_object_ref((UtObject *)self);
+  task->type = type;
+  task->index = index;
+  if (type == TASK_WRITE_BAND) {
+    task->image = ut_object_ref(self->image);
+  }
+  self->n_running_tasks++;
+  ut_event_loop_add_worker_thread(parallel_task_thread_cb, object, object,
+                                  parallel_task_result_cb);
+}
+
+// Returns true if all the MCU rows [band] uses have been decoded.
+static bool band_is_decoded(UtJpegDecoder *self, size_t band) {
+  // Rows are interpolated with the first row of the next band.
+  size_t end_mcu_row = (band + 1) * self->mcu_rows_per_band + 1;
+  if (end_mcu_row > self->height_in_mcus) {
+    end_mcu_row = self->height_in_mcus;
+  }
+
+  size_t mcus_per_interval =
+      self->restart_interval > 0 ? self->restart_interval : get_n_mcus(self);
+  size_t n_decoded_mcus = self->n_decoded_segments *
+                          self->intervals_per_segment * mcus_per_interval;
+  return n_decoded_mcus >= end_mcu_row * self->width_in_mcus;
+}
+
+// Start tasks while worker threads are available, converting decoded rows
+// before decoding more.
+static void start_tasks(UtJpegDecoder *self) {
+  while (self->n_running_tasks < self->n_threads) {
+    if (self->next_band < self->n_bands &&
+        band_is_decoded(self, self->next_band)) {
+      start_task(self, TASK_WRITE_BAND, self->next_band);
+      self->next_band++;
+    } else if (self->next_segment < self->n_segments) {
+      start_task(self, TASK_DECODE_SEGMENT, self->next_segment);
+      self->next_segment++;
+    } else {
+      return;
+    }
+  }
+}
+
+static size_t read_cb(UtObject *object, UtObject *data, bool complete);
+
+static void parallel_task_result_cb(UtObject *object, UtObject *result) {
+  ParallelTask *task = (ParallelTask *)object;
+  UtJpegDecoder *self = task->decoder;
+
+  self->n_running_tasks--;
+  if (self->state != DECODER_STATE_PARALLEL_SCAN) {
+    return;
+  }
+  if (task->error != NULL) {
+    set_error(self, "%s", task->error);
+    return;
+  }
+
+  switch (task->type) {
+  case TASK_DECODE_SEGMENT:
+    self->segment_decoded[task->index] = true;
+    while (self->n_decoded_segments < self->n_segments &&
+           self->segment_decoded[self->n_decoded_segments]) {
+      self->n_decoded_segments++;
+    }
+    break;
+  case TASK_WRITE_BAND:
+    self->n_written_bands++;
+    break;
+  }
+
+  if (self->n_written_bands < self->n_bands) {
+    start_tasks(self);
+    return;
+  }
+
+  // Continue with the data after the scan.
+  self->mcu_count = get_n_mcus(self);
+  self->state = DECODER_STATE_MARKER;
+  UtObjectRef remaining_data = self->remaining_data;
+  self->remaining_data = NULL;
+  ut_object_unref(self->scan_data);
+  self->scan_data = NULL;
+  read_cb((UtObject *)self, remaining_data, true);
+}
+
+// Find the restart intervals in the scan [data]. Returns the offset of the
+// marker after the scan or 0 if more data is required.
+static size_t find_intervals(UtJpegDecoder *self, const uint8_t *data,
+                             size_t data_length) {
+  size_t n_intervals = 1;
+  if (self->restart_interval > 0) {
+    n_intervals = (get_n_mcus(self) + self->restart_interval - 1) /
+                  self->restart_interval;
+  }
+  free(self->intervals);
+  self->intervals = malloc(sizeof(ScanInterval) * n_intervals);
+  self->n_intervals = 0;
+
+  size_t offset = 0;
+  size_t interval_start = 0;
+  while (true) {
+    const uint8_t *marker = memchr(data + offset, 0xff, data_length - offset);
+    if (marker == NULL) {
+      return 0;
+    }
+    size_t marker_offset = marker - data;
+
+    // Markers may be preceded by any number of 0xff fill bytes.
+    size_t code_offset = marker_offset + 1;
+    while (code_offset < data_length && data[code_offset] == 0xff) {
+      code_offset++;
+    }
+    if (code_offset >= data_length) {
+      return 0;
+    }
+    uint8_t code = data[code_offset];
+    offset = code_offset + 1;
+    if (code == 0x00) {
+      continue;
+    }
+
+    if (self->n_intervals >= n_intervals) {
+      set_error(self, "Too many JPEG restart intervals");
+      return 0;
+    }
+    self->intervals[self->n_intervals].start = interval_start;
+    self->intervals[self->n_intervals].end = marker_offset;
+    self->n_intervals++;
+    interval_start = offset;
+
+    if (code < 0xd0 || code > 0xd7) {
+      if (self->n_intervals != n_intervals) {
+        set_error(self, "Missing JPEG restart markers");
+        return 0;
+      }
+
+      // The marker is processed after the scan is decoded.
+      return marker_offset;
+    }
+    if (code != 0xd0 + (self->n_intervals - 1) % 8) {
+      set_error(self, "Invalid JPEG restart marker %d, expected %zi",
+                code - 0xd0, (self->n_intervals - 1) % 8);
+      return 0;
+    }
+  }
+}
+
+// Decode the scan in [data] using worker threads.
+static size_t decode_scan_parallel(UtJpegDecoder *self, UtObject *data) {
+  // Decode from contiguous memory, copying if the data is not stored that way.
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  UtObjectRef data_copy = NULL;
+  if (d == NULL && data_length > 0) {
+    data_copy = ut_list_copy(data);
+    d = ut_uint8_list_get_data(data_copy);
+  }
+
+  size_t scan_length = find_intervals(self, d, data_length);
+  if (scan_length == 0) {
+    return 0;
+  }
+  ut_object_unref(self->scan_data);
+  self->scan_data = ut_object_ref(data_copy != NULL ? data_copy : data);
+  ut_object_unref(self->remaining_data);
+  self->remaining_data =
+      ut_list_get_sublist(data, scan_length, data_length - scan_length);
+
+  // The Huffman decoders build their lookup tables on first use, which is
+  // not safe to do in the worker threads.
+  for (size_t i = 0;
+       i < MAX_SCAN_COMPONENTS && self->scan_components[i] != NULL; i++) {
+    uint16_t symbol;
+    ut_huffman_decoder_lookup_msb_first(self->scan_components[i]->dc_decoder,
+                                        0, &symbol);
+    ut_huffman_decoder_lookup_msb_first(self->scan_components[i]->ac_decoder,
+                                        0, &symbol);
+  }
+
+  size_t n_tasks = self->n_threads * TASKS_PER_THREAD;
+  self->intervals_per_segment = (self->n_intervals + n_tasks - 1) / n_tasks;
+  self->n_segments = (self->n_intervals + self->intervals_per_segment - 1) /
+                     self->intervals_per_segment;
+  self->next_segment = 0;
+  free(self->segment_decoded);
+  self->segment_decoded = calloc(self->n_segments, sizeof(bool));
+  self->n_decoded_segments = 0;
+  self->mcu_rows_per_band = (self->height_in_mcus + n_tasks - 1) / n_tasks;
+  self->n_bands = (self->height_in_mcus + self->mcu_rows_per_band - 1) /
+                  self->mcu_rows_per_band;
+  self->next_band = 0;
+  self->n_written_bands = 0;
+
+  self->state = DECODER_STATE_PARALLEL_SCAN;
+  start_tasks(self);
+
+  return data_length;
+}
+
 static size_t decode_scan(UtJpegDecoder *self, UtObject *data) {
+  if (self->n_threads > 0) {
+    return decode_scan_parallel(self, data);
+  }
+
+  // Decode from contiguous memory, copying if the data is not stored that way.
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  UtObjectRef data_copy = NULL;
+  if (d == NULL && data_length > 0) {
+    data_copy = ut_list_copy(data);
+    d = ut_uint8_list_get_data(data_copy);
+  }
+
   size_t offset = 0;
 
   bool decoding;
   do {
+    // Skip any padding at the end of the restart interval or scan until the
+    // next marker.
+    if (self->mcu_count >= get_restart_mcu(self)) {
+      uint8_t byte;
+      while (read_scan_byte(self, d, data_length, &offset, &byte)) {
+      }
+      return offset;
+    }
+
     switch (self->scan_decoder_state) {
     case SCAN_DECODER_STATE_COEFFICIENT_MAGNITUDE:
-      decoding = decode_coefficient_magnitude(self, data, &offset);
+      decoding = decode_coefficient_magnitude(self, d, data_length, &offset);
       break;
     case SCAN_DECODER_STATE_COEFFICIENT_AMPLITUDE:
-      decoding = decode_coefficient_amplitude(self, data, &offset);
+      decoding = decode_coefficient_amplitude(self, d, data_length, &offset);
       break;
     case SCAN_DECODER_STATE_COEFFICIENT_END_OF_BLOCK_COUNT:
-      decoding = decode_coefficient_end_of_block_count(self, data, &offset);
+      decoding = decode_coefficient_end_of_block_count(self, d, data_length,
+                                                       &offset);
       break;
     }
   } while (decoding && self->state != DECODER_STATE_ERROR);
@@ -1630,6 +2369,7 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
     case DECODER_STATE_COMMENT:
       n_used = decode_comment(self, d);
       break;
+    case DECODER_STATE_PARALLEL_SCAN:
     case DECODER_STATE_ERROR:
     case DECODER_STATE_DONE:
       return offset;
@@ -1652,7 +2392,6 @@ static void done_cb(UtObject *object) {}
 static void ut_jpeg_decoder_init(UtObject *object) {
   UtJpegDecoder *self = (UtJpegDecoder *)object;
   jpeg_build_data_unit_order(self->data_unit_order);
-  jpeg_build_dct_values(self->dct_alpha, self->dct_cos);
 }
 
 static void ut_jpeg_decoder_cleanup(UtObject *object) {
@@ -1662,6 +2401,7 @@ static void ut_jpeg_decoder_cleanup(UtObject *object) {
 
   ut_object_unref(self->input_stream);
   ut_object_weak_unref(&self->callback_object);
+  ut_object_weak_unref(&self->row_callback_object);
   for (size_t i = 0; i < 4; i++) {
     ut_object_unref(self->quantization_tables[i]);
     ut_object_unref(self->dc_decoders[i]);
@@ -1670,8 +2410,14 @@ static void ut_jpeg_decoder_cleanup(UtObject *object) {
     ut_object_unref(self->ac_tables[i]);
   }
   for (size_t i = 0; i < MAX_SCAN_COMPONENTS; i++) {
-    ut_object_unref(self->components[i].coefficients);
-  }
+    ut_object_unref(self->components[i].samples);
+    ut_object_unref(self->components[i].upsampled_row);
+  }
+  ut_object_unref(self->scan_data);
+  ut_object_unref(self->remaining_data);
+  free(self->intervals);
+  free(self->segment_decoded);
+  ut_object_unref(self->row_data);
   free(self->comment);
   ut_object_unref(self->image);
   ut_object_unref(self->error);
@@ -1683,9 +2429,26 @@ static UtObjectInterface object_interface = {.type_name = "UtJpegDecoder",
                                                  ut_jpeg_decoder_cleanup};
 
 UtObject *ut_jpeg_decoder_new(UtObject *input_stream) {
+  return ut_jpeg_decoder_new_with_scale(1, input_stream);
+}
+
+UtObject *ut_jpeg_decoder_new_with_scale(size_t scale,
+                                         UtObject *input_stream) {
+  assert(scale == 1 || scale == 2 || scale == 4 || scale == 8);
   UtObject *object = ut_object_new(sizeof(UtJpegDecoder), &object_interface);
   UtJpegDecoder *self = (UtJpegDecoder *)object;
   self->input_stream = ut_object_ref(input_stream);
+  self->scale = scale;
+  self->data_unit_size = 8 / scale;
+  return object;
+}
+
+UtObject *ut_jpeg_decoder_new_parallel(size_t n_threads, UtObject *data) {
+  assert(n_threads > 0);
+  UtObjectRef input_stream = ut_list_input_stream_new(data);
+  UtObject *object = ut_jpeg_decoder_new(input_stream);
+  UtJpegDecoder *self = (UtJpegDecoder *)object;
+  self->n_threads = n_threads;
   return object;
 }
 
@@ -1703,10 +2466,25 @@ void ut_jpeg_decoder_decode(UtObject *object, UtObject *callback_object,
   ut_input_stream_read(self->input_stream, object, read_cb);
 }
 
+void ut_jpeg_decoder_set_row_callback(UtObject *object,
+                                      UtObject *callback_object,
+                                      UtJpegDecodeRowCallback callback) {
+  assert(ut_object_is_jpeg_decoder(object));
+  UtJpegDecoder *self = (UtJpegDecoder *)object;
+
+  assert(self->callback == NULL);
+  assert(self->n_threads == 0);
+
+  ut_object_weak_ref(callback_object, &self->row_callback_object);
+  self->row_callback = callback;
+}
+
 UtObject *ut_jpeg_decoder_decode_sync(UtObject *object) {
   assert(ut_object_is_jpeg_decoder(object));
   UtJpegDecoder *self = (UtJpegDecoder *)object;
 
+  assert(self->n_threads == 0);
+
   UtObjectRef dummy_object = ut_null_new();
   ut_jpeg_decoder_decode(object, (UtObject *)dummy_object, done_cb);
   if (self->error != NULL) {
@@ -5,6 +5,8 @@
 #pragma once
 
 typedef void (*UtJpegDecodeCallback)(UtObject *object);
+typedef void (*UtJpegDecodeRowCallback)(UtObject *object, size_t row,
+                                        UtObject *data);
 
 /// Creates a new JPEG decoder to read an image from [input_stream].
 ///
@@ -13,11 +15,42 @@ typedef void (*UtJpegDecodeCallback)(UtObject *object);
 /// !return-type UtJpegDecoder
 UtObject *ut_jpeg_decoder_new(UtObject *input_stream);
 
+/// Creates a new JPEG decoder to read an image from [input_stream], reducing
+/// it to 1/[scale] of the original size. [scale] must be 1, 2, 4 or 8.
+/// This is faster than decoding the full size image and scaling it.
+///
+/// !arg-type input_stream UtInputStream
+/// !return-ref
+/// !return-type UtJpegDecoder
+UtObject *ut_jpeg_decoder_new_with_scale(size_t scale, UtObject *input_stream);
+
+/// Creates a new JPEG decoder to read an image from [data], using up to
+/// [n_threads] worker threads.
+/// The entropy coded data between restart markers is decoded in parallel, and
+/// the decoded rows are converted to pixels in parallel. Images without
+/// restart markers only do the conversion in parallel.
+/// The image is completed from the event loop, so
+/// [ut_jpeg_decoder_decode_sync] and row callbacks can't be used.
+///
+/// !arg-type data UtUint8List
+/// !return-ref
+/// !return-type UtJpegDecoder
+UtObject *ut_jpeg_decoder_new_parallel(size_t n_threads, UtObject *data);
+
 /// Start decoding.
 /// When complete [callback] is called.
 void ut_jpeg_decoder_decode(UtObject *object, UtObject *callback_object,
                             UtJpegDecodeCallback callback);
 
+/// Set [callback] to be called with each row of the image as it is decoded.
+/// [data] contains the pixels for [row] in the same format as
+/// [ut_jpeg_image_get_data] and is only valid during the callback.
+/// When set, the decoded image does not contain any pixel data.
+/// Must be called before decoding starts.
+void ut_jpeg_decoder_set_row_callback(UtObject *object,
+                                      UtObject *callback_object,
+                                      UtJpegDecodeRowCallback callback);
+
 /// Starts decoding an image that has all data available.
 ///
 /// !return-ref
@@ -48,11 +48,11 @@ const char *test_greyscale_data =
     "40307073d01a9bed2f9c616b9dd47c4f7b6b7c608e2b72b9eacad9fe757f4ed66e6eefa282"
     "44882b8392a0e7a13eb522ff00c8c173f41ffa08ab3fc55c4eb7ff002173f5ad8d0ffe42d6"
     "df43ff00a09ae99ada04964b9f2ff7a4649c9e702b165d664361a65c5a697f689afc6443f6"
-    "809b7e5dc792307f4aad2be913453dcdf697347790c8b135bf984b33b0ca85c360e7357f47"
-    "889bbdd36892d8b22931c8d38901ed8e0f079ab5aacda9c584d3ec62ba575218b4fe5943eb"
-    "d39159936817125968967e74d18b4044d35bc9b197e4c707af278ab173a0086c97fb3989ba"
-    "8a75b80f70e5ccac38c313cf4e296c25d66e75b592f6c0d9dac70b2e16e448aec4ae0e063b"
-    "03dabfffd9";
+    "809b7e5dc7e62307f4aad2be913453dcdf697347790c8b135bf984b33b0ca85c360e7357f4"
+    "7889bbdd36892d8b22931c8d38901ed8e0f079ab5aacda9c584d3ec62ba575218b4fe5943e"
+    "bd39159936817125968967e74d18b4044d35bc9b197e4c707af278ab173a0086c97fb3989b"
+    "a8a75b80f70e5ccac38c313cf4e296c25d66e75b592f6c0d9dac70b2e16e448aec4ae0e063"
+    "b03dabffd9";
 
 // Example from https://en.wikipedia.org/wiki/JPEG
 const char *wikipedia_image_data =
@@ -69,3 +69,68 @@ const char *wikipedia_data =
     "a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae1e2"
     "e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9faffda0008010000003f00c54d8b0b4650994b02"
     "1bd057ffd9";
+
+// Python logo, 16x16 RGB.
+const char *test_color_image_data =
+    "0002080000050100040004106582a05884ab4f7fad497bac4976af436b9c4163"
+    "7e00061300010603000000020000020000050d00030b0001090003126586a5d8"
+    "ffff5083ae4074a33f6da1436c9a4d6c89000413000105010000000100010600"
+    "00030b00040e00091900071e5782a24b7fa4427a9f437aa13b6b99456b98405d"
+    "7f000219000309030804000200000501000b1f6a8aa15f84a15782a54d7fa442"
+    "7a9f336f942b668e396e9a3c66904a6286000713010300070300090700050200"
+    "5590b85288b45684b6507eb2447aa83a77a33675a131709c2a67933e6e944961"
+    "7d000200efde8ef6de7ee5d1941100004a8dc24d8cc14f84ba4a7db24176a842"
+    "7ba838729a346b92386e944169824d5d5c0f0900fbde69fbd856e9ce77180000"
+    "578bc54b83b64882a8437ba04070a1446f9c3e6a8741677e43627e45585c0806"
+    "00ddcb69f6d44cfcd64ff0d3751901004e80b54e82b1427b9947799047677e1c"
+    "323f000700000a00000700060800d2c463f7db56ffdb44f3ce41eacd671c0300"
+    "4983ab437ba0487999456771000600e3dea6f1e696f0e482f1e67aeee065f8dd"
+    "52fcd941f8d231f2ce3aecd0621b0400467f9d4b7e9d49708d223634dfde9efb"
+    "e882ffe46cffe35af8dd48fddf43f9d235ffd737fad12bf4d03ed6be541a0800"
+    "497894466e88506880000400f4ec97ffec6fffdf5affda4fffd847ffd743ffd2"
+    "39fbc628fbcb29f3cd44ae99460f030000061b000a1c000212090900f5e784f7"
+    "dd52ffdd4ef0c133efc034eebf33edbc33e9bb34dfb837b89b35120100140600"
+    "00000b000209000306070300efdd71ffe755ffdc46fdd542f7d148f1cf51e8c8"
+    "571e05001103001105001402000e0000070000040000040301080200f6e27ff9"
+    "dc5af4d24df8d553efd155ffff95d9c56e0e04000404000001000700020d0006"
+    "060201030200010000070100dccb85e4cd6feed175ebcc6fe7ce6ad5c067aa9b"
+    "5a09040000030001070700000401000500010000000001000207010014050017"
+    "04001b01001d02001b03001906000f0200060200000300000304000105000106";
+const char *test_color_data =
+    "ffd8ffe000104a46494600010100000100010000ffdb008400100b0c0e0c0a100e0d0e1211"
+    "101318281a181616183123251d283a333d3c3933383740485c4e404457453738506d51575f"
+    "626768673e4d71797064785c656763011112121815182f1a1a2f6342384263636363636363"
+    "63636363636363636363636363636363636363636363636363636363636363636363636363"
+    "636363636363ffc00011080010001003001100011101021101ffc401a20000010501010101"
+    "010100000000000000000102030405060708090a0b01000301010101010101010100000000"
+    "00000102030405060708090a0b100002010303020403050504040000017d01020300041105"
+    "122131410613516107227114328191a1082342b1c11552d1f02433627282090a161718191a"
+    "25262728292a3435363738393a434445464748494a535455565758595a636465666768696a"
+    "737475767778797a838485868788898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4"
+    "b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae1e2e3e4e5e6e7e8e9eaf1f2f3"
+    "f4f5f6f7f8f9fa110002010204040304070504040001027700010203110405213106124151"
+    "0761711322328108144291a1b1c109233352f0156272d10a162434e125f11718191a262728"
+    "292a35363738393a434445464748494a535455565758595a636465666768696a7374757677"
+    "78797a82838485868788898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8"
+    "b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae2e3e4e5e6e7e8e9eaf2f3f4f5f6f7f8f9"
+    "faffda000c03000001110211003f00cbb6b683488a4db37fad003b498c647a7a575a8a8753"
+    "925273e847368adaa5add6a226d915bc24a1d9b84a46e24039fa73cf5f6ae1af898aa8a0ba"
+    "9d54a9be5bb2ff0083f5781a6bc9afa6b68240a8b19760bc7cc5b193feee7e82b0c6ba934b"
+    "94d28c2311de28f13a2249636862b859a2c34c8f90b9c82303be3dfbd7361f08f994e4cd67"
+    "5125647fffd9";
+
+// Encoded with quality 85, 4:2:0 subsampling and optimized Huffman tables.
+const char *test_color_optimized_data =
+    "ffd8ffe000104a46494600010100000100010000ffdb008400050304040403050404040505"
+    "0506070c08070707070f0b0b090c110f1212110f111113161c1713141a1511111821181a1d"
+    "1d1f1f1f13172224221e241c1e1f1e010505050706070e08080e1e1411141e1e1e1e1e1e1e"
+    "1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e1e"
+    "1e1e1e1e1e1effc00011080010001003002200011101021101ffc400670000030000000000"
+    "00000000000000000003040601010100000000000000000000000000000005100001030400"
+    "06030000000000000000000102030504061112000708132131224142110001020701000000"
+    "000000000000000001020400030511143141f1ffda000c03000001110211003f0080b7e161"
+    "f9771b5c9664d24d736d3752f5676c27641246991f0c927d1271e338ce5296e58bd7edbd70"
+    "5fa9963471d0b18a5d2ac53075120e36975c71295ee9c04e109dc05025447b428715fd2873"
+    "1a1de93ba252ef94b7e22b12c52d3d02ea5e432742a754e8417159c1296b600f9d519fae0d"
+    "d4973d6969a9abacfb7171934cc9c6e8ec9d355871b67b85485b7aa720ab51ef6fd0f07ee6"
+    "55ab8ee638c06526c0104a8eadb3bf60c29c940c870bb93c8fffd9";
@@ -15,10 +15,96 @@ static void check_jpeg(size_t width, size_t height, size_t n_components,
   ut_assert_uint8_list_equal_hex(data, hex_data);
 }
 
+static void check_jpeg_with_options(size_t width, size_t height,
+                                    size_t n_components,
+                                    const char *hex_image_data,
+                                    uint8_t quality,
+                                    UtJpegSubsampling subsampling,
+                                    bool optimize_huffman_tables,
+                                    const char *hex_data) {
+  UtObjectRef data = ut_uint8_array_new();
+  UtObjectRef image_data = ut_uint8_list_new_from_hex_string(hex_image_data);
+  UtObjectRef image =
+      ut_jpeg_image_new(width, height, UT_JPEG_DENSITY_UNITS_NONE, 1, 1,
+                        n_components, image_data);
+  UtObjectRef encoder = ut_jpeg_encoder_new(image, data);
+  ut_jpeg_encoder_set_quality(encoder, quality);
+  ut_jpeg_encoder_set_subsampling(encoder, subsampling);
+  ut_jpeg_encoder_set_optimize_huffman_tables(encoder,
+                                              optimize_huffman_tables);
+  ut_jpeg_encoder_encode(encoder);
+  ut_assert_uint8_list_equal_hex(data, hex_data);
+}
+
+static UtObject *decode_jpeg(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_jpeg_decoder_new(data_stream);
+  UtObject *image = ut_jpeg_decoder_decode_sync(decoder);
+  ut_assert_is_not_error(image);
+  return image;
+}
+
+// Check using restart markers doesn't change the decoded image.
+static void check_restart_jpeg(size_t width, size_t height,
+                               const char *hex_image_data,
+                               uint16_t restart_interval) {
+  UtObjectRef image_data = ut_uint8_list_new_from_hex_string(hex_image_data);
+  UtObjectRef image = ut_jpeg_image_new(
+      width, height, UT_JPEG_DENSITY_UNITS_NONE, 1, 1, 1, image_data);
+
+  UtObjectRef data = ut_uint8_array_new();
+  UtObjectRef encoder = ut_jpeg_encoder_new(image, data);
+  ut_jpeg_encoder_encode(encoder);
+  UtObjectRef restart_data = ut_uint8_array_new();
+  UtObjectRef restart_encoder = ut_jpeg_encoder_new(image, restart_data);
+  ut_jpeg_encoder_set_restart_interval(restart_encoder, restart_interval);
+  ut_jpeg_encoder_encode(restart_encoder);
+
+  UtObjectRef decoded_image = decode_jpeg(data);
+  UtObjectRef restart_decoded_image = decode_jpeg(restart_data);
+  ut_assert_equal(ut_jpeg_image_get_data(restart_decoded_image),
+                  ut_jpeg_image_get_data(decoded_image));
+}
+
+// Check optimized Huffman tables make the data smaller without changing the
+// decoded image.
+static void check_optimized_jpeg(size_t width, size_t height,
+                                 size_t n_components,
+                                 const char *hex_image_data) {
+  UtObjectRef image_data = ut_uint8_list_new_from_hex_string(hex_image_data);
+  UtObjectRef image =
+      ut_jpeg_image_new(width, height, UT_JPEG_DENSITY_UNITS_NONE, 1, 1,
+                        n_components, image_data);
+
+  UtObjectRef data = ut_uint8_array_new();
+  UtObjectRef encoder = ut_jpeg_encoder_new(image, data);
+  ut_jpeg_encoder_encode(encoder);
+  UtObjectRef optimized_data = ut_uint8_array_new();
+  UtObjectRef optimized_encoder = ut_jpeg_encoder_new(image, optimized_data);
+  ut_jpeg_encoder_set_optimize_huffman_tables(optimized_encoder, true);
+  ut_jpeg_encoder_encode(optimized_encoder);
+
+  ut_assert_true(ut_list_get_length(optimized_data) <
+                 ut_list_get_length(data));
+  UtObjectRef decoded_image = decode_jpeg(data);
+  UtObjectRef optimized_decoded_image = decode_jpeg(optimized_data);
+  ut_assert_equal(ut_jpeg_image_get_data(optimized_decoded_image),
+                  ut_jpeg_image_get_data(decoded_image));
+}
+
 int main(int argc, char **argv) {
   check_jpeg(8, 8, 1, wikipedia_image_data, wikipedia_data);
 
   check_jpeg(32, 32, 1, test_greyscale_image_data, test_greyscale_data);
+  check_restart_jpeg(32, 32, test_greyscale_image_data, 1);
+  check_restart_jpeg(32, 32, test_greyscale_image_data, 5);
+  check_optimized_jpeg(32, 32, 1, test_greyscale_image_data);
+
+  check_jpeg(16, 16, 3, test_color_image_data, test_color_data);
+  check_jpeg_with_options(16, 16, 3, test_color_image_data, 85,
+                          UT_JPEG_SUBSAMPLING_420, true,
+                          test_color_optimized_data);
+  check_optimized_jpeg(16, 16, 3, test_color_image_data);
 
   return 0;
 }
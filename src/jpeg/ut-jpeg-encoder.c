@@ -1,9 +1,44 @@
 #include <assert.h>
-#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ut-jpeg.h"
 #include "ut.h"
 
+// Maximum length of a Huffman code.
+#define MAX_CODE_WIDTH 16
+
+// Huffman table and the codes for each value in it.
+typedef struct {
+  // Values in the order they are written in the table.
+  UtObject *symbols;
+  UtObject *encoder;
+
+  // Code for each value, from [encoder].
+  uint16_t codes[256];
+  uint8_t code_widths[256];
+
+  // Number of times each value is used, when generating optimized tables.
+  size_t counts[256];
+} HuffmanTable;
+
+typedef struct {
+  uint8_t horizontal_sampling_factor;
+  uint8_t vertical_sampling_factor;
+
+  // Quantization and Huffman tables used, 0 for luminance and 1 for
+  // chrominance.
+  uint8_t table_index;
+
+  // Samples, padded to a whole number of MCUs.
+  uint8_t *samples;
+  size_t width;
+  size_t height;
+
+  // Last DC value written.
+  int16_t previous_dc;
+} JpegComponent;
+
 typedef struct {
   UtObject object;
 
@@ -16,26 +51,73 @@ typedef struct {
   // Tables for coefficient quantization values.
   UtObject *quantization_tables[4];
 
-  // Huffman encoders for DC coefficients.
-  UtObject *dc_symbols[2]; // FIXME: Can just be a fixed 256 array
-  UtObject *dc_encoders[2];
-
-  // Huffman encoders for AC coefficients.
-  UtObject *ac_symbols[2];
-  UtObject *ac_encoders[2];
+  // Huffman tables for DC and AC coefficients.
+  HuffmanTable dc_tables[2];
+  HuffmanTable ac_tables[2];
 
   // Order that data unit values are written.
   uint8_t data_unit_order[64];
 
-  // Precalculated cosines for DCT.
-  float dct_alpha[8];
-  float dct_cos[64];
+  // Options set before encoding.
+  uint8_t quality;
+  UtJpegSubsampling subsampling;
+  bool optimize_huffman_tables;
+
+  // Number of MCUs between restart markers, or 0 if not used.
+  uint16_t restart_interval;
+
+  // Components being written.
+  JpegComponent components[3];
+  size_t n_components;
+
+  // Dimensions of the image in MCUs.
+  size_t width_in_mcus;
+  size_t height_in_mcus;
+
+  // Quantized coefficients for each data unit, stored when generating
+  // optimized Huffman tables.
+  int16_t *coefficients;
 
   // Current bits being written.
   uint32_t bit_buffer;
   size_t bit_buffer_length;
 } UtJpegEncoder;
 
+// Use [encoder] for the values in [symbols].
+static void set_huffman_table(HuffmanTable *table, UtObject *symbols,
+                              UtObject *encoder) {
+  ut_object_unref(table->symbols);
+  table->symbols = ut_object_ref(symbols);
+  ut_object_unref(table->encoder);
+  table->encoder = ut_object_ref(encoder);
+
+  const uint8_t *symbols_data = ut_uint8_list_get_data(symbols);
+  for (size_t i = 0; i < ut_list_get_length(symbols); i++) {
+    uint16_t code;
+    size_t code_width;
+    ut_huffman_encoder_get_code(encoder, i, &code, &code_width);
+    table->codes[symbols_data[i]] = code;
+    table->code_widths[symbols_data[i]] = code_width;
+  }
+}
+
+// Scale [quantization_table] for [quality] using the same method as the
+// Independent JPEG Group's libjpeg, so quality values are comparable.
+static void scale_quantization_table(UtObject *quantization_table,
+                                     uint8_t quality) {
+  size_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  uint8_t *data = ut_uint8_list_get_writable_data(quantization_table);
+  for (size_t i = 0; i < 64; i++) {
+    size_t value = (data[i] * scale + 50) / 100;
+    if (value < 1) {
+      value = 1;
+    } else if (value > 255) {
+      value = 255;
+    }
+    data[i] = value;
+  }
+}
+
 static void build_tables(UtJpegEncoder *self) {
   // Standard Luminance quantization table and Huffman encoders.
   self->quantization_tables[0] = ut_uint8_list_new_from_elements(
@@ -43,13 +125,16 @@ static void build_tables(UtJpegEncoder *self) {
       13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37,
       56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87,
       103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99);
-  self->dc_symbols[0] =
+  scale_quantization_table(self->quantization_tables[0], self->quality);
+  UtObjectRef luminance_dc_symbols =
       ut_uint8_list_new_from_elements(12, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
   UtObjectRef luminance_dc_code_widths =
       ut_uint8_list_new_from_elements(12, 2, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9);
-  self->dc_encoders[0] =
+  UtObjectRef luminance_dc_encoder =
       ut_huffman_encoder_new_canonical(luminance_dc_code_widths);
-  self->ac_symbols[0] = ut_uint8_list_new_from_elements(
+  set_huffman_table(&self->dc_tables[0], luminance_dc_symbols,
+                    luminance_dc_encoder);
+  UtObjectRef luminance_ac_symbols = ut_uint8_list_new_from_elements(
       162, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
       0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x21, 0x22,
       0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x31, 0x32, 0x33, 0x34,
@@ -74,23 +159,28 @@ static void build_tables(UtJpegEncoder *self) {
       16, 16, 16, 16, 16, 16, 10, 16, 16, 16, 16, 16, 16, 16, 16, 16, 11, 16,
       16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
       11, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16);
-  self->ac_encoders[0] =
+  UtObjectRef luminance_ac_encoder =
       ut_huffman_encoder_new_canonical(luminance_ac_code_widths);
+  set_huffman_table(&self->ac_tables[0], luminance_ac_symbols,
+                    luminance_ac_encoder);
 
   // Standard Chrominance quantization table and Huffman encoders.
-  if (ut_jpeg_image_get_n_components(self->image) > 1) {
+  if (self->n_components > 1) {
     self->quantization_tables[1] = ut_uint8_list_new_from_elements(
         64, 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24,
         26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99,
         99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
         99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99);
-    self->dc_symbols[1] = ut_uint8_list_new_from_elements(12, 0, 1, 2, 3, 4, 5,
-                                                          6, 7, 8, 9, 10, 11);
+    scale_quantization_table(self->quantization_tables[1], self->quality);
+    UtObjectRef chrominance_dc_symbols = ut_uint8_list_new_from_elements(
+        12, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
     UtObjectRef chrominance_dc_code_widths = ut_uint8_list_new_from_elements(
         12, 2, 2, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
-    self->dc_encoders[1] =
+    UtObjectRef chrominance_dc_encoder =
         ut_huffman_encoder_new_canonical(chrominance_dc_code_widths);
-    self->ac_symbols[1] = ut_uint8_list_new_from_elements(
+    set_huffman_table(&self->dc_tables[1], chrominance_dc_symbols,
+                      chrominance_dc_encoder);
+    UtObjectRef chrominance_ac_symbols = ut_uint8_list_new_from_elements(
         162, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
         0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x21, 0x22,
         0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x31, 0x32, 0x33, 0x34,
@@ -115,42 +205,210 @@ static void build_tables(UtJpegEncoder *self) {
         16, 16, 16, 16, 16, 16, 16, 16, 16, 9, 16, 16, 16, 16, 16, 16, 16, 16,
         16, 11, 16, 16, 16, 16, 16, 16, 16, 16, 16, 14, 16, 16, 16, 16, 16, 16,
         16, 16, 16, 10, 15, 16, 16, 16, 16, 16, 16, 16, 16, 16);
-    self->ac_encoders[1] =
+    UtObjectRef chrominance_ac_encoder =
         ut_huffman_encoder_new_canonical(chrominance_ac_code_widths);
+    set_huffman_table(&self->ac_tables[1], chrominance_ac_symbols,
+                      chrominance_ac_encoder);
+  }
+}
+
+// Generate an optimized Huffman table from the values counted in [table].
+static void build_optimized_huffman_table(HuffmanTable *table) {
+  // Add a reserved symbol, so no code is all 1 bits as required by ITU T.81
+  // Annex C.
+  size_t n_symbols = 257;
+  UtObjectRef weights = ut_float64_array_new_sized(n_symbols);
+  double *weights_data = ut_float64_list_get_writable_data(weights);
+  for (size_t i = 0; i < 256; i++) {
+    weights_data[i] = table->counts[i];
+  }
+  weights_data[256] = 1;
+  UtObjectRef limited_encoder =
+      ut_huffman_encoder_new_length_limited(weights, MAX_CODE_WIDTH);
+
+  UtObjectRef code_widths = ut_uint8_array_new_sized(n_symbols);
+  uint8_t *code_widths_data = ut_uint8_list_get_writable_data(code_widths);
+  size_t max_code_width = 0;
+  for (size_t i = 0; i < n_symbols; i++) {
+    uint16_t code;
+    size_t code_width;
+    ut_huffman_encoder_get_code(limited_encoder, i, &code, &code_width);
+    code_widths_data[i] = code_width;
+    if (code_width > max_code_width) {
+      max_code_width = code_width;
+    }
   }
+
+  // Canonical codes are assigned in symbol order, so the reserved symbol gets
+  // the all 1 bits code if it has the longest code.
+  uint8_t reserved_code_width = code_widths_data[256];
+  if (reserved_code_width != max_code_width) {
+    size_t i = 255;
+    while (code_widths_data[i] != max_code_width) {
+      i--;
+    }
+    code_widths_data[i] = reserved_code_width;
+    code_widths_data[256] = max_code_width;
+  }
+  UtObjectRef encoder = ut_huffman_encoder_new_canonical(code_widths);
+
+  UtObjectRef symbols = ut_uint8_array_new_sized(256);
+  uint8_t *symbols_data = ut_uint8_list_get_writable_data(symbols);
+  for (size_t i = 0; i < 256; i++) {
+    symbols_data[i] = i;
+  }
+  set_huffman_table(table, symbols, encoder);
 }
 
-// Create the data unit at [data_unit_x], [data_unit_y] containing the given
-// image [component]. and write into [data_unit].
-static void create_data_unit(UtJpegEncoder *self, size_t data_unit_x,
-                             size_t data_unit_y, size_t component,
-                             int16_t *data_unit) {
-  uint16_t image_width = ut_jpeg_image_get_width(self->image);
-  uint16_t image_height = ut_jpeg_image_get_height(self->image);
+// Reduce the resolution of the samples in [component] by [scale_x] and
+// [scale_y], averaging the samples that are combined.
+static void downsample_component(JpegComponent *component, size_t scale_x,
+                                 size_t scale_y) {
+  size_t width = component->width / scale_x;
+  size_t height = component->height / scale_y;
+  size_t n_samples = scale_x * scale_y;
+  uint8_t *samples = malloc(width * height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const uint8_t *s = component->samples +
+                         (y * scale_y * component->width) + (x * scale_x);
+      size_t sum = 0;
+      for (size_t sy = 0; sy < scale_y; sy++) {
+        for (size_t sx = 0; sx < scale_x; sx++) {
+          sum += s[(sy * component->width) + sx];
+        }
+      }
+      samples[(y * width) + x] = (sum + n_samples / 2) / n_samples;
+    }
+  }
+
+  free(component->samples);
+  component->samples = samples;
+  component->width = width;
+  component->height = height;
+}
+
+// Convert the image into the component samples.
+static void build_components(UtJpegEncoder *self) {
+  size_t image_width = ut_jpeg_image_get_width(self->image);
+  size_t image_height = ut_jpeg_image_get_height(self->image);
   size_t n_components = ut_jpeg_image_get_n_components(self->image);
   const uint8_t *image_data =
       ut_uint8_list_get_data(ut_jpeg_image_get_data(self->image));
+  assert(n_components == 1 || n_components == 3);
+
+  // Luminance has the highest resolution, chrominance may be subsampled.
+  size_t max_horizontal_sampling_factor = 1;
+  size_t max_vertical_sampling_factor = 1;
+  if (n_components == 3) {
+    switch (self->subsampling) {
+    case UT_JPEG_SUBSAMPLING_444:
+      break;
+    case UT_JPEG_SUBSAMPLING_422:
+      max_horizontal_sampling_factor = 2;
+      break;
+    case UT_JPEG_SUBSAMPLING_420:
+      max_horizontal_sampling_factor = 2;
+      max_vertical_sampling_factor = 2;
+      break;
+    }
+  }
+  size_t mcu_width = max_horizontal_sampling_factor * 8;
+  size_t mcu_height = max_vertical_sampling_factor * 8;
+  self->width_in_mcus = (image_width + mcu_width - 1) / mcu_width;
+  self->height_in_mcus = (image_height + mcu_height - 1) / mcu_height;
+
+  size_t width = self->width_in_mcus * mcu_width;
+  size_t height = self->height_in_mcus * mcu_height;
+  self->n_components = n_components;
+  for (size_t i = 0; i < n_components; i++) {
+    JpegComponent *component = &self->components[i];
+    component->horizontal_sampling_factor =
+        i == 0 ? max_horizontal_sampling_factor : 1;
+    component->vertical_sampling_factor =
+        i == 0 ? max_vertical_sampling_factor : 1;
+    component->table_index = i == 0 ? 0 : 1;
+    component->samples = malloc(width * height);
+    component->width = width;
+    component->height = height;
+  }
+
+  // Convert to full resolution samples, and pad to a whole number of MCUs by
+  // repeating the last column and row.
+  for (size_t y = 0; y < height; y++) {
+    size_t image_y = y < image_height ? y : image_height - 1;
+    const uint8_t *image_row =
+        image_data + (image_y * image_width * n_components);
+    uint8_t *rows[3];
+    for (size_t i = 0; i < n_components; i++) {
+      rows[i] = self->components[i].samples + (y * width);
+    }
+    if (n_components == 1) {
+      memcpy(rows[0], image_row, image_width);
+    } else {
+      jpeg_rgb_to_ycbcr(image_row, rows[0], rows[1], rows[2], image_width);
+    }
+    for (size_t i = 0; i < n_components; i++) {
+      memset(rows[i] + image_width, rows[i][image_width - 1],
+             width - image_width);
+    }
+  }
+
+  for (size_t i = 1; i < n_components; i++) {
+    downsample_component(&self->components[i], max_horizontal_sampling_factor,
+                         max_vertical_sampling_factor);
+  }
+}
 
+// Create the data unit at [data_unit_x], [data_unit_y] in [component] and
+// write into [data_unit].
+static void create_data_unit(JpegComponent *component, size_t data_unit_x,
+                             size_t data_unit_y, int16_t *data_unit) {
+  const uint8_t *samples = component->samples +
+                           (data_unit_y * 8 * component->width) +
+                           (data_unit_x * 8);
   for (size_t y = 0; y < 8; y++) {
     for (size_t x = 0; x < 8; x++) {
-      size_t ix = data_unit_x * 8 + x;
-      if (ix >= image_width) {
-        ix = image_width - 1;
-      }
-      size_t iy = data_unit_y * 8 + y;
-      if (iy >= image_height) {
-        iy = image_height - 1;
-      }
-      int16_t value = image_data[(iy * image_width * n_components) +
-                                 (ix * n_components) + component];
-      data_unit[(y * 8) + x] = (value - 128);
+      data_unit[(y * 8) + x] = samples[(y * component->width) + x] - 128;
     }
   }
 }
 
-// Write the integer [value] of [length] bits to [buffer].
+// Calculate the quantized [coefficients] for the data unit at [data_unit_x],
+// [data_unit_y] in [component], in zigzag order.
+static void get_coefficients(UtJpegEncoder *self, JpegComponent *component,
+                             size_t data_unit_x, size_t data_unit_y,
+                             int16_t *coefficients) {
+  const uint8_t *quantization_table_data = ut_uint8_list_get_data(
+      self->quantization_tables[component->table_index]);
+
+  // Copy values from image data into data unit.
+  int16_t data_unit[64];
+  create_data_unit(component, data_unit_x, data_unit_y, data_unit);
+
+  // Perform the discrete cosine transform on the data.
+  int32_t encoded_data_unit[64];
+  jpeg_dct(data_unit, 8, encoded_data_unit);
+
+  // Quantize coefficients and put into zigzag order. The DCT output is
+  // scaled by 8, which is removed here.
+  for (size_t i = 0; i < 64; i++) {
+    uint8_t j = self->data_unit_order[i];
+    int32_t divisor = 8 * quantization_table_data[j];
+    int32_t value = encoded_data_unit[j];
+    coefficients[i] = value >= 0 ? (value + divisor / 2) / divisor
+                                 : -((divisor / 2 - value) / divisor);
+  }
+}
+
+// Write the integer [value] of [length] bits to [buffer]. Nothing is written
+// if [buffer] is NULL, which is used when only counting the values used.
 static void write_int(UtJpegEncoder *self, UtObject *buffer,
                       size_t value_length, uint16_t value) {
+  if (buffer == NULL) {
+    return;
+  }
+
   self->bit_buffer = self->bit_buffer << value_length | value;
   self->bit_buffer_length += value_length;
   while (self->bit_buffer_length >= 8) {
@@ -188,6 +446,9 @@ static void write_amplitude(UtJpegEncoder *self, UtObject *buffer,
   // 2 bits: -3,-2, 2, 3
   // 3 bits: -7,-6,-5,-4, 4, 5, 6, 7
   // ...
+  if (length == 0) {
+    return;
+  }
   int16_t min_amplitude = 1 << (length - 1);
   uint16_t value;
   if (amplitude > 0) {
@@ -213,46 +474,67 @@ static size_t get_amplitude_length(int16_t amplitude) {
   return length;
 }
 
-static uint16_t get_symbol(UtObject *symbols, uint8_t value) {
-  for (size_t i = 0; i < ut_list_get_length(symbols); i++) {
-    if (ut_uint8_list_get_element(symbols, i) == value) {
-      return i;
-    }
+static void write_huffman_code(UtJpegEncoder *self, UtObject *buffer,
+                               HuffmanTable *table, uint8_t value) {
+  if (buffer == NULL) {
+    table->counts[value]++;
+    return;
   }
 
-  assert(false);
-}
-
-static void write_huffman_code(UtJpegEncoder *self, UtObject *buffer,
-                               UtObject *symbols, UtObject *encoder,
-                               uint8_t value) {
-  uint16_t symbol = get_symbol(symbols, value);
-  uint16_t code;
-  size_t code_width;
-  ut_huffman_encoder_get_code(encoder, symbol, &code, &code_width);
-  write_int(self, buffer, code_width, code);
+  assert(table->code_widths[value] > 0);
+  write_int(self, buffer, table->code_widths[value], table->codes[value]);
 }
 
 static void write_dc_coefficient(UtJpegEncoder *self, UtObject *buffer,
-                                 UtObject *symbols, UtObject *encoder,
-                                 int16_t diff) {
+                                 HuffmanTable *table, int16_t diff) {
   size_t length = get_amplitude_length(diff);
-  write_huffman_code(self, buffer, symbols, encoder, length);
+  write_huffman_code(self, buffer, table, length);
   write_amplitude(self, buffer, length, diff);
 }
 
 static void write_ac_coefficient(UtJpegEncoder *self, UtObject *buffer,
-                                 UtObject *symbols, UtObject *encoder,
-                                 size_t run_length, int16_t coefficient) {
+                                 HuffmanTable *table, size_t run_length,
+                                 int16_t coefficient) {
   size_t length = get_amplitude_length(coefficient);
-  write_huffman_code(self, buffer, symbols, encoder,
-                     (run_length << 4) | length);
+  write_huffman_code(self, buffer, table, (run_length << 4) | length);
   write_amplitude(self, buffer, length, coefficient);
 }
 
-static void write_eob(UtJpegEncoder *self, UtObject *buffer, UtObject *symbols,
-                      UtObject *encoder) {
-  write_huffman_code(self, buffer, symbols, encoder, 0);
+static void write_eob(UtJpegEncoder *self, UtObject *buffer,
+                      HuffmanTable *table) {
+  write_huffman_code(self, buffer, table, 0);
+}
+
+// Write the quantized [coefficients] for a data unit in [component].
+static void write_data_unit(UtJpegEncoder *self, UtObject *buffer,
+                            JpegComponent *component,
+                            const int16_t *coefficients) {
+  HuffmanTable *dc_table = &self->dc_tables[component->table_index];
+  HuffmanTable *ac_table = &self->ac_tables[component->table_index];
+
+  int16_t dc = coefficients[0];
+  int16_t diff = dc - component->previous_dc;
+  component->previous_dc = dc;
+  write_dc_coefficient(self, buffer, dc_table, diff);
+  for (size_t i = 1; i < 64;) {
+    // Count number of zeros before the next coefficient.
+    size_t run_length = 0;
+    while (i + run_length < 64 && coefficients[i + run_length] == 0) {
+      run_length++;
+    }
+
+    if (i + run_length >= 64) {
+      write_eob(self, buffer, ac_table);
+      i = 64;
+    } else if (run_length <= 15) {
+      write_ac_coefficient(self, buffer, ac_table, run_length,
+                           coefficients[i + run_length]);
+      i += run_length + 1;
+    } else {
+      write_ac_coefficient(self, buffer, ac_table, 15, 0);
+      i += 16;
+    }
+  }
 }
 
 static void write_marker(UtObject *buffer, uint8_t value) {
@@ -329,11 +611,10 @@ static void write_define_quantization_table(UtJpegEncoder *self) {
 static void write_start_of_frame(UtJpegEncoder *self) {
   size_t image_width = ut_jpeg_image_get_width(self->image);
   size_t image_height = ut_jpeg_image_get_height(self->image);
-  size_t n_components = ut_jpeg_image_get_n_components(self->image);
 
   uint8_t precision = 8;
 
-  size_t length = 8 + 3 * n_components;
+  size_t length = 8 + 3 * self->n_components;
 
   UtObjectRef sof = ut_uint8_list_new();
   write_marker(sof, 0xc0);
@@ -341,33 +622,30 @@ static void write_start_of_frame(UtJpegEncoder *self) {
   ut_uint8_list_append(sof, precision);
   ut_uint8_list_append_uint16_be(sof, image_height);
   ut_uint8_list_append_uint16_be(sof, image_width);
-  ut_uint8_list_append(sof, n_components);
-  for (size_t i = 0; i < n_components; i++) {
+  ut_uint8_list_append(sof, self->n_components);
+  for (size_t i = 0; i < self->n_components; i++) {
+    JpegComponent *component = &self->components[i];
     uint8_t id = i;
-    uint8_t horizontal_sampling_factor = 1;
-    uint8_t vertical_sampling_factor = 1;
-    uint8_t quantization_table = 0; // FIXME
 
     ut_uint8_list_append(sof, id);
-    ut_uint8_list_append(sof, horizontal_sampling_factor << 4 |
-                                  vertical_sampling_factor);
-    ut_uint8_list_append(sof, quantization_table);
+    ut_uint8_list_append(sof, component->horizontal_sampling_factor << 4 |
+                                  component->vertical_sampling_factor);
+    ut_uint8_list_append(sof, component->table_index);
   }
   ut_output_stream_write(self->output_stream, sof);
 }
 
 static void write_huffman_table(UtObject *buffer, uint8_t class,
-                                uint8_t destination, UtObject *symbols,
-                                UtObject *encoder) {
-  size_t symbols_length = ut_list_get_length(symbols);
+                                uint8_t destination, HuffmanTable *table) {
+  size_t symbols_length = ut_list_get_length(table->symbols);
 
   ut_uint8_list_append(buffer, class << 4 | destination);
-  for (size_t length = 1; length <= 16; length++) {
+  for (size_t length = 1; length <= MAX_CODE_WIDTH; length++) {
     uint8_t count = 0;
     for (size_t i = 0; i < symbols_length; i++) {
       uint16_t code;
       size_t code_width;
-      ut_huffman_encoder_get_code(encoder, i, &code, &code_width);
+      ut_huffman_encoder_get_code(table->encoder, i, &code, &code_width);
       if (code_width == length) {
         assert(count < 255);
         count++;
@@ -375,13 +653,13 @@ static void write_huffman_table(UtObject *buffer, uint8_t class,
     }
     ut_uint8_list_append(buffer, count);
   }
-  for (size_t length = 1; length <= 16; length++) {
+  for (size_t length = 1; length <= MAX_CODE_WIDTH; length++) {
     for (size_t i = 0; i < symbols_length; i++) {
       uint16_t code;
       size_t code_width;
-      ut_huffman_encoder_get_code(encoder, i, &code, &code_width);
+      ut_huffman_encoder_get_code(table->encoder, i, &code, &code_width);
       if (code_width == length) {
-        uint8_t symbol = ut_uint8_list_get_element(symbols, i);
+        uint8_t symbol = ut_uint8_list_get_element(table->symbols, i);
         ut_uint8_list_append(buffer, symbol);
       }
     }
@@ -389,121 +667,140 @@ static void write_huffman_table(UtObject *buffer, uint8_t class,
 }
 
 static void write_define_huffman_table(UtJpegEncoder *self) {
-  size_t length = 2;
+  // Optimized tables don't use all the symbols, so the length is only known
+  // after the tables are written.
+  UtObjectRef tables = ut_uint8_list_new();
   for (size_t i = 0; i < 2; i++) {
-    if (self->dc_encoders[i] != NULL) {
-      length += 17 + ut_list_get_length(self->dc_symbols[i]);
+    if (self->dc_tables[i].encoder != NULL) {
+      write_huffman_table(tables, 0, i, &self->dc_tables[i]);
     }
-    if (self->ac_encoders[i] != NULL) {
-      length += 17 + ut_list_get_length(self->ac_symbols[i]);
+  }
+  for (size_t i = 0; i < 2; i++) {
+    if (self->ac_tables[i].encoder != NULL) {
+      write_huffman_table(tables, 1, i, &self->ac_tables[i]);
     }
   }
 
   UtObjectRef dht = ut_uint8_list_new();
   write_marker(dht, 0xc4);
-  ut_uint8_list_append_uint16_be(dht, length);
-  for (size_t i = 0; i < 2; i++) {
-    if (self->dc_encoders[i] != NULL) {
-      write_huffman_table(dht, 0, i, self->dc_symbols[i], self->dc_encoders[i]);
+  ut_uint8_list_append_uint16_be(dht, 2 + ut_list_get_length(tables));
+  ut_list_append_list(dht, tables);
+  ut_output_stream_write(self->output_stream, dht);
+}
+
+static void write_define_restart_interval(UtJpegEncoder *self) {
+  if (self->restart_interval == 0) {
+    return;
+  }
+
+  UtObjectRef dri = ut_uint8_list_new();
+  write_marker(dri, 0xdd);
+  ut_uint8_list_append_uint16_be(dri, 4);
+  ut_uint8_list_append_uint16_be(dri, self->restart_interval);
+  ut_output_stream_write(self->output_stream, dri);
+}
+
+// Write the data units in each MCU to [buffer], or count the values used if
+// [buffer] is NULL. If [coefficients] is not NULL, the quantized coefficients
+// are stored there when counting and reused when writing.
+static void write_scan_data(UtJpegEncoder *self, UtObject *buffer,
+                            int16_t *coefficients) {
+  bool reuse_coefficients = buffer != NULL && coefficients != NULL;
+
+  for (size_t i = 0; i < self->n_components; i++) {
+    self->components[i].previous_dc = 0;
+  }
+
+  size_t n_mcus = self->width_in_mcus * self->height_in_mcus;
+  for (size_t mcu = 0; mcu < n_mcus; mcu++) {
+    // Start each restart interval on a new byte after a restart marker,
+    // without a DC prediction.
+    if (self->restart_interval > 0 && mcu > 0 &&
+        mcu % self->restart_interval == 0) {
+      if (buffer != NULL) {
+        end_bits(self, buffer);
+        write_marker(buffer, 0xd0 + (mcu / self->restart_interval - 1) % 8);
+      }
+      for (size_t i = 0; i < self->n_components; i++) {
+        self->components[i].previous_dc = 0;
+      }
+    }
+
+    size_t mcu_x = mcu % self->width_in_mcus;
+    size_t mcu_y = mcu / self->width_in_mcus;
+    for (size_t i = 0; i < self->n_components; i++) {
+      JpegComponent *component = &self->components[i];
+      size_t horizontal_sampling_factor =
+          component->horizontal_sampling_factor;
+      size_t vertical_sampling_factor = component->vertical_sampling_factor;
+      for (size_t y = 0; y < vertical_sampling_factor; y++) {
+        for (size_t x = 0; x < horizontal_sampling_factor; x++) {
+          int16_t data_unit_coefficients[64];
+          int16_t *c = data_unit_coefficients;
+          if (coefficients != NULL) {
+            c = coefficients;
+            coefficients += 64;
+          }
+          if (!reuse_coefficients) {
+            get_coefficients(self, component,
+                             mcu_x * horizontal_sampling_factor + x,
+                             mcu_y * vertical_sampling_factor + y, c);
+          }
+          write_data_unit(self, buffer, component, c);
+        }
+      }
     }
   }
+}
+
+// Replace the standard Huffman tables with ones generated from the values
+// used in this image. The coefficients calculated are stored in
+// [self->coefficients] for use when writing the scan.
+static void optimize_huffman_tables(UtJpegEncoder *self) {
+  size_t data_units_per_mcu = 0;
+  for (size_t i = 0; i < self->n_components; i++) {
+    data_units_per_mcu += self->components[i].horizontal_sampling_factor *
+                          self->components[i].vertical_sampling_factor;
+  }
+  size_t n_data_units =
+      self->width_in_mcus * self->height_in_mcus * data_units_per_mcu;
+  self->coefficients = malloc(sizeof(int16_t) * 64 * n_data_units);
+
+  write_scan_data(self, NULL, self->coefficients);
+
   for (size_t i = 0; i < 2; i++) {
-    if (self->ac_encoders[i] != NULL) {
-      write_huffman_table(dht, 1, i, self->ac_symbols[i], self->ac_encoders[i]);
+    if (self->dc_tables[i].encoder != NULL) {
+      build_optimized_huffman_table(&self->dc_tables[i]);
+    }
+    if (self->ac_tables[i].encoder != NULL) {
+      build_optimized_huffman_table(&self->ac_tables[i]);
     }
   }
-  ut_output_stream_write(self->output_stream, dht);
 }
 
 static void write_start_of_scan(UtJpegEncoder *self) {
-  size_t image_width = ut_jpeg_image_get_width(self->image);
-  size_t image_height = ut_jpeg_image_get_height(self->image);
-  size_t n_components = ut_jpeg_image_get_n_components(self->image);
-
-  size_t length = 3 + 5 * n_components;
+  size_t length = 6 + 2 * self->n_components;
 
   UtObjectRef sos = ut_uint8_list_new();
   write_marker(sos, 0xda);
   ut_uint8_list_append_uint16_be(sos, length);
-  ut_uint8_list_append(sos, n_components);
-  for (size_t i = 0; i < n_components; i++) {
-    uint8_t component_selector = i; // FIXME
-    uint8_t dc_table = 0;           // FIXME
-    uint8_t ac_table = 0;           // FIXME
-    uint8_t selection_start = 0;
-    uint8_t selection_end = 63;
-    uint8_t successive_approximation = 0;
+  ut_uint8_list_append(sos, self->n_components);
+  for (size_t i = 0; i < self->n_components; i++) {
+    uint8_t component_selector = i;
+    uint8_t dc_table = self->components[i].table_index;
+    uint8_t ac_table = self->components[i].table_index;
 
     ut_uint8_list_append(sos, component_selector);
     ut_uint8_list_append(sos, dc_table << 4 | ac_table);
-    ut_uint8_list_append(sos, selection_start);
-    ut_uint8_list_append(sos, selection_end);
-    ut_uint8_list_append(sos, successive_approximation);
-  }
-
-  size_t width_in_data_units = (image_width + 7) / 8;
-  size_t height_in_data_units = (image_height + 7) / 8;
-  int16_t previous_dc = 0;
-  for (size_t component = 0; component < n_components; component++) {
-    uint8_t quantization_table_index = 0; // FIXME
-    uint8_t dc_table = 0;                 // FIXME
-    uint8_t ac_table = 0;                 // FIXME
-
-    UtObject *quantization_table =
-        self->quantization_tables[quantization_table_index];
-    UtObject *dc_symbols = self->dc_symbols[dc_table];
-    UtObject *dc_encoder = self->dc_encoders[dc_table];
-    UtObject *ac_symbols = self->ac_symbols[ac_table];
-    UtObject *ac_encoder = self->ac_encoders[ac_table];
-
-    const uint8_t *quantization_table_data =
-        ut_uint8_list_get_data(quantization_table);
-
-    for (size_t y = 0; y < height_in_data_units; y++) {
-      for (size_t x = 0; x < width_in_data_units; x++) {
-        int16_t data_unit[64], coefficients[64];
-        float encoded_data_unit[64];
-
-        // Copy values from image data into data unit.
-        create_data_unit(self, x, y, component, data_unit);
-
-        // Perform the discrete cosine transform on the data.
-        jpeg_dct(self->dct_alpha, self->dct_cos, data_unit, encoded_data_unit);
-
-        // Quantize coefficients and put into zigzag order.
-        for (size_t i = 0; i < 64; i++) {
-          uint8_t j = self->data_unit_order[i];
-          coefficients[i] =
-              round(encoded_data_unit[j] / (float)quantization_table_data[j]);
-        }
-
-        // Write out coefficients.
-        int16_t dc = coefficients[0];
-        int16_t diff = dc - previous_dc;
-        previous_dc = dc;
-        write_dc_coefficient(self, sos, dc_symbols, dc_encoder, diff);
-        for (size_t i = 1; i < 64;) {
-          // Count number of zeros before the next coefficient.
-          size_t run_length = 0;
-          while (coefficients[i + run_length] == 0 && i + run_length < 64) {
-            run_length++;
-          }
-
-          if (i + run_length >= 64) {
-            write_eob(self, sos, ac_symbols, ac_encoder);
-            i = 64;
-          } else if (run_length <= 15) {
-            write_ac_coefficient(self, sos, ac_symbols, ac_encoder, run_length,
-                                 coefficients[i + run_length]);
-            i += run_length + 1;
-          } else {
-            write_ac_coefficient(self, sos, ac_symbols, ac_encoder, 15, 0);
-            i += 16;
-          }
-        }
-      }
-    }
   }
+  uint8_t selection_start = 0;
+  uint8_t selection_end = 63;
+  uint8_t successive_approximation = 0;
+  ut_uint8_list_append(sos, selection_start);
+  ut_uint8_list_append(sos, selection_end);
+  ut_uint8_list_append(sos, successive_approximation);
+
+  write_scan_data(self, sos, self->coefficients);
 
   // Write any partially complete byte.
   end_bits(self, sos);
@@ -526,11 +823,15 @@ static void ut_jpeg_encoder_cleanup(UtObject *object) {
     ut_object_unref(self->quantization_tables[i]);
   }
   for (size_t i = 0; i < 2; i++) {
-    ut_object_unref(self->dc_symbols[i]);
-    ut_object_unref(self->dc_encoders[i]);
-    ut_object_unref(self->ac_symbols[i]);
-    ut_object_unref(self->ac_encoders[i]);
+    ut_object_unref(self->dc_tables[i].symbols);
+    ut_object_unref(self->dc_tables[i].encoder);
+    ut_object_unref(self->ac_tables[i].symbols);
+    ut_object_unref(self->ac_tables[i].encoder);
+  }
+  for (size_t i = 0; i < self->n_components; i++) {
+    free(self->components[i].samples);
   }
+  free(self->coefficients);
 }
 
 static UtObjectInterface object_interface = {
@@ -541,23 +842,58 @@ UtObject *ut_jpeg_encoder_new(UtObject *image, UtObject *output_stream) {
   UtJpegEncoder *self = (UtJpegEncoder *)object;
   self->image = ut_object_ref(image);
   self->output_stream = ut_object_ref(output_stream);
+  self->quality = 50;
+  self->subsampling = UT_JPEG_SUBSAMPLING_444;
 
-  build_tables(self);
   jpeg_build_data_unit_order(self->data_unit_order);
-  jpeg_build_dct_values(self->dct_alpha, self->dct_cos);
 
   return object;
 }
 
+void ut_jpeg_encoder_set_quality(UtObject *object, uint8_t quality) {
+  assert(ut_object_is_jpeg_encoder(object));
+  UtJpegEncoder *self = (UtJpegEncoder *)object;
+  assert(quality >= 1 && quality <= 100);
+  self->quality = quality;
+}
+
+void ut_jpeg_encoder_set_subsampling(UtObject *object,
+                                     UtJpegSubsampling subsampling) {
+  assert(ut_object_is_jpeg_encoder(object));
+  UtJpegEncoder *self = (UtJpegEncoder *)object;
+  self->subsampling = subsampling;
+}
+
+void ut_jpeg_encoder_set_optimize_huffman_tables(
+    UtObject *object, bool optimize_huffman_tables) {
+  assert(ut_object_is_jpeg_encoder(object));
+  UtJpegEncoder *self = (UtJpegEncoder *)object;
+  self->optimize_huffman_tables = optimize_huffman_tables;
+}
+
+void ut_jpeg_encoder_set_restart_interval(UtObject *object,
+                                          uint16_t restart_interval) {
+  assert(ut_object_is_jpeg_encoder(object));
+  UtJpegEncoder *self = (UtJpegEncoder *)object;
+  self->restart_interval = restart_interval;
+}
+
 void ut_jpeg_encoder_encode(UtObject *object) {
   assert(ut_object_is_jpeg_encoder(object));
   UtJpegEncoder *self = (UtJpegEncoder *)object;
 
+  build_components(self);
+  build_tables(self);
+  if (self->optimize_huffman_tables) {
+    optimize_huffman_tables(self);
+  }
+
   write_start_of_image(self);
   write_app0(self);
   write_define_quantization_table(self);
   write_start_of_frame(self);
   write_define_huffman_table(self);
+  write_define_restart_interval(self);
   write_start_of_scan(self);
   write_end_of_image(self);
 }
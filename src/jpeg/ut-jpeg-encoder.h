@@ -1,9 +1,20 @@
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "ut-object.h"
 
 #pragma once
 
+/// Resolution of the chrominance samples relative to the luminance samples:
+/// - [UT_JPEG_SUBSAMPLING_444] - full resolution.
+/// - [UT_JPEG_SUBSAMPLING_422] - half horizontal resolution.
+/// - [UT_JPEG_SUBSAMPLING_420] - half horizontal and vertical resolution.
+typedef enum {
+  UT_JPEG_SUBSAMPLING_444,
+  UT_JPEG_SUBSAMPLING_422,
+  UT_JPEG_SUBSAMPLING_420
+} UtJpegSubsampling;
+
 /// Creates a new JPEG encoder to write [image] to [output_stream].
 ///
 /// !arg-type image UtJpegImage
@@ -12,6 +23,28 @@
 /// !return-type UtJpegEncoder
 UtObject *ut_jpeg_encoder_new(UtObject *image, UtObject *output_stream);
 
+/// Sets the [quality] of the image from 1 (smallest) to 100 (best). Higher
+/// values scale down the quantization tables, keeping more detail. The default
+/// of 50 uses the example tables from ITU T.81 Annex K.
+void ut_jpeg_encoder_set_quality(UtObject *object, uint8_t quality);
+
+/// Sets the chrominance [subsampling] used for color images. The default is
+/// [UT_JPEG_SUBSAMPLING_444].
+void ut_jpeg_encoder_set_subsampling(UtObject *object,
+                                     UtJpegSubsampling subsampling);
+
+/// Sets if Huffman tables are generated for this image. This makes the image
+/// smaller, but requires encoding in two passes. By default the example tables
+/// from ITU T.81 Annex K are used.
+void ut_jpeg_encoder_set_optimize_huffman_tables(UtObject *object,
+                                                 bool optimize_huffman_tables);
+
+/// Sets the number of MCUs between restart markers, or 0 to not use restart
+/// markers (the default). Restart markers allow the image to be decoded in
+/// parallel, see [ut_jpeg_decoder_new_parallel].
+void ut_jpeg_encoder_set_restart_interval(UtObject *object,
+                                          uint16_t restart_interval);
+
 /// Start encoding.
 void ut_jpeg_encoder_encode(UtObject *object);
 
@@ -38,7 +38,8 @@ UtObject *ut_jpeg_image_new(uint16_t width, uint16_t height,
   UtObject *object = ut_object_new(sizeof(UtJpegImage), &object_interface);
   UtJpegImage *self = (UtJpegImage *)object;
 
-  assert(ut_list_get_length(data) == width * height * n_components);
+  size_t data_length = ut_list_get_length(data);
+  assert(data_length == width * height * n_components || data_length == 0);
 
   self->width = width;
   self->height = height;
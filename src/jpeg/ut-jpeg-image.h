@@ -16,7 +16,8 @@ typedef enum {
 } UtJpegDensityUnits;
 
 /// Creates a new JPEG image with dimensions [width] and [height].
-/// [data] contains 8 bits image samples that match [n_components].
+/// [data] contains 8 bits image samples that match [n_components], or is empty
+/// if the samples are not stored.
 /// Pixel density is set in [horizontal_pixel_density], [vertical_pixel_density]
 /// and [density_units].
 ///
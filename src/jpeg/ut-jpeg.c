@@ -1,6 +1,492 @@
-#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "ut-jpeg.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_AVX2
+#endif
+
+// The transforms use the fixed point method from the Independent JPEG Group's
+// jfdctint.c and jidctint.c, which is based on "Practical Fast 1-D DCT
+// Algorithms with 11 Multiplications", Loeffler, Ligtenberg and Moschytz,
+// 1989. Constants are scaled by 2^CONST_BITS, and intermediate values between
+// the two passes by 2^pass1_bits. As in IJG, fewer bits are used for
+// precisions above 8 bits so the intermediate values fit in 32 bits.
+#define CONST_BITS 13
+
+// Returns the scaling between the passes for samples of [precision] bits.
+#define PASS1_BITS(precision) ((precision) > 8 ? 1 : 2)
+
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+// Constants for the reduced size inverse DCTs, which include the scaling
+// factor of 1/2 for each dimension.
+#define FIX_0_191341716 1567
+#define FIX_0_353553391 2896
+#define FIX_0_461939766 3784
+
+// Color conversion constants from ITU-T T.871, scaled by 2^SCALE_BITS.
+#define SCALE_BITS 16
+#define FIX_0_34414 22554
+#define FIX_0_71414 46802
+#define FIX_1_40200 91881
+#define FIX_1_77200 116130
+#define FIX_0_29900 19595
+#define FIX_0_58700 38470
+#define FIX_0_11400 7471
+#define FIX_0_16874 11059
+#define FIX_0_33126 21709
+#define FIX_0_41869 27439
+#define FIX_0_08131 5329
+#define FIX_0_50000 32768
+
+// Divide [value] by 2^[n], rounding to the nearest integer.
+#define DESCALE(value, n) (((value) + (1 << ((n)-1))) >> (n))
+
+// Divide the unsigned vector [value] by 2^[n] as a signed value, rounding to
+// the nearest integer.
+#define DESCALE_UNSIGNED(value, n)                                            \
+  ((Vector)((value) + (1u << ((n)-1))) >> (n))
+
+// Eight 32 bit values, so the one dimensional transform is done on a whole row
+// or column at once. On x86-64 these use SSE2 by default, or AVX2 if
+// supported. Other architectures use their own SIMD instructions (e.g. NEON),
+// or fall back to scalar operations.
+typedef int32_t Vector __attribute__((vector_size(32)));
+
+// Unsigned form of [Vector], for arithmetic that may overflow.
+typedef uint32_t UnsignedVector __attribute__((vector_size(32)));
+
+// Sixteen 16 bit values, used when upsampling rows of samples.
+typedef int16_t Vector16 __attribute__((vector_size(32)));
+
+// Samples that are converted to and from vectors.
+typedef uint8_t Bytes8 __attribute__((vector_size(8)));
+typedef uint8_t Bytes16 __attribute__((vector_size(16)));
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void (*dct_function)(const int16_t *data_unit, size_t precision,
+                            int32_t *encoded_data_unit) = NULL;
+static void (*inverse_dct_function)(const int16_t *encoded_data_unit,
+                                    size_t precision,
+                                    int16_t *data_unit) = NULL;
+static void (*upsample_row_function)(const uint8_t *row,
+                                     const uint8_t *neighbour_row,
+                                     size_t width, size_t scale,
+                                     uint8_t *output) = NULL;
+static void (*ycbcr_to_rgb_function)(const uint8_t *y, const uint8_t *cb,
+                                     const uint8_t *cr, uint8_t *rgb,
+                                     size_t width) = NULL;
+
+// Swap the rows and columns of [v].
+static inline __attribute__((always_inline)) void transpose(Vector *v) {
+  for (size_t i = 0; i < 8; i++) {
+    for (size_t j = i + 1; j < 8; j++) {
+      int32_t value = v[i][j];
+      v[i][j] = v[j][i];
+      v[j][i] = value;
+    }
+  }
+}
+
+// Perform a one dimensional DCT on each lane of [v]. The first pass scales
+// the output by 2^[pass1_bits], the second pass removes this scaling.
+static inline __attribute__((always_inline)) void
+dct_1d(Vector *v, bool first_pass, int pass1_bits) {
+  Vector tmp0 = v[0] + v[7];
+  Vector tmp7 = v[0] - v[7];
+  Vector tmp1 = v[1] + v[6];
+  Vector tmp6 = v[1] - v[6];
+  Vector tmp2 = v[2] + v[5];
+  Vector tmp5 = v[2] - v[5];
+  Vector tmp3 = v[3] + v[4];
+  Vector tmp4 = v[3] - v[4];
+
+  // Even part.
+  Vector tmp10 = tmp0 + tmp3;
+  Vector tmp13 = tmp0 - tmp3;
+  Vector tmp11 = tmp1 + tmp2;
+  Vector tmp12 = tmp1 - tmp2;
+  if (first_pass) {
+    v[0] = (tmp10 + tmp11) * (1 << pass1_bits);
+    v[4] = (tmp10 - tmp11) * (1 << pass1_bits);
+  } else {
+    v[0] = DESCALE(tmp10 + tmp11, pass1_bits);
+    v[4] = DESCALE(tmp10 - tmp11, pass1_bits);
+  }
+  int shift = first_pass ? CONST_BITS - pass1_bits : CONST_BITS + pass1_bits;
+  Vector z1 = (tmp12 + tmp13) * FIX_0_541196100;
+  v[2] = DESCALE(z1 + tmp13 * FIX_0_765366865, shift);
+  v[6] = DESCALE(z1 - tmp12 * FIX_1_847759065, shift);
+
+  // Odd part.
+  z1 = tmp4 + tmp7;
+  Vector z2 = tmp5 + tmp6;
+  Vector z3 = tmp4 + tmp6;
+  Vector z4 = tmp5 + tmp7;
+  Vector z5 = (z3 + z4) * FIX_1_175875602;
+  tmp4 = tmp4 * FIX_0_298631336;
+  tmp5 = tmp5 * FIX_2_053119869;
+  tmp6 = tmp6 * FIX_3_072711026;
+  tmp7 = tmp7 * FIX_1_501321110;
+  z1 = z1 * -FIX_0_899976223;
+  z2 = z2 * -FIX_2_562915447;
+  z3 = z3 * -FIX_1_961570560 + z5;
+  z4 = z4 * -FIX_0_390180644 + z5;
+  v[7] = DESCALE(tmp4 + z1 + z3, shift);
+  v[5] = DESCALE(tmp5 + z2 + z4, shift);
+  v[3] = DESCALE(tmp6 + z2 + z3, shift);
+  v[1] = DESCALE(tmp7 + z1 + z4, shift);
+}
+
+// Perform a one dimensional inverse DCT on each lane of [v], dividing the
+// result by 2^[shift]. Coefficients in corrupt images can be large enough to
+// overflow 32 bits, so the arithmetic is unsigned, which wraps rather than
+// being undefined. The output is meaningless in this case, but the decoder
+// clamps it to valid samples.
+static inline __attribute__((always_inline)) void inverse_dct_1d(Vector *v,
+                                                                 int shift) {
+  UnsignedVector u[8];
+  for (size_t i = 0; i < 8; i++) {
+    u[i] = (UnsignedVector)v[i];
+  }
+
+  // Even part.
+  UnsignedVector z2 = u[2];
+  UnsignedVector z3 = u[6];
+  UnsignedVector z1 = (z2 + z3) * FIX_0_541196100;
+  UnsignedVector tmp2 = z1 - z3 * FIX_1_847759065;
+  UnsignedVector tmp3 = z1 + z2 * FIX_0_765366865;
+  UnsignedVector tmp0 = (u[0] + u[4]) << CONST_BITS;
+  UnsignedVector tmp1 = (u[0] - u[4]) << CONST_BITS;
+  UnsignedVector tmp10 = tmp0 + tmp3;
+  UnsignedVector tmp13 = tmp0 - tmp3;
+  UnsignedVector tmp11 = tmp1 + tmp2;
+  UnsignedVector tmp12 = tmp1 - tmp2;
+
+  // Odd part.
+  tmp0 = u[7];
+  tmp1 = u[5];
+  tmp2 = u[3];
+  tmp3 = u[1];
+  z1 = tmp0 + tmp3;
+  z2 = tmp1 + tmp2;
+  z3 = tmp0 + tmp2;
+  UnsignedVector z4 = tmp1 + tmp3;
+  UnsignedVector z5 = (z3 + z4) * FIX_1_175875602;
+  tmp0 = tmp0 * FIX_0_298631336;
+  tmp1 = tmp1 * FIX_2_053119869;
+  tmp2 = tmp2 * FIX_3_072711026;
+  tmp3 = tmp3 * FIX_1_501321110;
+  z1 = -(z1 * FIX_0_899976223);
+  z2 = -(z2 * FIX_2_562915447);
+  z3 = z5 - z3 * FIX_1_961570560;
+  z4 = z5 - z4 * FIX_0_390180644;
+  tmp0 += z1 + z3;
+  tmp1 += z2 + z4;
+  tmp2 += z2 + z3;
+  tmp3 += z1 + z4;
+
+  v[0] = DESCALE_UNSIGNED(tmp10 + tmp3, shift);
+  v[7] = DESCALE_UNSIGNED(tmp10 - tmp3, shift);
+  v[1] = DESCALE_UNSIGNED(tmp11 + tmp2, shift);
+  v[6] = DESCALE_UNSIGNED(tmp11 - tmp2, shift);
+  v[2] = DESCALE_UNSIGNED(tmp12 + tmp1, shift);
+  v[5] = DESCALE_UNSIGNED(tmp12 - tmp1, shift);
+  v[3] = DESCALE_UNSIGNED(tmp13 + tmp0, shift);
+  v[4] = DESCALE_UNSIGNED(tmp13 - tmp0, shift);
+}
+
+// Divide [value] by 2^[n] as a signed value, rounding to the nearest integer.
+static int32_t descale_unsigned(uint32_t value, int n) {
+  return (int32_t)(value + (1u << (n - 1))) >> n;
+}
+
+// Perform a four point inverse DCT on the first four values in [v], which are
+// [stride] values apart. The result is divided by 2^[shift]. As with
+// [inverse_dct_1d] the arithmetic is unsigned so it can wrap.
+static void inverse_dct_4(int32_t *v, size_t stride, int shift) {
+  uint32_t v0 = v[0], v1 = v[stride], v2 = v[stride * 2], v3 = v[stride * 3];
+  uint32_t even0 = (v0 + v2) * FIX_0_353553391;
+  uint32_t even1 = (v0 - v2) * FIX_0_353553391;
+  uint32_t odd0 = v1 * FIX_0_461939766 + v3 * FIX_0_191341716;
+  uint32_t odd1 = v1 * FIX_0_191341716 - v3 * FIX_0_461939766;
+  v[0] = descale_unsigned(even0 + odd0, shift);
+  v[stride] = descale_unsigned(even1 + odd1, shift);
+  v[stride * 2] = descale_unsigned(even1 - odd1, shift);
+  v[stride * 3] = descale_unsigned(even0 - odd0, shift);
+}
+
+// Perform a two point inverse DCT on the first two values in [v], which are
+// [stride] values apart. The result is divided by 2^[shift].
+static void inverse_dct_2(int32_t *v, size_t stride, int shift) {
+  uint32_t v0 = v[0], v1 = v[stride];
+  v[0] = descale_unsigned((v0 + v1) * FIX_0_353553391, shift);
+  v[stride] = descale_unsigned((v0 - v1) * FIX_0_353553391, shift);
+}
+
+static inline __attribute__((always_inline)) void
+dct(const int16_t *data_unit, int pass1_bits, int32_t *encoded_data_unit) {
+  // Load with each vector containing a column, so the first pass transforms
+  // the rows.
+  Vector v[8];
+  for (size_t x = 0; x < 8; x++) {
+    for (size_t y = 0; y < 8; y++) {
+      v[x][y] = data_unit[(y * 8) + x];
+    }
+  }
+  dct_1d(v, true, pass1_bits);
+  transpose(v);
+  dct_1d(v, false, pass1_bits);
+  for (size_t y = 0; y < 8; y++) {
+    for (size_t x = 0; x < 8; x++) {
+      encoded_data_unit[(y * 8) + x] = v[y][x];
+    }
+  }
+}
+
+static inline __attribute__((always_inline)) void
+inverse_dct(const int16_t *encoded_data_unit, int pass1_bits,
+            int16_t *data_unit) {
+  // Load with each vector containing a row, so the first pass transforms the
+  // columns.
+  Vector v[8];
+  for (size_t y = 0; y < 8; y++) {
+    for (size_t x = 0; x < 8; x++) {
+      v[y][x] = encoded_data_unit[(y * 8) + x];
+    }
+  }
+  inverse_dct_1d(v, CONST_BITS - pass1_bits);
+  transpose(v);
+  // The output is also scaled down by 8.
+  inverse_dct_1d(v, CONST_BITS + pass1_bits + 3);
+  for (size_t y = 0; y < 8; y++) {
+    for (size_t x = 0; x < 8; x++) {
+      data_unit[(y * 8) + x] = v[x][y];
+    }
+  }
+}
+
+// Get the sum of [row] and [neighbour_row] at [i], weighted 3:1. This is the
+// sample value scaled by 4.
+static inline __attribute__((always_inline)) int16_t
+column_sum(const uint8_t *row, const uint8_t *neighbour_row, size_t i) {
+  return neighbour_row != NULL ? (row[i] * 3) + neighbour_row[i] : row[i] * 4;
+}
+
+static inline __attribute__((always_inline)) void
+upsample_row(const uint8_t *row, const uint8_t *neighbour_row, size_t width,
+             size_t scale, uint8_t *output) {
+  if (scale != 2) {
+    for (size_t i = 0; i < width; i++) {
+      uint8_t value = (column_sum(row, neighbour_row, i) + 2) >> 2;
+      for (size_t j = 0; j < scale; j++) {
+        output[(i * scale) + j] = value;
+      }
+    }
+    return;
+  }
+
+  // Each output sample is 3:1 weighted between the nearest two input
+  // samples, i.e. a triangle filter. The edges use the nearest sample.
+  int16_t sum = column_sum(row, neighbour_row, 0);
+  if (width == 1) {
+    output[0] = ((sum * 4) + 8) >> 4;
+    output[1] = ((sum * 4) + 7) >> 4;
+    return;
+  }
+  output[0] = ((sum * 4) + 8) >> 4;
+  output[1] = ((sum * 3) + column_sum(row, neighbour_row, 1) + 7) >> 4;
+  size_t i = 1;
+  for (; i + 16 < width; i += 16) {
+    Bytes16 previous_samples, samples, next_samples;
+    memcpy(&previous_samples, row + i - 1, 16);
+    memcpy(&samples, row + i, 16);
+    memcpy(&next_samples, row + i + 1, 16);
+    Vector16 previous = __builtin_convertvector(previous_samples, Vector16);
+    Vector16 current = __builtin_convertvector(samples, Vector16);
+    Vector16 next = __builtin_convertvector(next_samples, Vector16);
+    if (neighbour_row != NULL) {
+      memcpy(&previous_samples, neighbour_row + i - 1, 16);
+      memcpy(&samples, neighbour_row + i, 16);
+      memcpy(&next_samples, neighbour_row + i + 1, 16);
+      previous = (previous * 3) +
+                 __builtin_convertvector(previous_samples, Vector16);
+      current = (current * 3) + __builtin_convertvector(samples, Vector16);
+      next = (next * 3) + __builtin_convertvector(next_samples, Vector16);
+    } else {
+      previous *= 4;
+      current *= 4;
+      next *= 4;
+    }
+    Vector16 even = ((current * 3) + previous + 8) >> 4;
+    Vector16 odd = ((current * 3) + next + 7) >> 4;
+    for (size_t j = 0; j < 16; j++) {
+      output[(i + j) * 2] = even[j];
+      output[((i + j) * 2) + 1] = odd[j];
+    }
+  }
+  for (; i < width - 1; i++) {
+    sum = column_sum(row, neighbour_row, i);
+    output[i * 2] =
+        ((sum * 3) + column_sum(row, neighbour_row, i - 1) + 8) >> 4;
+    output[(i * 2) + 1] =
+        ((sum * 3) + column_sum(row, neighbour_row, i + 1) + 7) >> 4;
+  }
+  sum = column_sum(row, neighbour_row, i);
+  output[i * 2] = ((sum * 3) + column_sum(row, neighbour_row, i - 1) + 8) >> 4;
+  output[(i * 2) + 1] = ((sum * 4) + 7) >> 4;
+}
+
+static inline __attribute__((always_inline)) uint8_t clamp(int32_t value) {
+  return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static inline __attribute__((always_inline)) void
+ycbcr_to_rgb(const uint8_t *y, const uint8_t *cb, const uint8_t *cr,
+             uint8_t *rgb, size_t width) {
+  int32_t half = 1 << (SCALE_BITS - 1);
+  size_t i = 0;
+  for (; i + 8 <= width; i += 8) {
+    Bytes8 y_samples, cb_samples, cr_samples;
+    memcpy(&y_samples, y + i, 8);
+    memcpy(&cb_samples, cb + i, 8);
+    memcpy(&cr_samples, cr + i, 8);
+    Vector Y = __builtin_convertvector(y_samples, Vector);
+    Vector Cb = __builtin_convertvector(cb_samples, Vector) - 128;
+    Vector Cr = __builtin_convertvector(cr_samples, Vector) - 128;
+
+    Vector R = Y + ((Cr * FIX_1_40200 + half) >> SCALE_BITS);
+    Vector G =
+        Y + ((half - Cb * FIX_0_34414 - Cr * FIX_0_71414) >> SCALE_BITS);
+    Vector B = Y + ((Cb * FIX_1_77200 + half) >> SCALE_BITS);
+
+    // Clamp to 0-255.
+    R = ((R & ~(R < 0)) | (R > 255)) & 255;
+    G = ((G & ~(G < 0)) | (G > 255)) & 255;
+    B = ((B & ~(B < 0)) | (B > 255)) & 255;
+
+    Bytes8 r = __builtin_convertvector(R, Bytes8);
+    Bytes8 g = __builtin_convertvector(G, Bytes8);
+    Bytes8 b = __builtin_convertvector(B, Bytes8);
+    uint8_t *pixel = rgb + (i * 3);
+    for (size_t j = 0; j < 8; j++) {
+      pixel[0] = r[j];
+      pixel[1] = g[j];
+      pixel[2] = b[j];
+      pixel += 3;
+    }
+  }
+  for (; i < width; i++) {
+    int32_t Y = y[i];
+    int32_t Cb = cb[i] - 128;
+    int32_t Cr = cr[i] - 128;
+    uint8_t *pixel = rgb + (i * 3);
+    pixel[0] = clamp(Y + ((Cr * FIX_1_40200 + half) >> SCALE_BITS));
+    pixel[1] = clamp(
+        Y + ((half - Cb * FIX_0_34414 - Cr * FIX_0_71414) >> SCALE_BITS));
+    pixel[2] = clamp(Y + ((Cb * FIX_1_77200 + half) >> SCALE_BITS));
+  }
+}
+
+// The transforms are expanded for each pass scaling, so the shifts are
+// constant.
+static void dct_default(const int16_t *data_unit, size_t precision,
+                        int32_t *encoded_data_unit) {
+  if (PASS1_BITS(precision) == 1) {
+    dct(data_unit, 1, encoded_data_unit);
+  } else {
+    dct(data_unit, 2, encoded_data_unit);
+  }
+}
+
+static void inverse_dct_default(const int16_t *encoded_data_unit,
+                                size_t precision, int16_t *data_unit) {
+  if (PASS1_BITS(precision) == 1) {
+    inverse_dct(encoded_data_unit, 1, data_unit);
+  } else {
+    inverse_dct(encoded_data_unit, 2, data_unit);
+  }
+}
+
+static void upsample_row_default(const uint8_t *row,
+                                 const uint8_t *neighbour_row, size_t width,
+                                 size_t scale, uint8_t *output) {
+  upsample_row(row, neighbour_row, width, scale, output);
+}
+
+static void ycbcr_to_rgb_default(const uint8_t *y, const uint8_t *cb,
+                                 const uint8_t *cr, uint8_t *rgb,
+                                 size_t width) {
+  ycbcr_to_rgb(y, cb, cr, rgb, width);
+}
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2"))) static void
+dct_avx2(const int16_t *data_unit, size_t precision,
+         int32_t *encoded_data_unit) {
+  if (PASS1_BITS(precision) == 1) {
+    dct(data_unit, 1, encoded_data_unit);
+  } else {
+    dct(data_unit, 2, encoded_data_unit);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+inverse_dct_avx2(const int16_t *encoded_data_unit, size_t precision,
+                 int16_t *data_unit) {
+  if (PASS1_BITS(precision) == 1) {
+    inverse_dct(encoded_data_unit, 1, data_unit);
+  } else {
+    inverse_dct(encoded_data_unit, 2, data_unit);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+upsample_row_avx2(const uint8_t *row, const uint8_t *neighbour_row,
+                  size_t width, size_t scale, uint8_t *output) {
+  upsample_row(row, neighbour_row, width, scale, output);
+}
+
+__attribute__((target("avx2"))) static void
+ycbcr_to_rgb_avx2(const uint8_t *y, const uint8_t *cb, const uint8_t *cr,
+                  uint8_t *rgb, size_t width) {
+  ycbcr_to_rgb(y, cb, cr, rgb, width);
+}
+#endif
+
+static void init_functions() {
+  dct_function = dct_default;
+  inverse_dct_function = inverse_dct_default;
+  upsample_row_function = upsample_row_default;
+  ycbcr_to_rgb_function = ycbcr_to_rgb_default;
+#ifdef HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    dct_function = dct_avx2;
+    inverse_dct_function = inverse_dct_avx2;
+    upsample_row_function = upsample_row_avx2;
+    ycbcr_to_rgb_function = ycbcr_to_rgb_avx2;
+  }
+#endif
+}
 
 void jpeg_build_data_unit_order(uint8_t *order) {
   // Data units are encoded in zig-zag order.
@@ -38,49 +524,103 @@ void jpeg_build_data_unit_order(uint8_t *order) {
   }
 }
 
-void jpeg_build_dct_values(float *dct_alpha, float *dct_cos) {
-  // 1/√2
-  dct_alpha[0] = 0.70710678118654752440;
-  for (size_t i = 1; i < 8; i++) {
-    dct_alpha[i] = 1.0;
-  }
+void jpeg_dct(const int16_t *data_unit, size_t precision,
+              int32_t *encoded_data_unit) {
+  pthread_once(&init_once, init_functions);
+  dct_function(data_unit, precision, encoded_data_unit);
+}
 
-  float pi = 3.14159265358979323846;
-  for (size_t u = 0; u < 8; u++) {
-    for (size_t v = 0; v < 8; v++) {
-      dct_cos[(v * 8) + u] = cos(((2 * u) + 1) * v * pi / 16.0);
+void jpeg_inverse_dct(const int16_t *encoded_data_unit, size_t precision,
+                      int16_t *data_unit) {
+  // Many data units only have a DC coefficient, which gives a constant value.
+  int16_t ac = 0;
+  for (size_t i = 1; i < 64; i++) {
+    ac |= encoded_data_unit[i];
+  }
+  if (ac == 0) {
+    int16_t value = (encoded_data_unit[0] + 4) >> 3;
+    for (size_t i = 0; i < 64; i++) {
+      data_unit[i] = value;
     }
+    return;
   }
+
+  pthread_once(&init_once, init_functions);
+  inverse_dct_function(encoded_data_unit, precision, data_unit);
 }
 
-void jpeg_dct(float *dct_alpha, float *dct_cos, const int16_t *data_unit,
-              float *encoded_data_unit) {
-  for (size_t u = 0; u < 8; u++) {
-    for (size_t v = 0; v < 8; v++) {
-      float sum = 0.0;
-      for (size_t x = 0; x < 8; x++) {
-        for (size_t y = 0; y < 8; y++) {
-          sum += data_unit[(y * 8) + x] * dct_cos[(u * 8) + x] *
-                 dct_cos[(v * 8) + y];
-        }
-      }
-      encoded_data_unit[(v * 8) + u] = 0.25 * dct_alpha[u] * dct_alpha[v] * sum;
+void jpeg_inverse_dct_scaled(const int16_t *encoded_data_unit, size_t size,
+                             size_t precision, int16_t *data_unit) {
+  if (size == 8) {
+    jpeg_inverse_dct(encoded_data_unit, precision, data_unit);
+    return;
+  }
+
+  // A one point DCT is just the DC coefficient.
+  if (size == 1) {
+    data_unit[0] = (encoded_data_unit[0] + 4) >> 3;
+    return;
+  }
+
+  // Transform the low frequency coefficients, which gives samples at the
+  // reduced size.
+  void (*inverse_dct_1d)(int32_t *v, size_t stride, int shift);
+  switch (size) {
+  case 4:
+    inverse_dct_1d = inverse_dct_4;
+    break;
+  case 2:
+    inverse_dct_1d = inverse_dct_2;
+    break;
+  default:
+    assert(false);
+  }
+  int32_t v[64];
+  for (size_t y = 0; y < size; y++) {
+    for (size_t x = 0; x < size; x++) {
+      v[(y * size) + x] = encoded_data_unit[(y * 8) + x];
     }
   }
+  int pass1_bits = PASS1_BITS(precision);
+  for (size_t x = 0; x < size; x++) {
+    inverse_dct_1d(v + x, size, CONST_BITS - pass1_bits);
+  }
+  for (size_t y = 0; y < size; y++) {
+    inverse_dct_1d(v + (y * size), 1, CONST_BITS + pass1_bits);
+  }
+  for (size_t i = 0; i < size * size; i++) {
+    data_unit[i] = v[i];
+  }
 }
 
-void jpeg_inverse_dct(float *dct_alpha, float *dct_cos,
-                      const int16_t *encoded_data_unit, int16_t *data_unit) {
-  for (size_t x = 0; x < 8; x++) {
-    for (size_t y = 0; y < 8; y++) {
-      float sum = 0.0;
-      for (size_t u = 0; u < 8; u++) {
-        for (size_t v = 0; v < 8; v++) {
-          sum += dct_alpha[u] * dct_alpha[v] * encoded_data_unit[(v * 8) + u] *
-                 dct_cos[(u * 8) + x] * dct_cos[(v * 8) + y];
-        }
-      }
-      data_unit[(y * 8) + x] = round(0.25 * sum);
-    }
+void jpeg_upsample_row(const uint8_t *row, const uint8_t *neighbour_row,
+                       size_t width, size_t scale, uint8_t *output) {
+  pthread_once(&init_once, init_functions);
+  upsample_row_function(row, neighbour_row, width, scale, output);
+}
+
+void jpeg_ycbcr_to_rgb(const uint8_t *y, const uint8_t *cb, const uint8_t *cr,
+                       uint8_t *rgb, size_t width) {
+  pthread_once(&init_once, init_functions);
+  ycbcr_to_rgb_function(y, cb, cr, rgb, width);
+}
+
+void jpeg_rgb_to_ycbcr(const uint8_t *rgb, uint8_t *y, uint8_t *cb, uint8_t *cr,
+                       size_t width) {
+  // Rounds to nearest, with Cb and Cr just under half so they don't exceed
+  // 255.
+  int32_t half = 1 << (SCALE_BITS - 1);
+  int32_t offset = (128 << SCALE_BITS) + half - 1;
+  for (size_t i = 0; i < width; i++) {
+    int32_t R = rgb[0];
+    int32_t G = rgb[1];
+    int32_t B = rgb[2];
+    rgb += 3;
+    y[i] = (R * FIX_0_29900 + G * FIX_0_58700 + B * FIX_0_11400 + half) >>
+           SCALE_BITS;
+    cb[i] = (B * FIX_0_50000 - R * FIX_0_16874 - G * FIX_0_33126 + offset) >>
+            SCALE_BITS;
+    cr[i] = (R * FIX_0_50000 - G * FIX_0_41869 - B * FIX_0_08131 + offset) >>
+            SCALE_BITS;
   }
 }
@@ -1,17 +1,38 @@
+#include <stddef.h>
 #include <stdint.h>
 
 // Precaclulate order values are entered into a data unit.
 void jpeg_build_data_unit_order(uint8_t *order);
 
-// Precaculate values used in DCT calculations.
-void jpeg_build_dct_values(float *dct_alpha, float *dct_cos);
+// Perform discrete cosine transform on [data_unit] containing samples of
+// [precision] bits and write to [encoded_data_unit]. The coefficients are
+// scaled up by a factor of 8.
+void jpeg_dct(const int16_t *data_unit, size_t precision,
+              int32_t *encoded_data_unit);
 
-// Perform discrete cosine transform on [data_unit] and write to
-// [encoded_data_unit].
-void jpeg_dct(float *dct_alpha, float *dct_cos, const int16_t *data_unit,
-              float *encoded_data_unit);
+// Perform inverse discrete cosine transform on [encoded_data_unit] and write
+// samples of [precision] bits to [data_unit].
+void jpeg_inverse_dct(const int16_t *encoded_data_unit, size_t precision,
+                      int16_t *data_unit);
 
-// Perform inverse discrete cosine transform on [encoded_data_unit] and write to
-// [data_unit].
-void jpeg_inverse_dct(float *dct_alpha, float *dct_cos,
-                      const int16_t *encoded_data_unit, int16_t *data_unit);
+// Perform inverse discrete cosine transform on [encoded_data_unit] and write
+// [size]x[size] samples of [precision] bits to [data_unit], where [size] is 8,
+// 4, 2 or 1.
+void jpeg_inverse_dct_scaled(const int16_t *encoded_data_unit, size_t size,
+                             size_t precision, int16_t *data_unit);
+
+// Upsample [width] samples in [row] by [scale] (1, 2 or 4) and write to
+// [output]. If [neighbour_row] is not NULL, the samples are interpolated
+// towards the samples in that row.
+void jpeg_upsample_row(const uint8_t *row, const uint8_t *neighbour_row,
+                       size_t width, size_t scale, uint8_t *output);
+
+// Convert [width] samples from the [y], [cb] and [cr] rows into RGB pixels in
+// [rgb].
+void jpeg_ycbcr_to_rgb(const uint8_t *y, const uint8_t *cb, const uint8_t *cr,
+                       uint8_t *rgb, size_t width);
+
+// Convert [width] RGB pixels in [rgb] into samples in the [y], [cb] and [cr]
+// rows.
+void jpeg_rgb_to_ycbcr(const uint8_t *rgb, uint8_t *y, uint8_t *cb, uint8_t *cr,
+                       size_t width);
@@ -57,6 +57,17 @@ static void update_code_length(UtLzwDecoder *self) {
 // Create a mask for the last [length] bits in a 16 bit word.
 static uint16_t bit_mask(size_t length) { return 0xffff >> (16 - length); }
 
+// Write the symbols for [code] to the output buffer.
+static void write_entry(UtLzwDecoder *self, uint16_t code) {
+  size_t entry_length =
+      ut_lzw_dictionary_get_entry_length(self->dictionary, code);
+  size_t buffer_length = ut_list_get_length(self->buffer);
+  ut_list_resize(self->buffer, buffer_length + entry_length);
+  ut_lzw_dictionary_get_entry(
+      self->dictionary, code,
+      ut_uint8_list_get_writable_data(self->buffer) + buffer_length);
+}
+
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   UtLzwDecoder *self = (UtLzwDecoder *)object;
 
@@ -108,14 +119,13 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
       uint8_t first_symbol;
       size_t dictionary_length = ut_lzw_dictionary_get_length(self->dictionary);
       if (code < dictionary_length) {
-        UtObject *entry = ut_lzw_dictionary_lookup(self->dictionary, code);
-        ut_list_append_list(self->buffer, entry);
-        first_symbol = ut_uint8_list_get_element(entry, 0);
+        write_entry(self, code);
+        first_symbol =
+            ut_lzw_dictionary_get_first_symbol(self->dictionary, code);
       } else if (code == dictionary_length && self->last_code != clear_code) {
-        UtObject *entry =
-            ut_lzw_dictionary_lookup(self->dictionary, self->last_code);
-        first_symbol = ut_uint8_list_get_element(entry, 0);
-        ut_list_append_list(self->buffer, entry);
+        write_entry(self, self->last_code);
+        first_symbol = ut_lzw_dictionary_get_first_symbol(self->dictionary,
+                                                          self->last_code);
         ut_uint8_list_append(self->buffer, first_symbol);
       } else {
         error(self, "Invalid code received");
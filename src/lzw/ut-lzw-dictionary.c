@@ -1,8 +1,15 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ut-lzw-dictionary.h"
 #include "ut.h"
 
+// Value in [hash_table] for an unused slot. Codes added to the dictionary are
+// always after the symbol, clear and end of information codes so this can
+// never be a valid entry.
+#define EMPTY_SLOT 0
+
 typedef struct {
   UtObject object;
 
@@ -12,42 +19,84 @@ typedef struct {
   // Maximum length of dictionary.
   size_t max_length;
 
-  // Mapping from codes to symbols.
-  UtObject *codes;
+  // Number of codes in the dictionary.
+  size_t length;
+
+  // Each code is the code of a shorter entry (prefix) with one symbol
+  // (suffix) appended.
+  uint16_t *prefixes;
+  uint8_t *suffixes;
+
+  // First symbol and number of symbols for each code.
+  uint8_t *first_symbols;
+  uint16_t *lengths;
+
+  // Open addressed hash table mapping (prefix, suffix) to the code that
+  // extends prefix with suffix.
+  uint16_t *hash_table;
+  size_t hash_table_mask;
 } UtLzwDictionary;
 
-static void ut_lzw_dictionary_init(UtObject *object) {
-  UtLzwDictionary *self = (UtLzwDictionary *)object;
-  self->codes = ut_object_list_new();
+static size_t get_hash(UtLzwDictionary *self, uint16_t code, uint8_t b) {
+  uint32_t key = (uint32_t)code << 8 | b;
+  return (key * 2654435761u >> 8) & self->hash_table_mask;
 }
 
 static void ut_lzw_dictionary_cleanup(UtObject *object) {
   UtLzwDictionary *self = (UtLzwDictionary *)object;
-  ut_object_unref(self->codes);
+  free(self->prefixes);
+  free(self->suffixes);
+  free(self->first_symbols);
+  free(self->lengths);
+  free(self->hash_table);
 }
 
 static UtObjectInterface object_interface = {.type_name = "UtLzwDictionary",
-                                             .init = ut_lzw_dictionary_init,
                                              .cleanup =
                                                  ut_lzw_dictionary_cleanup};
 
 UtObject *ut_lzw_dictionary_new(size_t n_symbols, size_t max_length) {
+  assert(n_symbols <= 256);
+  assert(max_length <= 65536);
+
   UtObject *object = ut_object_new(sizeof(UtLzwDictionary), &object_interface);
   UtLzwDictionary *self = (UtLzwDictionary *)object;
 
   self->n_symbols = n_symbols;
   self->max_length = max_length;
+
+  // Always have space for the symbols, clear and end of information codes.
+  size_t allocated_length =
+      max_length > n_symbols + 2 ? max_length : n_symbols + 2;
+  self->prefixes = malloc(sizeof(uint16_t) * allocated_length);
+  self->suffixes = malloc(sizeof(uint8_t) * allocated_length);
+  self->first_symbols = malloc(sizeof(uint8_t) * allocated_length);
+  self->lengths = malloc(sizeof(uint16_t) * allocated_length);
+
+  // Keep the hash table at most half full.
+  size_t hash_table_length = 1;
+  while (hash_table_length < allocated_length * 2) {
+    hash_table_length *= 2;
+  }
+  self->hash_table = malloc(sizeof(uint16_t) * hash_table_length);
+  self->hash_table_mask = hash_table_length - 1;
+
   // Symbols.
-  for (size_t i = 0; i < self->n_symbols; i++) {
-    UtObjectRef entry = ut_uint8_list_new_from_elements(1, i);
-    ut_list_append(self->codes, entry);
+  for (size_t i = 0; i < n_symbols; i++) {
+    self->prefixes[i] = 0;
+    self->suffixes[i] = i;
+    self->first_symbols[i] = i;
+    self->lengths[i] = 1;
+  }
+  // Clear and End of Information.
+  for (size_t i = n_symbols; i < n_symbols + 2; i++) {
+    self->prefixes[i] = 0;
+    self->suffixes[i] = 0;
+    self->first_symbols[i] = 0;
+    self->lengths[i] = 0;
   }
-  // Clear.
-  UtObjectRef clear_entry = ut_uint8_list_new();
-  ut_list_append(self->codes, clear_entry);
-  // End of Information.
-  UtObjectRef eoi_entry = ut_uint8_list_new();
-  ut_list_append(self->codes, eoi_entry);
+
+  ut_lzw_dictionary_clear(object);
 
   return object;
 }
@@ -67,40 +116,90 @@ uint16_t ut_lzw_dictionary_get_end_of_information_code(UtObject *object) {
 size_t ut_lzw_dictionary_get_length(UtObject *object) {
   assert(ut_object_is_lzw_dictionary(object));
   UtLzwDictionary *self = (UtLzwDictionary *)object;
-  return ut_list_get_length(self->codes);
+  return self->length;
 }
 
 bool ut_lzw_dictionary_get_is_full(UtObject *object) {
   assert(ut_object_is_lzw_dictionary(object));
   UtLzwDictionary *self = (UtLzwDictionary *)object;
-  return ut_list_get_length(self->codes) >= self->max_length;
+  return self->length >= self->max_length;
+}
+
+size_t ut_lzw_dictionary_get_entry_length(UtObject *object, uint16_t code) {
+  assert(ut_object_is_lzw_dictionary(object));
+  UtLzwDictionary *self = (UtLzwDictionary *)object;
+  assert(code < self->length);
+  return self->lengths[code];
 }
 
-UtObject *ut_lzw_dictionary_lookup(UtObject *object, uint16_t code) {
+uint8_t ut_lzw_dictionary_get_first_symbol(UtObject *object, uint16_t code) {
   assert(ut_object_is_lzw_dictionary(object));
   UtLzwDictionary *self = (UtLzwDictionary *)object;
-  return ut_object_list_get_element(self->codes, code);
+  assert(code < self->length);
+  return self->first_symbols[code];
+}
+
+void ut_lzw_dictionary_get_entry(UtObject *object, uint16_t code,
+                                 uint8_t *data) {
+  assert(ut_object_is_lzw_dictionary(object));
+  UtLzwDictionary *self = (UtLzwDictionary *)object;
+  assert(code < self->length);
+
+  // Follow the prefixes back to the first symbol.
+  for (size_t i = self->lengths[code]; i > 0; i--) {
+    data[i - 1] = self->suffixes[code];
+    code = self->prefixes[code];
+  }
+}
+
+bool ut_lzw_dictionary_find(UtObject *object, uint16_t code, uint8_t b,
+                            uint16_t *extended_code) {
+  assert(ut_object_is_lzw_dictionary(object));
+  UtLzwDictionary *self = (UtLzwDictionary *)object;
+
+  size_t i = get_hash(self, code, b);
+  while (self->hash_table[i] != EMPTY_SLOT) {
+    uint16_t c = self->hash_table[i];
+    if (self->prefixes[c] == code && self->suffixes[c] == b) {
+      *extended_code = c;
+      return true;
+    }
+    i = (i + 1) & self->hash_table_mask;
+  }
+
+  return false;
 }
 
 void ut_lzw_dictionary_clear(UtObject *object) {
   assert(ut_object_is_lzw_dictionary(object));
   UtLzwDictionary *self = (UtLzwDictionary *)object;
-  // Return to the original symobls, clear, end of information.
-  ut_list_resize(self->codes, self->n_symbols + 2);
+  // Return to the original symbols, clear, end of information.
+  self->length = self->n_symbols + 2;
+  memset(self->hash_table, EMPTY_SLOT,
+         sizeof(uint16_t) * (self->hash_table_mask + 1));
 }
 
 void ut_lzw_dictionary_append(UtObject *object, uint16_t code, uint8_t b) {
   assert(ut_object_is_lzw_dictionary(object));
   UtLzwDictionary *self = (UtLzwDictionary *)object;
 
-  if (ut_list_get_length(self->codes) >= self->max_length) {
+  if (self->length >= self->max_length) {
     return;
   }
 
-  UtObject *entry = ut_object_list_get_element(self->codes, code);
-  UtObjectRef new_entry = ut_list_copy(entry);
-  ut_uint8_list_append(new_entry, b);
-  ut_list_append(self->codes, new_entry);
+  assert(code < self->length);
+  uint16_t new_code = self->length;
+  self->prefixes[new_code] = code;
+  self->suffixes[new_code] = b;
+  self->first_symbols[new_code] = self->first_symbols[code];
+  self->lengths[new_code] = self->lengths[code] + 1;
+  self->length++;
+
+  size_t i = get_hash(self, code, b);
+  while (self->hash_table[i] != EMPTY_SLOT) {
+    i = (i + 1) & self->hash_table_mask;
+  }
+  self->hash_table[i] = new_code;
 }
 
 bool ut_object_is_lzw_dictionary(UtObject *object) {
@@ -24,9 +24,22 @@ size_t ut_lzw_dictionary_get_length(UtObject *object);
 /// Returns true if the dictionary is full.
 bool ut_lzw_dictionary_get_is_full(UtObject *object);
 
-/// Returns the symbols for a given [code].
-/// !return-type UtUint8List
-UtObject *ut_lzw_dictionary_lookup(UtObject *object, uint16_t code);
+/// Returns the number of symbols for a given [code].
+size_t ut_lzw_dictionary_get_entry_length(UtObject *object, uint16_t code);
+
+/// Returns the first symbol for a given [code].
+uint8_t ut_lzw_dictionary_get_first_symbol(UtObject *object, uint16_t code);
+
+/// Writes the symbols for a given [code] into [data], which must have space
+/// for the number of symbols returned by
+/// [ut_lzw_dictionary_get_entry_length].
+void ut_lzw_dictionary_get_entry(UtObject *object, uint16_t code,
+                                 uint8_t *data);
+
+/// Returns [true] if the dictionary contains an entry that extends [code] with
+/// [b] and sets [extended_code] to the code of this entry.
+bool ut_lzw_dictionary_find(UtObject *object, uint16_t code, uint8_t b,
+                            uint16_t *extended_code);
 
 /// Reset the dictionary to the initial state.
 void ut_lzw_dictionary_clear(UtObject *object);
@@ -1,3 +1,4 @@
+#include "ut-benchmark.h"
 #include "ut.h"
 
 static UtObject *get_utf8_data(const char *value) {
@@ -123,9 +124,40 @@ static void test_msb() {
   ut_assert_uint8_list_equal_hex(dictionary_reset_result, "a51a2190a296c0");
 }
 
+static void test_round_trip() {
+  // Enough data to fill and reset the dictionary many times.
+  UtObjectRef data = ut_uint8_array_new();
+  for (size_t i = 0; i < 262144; i++) {
+    uint32_t random = ut_benchmark_get_random();
+    uint8_t value = random % 64 == 0 ? random >> 8 : i / 7 % 16;
+    ut_uint8_list_append(data, value);
+  }
+
+  UtObjectRef lsb_data_stream = ut_list_input_stream_new(data);
+  UtObjectRef lsb_encoder = ut_lzw_encoder_new_lsb(256, 4096, lsb_data_stream);
+  UtObjectRef lsb_result = ut_input_stream_read_sync(lsb_encoder);
+  ut_assert_is_not_error(lsb_result);
+  UtObjectRef lsb_result_stream = ut_list_input_stream_new(lsb_result);
+  UtObjectRef lsb_decoder =
+      ut_lzw_decoder_new_lsb(256, 4096, lsb_result_stream);
+  UtObjectRef lsb_decoded_data = ut_input_stream_read_sync(lsb_decoder);
+  ut_assert_equal(lsb_decoded_data, data);
+
+  UtObjectRef msb_data_stream = ut_list_input_stream_new(data);
+  UtObjectRef msb_encoder = ut_lzw_encoder_new_msb(256, 4096, msb_data_stream);
+  UtObjectRef msb_result = ut_input_stream_read_sync(msb_encoder);
+  ut_assert_is_not_error(msb_result);
+  UtObjectRef msb_result_stream = ut_list_input_stream_new(msb_result);
+  UtObjectRef msb_decoder =
+      ut_lzw_decoder_new_msb(256, 4096, msb_result_stream);
+  UtObjectRef msb_decoded_data = ut_input_stream_read_sync(msb_decoder);
+  ut_assert_equal(msb_decoded_data, data);
+}
+
 int main(int argc, char **argv) {
   test_lsb();
   test_msb();
+  test_round_trip();
 
   return 0;
 }
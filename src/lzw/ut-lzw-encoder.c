@@ -19,6 +19,10 @@ typedef struct {
   // Bytes that each code represents.
   UtObject *dictionary;
 
+  // Code for the symbols read that have not yet been written.
+  bool have_code;
+  uint16_t code;
+
   // Length of next code to write.
   size_t code_length;
 
@@ -33,59 +37,6 @@ typedef struct {
   size_t unused_bits;
 } UtLzwEncoder;
 
-// Returns true if [data] matches [entry].
-static bool matches(UtObject *entry, UtObject *data) {
-  size_t entry_length = ut_list_get_length(entry);
-  size_t data_length = ut_list_get_length(data);
-  size_t max_length = data_length < entry_length ? data_length : entry_length;
-  for (size_t i = 0; i < max_length; i++) {
-    if (ut_uint8_list_get_element(entry, i) !=
-        ut_uint8_list_get_element(data, i)) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
-// Find a dictionary match for the given data.
-static bool find_match(UtLzwEncoder *self, UtObject *data, bool complete,
-                       size_t *match_length, uint16_t *code) {
-  size_t data_length = ut_list_get_length(data);
-  size_t dictionary_length = ut_lzw_dictionary_get_length(self->dictionary);
-  UtObject *match = NULL;
-  size_t match_index = 0;
-  // FIXME: Reverse for efficiency (match longest first)
-  for (size_t i = 0; i < dictionary_length; i++) {
-    UtObject *entry = ut_lzw_dictionary_lookup(self->dictionary, i);
-    size_t entry_length = ut_list_get_length(entry);
-
-    // Existing match is longer.
-    if (match != NULL && entry_length < ut_list_get_length(match)) {
-      continue;
-    }
-
-    // Not enough data remaining for this entry.
-    if (entry_length > data_length && complete) {
-      continue;
-    }
-
-    if (matches(entry, data)) {
-      match = entry;
-      match_index = i;
-
-      // May be able to match longer if have more data.
-      if (entry_length > data_length && !complete) {
-        return false;
-      }
-    }
-  }
-
-  *match_length = ut_list_get_length(match);
-  *code = match_index;
-  return true;
-}
-
 // Update length of next code to read.
 static void update_code_length(UtLzwEncoder *self) {
   size_t dictionary_length = ut_lzw_dictionary_get_length(self->dictionary);
@@ -131,40 +82,70 @@ static void write_code(UtLzwEncoder *self, uint16_t code) {
   }
 }
 
+// Add a dictionary entry that extends [code] with [b].
+static void append_entry(UtLzwEncoder *self, uint16_t code, uint8_t b) {
+  ut_lzw_dictionary_append(self->dictionary, code, b);
+
+  // Reset dictionary when it's full.
+  // FIXME: Ideally would look ahead and determine if current dictionary is
+  // sufficient.
+  if (ut_lzw_dictionary_get_is_full(self->dictionary)) {
+    write_code(self, ut_lzw_dictionary_get_clear_code(self->dictionary));
+
+    ut_lzw_dictionary_clear(self->dictionary);
+    self->code_length = 0;
+  }
+}
+
+static void encode(UtLzwEncoder *self, const uint8_t *data,
+                   size_t data_length) {
+  size_t offset = 0;
+  if (!self->have_code && data_length > 0) {
+    assert(data[0] < self->n_symbols);
+    self->code = data[0];
+    self->have_code = true;
+    offset++;
+  }
+
+  // Extend the current code until there is no matching dictionary entry.
+  uint16_t code = self->code;
+  for (; offset < data_length; offset++) {
+    uint8_t b = data[offset];
+    assert(b < self->n_symbols);
+    uint16_t extended_code;
+    if (ut_lzw_dictionary_find(self->dictionary, code, b, &extended_code)) {
+      code = extended_code;
+    } else {
+      write_code(self, code);
+
+      // New dictionary entry with next symbol appended to just used match.
+      append_entry(self, code, b);
+      code = b;
+    }
+  }
+  self->code = code;
+}
+
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   UtLzwEncoder *self = (UtLzwEncoder *)object;
 
   size_t data_length = ut_list_get_length(data);
-  size_t offset = 0;
-  while (offset < data_length) {
-    assert(ut_uint8_list_get_element(data, 0) < self->n_symbols);
-
-    // Find the longest match in our dictionary.
-    UtObjectRef d = ut_list_get_sublist(data, offset, data_length - offset);
-    size_t match_length;
-    uint16_t code;
-    if (!find_match(self, d, complete, &match_length, &code)) {
-      break;
-    }
-    write_code(self, code);
-    offset += match_length;
-
-    // New dictionary entry with next symbol appended to just used match.
-    // Note on the last code an entry is written using 0 to ensure the following
-    // code is the correct length.
-    uint8_t b =
-        offset < data_length ? ut_uint8_list_get_element(data, offset) : 0;
-    ut_lzw_dictionary_append(self->dictionary, code, b);
-
-    // Reset dictionary when it's full.
-    // FIXME: Ideally would look ahead and determine if current dictionary is
-    // sufficient.
-    if (ut_lzw_dictionary_get_is_full(self->dictionary)) {
-      write_code(self, ut_lzw_dictionary_get_clear_code(self->dictionary));
-
-      ut_lzw_dictionary_clear(self->dictionary);
-      self->code_length = 0;
-    }
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  if (d != NULL) {
+    encode(self, d, data_length);
+  } else {
+    UtObjectRef data_copy = ut_uint8_array_new();
+    ut_list_append_list(data_copy, data);
+    encode(self, ut_uint8_list_get_data(data_copy), data_length);
+  }
+
+  // Write the remaining symbols.
+  // Note on the last code an entry is written using 0 to ensure the following
+  // code is the correct length.
+  if (complete && self->have_code) {
+    write_code(self, self->code);
+    append_entry(self, self->code, 0);
+    self->have_code = false;
   }
 
   if (complete) {
@@ -185,7 +166,7 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
     ut_list_remove(self->buffer, 0, n);
   }
 
-  return offset;
+  return data_length;
 }
 
 static void ut_lzw_encoder_init(UtObject *object) {
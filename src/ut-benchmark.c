@@ -0,0 +1,98 @@
+#include <string.h>
+#include <time.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+static uint32_t seed = 1;
+
+double ut_benchmark_get_time() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+uint32_t ut_benchmark_get_random() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+UtObject *ut_benchmark_make_text(size_t length) {
+  const char *words[] = {
+      "the",         "of",        "and",        "to",     "in",     "is",
+      "that",        "for",       "it",         "as",     "was",    "with",
+      "be",          "by",        "on",         "not",    "he",     "this",
+      "are",         "or",        "his",        "from",   "at",     "which",
+      "but",         "have",      "an",         "had",    "they",   "you",
+      "were",        "their",     "one",        "all",    "we",     "can",
+      "her",         "has",       "there",      "been",   "if",     "more",
+      "when",        "will",      "would",      "who",    "so",     "no",
+      "compression", "algorithm", "dictionary", "window", "symbol", "Huffman",
+      "stream",      "encoder",   "decoder",    "buffer"};
+  size_t n_words = sizeof(words) / sizeof(words[0]);
+
+  UtObjectRef data = ut_uint8_array_new();
+  size_t line_length = 0;
+  while (ut_list_get_length(data) < length) {
+    const char *word = words[ut_benchmark_get_random() % n_words];
+    ut_uint8_list_append_block(data, (const uint8_t *)word, strlen(word));
+    line_length += strlen(word) + 1;
+    if (line_length > 72) {
+      ut_uint8_list_append(data, '.');
+      ut_uint8_list_append(data, '\n');
+      line_length = 0;
+    } else {
+      ut_uint8_list_append(data, ' ');
+    }
+  }
+
+  return ut_list_get_sublist(data, 0, length);
+}
+
+UtObject *ut_benchmark_make_log_text(size_t length) {
+  const char *words[] = {"GET",     "POST",  "/index.html", "/api/v1/items",
+                         "200",     "404",   "Mozilla/5.0", "curl/8.0",
+                         "gzip",    "token", "session",     "user",
+                         "timeout", "retry", "connected",   "closed"};
+  size_t n_words = sizeof(words) / sizeof(words[0]);
+
+  UtObjectRef data = ut_uint8_array_new();
+  size_t line = 0;
+  while (ut_list_get_length(data) < length) {
+    ut_cstring_ref prefix =
+        ut_cstring_new_printf("2024-01-01 12:%02zi:%02zi [%zi]", line / 60 % 60,
+                              line % 60, line);
+    ut_uint8_list_append_block(data, (const uint8_t *)prefix, strlen(prefix));
+    for (size_t i = 0; i < 8; i++) {
+      const char *word = words[ut_benchmark_get_random() % n_words];
+      ut_uint8_list_append(data, ' ');
+      ut_uint8_list_append_block(data, (const uint8_t *)word, strlen(word));
+    }
+    ut_uint8_list_append(data, '\n');
+    line++;
+  }
+
+  return ut_list_get_sublist(data, 0, length);
+}
+
+UtObject *ut_benchmark_make_binary(size_t length) {
+  UtObjectRef data = ut_uint8_array_new();
+  uint32_t counter = 0;
+  while (ut_list_get_length(data) < length) {
+    ut_uint8_list_append_uint32_le(data, counter++);
+    ut_uint8_list_append_uint16_le(data, ut_benchmark_get_random() % 4);
+    ut_uint8_list_append_uint16_le(data, 0xffff);
+    ut_uint8_list_append_uint32_le(data, ut_benchmark_get_random());
+    ut_uint8_list_append_uint32_le(data, 0);
+  }
+  return ut_list_get_sublist(data, 0, length);
+}
+
+UtObject *ut_benchmark_make_random(size_t length) {
+  UtObjectRef data = ut_uint8_array_new_sized(length);
+  uint8_t *d = ut_uint8_list_get_writable_data(data);
+  for (size_t i = 0; i < length; i++) {
+    d[i] = ut_benchmark_get_random() & 0xff;
+  }
+  return ut_object_ref(data);
+}
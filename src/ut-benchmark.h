@@ -0,0 +1,30 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+// Timing and data generation shared by the benchmarks, and tests that need
+// generated data.
+
+// Returns the time in seconds from an arbitrary starting point, for measuring
+// durations.
+double ut_benchmark_get_time();
+
+// Returns the next value from a fixed pseudo-random sequence in the range
+// 0-65535, so generated data is the same on every run.
+uint32_t ut_benchmark_get_random();
+
+// Returns [length] bytes of text made from common English words.
+UtObject *ut_benchmark_make_text(size_t length);
+
+// Returns [length] bytes of text in the style of a web server log.
+UtObject *ut_benchmark_make_log_text(size_t length);
+
+// Returns [length] bytes of binary records with counters, flags and some
+// noise.
+UtObject *ut_benchmark_make_binary(size_t length);
+
+// Returns [length] bytes of random data, which can't be compressed.
+UtObject *ut_benchmark_make_random(size_t length);
@@ -1,19 +1,44 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
   bool *data;
   size_t data_length;
+  size_t data_allocated;
 } UtBooleanArray;
 
+static void set_allocated(UtBooleanArray *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(bool) * allocated);
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtBooleanArray *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static void resize_list(UtBooleanArray *self, size_t length) {
-  self->data = realloc(self->data, sizeof(bool) * length);
-  for (size_t i = self->data_length; i < length; i++) {
-    self->data[i] = 0;
+  grow(self, length);
+  if (length > self->data_length) {
+    memset(self->data + self->data_length, 0,
+           sizeof(bool) * (length - self->data_length));
   }
   self->data_length = length;
 }
@@ -27,16 +52,11 @@ static void ut_boolean_array_insert(UtObject *object, size_t index, bool item) {
   UtBooleanArray *self = (UtBooleanArray *)object;
 
   size_t n_after = self->data_length - index;
-  resize_list(self, self->data_length + 1);
+  grow(self, self->data_length + 1);
 
-  // Shift existing data up
-  for (size_t i = 0; i < n_after; i++) {
-    size_t new_index = self->data_length - 1 - i;
-    self->data[new_index] = self->data[new_index - 1];
-  }
-
-  // Insert new data
+  memmove(self->data + index + 1, self->data + index, sizeof(bool) * n_after);
   self->data[index] = item;
+  self->data_length++;
 }
 
 static void ut_boolean_array_insert_object(UtObject *object, size_t index,
@@ -51,10 +71,12 @@ static void ut_boolean_array_remove(UtObject *object, size_t index,
   UtBooleanArray *self = (UtBooleanArray *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
-  for (size_t i = index; i < self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
+  if (count == 0) {
+    return;
   }
-  resize_list(self, self->data_length - count);
+  memmove(self->data + index, self->data + index + count,
+          sizeof(bool) * (self->data_length - index - count));
+  self->data_length -= count;
 }
 
 static void ut_boolean_array_resize(UtObject *object, size_t length) {
@@ -137,11 +159,9 @@ UtObject *ut_boolean_array_new_sized(size_t length) {
   UtObject *object = ut_boolean_array_new();
   UtBooleanArray *self = (UtBooleanArray *)object;
 
-  self->data = malloc(sizeof(bool) * length);
+  self->data = calloc(length, sizeof(bool));
   self->data_length = length;
-  for (size_t i = 0; i < length; i++) {
-    self->data[i] = 0;
-  }
+  self->data_allocated = length;
 
   return object;
 }
@@ -152,6 +172,26 @@ bool *ut_boolean_array_get_data(UtObject *object) {
   return self->data;
 }
 
+void ut_boolean_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_boolean_array(object));
+  UtBooleanArray *self = (UtBooleanArray *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_boolean_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_boolean_array(object));
+  UtBooleanArray *self = (UtBooleanArray *)object;
+  if (self->data_length == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->data_allocated = 0;
+  } else if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_boolean_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
@@ -22,5 +22,12 @@ UtObject *ut_boolean_array_new_sized(size_t length);
 /// You may modify the contents.
 bool *ut_boolean_array_get_data(UtObject *object);
 
+/// Ensures [object] has space for at least [length] values, so it can grow to
+/// this length without reallocating.
+void ut_boolean_array_reserve(UtObject *object, size_t length);
+
+/// Frees any space in [object] that isn't being used by its current values.
+void ut_boolean_array_shrink_to_fit(UtObject *object);
+
 /// Returns [true] if [object] is a [UtBooleaArray].
 bool ut_object_is_boolean_array(UtObject *object);
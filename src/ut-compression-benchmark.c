@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures speed, compression ratio and memory allocations of the
+// compression, encoding and checksum modules on a fixed synthetic corpus.
+
+// Length of each corpus.
+#define CORPUS_LENGTH (2 * 1024 * 1024)
+
+#ifdef COUNT_ALLOCATIONS
+// Allocations are counted by wrapping the allocator at link time with
+// -Wl,--wrap=malloc etc.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n_members, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static size_t n_allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+  __atomic_add_fetch(&n_allocations, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n_members, size_t size) {
+  __atomic_add_fetch(&n_allocations, 1, __ATOMIC_RELAXED);
+  return __real_calloc(n_members, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  __atomic_add_fetch(&n_allocations, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+#endif
+
+static size_t get_n_allocations() {
+#ifdef COUNT_ALLOCATIONS
+  return __atomic_load_n(&n_allocations, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif
+}
+
+typedef UtObject *(*CodecFunction)(UtObject *data);
+
+static UtObject *deflate_encode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_deflate_encoder_new(data_stream);
+  return ut_input_stream_read_sync(encoder);
+}
+
+static UtObject *deflate_decode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_deflate_decoder_new(data_stream);
+  return ut_input_stream_read_sync(decoder);
+}
+
+static UtObject *zlib_encode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_zlib_encoder_new(data_stream);
+  return ut_input_stream_read_sync(encoder);
+}
+
+static UtObject *zlib_decode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_zlib_decoder_new(data_stream);
+  return ut_input_stream_read_sync(decoder);
+}
+
+static UtObject *gzip_encode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_gzip_encoder_new(data_stream);
+  return ut_input_stream_read_sync(encoder);
+}
+
+static UtObject *gzip_decode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_gzip_decoder_new(data_stream);
+  return ut_input_stream_read_sync(decoder);
+}
+
+static UtObject *lzw_encode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef encoder = ut_lzw_encoder_new_lsb(256, 4096, data_stream);
+  return ut_input_stream_read_sync(encoder);
+}
+
+static UtObject *lzw_decode(UtObject *data) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_lzw_decoder_new_lsb(256, 4096, data_stream);
+  return ut_input_stream_read_sync(decoder);
+}
+
+// Encodes bytes with a canonical Huffman code built from their frequencies.
+// The encoded data is the 256 code widths, the number of bytes, then the
+// codes packed most significant bit first.
+static UtObject *huffman_encode(UtObject *data) {
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  size_t data_length = ut_list_get_length(data);
+
+  size_t counts[256] = {0};
+  for (size_t i = 0; i < data_length; i++) {
+    counts[d[i]]++;
+  }
+  UtObjectRef weights = ut_float64_array_new();
+  for (size_t i = 0; i < 256; i++) {
+    ut_float64_list_append(weights, counts[i]);
+  }
+  UtObjectRef encoder = ut_huffman_encoder_new_length_limited(weights, 15);
+
+  uint16_t codes[256];
+  size_t code_widths[256];
+  UtObjectRef encoded_data =
+      ut_uint8_array_new_sized(256 + 4 + data_length * 2);
+  uint8_t *e = ut_uint8_list_get_writable_data(encoded_data);
+  for (size_t i = 0; i < 256; i++) {
+    code_widths[i] = 0;
+    if (counts[i] > 0) {
+      ut_huffman_encoder_get_code(encoder, i, &codes[i], &code_widths[i]);
+    }
+    e[i] = code_widths[i];
+  }
+  e[256] = data_length & 0xff;
+  e[257] = (data_length >> 8) & 0xff;
+  e[258] = (data_length >> 16) & 0xff;
+  e[259] = (data_length >> 24) & 0xff;
+
+  size_t length = 260;
+  uint64_t bits = 0;
+  size_t n_bits = 0;
+  for (size_t i = 0; i < data_length; i++) {
+    bits = bits << code_widths[d[i]] | codes[d[i]];
+    n_bits += code_widths[d[i]];
+    while (n_bits >= 8) {
+      e[length++] = (bits >> (n_bits - 8)) & 0xff;
+      n_bits -= 8;
+    }
+  }
+  if (n_bits > 0) {
+    e[length++] = (bits << (8 - n_bits)) & 0xff;
+  }
+  ut_list_resize(encoded_data, length);
+
+  return ut_object_ref(encoded_data);
+}
+
+static UtObject *huffman_decode(UtObject *data) {
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  size_t data_length = ut_list_get_length(data);
+
+  UtObjectRef code_widths = ut_list_get_sublist(data, 0, 256);
+  UtObjectRef decoder = ut_huffman_decoder_new_canonical(code_widths);
+  size_t decoded_length = ut_uint8_list_get_uint32_le(data, 256);
+
+  UtObjectRef decoded_data = ut_uint8_array_new_sized(decoded_length);
+  uint8_t *output = ut_uint8_list_get_writable_data(decoded_data);
+  size_t offset = 260;
+  uint64_t bits = 0;
+  size_t n_bits = 0;
+  for (size_t i = 0; i < decoded_length; i++) {
+    while (n_bits <= 56 && offset < data_length) {
+      bits |= (uint64_t)d[offset++] << (56 - n_bits);
+      n_bits += 8;
+    }
+    uint16_t symbol;
+    size_t code_width =
+        ut_huffman_decoder_lookup_msb_first(decoder, bits >> 48, &symbol);
+    ut_assert_true(code_width > 0 && code_width <= n_bits);
+    bits <<= code_width;
+    n_bits -= code_width;
+    output[i] = symbol;
+  }
+
+  return ut_object_ref(decoded_data);
+}
+
+static UtObject *base64_encode(UtObject *data) {
+  ut_cstring_ref text = ut_base64_encode(data);
+  return ut_string_new(text);
+}
+
+static UtObject *base64_decode(UtObject *data) {
+  return ut_base64_decode(ut_string_get_text(data));
+}
+
+static size_t get_encoded_length(UtObject *encoded_data) {
+  if (ut_object_implements_string(encoded_data)) {
+    return strlen(ut_string_get_text(encoded_data));
+  }
+  return ut_list_get_length(encoded_data);
+}
+
+// Encode and decode [data] and print the results. Rates are in terms of the
+// unencoded data.
+static void benchmark_codec(const char *name, const char *corpus_name,
+                            UtObject *data, CodecFunction encode,
+                            CodecFunction decode) {
+  double data_mb = ut_list_get_length(data) / 1e6;
+
+  size_t n_allocations_start = get_n_allocations();
+  double start = ut_benchmark_get_time();
+  UtObjectRef encoded_data = encode(data);
+  double encode_duration = ut_benchmark_get_time() - start;
+  size_t n_encode_allocations = get_n_allocations() - n_allocations_start;
+  ut_assert_is_not_error(encoded_data);
+
+  n_allocations_start = get_n_allocations();
+  start = ut_benchmark_get_time();
+  UtObjectRef decoded_data = decode(encoded_data);
+  double decode_duration = ut_benchmark_get_time() - start;
+  size_t n_decode_allocations = get_n_allocations() - n_allocations_start;
+  ut_assert_is_not_error(decoded_data);
+  ut_assert_equal(decoded_data, data);
+
+  double ratio = (double)ut_list_get_length(data) /
+                 get_encoded_length(encoded_data);
+  printf("%-8s %-7s %6.2f %9.1f %10.1f %9.1f %10.1f\n", name, corpus_name,
+         ratio, data_mb / encode_duration, n_encode_allocations / data_mb,
+         data_mb / decode_duration, n_decode_allocations / data_mb);
+}
+
+typedef uint32_t (*ChecksumFunction)(uint32_t checksum, const uint8_t *data,
+                                     size_t data_length);
+
+static void benchmark_checksum(const char *name, const char *corpus_name,
+                               UtObject *data, ChecksumFunction function,
+                               uint32_t initial_value) {
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  size_t data_length = ut_list_get_length(data);
+  size_t n_iterations = 16;
+
+  double start = ut_benchmark_get_time();
+  uint32_t checksum = initial_value;
+  for (size_t i = 0; i < n_iterations; i++) {
+    checksum = function(checksum, d, data_length);
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  printf("%-8s %-7s %6s %9.1f %10s  (%08x)\n", name, corpus_name, "-",
+         data_length * n_iterations / duration / 1e6, "-", checksum);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef text = ut_benchmark_make_text(CORPUS_LENGTH);
+  UtObjectRef binary = ut_benchmark_make_binary(CORPUS_LENGTH);
+  UtObjectRef random = ut_benchmark_make_random(CORPUS_LENGTH);
+  UtObject *corpus[] = {text, binary, random};
+  const char *corpus_names[] = {"text", "binary", "random"};
+
+  struct {
+    const char *name;
+    CodecFunction encode;
+    CodecFunction decode;
+  } codecs[] = {{"deflate", deflate_encode, deflate_decode},
+                {"zlib", zlib_encode, zlib_decode},
+                {"gzip", gzip_encode, gzip_decode},
+                {"lzw", lzw_encode, lzw_decode},
+                {"huffman", huffman_encode, huffman_decode},
+                {"base64", base64_encode, base64_decode}};
+
+#ifndef COUNT_ALLOCATIONS
+  printf("Allocations not counted, linker doesn't support --wrap\n");
+#endif
+  printf("%-8s %-7s %6s %9s %10s %9s %10s\n", "", "", "", "encode", "encode",
+         "decode", "decode");
+  printf("%-8s %-7s %6s %9s %10s %9s %10s\n", "codec", "corpus", "ratio",
+         "MB/s", "allocs/MB", "MB/s", "allocs/MB");
+  for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+    for (size_t j = 0; j < 3; j++) {
+      benchmark_codec(codecs[i].name, corpus_names[j], corpus[j],
+                      codecs[i].encode, codecs[i].decode);
+    }
+  }
+  for (size_t j = 0; j < 3; j++) {
+    benchmark_checksum("crc32", corpus_names[j], corpus[j], ut_crc32_update, 0);
+  }
+  for (size_t j = 0; j < 3; j++) {
+    benchmark_checksum("adler32", corpus_names[j], corpus[j],
+                       ut_adler32_update, 1);
+  }
+
+  return 0;
+}
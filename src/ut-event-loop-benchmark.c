@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures worker thread throughput with all jobs queued at once, then
+// completion latency with a bounded number of jobs in flight so the latency
+// isn't dominated by the time spent waiting behind other queued jobs.
+
+#define N_JOBS 100000
+
+// Number of jobs kept running when measuring latency.
+#define N_JOBS_IN_FLIGHT 16
+
+typedef struct {
+  UtObject object;
+  double submit_time;
+} Job;
+
+static UtObjectInterface job_object_interface = {.type_name = "Job"};
+
+// True when measuring latency, false when measuring throughput.
+static bool measuring_latency = false;
+
+// Jobs submitted, kept as the event loop only holds weak references.
+static UtObject *jobs = NULL;
+static size_t n_submitted = 0;
+static size_t n_complete = 0;
+static double start_time = 0;
+
+static double latencies[N_JOBS];
+
+static int compare_latency(const void *a, const void *b) {
+  double latency_a = *(const double *)a;
+  double latency_b = *(const double *)b;
+  return latency_a < latency_b ? -1 : (latency_a > latency_b ? 1 : 0);
+}
+
+static UtObject *job_cb(UtObject *data) {
+  // Do a small amount of work.
+  uint32_t value = 0;
+  for (size_t i = 0; i < 100; i++) {
+    value = value * 31 + i;
+  }
+  return ut_uint32_new(value);
+}
+
+static void result_cb(UtObject *object, UtObject *result);
+
+static void submit_job() {
+  UtObject *object = ut_object_new(sizeof(Job), &job_object_interface);
+  Job *job = (Job *)object;
+  job->submit_time = ut_benchmark_get_time();
+  ut_list_append_take(jobs, object);
+  n_submitted++;
+  ut_event_loop_add_worker_thread(job_cb, NULL, object, result_cb);
+}
+
+static void start_latency() {
+  measuring_latency = true;
+  n_submitted = 0;
+  n_complete = 0;
+  start_time = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_JOBS_IN_FLIGHT; i++) {
+    submit_job();
+  }
+}
+
+static void result_cb(UtObject *object, UtObject *result) {
+  Job *job = (Job *)object;
+
+  if (!measuring_latency) {
+    n_complete++;
+    if (n_complete == N_JOBS) {
+      double duration = ut_benchmark_get_time() - start_time;
+      printf("throughput: %d jobs in %.3fs, %.0f jobs/s\n", N_JOBS, duration,
+             N_JOBS / duration);
+      start_latency();
+    }
+    return;
+  }
+
+  latencies[n_complete] = ut_benchmark_get_time() - job->submit_time;
+  n_complete++;
+  if (n_submitted < N_JOBS) {
+    submit_job();
+  }
+  if (n_complete < N_JOBS) {
+    return;
+  }
+
+  double duration = ut_benchmark_get_time() - start_time;
+  qsort(latencies, N_JOBS, sizeof(double), compare_latency);
+  printf("latency with %d jobs in flight: %.0f jobs/s, p50 %.1fus, p99 "
+         "%.1fus\n",
+         N_JOBS_IN_FLIGHT, N_JOBS / duration, latencies[N_JOBS / 2] * 1e6,
+         latencies[N_JOBS * 99 / 100] * 1e6);
+  ut_event_loop_return(NULL);
+}
+
+int main(int argc, char **argv) {
+  jobs = ut_object_list_new();
+
+  start_time = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_JOBS; i++) {
+    submit_job();
+  }
+  ut_event_loop_run();
+
+  ut_object_unref(jobs);
+
+  return 0;
+}
@@ -8,6 +8,8 @@ static UtObject *timer = NULL;
 
 static void delay2_cb(UtObject *object) { printf("delay 2s\n"); }
 
+static void delay1500_cb(UtObject *object) { printf("delay 1500ms\n"); }
+
 static void delay3_cb(UtObject *object) { printf("delay 3s\n"); }
 
 static void delay5_cb(UtObject *object) {
@@ -40,6 +42,8 @@ int main(int argc, char **argv) {
       ut_event_loop_add_delay(5, dummy_object, delay5_cb);
   UtObjectRef delay3_timer =
       ut_event_loop_add_delay(3, dummy_object, delay3_cb);
+  UtObjectRef delay1500_timer =
+      ut_event_loop_add_delay_ms(1500, dummy_object, delay1500_cb);
   timer = ut_event_loop_add_timer(1, dummy_object, timer_cb);
 
   ut_event_loop_add_worker_thread(thread_cb, NULL, dummy_object,
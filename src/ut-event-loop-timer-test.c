@@ -0,0 +1,142 @@
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Number of one shot timers with random delays.
+#define N_DELAYS 200
+
+typedef struct {
+  UtObject object;
+  uint64_t delay;
+  UtObject *timer;
+  bool cancelled;
+  bool fired;
+} Delay;
+
+static void delay_cleanup(UtObject *object) {
+  Delay *self = (Delay *)object;
+  ut_object_unref(self->timer);
+}
+
+static UtObjectInterface delay_object_interface = {.type_name = "Delay",
+                                                   .cleanup = delay_cleanup};
+
+static double start_time;
+
+static UtObject *delays = NULL;
+static uint64_t last_delay = 0;
+
+static UtObject *victim_delay = NULL;
+
+static UtObject *self_cancelling_timer = NULL;
+static size_t n_self_cancelling_calls = 0;
+
+static UtObject *repeating_timer = NULL;
+static size_t n_repeating_calls = 0;
+static size_t n_repeating_calls_at_cancel = 0;
+
+static double get_elapsed_ms() {
+  return (ut_benchmark_get_time() - start_time) * 1000;
+}
+
+static void delay_cb(UtObject *object) {
+  Delay *self = (Delay *)object;
+  ut_assert_false(self->cancelled);
+  ut_assert_false(self->fired);
+  self->fired = true;
+
+  // Timers run in order of expiry, and not before they expire.
+  ut_assert_true(self->delay >= last_delay);
+  last_delay = self->delay;
+  ut_assert_true(get_elapsed_ms() >= self->delay);
+}
+
+static UtObject *add_delay(uint64_t delay) {
+  UtObject *object = ut_object_new(sizeof(Delay), &delay_object_interface);
+  Delay *self = (Delay *)object;
+  self->delay = delay;
+  self->timer = ut_event_loop_add_delay_ms(delay, object, delay_cb);
+  ut_list_append_take(delays, object);
+  return object;
+}
+
+static void cancel_delay(UtObject *object) {
+  Delay *self = (Delay *)object;
+  ut_event_loop_cancel_timer(self->timer);
+  self->cancelled = true;
+}
+
+static void canceller_cb(UtObject *object) {
+  // Cancel a timer that is due, from inside another timer callback.
+  cancel_delay(victim_delay);
+}
+
+static void self_cancelling_cb(UtObject *object) {
+  n_self_cancelling_calls++;
+  if (n_self_cancelling_calls == 4) {
+    ut_event_loop_cancel_timer(self_cancelling_timer);
+  }
+}
+
+static void repeating_cb(UtObject *object) { n_repeating_calls++; }
+
+static void cancel_repeating_cb(UtObject *object) {
+  // Repeating timers are rescheduled after each call.
+  ut_assert_true(n_repeating_calls > 1);
+  ut_event_loop_cancel_timer(repeating_timer);
+  n_repeating_calls_at_cancel = n_repeating_calls;
+}
+
+static void done_cb(UtObject *object) {
+  size_t delays_length = ut_list_get_length(delays);
+  for (size_t i = 0; i < delays_length; i++) {
+    Delay *delay = (Delay *)ut_object_list_get_element(delays, i);
+    ut_assert_true(delay->fired != delay->cancelled);
+  }
+
+  ut_assert_int_equal(n_self_cancelling_calls, 4);
+  ut_assert_int_equal(n_repeating_calls, n_repeating_calls_at_cancel);
+
+  ut_event_loop_return(NULL);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef dummy_object = ut_null_new();
+  delays = ut_object_list_new();
+
+  start_time = ut_benchmark_get_time();
+
+  // Timers added in random order, some cancelled before they run. The delays
+  // are a few milliseconds apart so they don't depend on the time taken to
+  // add them.
+  for (size_t i = 0; i < N_DELAYS; i++) {
+    UtObject *delay = add_delay((ut_benchmark_get_random() % 50) * 2);
+    if (i % 7 == 0) {
+      cancel_delay(delay);
+    }
+  }
+
+  // Timer cancelled by the callback of an earlier timer.
+  UtObjectRef canceller_timer =
+      ut_event_loop_add_delay_ms(50, dummy_object, canceller_cb);
+  victim_delay = add_delay(51);
+
+  // Repeating timer that cancels itself.
+  self_cancelling_timer =
+      ut_event_loop_add_timer_ms(5, dummy_object, self_cancelling_cb);
+
+  // Repeating timer cancelled by another timer.
+  repeating_timer = ut_event_loop_add_timer_ms(3, dummy_object, repeating_cb);
+  UtObjectRef cancel_repeating_timer =
+      ut_event_loop_add_delay_ms(60, dummy_object, cancel_repeating_cb);
+
+  UtObjectRef done_timer =
+      ut_event_loop_add_delay_ms(150, dummy_object, done_cb);
+
+  ut_event_loop_run();
+
+  ut_object_unref(delays);
+  ut_object_unref(self_cancelling_timer);
+  ut_object_unref(repeating_timer);
+
+  return 0;
+}
@@ -1,5 +1,8 @@
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -7,69 +10,150 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #include "ut.h"
 
+// Maximum number of events to process from each call to epoll_wait().
+#define MAX_EPOLL_EVENTS 256
+
+// Number of file descriptors to check for abandoned watches each iteration.
+#define SWEEP_FDS_PER_ITERATION 16
+
+// Minimum number of threads in the worker thread pool.
+#define MINIMUM_WORKER_THREADS 4
+
 typedef struct {
   UtObject object;
-  struct timespec when;
-  struct timespec frequency;
+  // Monotonic time to run in nanoseconds.
+  uint64_t when;
+  // Time between repeats in nanoseconds, or 0 if doesn't repeat.
+  uint64_t frequency;
   UtObject *callback_object;
   UtEventLoopCallback callback;
   bool cancelled;
+  // Position in the loop timeout heap, or SIZE_MAX if not in the heap.
+  size_t heap_index;
 } Timeout;
 
-typedef struct {
+typedef struct _FdWatch FdWatch;
+
+struct _FdWatch {
   UtObject object;
   UtObject *fd;
   UtObject *callback_object;
   UtEventLoopCallback callback;
   bool cancelled;
-} FdWatch;
 
+  // Registration with the epoll backend.
+  bool is_write;
+  int registered_fd;
+  bool unpollable;
+  FdWatch *next;
+};
+
+// Watches on a file descriptor, used by the epoll backend.
 typedef struct {
-  UtObject object;
-  pthread_t thread_id;
-  int complete_write_fd;
-  int complete_read_fd;
+  FdWatch *read_watches;
+  FdWatch *write_watches;
+  uint32_t events;
+} FdRecord;
+
+typedef struct _WorkerJob WorkerJob;
+
+// Work submitted with ut_event_loop_add_worker_thread().
+struct _WorkerJob {
+  // Link in the completion queue, written by worker threads.
+  _Atomic(WorkerJob *) next_complete;
   UtThreadCallback thread_callback;
   UtObject *thread_data;
   UtObject *callback_object;
   UtThreadResultCallback result_callback;
-} WorkerThread;
+  UtObject *result;
+};
+
+// Queue of jobs for a worker, other workers steal from the back of it when
+// idle.
+typedef struct {
+  pthread_mutex_t mutex;
+  WorkerJob **jobs;
+  size_t start;
+  size_t length;
+  size_t allocated;
+} JobQueue;
+
+typedef struct _ThreadPool ThreadPool;
+
+typedef struct {
+  ThreadPool *pool;
+  pthread_t thread_id;
+  JobQueue queue;
+} PoolThread;
+
+struct _ThreadPool {
+  PoolThread *threads;
+  size_t threads_length;
+
+  // Thread to queue the next job on.
+  size_t next_thread;
+
+  // Idle threads wait on [condition] until jobs are queued.
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;
+  atomic_size_t n_queued;
+  bool shutdown;
+
+  // Lock-free multiple producer, single consumer queue of completed jobs.
+  // Producers add to [complete_head], the loop takes from [complete_tail].
+  _Atomic(WorkerJob *) complete_head;
+  WorkerJob *complete_tail;
+  WorkerJob complete_stub;
+
+  // Signalled when jobs are completed. Set [notify_pending] to avoid signalling
+  // more than once per wakeup.
+  int notify_write_fd;
+  UtObject *notify_read_fd;
+  UtObject *notify_watch;
+  atomic_bool notify_pending;
+};
 
 typedef struct {
   UtObject object;
-  UtObject *timeouts;
-  UtObject *read_watches;
-  UtObject *write_watches;
-  UtObject *worker_threads;
+  // Binary min-heap of timeouts ordered by expiry time.
+  Timeout **timeouts;
+  size_t timeouts_length;
+  size_t timeouts_allocated;
+  ThreadPool *thread_pool;
   bool complete;
   UtObject *return_value;
-} EventLoop;
 
-static UtObject *loop = NULL;
-
-static int time_compare(struct timespec *a, struct timespec *b) {
-  if (a->tv_sec == b->tv_sec) {
-    if (a->tv_nsec == b->tv_nsec) {
-      return 0;
-    }
+  // Watches used by the select backend.
+  UtObject *read_watches;
+  UtObject *write_watches;
 
-    return a->tv_nsec > b->tv_nsec ? 1 : -1;
-  }
+  // State for the epoll backend, or -1 if using select.
+  int epoll_fd;
+  FdRecord *fd_records;
+  size_t fd_records_length;
+  size_t sweep_fd;
+  // Watches on file descriptors that epoll doesn't support (e.g. regular
+  // files), these are always ready.
+  UtObject *unpollable_watches;
+  // Watches to be called this iteration.
+  FdWatch **ready_watches;
+  size_t ready_watches_length;
+  size_t ready_watches_allocated;
+} EventLoop;
 
-  return a->tv_sec > b->tv_sec ? 1 : -1;
-}
+static UtObject *loop = NULL;
 
-static void time_delta(struct timespec *a, struct timespec *b,
-                       struct timespec *delta) {
-  delta->tv_sec = b->tv_sec - a->tv_sec;
-  if (b->tv_nsec > a->tv_nsec) {
-    delta->tv_nsec = b->tv_nsec - a->tv_nsec;
-  } else {
-    delta->tv_sec--;
-    delta->tv_nsec = 1000000000 + b->tv_nsec - a->tv_nsec;
-  }
+static uint64_t get_monotonic_time() {
+  struct timespec now;
+  assert(clock_gettime(CLOCK_MONOTONIC, &now) == 0);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
 }
 
 static void timeout_cleanup(UtObject *object) {
@@ -80,31 +164,84 @@ static void timeout_cleanup(UtObject *object) {
 static UtObjectInterface timeout_object_interface = {
     .type_name = "Timeout", .cleanup = timeout_cleanup};
 
-static void insert_timeout(EventLoop *loop, Timeout *timeout) {
-  size_t timeouts_length = ut_list_get_length(loop->timeouts);
-  size_t index = 0;
-  while (index < timeouts_length) {
-    Timeout *next_timeout =
-        (Timeout *)ut_object_list_get_element(loop->timeouts, index);
-    if (time_compare(&next_timeout->when, &timeout->when) > 0) {
+static void set_heap_timeout(EventLoop *loop, size_t index, Timeout *timeout) {
+  loop->timeouts[index] = timeout;
+  timeout->heap_index = index;
+}
+
+static void sift_up(EventLoop *loop, size_t index) {
+  Timeout *timeout = loop->timeouts[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (loop->timeouts[parent]->when <= timeout->when) {
       break;
     }
-    index++;
+    set_heap_timeout(loop, index, loop->timeouts[parent]);
+    index = parent;
   }
-  ut_list_insert(loop->timeouts, index, (UtObject *)timeout);
+  set_heap_timeout(loop, index, timeout);
 }
 
-static UtObject *add_timeout(EventLoop *loop, time_t seconds, bool repeat,
+static void sift_down(EventLoop *loop, size_t index) {
+  Timeout *timeout = loop->timeouts[index];
+  while (true) {
+    size_t child = index * 2 + 1;
+    if (child >= loop->timeouts_length) {
+      break;
+    }
+    if (child + 1 < loop->timeouts_length &&
+        loop->timeouts[child + 1]->when < loop->timeouts[child]->when) {
+      child++;
+    }
+    if (timeout->when <= loop->timeouts[child]->when) {
+      break;
+    }
+    set_heap_timeout(loop, index, loop->timeouts[child]);
+    index = child;
+  }
+  set_heap_timeout(loop, index, timeout);
+}
+
+static void insert_timeout(EventLoop *loop, Timeout *timeout) {
+  if (loop->timeouts_length >= loop->timeouts_allocated) {
+    loop->timeouts_allocated =
+        loop->timeouts_allocated == 0 ? 16 : loop->timeouts_allocated * 2;
+    loop->timeouts =
+        realloc(loop->timeouts, sizeof(Timeout *) * loop->timeouts_allocated);
+  }
+  ut_object_ref((UtObject *)timeout);
+  set_heap_timeout(loop, loop->timeouts_length, timeout);
+  loop->timeouts_length++;
+  sift_up(loop, timeout->heap_index);
+}
+
+static void remove_timeout(EventLoop *loop, Timeout *timeout) {
+  size_t index = timeout->heap_index;
+  if (index >= loop->timeouts_length || loop->timeouts[index] != timeout) {
+    return;
+  }
+
+  loop->timeouts_length--;
+  if (index < loop->timeouts_length) {
+    set_heap_timeout(loop, index, loop->timeouts[loop->timeouts_length]);
+    sift_down(loop, index);
+    sift_up(loop, index);
+  }
+  timeout->heap_index = SIZE_MAX;
+  ut_object_unref((UtObject *)timeout);
+}
+
+static UtObject *add_timeout(EventLoop *loop, uint64_t nanoseconds, bool repeat,
                              UtObject *callback_object,
                              UtEventLoopCallback callback) {
   UtObject *object = ut_object_new(sizeof(Timeout), &timeout_object_interface);
   Timeout *self = (Timeout *)object;
-  assert(clock_gettime(CLOCK_MONOTONIC, &self->when) == 0);
-  self->when.tv_sec += seconds;
-  self->frequency.tv_sec = repeat ? seconds : 0;
-  self->frequency.tv_nsec = 0;
+  self->when = get_monotonic_time() + nanoseconds;
+  // A zero length repeat would never allow the loop to progress.
+  self->frequency = repeat ? (nanoseconds > 0 ? nanoseconds : 1) : 0;
   ut_object_weak_ref(callback_object, &self->callback_object);
   self->callback = callback;
+  self->heap_index = SIZE_MAX;
 
   insert_timeout(loop, self);
 
@@ -120,59 +257,324 @@ static void fd_watch_cleanup(UtObject *object) {
 static UtObjectInterface fd_watch_object_interface = {
     .type_name = "FdWatch", .cleanup = fd_watch_cleanup};
 
-static UtObject *fd_watch_new(UtObject *fd, UtObject *callback_object,
+static UtObject *fd_watch_new(UtObject *fd, bool is_write,
+                              UtObject *callback_object,
                               UtEventLoopCallback callback) {
   UtObject *object = ut_object_new(sizeof(FdWatch), &fd_watch_object_interface);
   FdWatch *self = (FdWatch *)object;
   self->fd = ut_object_ref(fd);
+  self->is_write = is_write;
+  self->registered_fd = -1;
   ut_object_weak_ref(callback_object, &self->callback_object);
   self->callback = callback;
   return object;
 }
 
-static void worker_thread_cleanup(UtObject *object) {
-  WorkerThread *thread = (WorkerThread *)object;
-  close(thread->complete_write_fd);
-  close(thread->complete_read_fd);
-  ut_object_unref(thread->thread_data);
-  ut_object_weak_unref(&thread->callback_object);
+static void job_free(WorkerJob *job) {
+  ut_object_unref(job->thread_data);
+  ut_object_weak_unref(&job->callback_object);
+  ut_object_unref(job->result);
+  free(job);
+}
+
+static void job_queue_init(JobQueue *queue) {
+  assert(pthread_mutex_init(&queue->mutex, NULL) == 0);
+  queue->jobs = NULL;
+  queue->start = 0;
+  queue->length = 0;
+  queue->allocated = 0;
 }
 
-static UtObjectInterface worker_thread_object_interface = {
-    .type_name = "WorkerThread", .cleanup = worker_thread_cleanup};
+static void job_queue_push(JobQueue *queue, WorkerJob *job) {
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->length >= queue->allocated) {
+    size_t allocated = queue->allocated == 0 ? 16 : queue->allocated * 2;
+    WorkerJob **jobs = malloc(sizeof(WorkerJob *) * allocated);
+    for (size_t i = 0; i < queue->length; i++) {
+      jobs[i] = queue->jobs[(queue->start + i) % queue->allocated];
+    }
+    free(queue->jobs);
+    queue->jobs = jobs;
+    queue->start = 0;
+    queue->allocated = allocated;
+  }
+  queue->jobs[(queue->start + queue->length) % queue->allocated] = job;
+  queue->length++;
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+// Take the oldest job, used by the thread that owns the queue.
+static WorkerJob *job_queue_pop(JobQueue *queue) {
+  pthread_mutex_lock(&queue->mutex);
+  WorkerJob *job = NULL;
+  if (queue->length > 0) {
+    job = queue->jobs[queue->start];
+    queue->start = (queue->start + 1) % queue->allocated;
+    queue->length--;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return job;
+}
 
-static UtObject *worker_thread_new(UtThreadCallback thread_callback,
-                                   void *thread_data, UtObject *callback_object,
-                                   UtThreadResultCallback result_callback) {
-  UtObject *object =
-      ut_object_new(sizeof(WorkerThread), &worker_thread_object_interface);
-  WorkerThread *self = (WorkerThread *)object;
+// Take the newest job, used by other threads.
+static WorkerJob *job_queue_steal(JobQueue *queue) {
+  if (pthread_mutex_trylock(&queue->mutex) != 0) {
+    return NULL;
+  }
+  WorkerJob *job = NULL;
+  if (queue->length > 0) {
+    queue->length--;
+    job = queue->jobs[(queue->start + queue->length) % queue->allocated];
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return job;
+}
+
+static void job_queue_clear(JobQueue *queue) {
+  WorkerJob *job;
+  while ((job = job_queue_pop(queue)) != NULL) {
+    job_free(job);
+  }
+  free(queue->jobs);
+  pthread_mutex_destroy(&queue->mutex);
+}
+
+static void push_complete_job(ThreadPool *pool, WorkerJob *job) {
+  atomic_store_explicit(&job->next_complete, NULL, memory_order_relaxed);
+  WorkerJob *prev = atomic_exchange_explicit(&pool->complete_head, job,
+                                             memory_order_acq_rel);
+  atomic_store_explicit(&prev->next_complete, job, memory_order_release);
+}
+
+// Returns the next completed job or NULL if none are ready.
+static WorkerJob *pop_complete_job(ThreadPool *pool) {
+  WorkerJob *tail = pool->complete_tail;
+  WorkerJob *next =
+      atomic_load_explicit(&tail->next_complete, memory_order_acquire);
+  if (tail == &pool->complete_stub) {
+    if (next == NULL) {
+      return NULL;
+    }
+    pool->complete_tail = next;
+    tail = next;
+    next = atomic_load_explicit(&next->next_complete, memory_order_acquire);
+  }
+  if (next != NULL) {
+    pool->complete_tail = next;
+    return tail;
+  }
+
+  // A producer is part way through adding a job, it will notify again when
+  // done.
+  if (tail != atomic_load_explicit(&pool->complete_head, memory_order_acquire)) {
+    return NULL;
+  }
+
+  // Put the stub back so the last job can be removed.
+  push_complete_job(pool, &pool->complete_stub);
+  next = atomic_load_explicit(&tail->next_complete, memory_order_acquire);
+  if (next != NULL) {
+    pool->complete_tail = next;
+    return tail;
+  }
+  return NULL;
+}
+
+static WorkerJob *take_job(ThreadPool *pool, PoolThread *thread) {
+  while (true) {
+    WorkerJob *job = job_queue_pop(&thread->queue);
+    for (size_t i = 0; job == NULL && i < pool->threads_length; i++) {
+      job = job_queue_steal(&pool->threads[i].queue);
+    }
+    if (job != NULL) {
+      atomic_fetch_sub(&pool->n_queued, 1);
+      return job;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (atomic_load(&pool->n_queued) == 0 && !pool->shutdown) {
+      pthread_cond_wait(&pool->condition, &pool->mutex);
+    }
+    bool shutdown = pool->shutdown;
+    pthread_mutex_unlock(&pool->mutex);
+    if (shutdown) {
+      return NULL;
+    }
+  }
+}
+
+static void *pool_thread_cb(void *data) {
+  PoolThread *thread = data;
+  ThreadPool *pool = thread->pool;
+
+  WorkerJob *job;
+  while ((job = take_job(pool, thread)) != NULL) {
+    job->result = job->thread_callback(job->thread_data);
+    push_complete_job(pool, job);
+
+    // Notify the main loop.
+    if (!atomic_exchange(&pool->notify_pending, true)) {
+      uint64_t count = 1;
+      assert(write(pool->notify_write_fd, &count, sizeof(count)) ==
+             sizeof(count));
+    }
+  }
+
+  return NULL;
+}
+
+static void thread_pool_notify_cb(UtObject *object) {
+  EventLoop *loop = (EventLoop *)object;
+  ThreadPool *pool = loop->thread_pool;
+
+  // Clear the notification before processing, so any jobs completed after
+  // this will notify again.
+  uint8_t buffer[8];
+  assert(read(ut_file_descriptor_get_fd(pool->notify_read_fd), buffer,
+              sizeof(buffer)) > 0);
+  atomic_store(&pool->notify_pending, false);
+
+  WorkerJob *job;
+  while ((job = pop_complete_job(pool)) != NULL) {
+    if (job->callback_object != NULL && job->result_callback != NULL) {
+      job->result_callback(job->callback_object, job->result);
+    }
+    job_free(job);
+  }
+}
+
+static ThreadPool *thread_pool_new(EventLoop *loop) {
+  ThreadPool *pool = malloc(sizeof(ThreadPool));
+
+  assert(pthread_mutex_init(&pool->mutex, NULL) == 0);
+  assert(pthread_cond_init(&pool->condition, NULL) == 0);
+  atomic_init(&pool->n_queued, 0);
+  pool->shutdown = false;
+  pool->next_thread = 0;
+
+  atomic_init(&pool->complete_stub.next_complete, NULL);
+  atomic_init(&pool->complete_head, &pool->complete_stub);
+  pool->complete_tail = &pool->complete_stub;
+
+#ifdef __linux__
+  int notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  assert(notify_fd >= 0);
+  pool->notify_write_fd = notify_fd;
+  pool->notify_read_fd = ut_file_descriptor_new(dup(notify_fd));
+#else
   int fds[2];
   assert(pipe(fds) == 0);
-  self->complete_write_fd = fds[1];
-  self->complete_read_fd = fds[0];
-  self->thread_callback = thread_callback;
-  self->thread_data = thread_data;
-  ut_object_weak_ref(callback_object, &self->callback_object);
-  self->result_callback = result_callback;
-  return object;
+  pool->notify_write_fd = fds[1];
+  pool->notify_read_fd = ut_file_descriptor_new(fds[0]);
+#endif
+  atomic_init(&pool->notify_pending, false);
+  pool->notify_watch = ut_event_loop_add_read_watch(
+      pool->notify_read_fd, (UtObject *)loop, thread_pool_notify_cb);
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  pool->threads_length =
+      n_cpus > MINIMUM_WORKER_THREADS ? n_cpus : MINIMUM_WORKER_THREADS;
+  pool->threads = malloc(sizeof(PoolThread) * pool->threads_length);
+  for (size_t i = 0; i < pool->threads_length; i++) {
+    PoolThread *thread = &pool->threads[i];
+    thread->pool = pool;
+    job_queue_init(&thread->queue);
+  }
+  for (size_t i = 0; i < pool->threads_length; i++) {
+    PoolThread *thread = &pool->threads[i];
+    assert(pthread_create(&thread->thread_id, NULL, pool_thread_cb, thread) ==
+           0);
+  }
+
+  return pool;
+}
+
+// Stops the threads in [pool], waiting for any running jobs to complete.
+// Jobs that haven't started are discarded.
+static void thread_pool_free(ThreadPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = true;
+  pthread_cond_broadcast(&pool->condition);
+  pthread_mutex_unlock(&pool->mutex);
+  for (size_t i = 0; i < pool->threads_length; i++) {
+    pthread_join(pool->threads[i].thread_id, NULL);
+  }
+  for (size_t i = 0; i < pool->threads_length; i++) {
+    job_queue_clear(&pool->threads[i].queue);
+  }
+  free(pool->threads);
+
+  WorkerJob *job;
+  while ((job = pop_complete_job(pool)) != NULL) {
+    job_free(job);
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->condition);
+  close(pool->notify_write_fd);
+  ut_object_unref(pool->notify_read_fd);
+  ut_object_unref(pool->notify_watch);
+  free(pool);
+}
+
+static void thread_pool_add_job(ThreadPool *pool, WorkerJob *job) {
+  PoolThread *thread = &pool->threads[pool->next_thread];
+  pool->next_thread = (pool->next_thread + 1) % pool->threads_length;
+  job_queue_push(&thread->queue, job);
+
+  pthread_mutex_lock(&pool->mutex);
+  atomic_fetch_add(&pool->n_queued, 1);
+  pthread_cond_signal(&pool->condition);
+  pthread_mutex_unlock(&pool->mutex);
 }
 
 static void event_loop_init(UtObject *object) {
   EventLoop *self = (EventLoop *)object;
-  self->timeouts = ut_list_new();
   self->read_watches = ut_list_new();
   self->write_watches = ut_list_new();
-  self->worker_threads = ut_list_new();
+  self->unpollable_watches = ut_list_new();
+
+  self->epoll_fd = -1;
+#ifdef __linux__
+  if (getenv("UT_EVENT_LOOP_USE_SELECT") == NULL) {
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  }
+#endif
+}
+
+static void free_watch_list(FdWatch *watches) {
+  FdWatch *next_watch;
+  for (FdWatch *watch = watches; watch != NULL; watch = next_watch) {
+    next_watch = watch->next;
+    watch->next = NULL;
+    watch->registered_fd = -1;
+    ut_object_unref((UtObject *)watch);
+  }
 }
 
 static void event_loop_cleanup(UtObject *object) {
   EventLoop *self = (EventLoop *)object;
-  ut_object_unref(self->timeouts);
+  for (size_t i = 0; i < self->timeouts_length; i++) {
+    self->timeouts[i]->heap_index = SIZE_MAX;
+    ut_object_unref((UtObject *)self->timeouts[i]);
+  }
+  free(self->timeouts);
   ut_object_unref(self->read_watches);
   ut_object_unref(self->write_watches);
-  ut_object_unref(self->worker_threads);
+  if (self->thread_pool != NULL) {
+    thread_pool_free(self->thread_pool);
+  }
   ut_object_unref(self->return_value);
+  for (size_t i = 0; i < self->fd_records_length; i++) {
+    free_watch_list(self->fd_records[i].read_watches);
+    free_watch_list(self->fd_records[i].write_watches);
+  }
+  free(self->fd_records);
+  ut_object_unref(self->unpollable_watches);
+  free(self->ready_watches);
+  if (self->epoll_fd >= 0) {
+    close(self->epoll_fd);
+  }
 }
 
 static UtObjectInterface event_loop_object_interface = {
@@ -191,34 +593,205 @@ static EventLoop *get_loop() {
 UtObject *ut_event_loop_add_delay(time_t seconds, UtObject *callback_object,
                                   UtEventLoopCallback callback) {
   EventLoop *loop = get_loop();
-  return add_timeout(loop, seconds, false, callback_object, callback);
+  return add_timeout(loop, (uint64_t)seconds * 1000000000, false,
+                     callback_object, callback);
+}
+
+UtObject *ut_event_loop_add_delay_ms(uint64_t milliseconds,
+                                     UtObject *callback_object,
+                                     UtEventLoopCallback callback) {
+  EventLoop *loop = get_loop();
+  return add_timeout(loop, milliseconds * 1000000, false, callback_object,
+                     callback);
 }
 
 UtObject *ut_event_loop_add_timer(time_t seconds, UtObject *callback_object,
                                   UtEventLoopCallback callback) {
   EventLoop *loop = get_loop();
-  return add_timeout(loop, seconds, true, callback_object, callback);
+  return add_timeout(loop, (uint64_t)seconds * 1000000000, true,
+                     callback_object, callback);
+}
+
+UtObject *ut_event_loop_add_timer_ms(uint64_t milliseconds,
+                                     UtObject *callback_object,
+                                     UtEventLoopCallback callback) {
+  EventLoop *loop = get_loop();
+  return add_timeout(loop, milliseconds * 1000000, true, callback_object,
+                     callback);
 }
 
 void ut_event_loop_cancel_timer(UtObject *timer) {
   assert(ut_object_is_type(timer, &timeout_object_interface));
   Timeout *t = (Timeout *)timer;
   t->cancelled = true;
+  if (loop != NULL) {
+    remove_timeout((EventLoop *)loop, t);
+  }
+}
+
+#ifdef __linux__
+static FdRecord *get_fd_record(EventLoop *loop, int fd) {
+  if ((size_t)fd >= loop->fd_records_length) {
+    size_t length = loop->fd_records_length == 0 ? 64 : loop->fd_records_length;
+    while (length <= (size_t)fd) {
+      length *= 2;
+    }
+    loop->fd_records = realloc(loop->fd_records, sizeof(FdRecord) * length);
+    for (size_t i = loop->fd_records_length; i < length; i++) {
+      loop->fd_records[i].read_watches = NULL;
+      loop->fd_records[i].write_watches = NULL;
+      loop->fd_records[i].events = 0;
+    }
+    loop->fd_records_length = length;
+  }
+
+  return &loop->fd_records[fd];
+}
+
+// Update the epoll registration for [fd] to match the watches on it.
+static bool update_fd_record(EventLoop *loop, int fd) {
+  FdRecord *record = get_fd_record(loop, fd);
+  uint32_t events = (record->read_watches != NULL ? EPOLLIN : 0) |
+                    (record->write_watches != NULL ? EPOLLOUT : 0);
+  if (events == record->events) {
+    return true;
+  }
+
+  struct epoll_event event = {.events = events, .data.fd = fd};
+  int result;
+  if (events == 0) {
+    // May fail if the fd has already been closed, which removes it from epoll.
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    result = 0;
+  } else if (record->events == 0) {
+    result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    if (result != 0 && errno == EEXIST) {
+      result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+  } else {
+    result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    if (result != 0 && errno == ENOENT) {
+      result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+  }
+  if (result != 0) {
+    return false;
+  }
+
+  record->events = events;
+  return true;
+}
+
+static void epoll_add_watch(EventLoop *loop, FdWatch *watch) {
+  int fd = ut_file_descriptor_get_fd(watch->fd);
+  assert(fd >= 0);
+
+  FdRecord *record = get_fd_record(loop, fd);
+  FdWatch **watches =
+      watch->is_write ? &record->write_watches : &record->read_watches;
+  watch->next = *watches;
+  *watches = (FdWatch *)ut_object_ref((UtObject *)watch);
+  watch->registered_fd = fd;
+  if (update_fd_record(loop, fd)) {
+    return;
+  }
+
+  // epoll doesn't support regular files, treat them as always ready like
+  // select does.
+  assert(errno == EPERM);
+  *watches = watch->next;
+  watch->next = NULL;
+  watch->registered_fd = -1;
+  watch->unpollable = true;
+  ut_list_append(loop->unpollable_watches, (UtObject *)watch);
+  ut_object_unref((UtObject *)watch);
+}
+
+static void epoll_remove_watch(EventLoop *loop, FdWatch *watch) {
+  if (watch->unpollable) {
+    size_t unpollable_watches_length =
+        ut_list_get_length(loop->unpollable_watches);
+    for (size_t i = 0; i < unpollable_watches_length; i++) {
+      if (ut_object_list_get_element(loop->unpollable_watches, i) ==
+          (UtObject *)watch) {
+        ut_list_remove(loop->unpollable_watches, i, 1);
+        break;
+      }
+    }
+    return;
+  }
+
+  int fd = watch->registered_fd;
+  if (fd < 0 || (size_t)fd >= loop->fd_records_length) {
+    return;
+  }
+
+  FdRecord *record = &loop->fd_records[fd];
+  FdWatch **watches =
+      watch->is_write ? &record->write_watches : &record->read_watches;
+  for (FdWatch **w = watches; *w != NULL; w = &(*w)->next) {
+    if (*w == watch) {
+      *w = watch->next;
+      watch->next = NULL;
+      watch->registered_fd = -1;
+      update_fd_record(loop, fd);
+      ut_object_unref((UtObject *)watch);
+      return;
+    }
+  }
+}
+
+// Remove watches whose callback object has been destroyed without cancelling
+// them. These would otherwise stay registered until the fd becomes ready.
+static void sweep_watch_list(EventLoop *loop, FdWatch *watches) {
+  FdWatch *next_watch;
+  for (FdWatch *watch = watches; watch != NULL; watch = next_watch) {
+    next_watch = watch->next;
+    if (watch->callback_object == NULL) {
+      epoll_remove_watch(loop, watch);
+    }
+  }
+}
+
+static void sweep_fd_records(EventLoop *loop) {
+  if (loop->fd_records_length == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < SWEEP_FDS_PER_ITERATION; i++) {
+    loop->sweep_fd = (loop->sweep_fd + 1) % loop->fd_records_length;
+    FdRecord *record = &loop->fd_records[loop->sweep_fd];
+    sweep_watch_list(loop, record->read_watches);
+    sweep_watch_list(loop, record->write_watches);
+  }
+}
+#endif
+
+static void add_watch(EventLoop *loop, FdWatch *watch) {
+#ifdef __linux__
+  if (loop->epoll_fd >= 0) {
+    epoll_add_watch(loop, watch);
+    return;
+  }
+#endif
+
+  ut_list_prepend(watch->is_write ? loop->write_watches : loop->read_watches,
+                  (UtObject *)watch);
 }
 
 UtObject *ut_event_loop_add_read_watch(UtObject *fd, UtObject *callback_object,
                                        UtEventLoopCallback callback) {
   EventLoop *loop = get_loop();
-  UtObject *watch = fd_watch_new(fd, callback_object, callback);
-  ut_list_prepend(loop->read_watches, watch);
+  UtObject *watch = fd_watch_new(fd, false, callback_object, callback);
+  add_watch(loop, (FdWatch *)watch);
   return watch;
 }
 
 UtObject *ut_event_loop_add_write_watch(UtObject *fd, UtObject *callback_object,
                                         UtEventLoopCallback callback) {
   EventLoop *loop = get_loop();
-  UtObject *watch = fd_watch_new(fd, callback_object, callback);
-  ut_list_prepend(loop->write_watches, watch);
+  UtObject *watch = fd_watch_new(fd, true, callback_object, callback);
+  add_watch(loop, (FdWatch *)watch);
   return watch;
 }
 
@@ -226,18 +799,15 @@ void ut_event_loop_cancel_watch(UtObject *watch) {
   assert(ut_object_is_type(watch, &fd_watch_object_interface));
   FdWatch *w = (FdWatch *)watch;
   w->cancelled = true;
-}
-
-static void *thread_cb(void *data) {
-  WorkerThread *thread = data;
 
-  void *result = thread->thread_callback(thread->thread_data);
-
-  // Notify the main loop.
-  uint8_t complete_data = 0;
-  assert(write(thread->complete_write_fd, &complete_data, 1) == 1);
-
-  return result;
+#ifdef __linux__
+  // Select watches are removed on the next iteration, epoll watches need to be
+  // unregistered now.
+  EventLoop *l = (EventLoop *)loop;
+  if (l != NULL && l->epoll_fd >= 0) {
+    epoll_remove_watch(l, w);
+  }
+#endif
 }
 
 void ut_event_loop_add_worker_thread(UtThreadCallback thread_callback,
@@ -245,12 +815,18 @@ void ut_event_loop_add_worker_thread(UtThreadCallback thread_callback,
                                      UtObject *callback_object,
                                      UtThreadResultCallback result_callback) {
   EventLoop *loop = get_loop();
-  UtObjectRef thread_object = worker_thread_new(
-      thread_callback, thread_data, callback_object, result_callback);
-  ut_list_prepend(loop->worker_threads, thread_object);
+  if (loop->thread_pool == NULL) {
+    loop->thread_pool = thread_pool_new(loop);
+  }
 
-  WorkerThread *thread = (WorkerThread *)thread_object;
-  assert(pthread_create(&thread->thread_id, NULL, thread_cb, thread) == 0);
+  WorkerJob *job = malloc(sizeof(WorkerJob));
+  atomic_init(&job->next_complete, NULL);
+  job->thread_callback = thread_callback;
+  job->thread_data = thread_data;
+  ut_object_weak_ref(callback_object, &job->callback_object);
+  job->result_callback = result_callback;
+  job->result = NULL;
+  thread_pool_add_job(loop->thread_pool, job);
 }
 
 void ut_event_loop_return(UtObject *return_value) {
@@ -260,197 +836,224 @@ void ut_event_loop_return(UtObject *return_value) {
   loop->complete = true;
 }
 
-UtObject *ut_event_loop_run() {
-  EventLoop *self = get_loop();
-  while (!self->complete) {
-    // Check for expired timeouts.
-    struct timespec now;
-    assert(clock_gettime(CLOCK_MONOTONIC, &now) == 0);
-    UtObjectRef expired_timeouts = ut_object_list_new();
-    UtObjectRef repeat_timeouts = ut_object_list_new();
-    size_t timeouts_length = ut_list_get_length(self->timeouts);
-    while (timeouts_length > 0) {
-      UtObject *timeout_object = ut_object_list_get_element(self->timeouts, 0);
-      Timeout *t = (Timeout *)timeout_object;
-
-      // All other timers are yet to expire.
-      if (time_compare(&t->when, &now) > 0) {
-        break;
-      }
+static void select_iteration(EventLoop *self, const struct timespec *timeout) {
+  int max_fd = -1;
+  fd_set read_fds;
+  fd_set write_fds;
+  FD_ZERO(&read_fds);
+  FD_ZERO(&write_fds);
 
-      ut_list_append(expired_timeouts, timeout_object);
-      bool repeats = t->frequency.tv_sec != 0 || t->frequency.tv_nsec != 0;
-      if (repeats) {
-        t->when.tv_sec += t->frequency.tv_sec;
-        t->when.tv_nsec += t->frequency.tv_nsec;
-        if (t->when.tv_nsec > 1000000000) {
-          t->when.tv_sec++;
-          t->when.tv_nsec -= 1000000000;
-        }
-        ut_list_append(repeat_timeouts, timeout_object);
-      }
-      ut_list_remove(self->timeouts, 0, 1);
-      timeouts_length--;
+  // Register file descriptors we are watching for.
+  size_t read_watches_length = ut_list_get_length(self->read_watches);
+  for (size_t i = 0; i < read_watches_length;) {
+    FdWatch *watch =
+        (FdWatch *)ut_object_list_get_element(self->read_watches, i);
+    if (watch->cancelled || watch->callback_object == NULL) {
+      ut_list_remove(self->read_watches, i, 1);
+      read_watches_length--;
+      continue;
     }
 
-    // Do callbacks for any timers that have expired.
-    size_t expired_timeouts_length = ut_list_get_length(expired_timeouts);
-    for (size_t i = 0; i < expired_timeouts_length; i++) {
-      Timeout *t = (Timeout *)ut_object_list_get_element(expired_timeouts, i);
-      if (!t->cancelled && t->callback_object) {
-        t->callback(t->callback_object);
-      }
+    int fd = ut_file_descriptor_get_fd(watch->fd);
+    assert(fd < FD_SETSIZE);
+    FD_SET(fd, &read_fds);
+    max_fd = fd > max_fd ? fd : max_fd;
+    i++;
+  }
+  size_t write_watches_length = ut_list_get_length(self->write_watches);
+  for (size_t i = 0; i < write_watches_length;) {
+    FdWatch *watch =
+        (FdWatch *)ut_object_list_get_element(self->write_watches, i);
+    if (watch->cancelled || watch->callback_object == NULL) {
+      ut_list_remove(self->write_watches, i, 1);
+      write_watches_length--;
+      continue;
     }
 
-    // Put in repeated timeouts.
-    size_t repeat_timeouts_length = ut_list_get_length(repeat_timeouts);
-    for (size_t i = 0; i < repeat_timeouts_length; i++) {
-      Timeout *t = (Timeout *)ut_object_list_get_element(repeat_timeouts, i);
-      insert_timeout(self, t);
-    }
+    int fd = ut_file_descriptor_get_fd(watch->fd);
+    assert(fd < FD_SETSIZE);
+    FD_SET(fd, &write_fds);
+    max_fd = fd > max_fd ? fd : max_fd;
+    i++;
+  }
 
-    // Remove any cancelled timeouts.
-    timeouts_length = ut_list_get_length(self->timeouts);
-    for (size_t i = 0; i < timeouts_length;) {
-      Timeout *t = (Timeout *)ut_object_list_get_element(self->timeouts, i);
-      if (t->cancelled || !t->callback_object) {
-        ut_list_remove(self->timeouts, i, 1);
-        timeouts_length--;
-      } else {
-        i++;
-      }
-    }
+  // Wait for file descriptors or timeout.
+  assert(pselect(max_fd + 1, &read_fds, &write_fds, NULL, timeout, NULL) >= 0);
 
-    // Next wait time is time to the next timeout.
-    const struct timespec *timeout = NULL;
-    struct timespec next_timeout;
-    if (timeouts_length > 0) {
-      Timeout *t = (Timeout *)ut_object_list_get_element(self->timeouts, 0);
-      time_delta(&now, &t->when, &next_timeout);
-      timeout = &next_timeout;
+  // Do callbacks for each fd that has changed.
+  read_watches_length = ut_list_get_length(self->read_watches);
+  UtObjectRef active_read_watches = ut_list_new();
+  for (size_t i = 0; i < read_watches_length; i++) {
+    UtObject *watch_object = ut_object_list_get_element(self->read_watches, i);
+    FdWatch *watch = (FdWatch *)watch_object;
+    if (FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &read_fds)) {
+      ut_list_append(active_read_watches, watch_object);
     }
-
-    if (self->complete) {
-      break;
+  }
+  size_t active_read_watches_length = ut_list_get_length(active_read_watches);
+  for (size_t i = 0; i < active_read_watches_length; i++) {
+    FdWatch *watch =
+        (FdWatch *)ut_object_list_get_element(active_read_watches, i);
+    if (!watch->cancelled && watch->callback_object != NULL &&
+        FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &read_fds)) {
+      watch->callback(watch->callback_object);
+    }
+  }
+  write_watches_length = ut_list_get_length(self->write_watches);
+  UtObjectRef active_write_watches = ut_list_new();
+  for (size_t i = 0; i < write_watches_length; i++) {
+    UtObject *watch_object = ut_object_list_get_element(self->write_watches, i);
+    FdWatch *watch = (FdWatch *)watch_object;
+    if (FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &write_fds)) {
+      ut_list_append(active_write_watches, watch_object);
+    }
+  }
+  size_t active_write_watches_length = ut_list_get_length(active_write_watches);
+  for (size_t i = 0; i < active_write_watches_length; i++) {
+    FdWatch *watch =
+        (FdWatch *)ut_object_list_get_element(active_write_watches, i);
+    if (!watch->cancelled && watch->callback_object != NULL &&
+        FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &write_fds)) {
+      watch->callback(watch->callback_object);
     }
+  }
+}
 
-    int max_fd = -1;
-    fd_set read_fds;
-    fd_set write_fds;
-    FD_ZERO(&read_fds);
-    FD_ZERO(&write_fds);
-
-    // Listen for thread completion.
-    size_t worker_threads_length = ut_list_get_length(self->worker_threads);
-    for (size_t i = 0; i < worker_threads_length; i++) {
-      WorkerThread *thread =
-          (WorkerThread *)ut_object_list_get_element(self->worker_threads, i);
-      FD_SET(thread->complete_read_fd, &read_fds);
-      max_fd =
-          thread->complete_read_fd > max_fd ? thread->complete_read_fd : max_fd;
-    }
-
-    // Register file descriptors we are watching for.
-    size_t read_watches_length = ut_list_get_length(self->read_watches);
-    for (size_t i = 0; i < read_watches_length;) {
-      FdWatch *watch =
-          (FdWatch *)ut_object_list_get_element(self->read_watches, i);
-      if (watch->cancelled || watch->callback_object == NULL) {
-        ut_list_remove(self->read_watches, i, 1);
-        read_watches_length--;
-        continue;
-      }
+#ifdef __linux__
+static void add_ready_watch(EventLoop *self, FdWatch *watch) {
+  if (self->ready_watches_length >= self->ready_watches_allocated) {
+    self->ready_watches_allocated = self->ready_watches_allocated == 0
+                                        ? MAX_EPOLL_EVENTS
+                                        : self->ready_watches_allocated * 2;
+    self->ready_watches = realloc(
+        self->ready_watches, sizeof(FdWatch *) * self->ready_watches_allocated);
+  }
+  self->ready_watches[self->ready_watches_length] =
+      (FdWatch *)ut_object_ref((UtObject *)watch);
+  self->ready_watches_length++;
+}
 
-      int fd = ut_file_descriptor_get_fd(watch->fd);
-      FD_SET(fd, &read_fds);
-      max_fd = fd > max_fd ? fd : max_fd;
-      i++;
-    }
-    size_t write_watches_length = ut_list_get_length(self->write_watches);
-    for (size_t i = 0; i < write_watches_length;) {
-      FdWatch *watch =
-          (FdWatch *)ut_object_list_get_element(self->write_watches, i);
-      if (watch->cancelled || watch->callback_object == NULL) {
-        ut_list_remove(self->write_watches, i, 1);
-        write_watches_length--;
-        continue;
-      }
+static void add_ready_watch_list(EventLoop *self, FdWatch *watches) {
+  for (FdWatch *watch = watches; watch != NULL; watch = watch->next) {
+    add_ready_watch(self, watch);
+  }
+}
+
+static void epoll_iteration(EventLoop *self, const struct timespec *timeout) {
+  sweep_fd_records(self);
 
-      int fd = ut_file_descriptor_get_fd(watch->fd);
-      FD_SET(fd, &write_fds);
-      max_fd = fd > max_fd ? fd : max_fd;
-      i++;
+  int timeout_ms = -1;
+  if (ut_list_get_length(self->unpollable_watches) > 0) {
+    timeout_ms = 0;
+  } else if (timeout != NULL) {
+    // Round up so we don't wake before the timeout has expired. Long timeouts
+    // are limited to what epoll supports, and wake early to check again.
+    int64_t ms = (int64_t)timeout->tv_sec * 1000 +
+                 (timeout->tv_nsec + 999999) / 1000000;
+    timeout_ms = ms < INT_MAX ? ms : INT_MAX;
+  }
+
+  // Wait for file descriptors or timeout.
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  int n_events =
+      epoll_wait(self->epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+  assert(n_events >= 0 || errno == EINTR);
+
+  // Collect the watches first, as callbacks may add and remove watches.
+  for (int i = 0; i < n_events; i++) {
+    FdRecord *record = &self->fd_records[events[i].data.fd];
+    uint32_t e = events[i].events;
+    if ((e & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+      add_ready_watch_list(self, record->read_watches);
+    }
+    if ((e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0) {
+      add_ready_watch_list(self, record->write_watches);
     }
+  }
+  size_t unpollable_watches_length =
+      ut_list_get_length(self->unpollable_watches);
+  for (size_t i = 0; i < unpollable_watches_length; i++) {
+    add_ready_watch(self, (FdWatch *)ut_object_list_get_element(
+                              self->unpollable_watches, i));
+  }
 
-    // Wait for file descriptors or timeout.
-    assert(pselect(max_fd + 1, &read_fds, &write_fds, NULL, timeout, NULL) >=
-           0);
+  // Do callbacks for each fd that has changed.
+  for (size_t i = 0; i < self->ready_watches_length; i++) {
+    FdWatch *watch = self->ready_watches[i];
+    if (watch->cancelled) {
+      continue;
+    }
+    if (watch->callback_object != NULL) {
+      watch->callback(watch->callback_object);
+    } else {
+      epoll_remove_watch(self, watch);
+    }
+  }
+  for (size_t i = 0; i < self->ready_watches_length; i++) {
+    ut_object_unref((UtObject *)self->ready_watches[i]);
+  }
+  self->ready_watches_length = 0;
+}
+#endif
+
+UtObject *ut_event_loop_run() {
+  EventLoop *self = get_loop();
+  while (!self->complete) {
+    // Do callbacks for any timers that have expired.
+    uint64_t now = get_monotonic_time();
+    while (self->timeouts_length > 0 && self->timeouts[0]->when <= now &&
+           !self->complete) {
+      Timeout *t = self->timeouts[0];
 
-    // Complete any worker threads.
-    worker_threads_length = ut_list_get_length(self->worker_threads);
-    for (size_t i = 0; i < worker_threads_length;) {
-      WorkerThread *thread =
-          (WorkerThread *)ut_object_list_get_element(self->worker_threads, i);
-      if (FD_ISSET(thread->complete_read_fd, &read_fds)) {
-        void *r;
-        assert(pthread_join(thread->thread_id, &r) == 0);
-        UtObjectRef result = r;
-        if (thread->callback_object != NULL &&
-            thread->result_callback != NULL) {
-          thread->result_callback(thread->callback_object, result);
+      // Hold a reference, as the callback may cancel the timer.
+      ut_object_ref((UtObject *)t);
+      if (t->frequency != 0 && t->callback_object != NULL) {
+        t->when += t->frequency;
+        // Skip missed repeats rather than running them all at once.
+        if (t->when <= now) {
+          t->when = now + t->frequency;
         }
-        ut_list_remove(self->worker_threads, i, 1);
-        worker_threads_length--;
+        sift_down(self, 0);
       } else {
-        i++;
+        remove_timeout(self, t);
       }
-    }
-
-    // Do callbacks for each fd that has changed.
-    read_watches_length = ut_list_get_length(self->read_watches);
-    UtObjectRef active_read_watches = ut_list_new();
-    for (size_t i = 0; i < read_watches_length; i++) {
-      UtObject *watch_object =
-          ut_object_list_get_element(self->read_watches, i);
-      FdWatch *watch = (FdWatch *)watch_object;
-      if (FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &read_fds)) {
-        ut_list_append(active_read_watches, watch_object);
+      if (!t->cancelled && t->callback_object != NULL) {
+        t->callback(t->callback_object);
       }
+      ut_object_unref((UtObject *)t);
     }
-    size_t active_read_watches_length = ut_list_get_length(active_read_watches);
-    for (size_t i = 0; i < active_read_watches_length; i++) {
-      FdWatch *watch =
-          (FdWatch *)ut_object_list_get_element(active_read_watches, i);
-      if (watch->callback_object != NULL &&
-          FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &read_fds)) {
-        watch->callback(watch->callback_object);
-      }
+
+    // Next wait time is time to the next timeout.
+    const struct timespec *timeout = NULL;
+    struct timespec next_timeout;
+    if (self->timeouts_length > 0) {
+      now = get_monotonic_time();
+      uint64_t when = self->timeouts[0]->when;
+      uint64_t delta = when > now ? when - now : 0;
+      next_timeout.tv_sec = delta / 1000000000;
+      next_timeout.tv_nsec = delta % 1000000000;
+      timeout = &next_timeout;
     }
-    write_watches_length = ut_list_get_length(self->write_watches);
-    UtObjectRef active_write_watches = ut_list_new();
-    for (size_t i = 0; i < write_watches_length; i++) {
-      UtObject *watch_object =
-          ut_object_list_get_element(self->write_watches, i);
-      FdWatch *watch = (FdWatch *)watch_object;
-      if (FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &write_fds)) {
-        ut_list_append(active_write_watches, watch_object);
-      }
+
+    if (self->complete) {
+      break;
     }
-    size_t active_write_watches_length =
-        ut_list_get_length(active_write_watches);
-    for (size_t i = 0; i < active_write_watches_length; i++) {
-      FdWatch *watch =
-          (FdWatch *)ut_object_list_get_element(active_write_watches, i);
-      if (watch->callback_object != NULL &&
-          FD_ISSET(ut_file_descriptor_get_fd(watch->fd), &write_fds)) {
-        watch->callback(watch->callback_object);
-      }
+
+#ifdef __linux__
+    if (self->epoll_fd >= 0) {
+      epoll_iteration(self, timeout);
+      continue;
     }
+#endif
+    select_iteration(self, timeout);
   }
 
   UtObjectRef return_value = ut_object_ref(self->return_value);
 
-  ut_object_clear(&loop);
+  // Clear the global first, so objects cleaned up with the loop don't try to
+  // use it.
+  loop = NULL;
+  ut_object_unref((UtObject *)self);
 
   return ut_object_ref(return_value);
 }
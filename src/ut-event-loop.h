@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/time.h>
 
 #include "ut-object.h"
@@ -16,6 +17,14 @@ typedef void (*UtThreadResultCallback)(UtObject *object, UtObject *result);
 UtObject *ut_event_loop_add_delay(time_t seconds, UtObject *callback_object,
                                   UtEventLoopCallback callback);
 
+/// Add a [callback] to be called after [milliseconds].
+/// Returns a handle that can be used in [ut_event_loop_cancel_timer].
+///
+/// !return-type UtObject
+UtObject *ut_event_loop_add_delay_ms(uint64_t milliseconds,
+                                     UtObject *callback_object,
+                                     UtEventLoopCallback callback);
+
 /// Add a [callback] to be called every [seconds].
 /// Returns a handle that can be used in [ut_event_loop_cancel_timer].
 ///
@@ -23,6 +32,14 @@ UtObject *ut_event_loop_add_delay(time_t seconds, UtObject *callback_object,
 UtObject *ut_event_loop_add_timer(time_t seconds, UtObject *callback_object,
                                   UtEventLoopCallback callback);
 
+/// Add a [callback] to be called every [milliseconds].
+/// Returns a handle that can be used in [ut_event_loop_cancel_timer].
+///
+/// !return-type UtObject
+UtObject *ut_event_loop_add_timer_ms(uint64_t milliseconds,
+                                     UtObject *callback_object,
+                                     UtEventLoopCallback callback);
+
 /// Cancels a previously started [timer].
 ///
 /// !arg-type timer UtObject
@@ -47,9 +64,11 @@ UtObject *ut_event_loop_add_write_watch(UtObject *fd, UtObject *callback_object,
 /// !arg-type watch UtObject
 void ut_event_loop_cancel_watch(UtObject *watch);
 
-/// Starts a thread in [thread_callback].
-/// [thread_data] is passed to the new thread.
+/// Runs [thread_callback] on a worker thread.
+/// [thread_data] is passed to the thread.
 /// When the thread completes, [result_callback] is called.
+/// Worker threads are shared from a fixed size pool, so [thread_callback]
+/// may not start immediately if all threads are busy.
 ///
 /// !arg-type thread_data UtObject NULL.
 void ut_event_loop_add_worker_thread(UtThreadCallback thread_callback,
@@ -64,6 +83,8 @@ void ut_event_loop_return(UtObject *return_value);
 
 /// Run the event loop.
 /// This will return when [ut_event_loop_return] is called.
+/// On Linux file descriptors are polled using epoll, set the environment
+/// variable UT_EVENT_LOOP_USE_SELECT to use select() instead.
 ///
 /// !return-ref
 /// !return-type UtObject NULL
@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include "ut-fd-input-stream.h"
+#include "ut-input-buffer.h"
 #include "ut.h"
 
 typedef struct {
@@ -21,18 +22,14 @@ typedef struct {
 static void read_cb(UtObject *object) {
   UtFdInputStream *self = (UtFdInputStream *)object;
 
-  // Make space to read a new block.
-  size_t buffer_length = ut_list_get_length(self->read_buffer);
-  ut_list_resize(self->read_buffer, buffer_length + self->block_size);
-
-  // Read a block.
+  // Read as much as fits in the buffer, which is at least a block.
+  size_t buffer_length;
+  uint8_t *buffer = ut_input_buffer_get_write_space(
+      self->read_buffer, self->block_size, &buffer_length);
   ssize_t n_read =
-      read(ut_file_descriptor_get_fd(self->fd),
-           ut_uint8_list_get_writable_data(self->read_buffer) + buffer_length,
-           self->block_size);
+      read(ut_file_descriptor_get_fd(self->fd), buffer, buffer_length);
   assert(n_read >= 0);
-  buffer_length += n_read;
-  ut_list_resize(self->read_buffer, buffer_length);
+  ut_input_buffer_commit(self->read_buffer, n_read);
 
   // No more data to read.
   if (n_read == 0) {
@@ -43,19 +40,21 @@ static void read_cb(UtObject *object) {
                       ? self->callback(self->callback_object, self->read_buffer,
                                        self->complete)
                       : 0;
-  assert(n_used <= buffer_length);
-  ut_list_remove(self->read_buffer, 0, n_used);
+  ut_input_buffer_consume(self->read_buffer, n_used);
 }
 
 static void ut_fd_input_stream_init(UtObject *object) {
   UtFdInputStream *self = (UtFdInputStream *)object;
-  self->read_buffer = ut_uint8_array_new();
+  self->read_buffer = ut_input_buffer_new();
   self->block_size = 4096;
 }
 
 static void ut_fd_input_stream_cleanup(UtObject *object) {
   UtFdInputStream *self = (UtFdInputStream *)object;
 
+  if (self->read_watch != NULL) {
+    ut_event_loop_cancel_watch(self->read_watch);
+  }
   ut_object_unref(self->fd);
   ut_object_unref(self->read_buffer);
   ut_object_unref(self->read_watch);
@@ -95,6 +95,9 @@ static void write_cb(UtObject *object) {
 
 static void ut_fd_output_stream_cleanup(UtObject *object) {
   UtFdOutputStream *self = (UtFdOutputStream *)object;
+  if (self->watch != NULL) {
+    ut_event_loop_cancel_watch(self->watch);
+  }
   ut_object_unref(self->fd);
   ut_object_unref(self->watch);
   WriteBlock *next_block;
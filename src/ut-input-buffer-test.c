@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include "ut-input-buffer.h"
+#include "ut.h"
+
+static void write_hex(UtObject *buffer, const char *hex) {
+  UtObjectRef data = ut_uint8_array_new_from_hex_string(hex);
+  size_t data_length = ut_list_get_length(data);
+  size_t length;
+  uint8_t *space = ut_input_buffer_get_write_space(buffer, data_length, &length);
+  ut_assert_true(length >= data_length);
+  memcpy(space, ut_uint8_list_get_data(data), data_length);
+  ut_input_buffer_commit(buffer, data_length);
+}
+
+static void test_consume() {
+  UtObjectRef buffer = ut_input_buffer_new();
+  ut_assert_uint8_list_equal_hex(buffer, "");
+
+  write_hex(buffer, "01020304");
+  ut_assert_uint8_list_equal_hex(buffer, "01020304");
+  ut_input_buffer_consume(buffer, 1);
+  ut_assert_uint8_list_equal_hex(buffer, "020304");
+
+  write_hex(buffer, "0506");
+  ut_assert_uint8_list_equal_hex(buffer, "0203040506");
+
+  UtObjectRef sublist = ut_list_get_sublist(buffer, 1, 2);
+  ut_assert_uint8_list_equal_hex(sublist, "0304");
+
+  ut_input_buffer_consume(buffer, 5);
+  ut_assert_uint8_list_equal_hex(buffer, "");
+}
+
+static void test_many() {
+  UtObjectRef buffer = ut_input_buffer_new();
+
+  // Write blocks and consume less than was written, so data has to be moved
+  // within the buffer.
+  uint8_t next_write = 0, next_read = 0;
+  for (size_t i = 0; i < 1000; i++) {
+    size_t length;
+    uint8_t *space = ut_input_buffer_get_write_space(buffer, 100, &length);
+    ut_assert_true(length >= 100);
+    for (size_t j = 0; j < 100; j++) {
+      space[j] = next_write++;
+    }
+    ut_input_buffer_commit(buffer, 100);
+
+    size_t n_used = ut_list_get_length(buffer) - (i % 150);
+    const uint8_t *data = ut_uint8_list_get_data(buffer);
+    for (size_t j = 0; j < n_used; j++) {
+      ut_assert_int_equal(data[j], next_read++);
+    }
+    ut_input_buffer_consume(buffer, n_used);
+  }
+}
+
+int main(int argc, char **argv) {
+  test_consume();
+  test_many();
+
+  return 0;
+}
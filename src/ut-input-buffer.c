@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ut-input-buffer.h"
+#include "ut-uint8-subarray.h"
+#include "ut.h"
+
+// Data is stored in [data] from [start] to [start + length]. Consuming data
+// moves [start] forward, and the unconsumed data is only moved back to the
+// start of the allocation when at least as much data has been consumed, so
+// each byte is moved at most once on average.
+
+typedef struct {
+  UtObject object;
+  uint8_t *data;
+  size_t data_allocated;
+  size_t start;
+  size_t length;
+} UtInputBuffer;
+
+static uint8_t ut_input_buffer_get_element(UtObject *object, size_t index) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  assert(index < self->length);
+  return self->data[self->start + index];
+}
+
+static const uint8_t *ut_input_buffer_get_const_data(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  return self->data + self->start;
+}
+
+static uint8_t *ut_input_buffer_get_writable_data(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  return self->data + self->start;
+}
+
+static uint8_t *ut_input_buffer_take_data(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  uint8_t *copy = malloc(sizeof(uint8_t) * self->length);
+  memcpy(copy, self->data + self->start, self->length);
+  return copy;
+}
+
+static size_t ut_input_buffer_get_length(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  return self->length;
+}
+
+static UtObject *ut_input_buffer_get_element_object(UtObject *object,
+                                                    size_t index) {
+  return ut_uint8_new(ut_input_buffer_get_element(object, index));
+}
+
+static UtObject *ut_input_buffer_get_sublist(UtObject *object, size_t start,
+                                             size_t count) {
+  return ut_uint8_subarray_new(object, start, count);
+}
+
+static UtObject *ut_input_buffer_copy(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  return ut_uint8_array_new_from_data(self->data + self->start, self->length);
+}
+
+static char *ut_input_buffer_to_string(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  UtObjectRef string = ut_string_new("<uint8>[");
+  for (size_t i = 0; i < self->length; i++) {
+    if (i != 0) {
+      ut_string_append(string, ", ");
+    }
+    ut_string_append_printf(string, "%d", self->data[self->start + i]);
+  }
+  ut_string_append(string, "]");
+
+  return ut_string_take_text(string);
+}
+
+static bool ut_input_buffer_equal(UtObject *object, UtObject *other) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  if (!ut_object_implements_uint8_list(other)) {
+    return false;
+  }
+  if (self->length != ut_list_get_length(other)) {
+    return false;
+  }
+  for (size_t i = 0; i < self->length; i++) {
+    if (self->data[self->start + i] != ut_uint8_list_get_element(other, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void ut_input_buffer_cleanup(UtObject *object) {
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  free(self->data);
+}
+
+static UtUint8ListInterface uint8_list_interface = {
+    .get_element = ut_input_buffer_get_element,
+    .get_data = ut_input_buffer_get_const_data,
+    .get_writable_data = ut_input_buffer_get_writable_data,
+    .take_data = ut_input_buffer_take_data};
+
+static UtListInterface list_interface = {
+    .get_length = ut_input_buffer_get_length,
+    .get_element = ut_input_buffer_get_element_object,
+    .get_sublist = ut_input_buffer_get_sublist,
+    .copy = ut_input_buffer_copy};
+
+static UtObjectInterface object_interface = {
+    .type_name = "UtInputBuffer",
+    .to_string = ut_input_buffer_to_string,
+    .equal = ut_input_buffer_equal,
+    .cleanup = ut_input_buffer_cleanup,
+    .interfaces = {{&ut_uint8_list_id, &uint8_list_interface},
+                   {&ut_list_id, &list_interface},
+                   {NULL, NULL}}};
+
+UtObject *ut_input_buffer_new() {
+  return ut_object_new(sizeof(UtInputBuffer), &object_interface);
+}
+
+uint8_t *ut_input_buffer_get_write_space(UtObject *object, size_t min_length,
+                                         size_t *length) {
+  assert(ut_object_is_input_buffer(object));
+  UtInputBuffer *self = (UtInputBuffer *)object;
+
+  size_t end = self->start + self->length;
+  if (self->data_allocated - end < min_length) {
+    if (self->length <= self->start &&
+        self->data_allocated - self->length >= min_length) {
+      memmove(self->data, self->data + self->start, self->length);
+      self->start = 0;
+    } else {
+      size_t allocated = self->data_allocated * 2;
+      if (allocated < end + min_length) {
+        allocated = end + min_length;
+      }
+      self->data = realloc(self->data, sizeof(uint8_t) * allocated);
+      self->data_allocated = allocated;
+    }
+    end = self->start + self->length;
+  }
+
+  *length = self->data_allocated - end;
+  return self->data + end;
+}
+
+void ut_input_buffer_commit(UtObject *object, size_t length) {
+  assert(ut_object_is_input_buffer(object));
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  assert(self->start + self->length + length <= self->data_allocated);
+  self->length += length;
+}
+
+void ut_input_buffer_consume(UtObject *object, size_t length) {
+  assert(ut_object_is_input_buffer(object));
+  UtInputBuffer *self = (UtInputBuffer *)object;
+  assert(length <= self->length);
+  self->length -= length;
+  if (self->length == 0) {
+    self->start = 0;
+  } else {
+    self->start += length;
+  }
+}
+
+bool ut_object_is_input_buffer(UtObject *object) {
+  return ut_object_is_type(object, &object_interface);
+}
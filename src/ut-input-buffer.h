@@ -0,0 +1,26 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ut-object.h"
+
+#pragma once
+
+/// Creates a buffer for data read from a file descriptor.
+/// The buffer is a [UtUint8List] of the data that has not been consumed.
+UtObject *ut_input_buffer_new();
+
+/// Returns space to write at least [min_length] bytes to the end of the buffer.
+/// The amount of space available is written to [length].
+uint8_t *ut_input_buffer_get_write_space(UtObject *object, size_t min_length,
+                                         size_t *length);
+
+/// Adds [length] bytes written to the space from
+/// [ut_input_buffer_get_write_space] to the end of the buffer.
+void ut_input_buffer_commit(UtObject *object, size_t length);
+
+/// Removes [length] bytes from the start of the buffer.
+void ut_input_buffer_consume(UtObject *object, size_t length);
+
+/// Returns [true] if [object] is a [UtInputBuffer].
+bool ut_object_is_input_buffer(UtObject *object);
@@ -2,20 +2,45 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut-int16-subarray.h"
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
   int16_t *data;
   size_t data_length;
+  size_t data_allocated;
 } UtInt16Array;
 
+static void set_allocated(UtInt16Array *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(int16_t) * allocated);
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtInt16Array *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static void resize_list(UtInt16Array *self, size_t length) {
-  self->data = realloc(self->data, sizeof(int16_t) * length);
-  for (size_t i = self->data_length; i < length; i++) {
-    self->data[i] = 0;
+  grow(self, length);
+  if (length > self->data_length) {
+    memset(self->data + self->data_length, 0,
+           sizeof(int16_t) * (length - self->data_length));
   }
   self->data_length = length;
 }
@@ -40,6 +65,7 @@ static int16_t *ut_int16_array_take_data(UtObject *object) {
   int16_t *result = self->data;
   self->data = NULL;
   self->data_length = 0;
+  self->data_allocated = 0;
   return result;
 }
 
@@ -48,19 +74,17 @@ static void ut_int16_array_insert(UtObject *object, size_t index,
   assert(ut_object_is_int16_array(object));
   UtInt16Array *self = (UtInt16Array *)object;
 
-  size_t n_after = self->data_length - index;
-  resize_list(self, self->data_length + data_length);
-
-  // Shift existing data up
-  for (size_t i = 0; i < n_after; i++) {
-    size_t new_index = self->data_length - 1 - i;
-    self->data[new_index] = self->data[new_index - data_length];
+  if (data_length == 0) {
+    return;
   }
 
-  // Insert new data
-  for (size_t i = 0; i < data_length; i++) {
-    self->data[index + i] = data[i];
-  }
+  size_t n_after = self->data_length - index;
+  grow(self, self->data_length + data_length);
+
+  memmove(self->data + index + data_length, self->data + index,
+          sizeof(int16_t) * n_after);
+  memcpy(self->data + index, data, sizeof(int16_t) * data_length);
+  self->data_length += data_length;
 }
 
 static void ut_int16_array_insert_object(UtObject *object, size_t index,
@@ -75,10 +99,12 @@ static void ut_int16_array_remove(UtObject *object, size_t index,
   UtInt16Array *self = (UtInt16Array *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
-  for (size_t i = index; i < self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
+  if (count == 0) {
+    return;
   }
-  resize_list(self, self->data_length - count);
+  memmove(self->data + index, self->data + index + count,
+          sizeof(int16_t) * (self->data_length - index - count));
+  self->data_length -= count;
 }
 
 static void ut_int16_array_resize(UtObject *object, size_t length) {
@@ -178,11 +204,9 @@ UtObject *ut_int16_array_new_sized(size_t length) {
   UtObject *object = ut_int16_array_new();
   UtInt16Array *self = (UtInt16Array *)object;
 
-  self->data = malloc(sizeof(int16_t) * length);
+  self->data = calloc(length, sizeof(int16_t));
   self->data_length = length;
-  for (size_t i = 0; i < length; i++) {
-    self->data[i] = 0;
-  }
+  self->data_allocated = length;
 
   return object;
 }
@@ -207,6 +231,26 @@ UtObject *ut_int16_array_new_from_va_elements(size_t length, va_list ap) {
   return object;
 }
 
+void ut_int16_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_int16_array(object));
+  UtInt16Array *self = (UtInt16Array *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_int16_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_int16_array(object));
+  UtInt16Array *self = (UtInt16Array *)object;
+  if (self->data_length == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->data_allocated = 0;
+  } else if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_int16_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
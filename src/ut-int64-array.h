@@ -31,5 +31,12 @@ UtObject *ut_int64_array_new_from_elements(size_t length, ...);
 /// !return-type UtInt64Array
 UtObject *ut_int64_array_new_from_va_elements(size_t length, va_list ap);
 
+/// Ensures [object] has space for at least [length] values, so it can grow to
+/// this length without reallocating.
+void ut_int64_array_reserve(UtObject *object, size_t length);
+
+/// Frees any space in [object] that isn't being used by its current values.
+void ut_int64_array_shrink_to_fit(UtObject *object);
+
 /// Returns [true] if [object] is a [UtInt64Array].
 bool ut_object_is_int64_array(UtObject *object);
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Compares UtMap against a linear scan of keys, which is how UtMap was
+// previously implemented.
+
+static UtObject *make_keys(size_t n_keys) {
+  UtObject *keys = ut_object_list_new();
+  for (size_t i = 0; i < n_keys; i++) {
+    ut_list_append_take(keys, ut_string_new_printf("key-%zi", i));
+  }
+  return keys;
+}
+
+static UtObject *linear_lookup(UtObject *keys, UtObject *values,
+                               UtObject *key) {
+  size_t length = ut_list_get_length(keys);
+  for (size_t i = 0; i < length; i++) {
+    if (ut_object_equal(ut_object_list_get_element(keys, i), key)) {
+      return ut_object_list_get_element(values, i);
+    }
+  }
+  return NULL;
+}
+
+static void linear_insert(UtObject *keys, UtObject *values, UtObject *key,
+                          UtObject *value) {
+  size_t length = ut_list_get_length(keys);
+  for (size_t i = 0; i < length; i++) {
+    if (ut_object_equal(ut_object_list_get_element(keys, i), key)) {
+      ut_list_remove(values, i, 1);
+      ut_list_insert(values, i, value);
+      return;
+    }
+  }
+  ut_list_append(keys, key);
+  ut_list_append(values, value);
+}
+
+static void benchmark_linear(UtObject *keys) {
+  size_t n_keys = ut_list_get_length(keys);
+  UtObjectRef map_keys = ut_object_list_new();
+  UtObjectRef map_values = ut_object_list_new();
+  UtObjectRef value = ut_null_new();
+
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < n_keys; i++) {
+    linear_insert(map_keys, map_values, ut_object_list_get_element(keys, i),
+                  value);
+  }
+  double insert_time = ut_benchmark_get_time() - start;
+
+  start = ut_benchmark_get_time();
+  for (size_t i = 0; i < n_keys; i++) {
+    linear_lookup(map_keys, map_values, ut_object_list_get_element(keys, i));
+  }
+  double lookup_time = ut_benchmark_get_time() - start;
+
+  printf("linear %8zi keys: insert %10.1f ns/key, lookup %10.1f ns/key\n",
+         n_keys, insert_time * 1e9 / n_keys, lookup_time * 1e9 / n_keys);
+}
+
+static void benchmark_map(UtObject *keys) {
+  size_t n_keys = ut_list_get_length(keys);
+  UtObjectRef map = ut_map_new();
+  UtObjectRef value = ut_null_new();
+
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < n_keys; i++) {
+    ut_map_insert(map, ut_object_list_get_element(keys, i), value);
+  }
+  double insert_time = ut_benchmark_get_time() - start;
+
+  start = ut_benchmark_get_time();
+  for (size_t i = 0; i < n_keys; i++) {
+    ut_map_lookup(map, ut_object_list_get_element(keys, i));
+  }
+  double lookup_time = ut_benchmark_get_time() - start;
+
+  start = ut_benchmark_get_time();
+  for (size_t i = 0; i < 1000; i++) {
+    ut_map_get_length(map);
+  }
+  double length_time = ut_benchmark_get_time() - start;
+
+  printf("UtMap  %8zi keys: insert %10.1f ns/key, lookup %10.1f ns/key, "
+         "length %6.1f ns\n",
+         n_keys, insert_time * 1e9 / n_keys, lookup_time * 1e9 / n_keys,
+         length_time * 1e9 / 1000);
+}
+
+int main(int argc, char **argv) {
+  size_t sizes[] = {10, 1000, 1000000};
+  for (size_t i = 0; i < 3; i++) {
+    UtObjectRef keys = make_keys(sizes[i]);
+    // The linear scan is quadratic, so too slow to run on large sizes.
+    if (sizes[i] <= 1000) {
+      benchmark_linear(keys);
+    }
+    benchmark_map(keys);
+  }
+
+  return 0;
+}
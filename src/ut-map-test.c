@@ -3,15 +3,100 @@
 
 #include "ut.h"
 
-// FIXME: Write tests.
-
-int main(int argc, char **argv) {
+static void test_insert() {
   UtObjectRef map = ut_map_new();
+  ut_assert_int_equal(ut_map_get_length(map), 0);
   ut_map_insert_string_take(map, "one", ut_uint8_new(1));
   ut_map_insert_string_take(map, "two", ut_uint8_new(42));
   ut_map_insert_string_take(map, "two", ut_uint8_new(2));
+  ut_map_insert_string_take(map, "three", ut_uint8_new(3));
+  ut_assert_int_equal(ut_map_get_length(map), 3);
   ut_cstring_ref map_string = ut_object_to_string(map);
-  printf("map: %s\n", map_string);
+  ut_assert_cstring_equal(
+      map_string,
+      "{\"one\": <uint8>(1), \"two\": <uint8>(2), \"three\": <uint8>(3)}");
+
+  UtObject *value = ut_map_lookup_string(map, "two");
+  ut_assert_non_null_object(value);
+  ut_assert_int_equal(ut_uint8_get_value(value), 2);
+  ut_assert_null_object(ut_map_lookup_string(map, "four"));
+}
+
+static void test_remove() {
+  UtObjectRef map = ut_map_new();
+  ut_map_insert_string_take(map, "one", ut_uint8_new(1));
+  ut_map_insert_string_take(map, "two", ut_uint8_new(2));
+  ut_map_insert_string_take(map, "three", ut_uint8_new(3));
+
+  UtObjectRef two = ut_string_new("two");
+  ut_map_remove(map, two);
+  ut_assert_int_equal(ut_map_get_length(map), 2);
+  ut_assert_null_object(ut_map_lookup(map, two));
+  ut_map_remove(map, two);
+  ut_assert_int_equal(ut_map_get_length(map), 2);
+
+  // Re-inserted keys go to the end.
+  ut_map_insert_take(map, ut_object_ref(two), ut_uint8_new(22));
+  UtObjectRef keys = ut_map_get_keys(map);
+  ut_assert_int_equal(ut_list_get_length(keys), 3);
+  ut_assert_cstring_equal(
+      ut_string_get_text(ut_object_list_get_element(keys, 0)), "one");
+  ut_assert_cstring_equal(
+      ut_string_get_text(ut_object_list_get_element(keys, 1)), "three");
+  ut_assert_cstring_equal(
+      ut_string_get_text(ut_object_list_get_element(keys, 2)), "two");
+}
+
+static void test_many() {
+  UtObjectRef map = ut_map_new();
+  for (uint32_t i = 0; i < 10000; i++) {
+    ut_map_insert_take(map, ut_uint32_new(i), ut_uint32_new(i * 2));
+  }
+  ut_assert_int_equal(ut_map_get_length(map), 10000);
+
+  // Remove every odd key.
+  for (uint32_t i = 1; i < 10000; i += 2) {
+    UtObjectRef key = ut_uint32_new(i);
+    ut_map_remove(map, key);
+  }
+  ut_assert_int_equal(ut_map_get_length(map), 5000);
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    UtObjectRef key = ut_uint32_new(i);
+    UtObject *value = ut_map_lookup(map, key);
+    if (i % 2 == 0) {
+      ut_assert_non_null_object(value);
+      ut_assert_int_equal(ut_uint32_get_value(value), i * 2);
+    } else {
+      ut_assert_null_object(value);
+    }
+  }
+
+  UtObjectRef values = ut_map_get_values(map);
+  ut_assert_int_equal(ut_list_get_length(values), 5000);
+  for (size_t i = 0; i < 5000; i++) {
+    ut_assert_int_equal(
+        ut_uint32_get_value(ut_object_list_get_element(values, i)), i * 4);
+  }
+}
+
+static void test_equal() {
+  UtObjectRef map1 = ut_map_new();
+  ut_map_insert_string_take(map1, "one", ut_uint8_new(1));
+  ut_map_insert_string_take(map1, "two", ut_uint8_new(2));
+  UtObjectRef map2 = ut_map_new_unordered();
+  ut_map_insert_string_take(map2, "two", ut_uint8_new(2));
+  ut_map_insert_string_take(map2, "one", ut_uint8_new(1));
+  ut_assert_true(ut_object_equal(map1, map2));
+  ut_map_insert_string_take(map2, "one", ut_uint8_new(11));
+  ut_assert_false(ut_object_equal(map1, map2));
+}
+
+int main(int argc, char **argv) {
+  test_insert();
+  test_remove();
+  test_many();
+  test_equal();
 
   return 0;
 }
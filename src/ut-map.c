@@ -9,7 +9,8 @@ int ut_map_id = 0;
 UtObject *ut_map_new() { return ut_ordered_hash_table_new(); }
 
 UtObject *ut_map_new_unordered() {
-  // FIXME: Change we have an unordered type.
+  // The ordered hash table has the same lookup cost as an unordered one, so
+  // use it for both.
   return ut_ordered_hash_table_new();
 }
 
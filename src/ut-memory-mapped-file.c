@@ -54,6 +54,12 @@ static uint8_t ut_memory_mapped_file_get_element(UtObject *object,
   return self->data[index];
 }
 
+static const uint8_t *
+ut_memory_mapped_file_get_const_data(UtObject *object) {
+  UtMemoryMappedFile *self = (UtMemoryMappedFile *)object;
+  return self->data;
+}
+
 static uint8_t *ut_memory_mapped_file_take_data(UtObject *object) {
   UtMemoryMappedFile *self = (UtMemoryMappedFile *)object;
   uint8_t *copy = malloc(sizeof(uint8_t) * self->data_length);
@@ -95,6 +101,7 @@ static UtFileInterface file_interface = {
 
 static UtUint8ListInterface uint8_list_interface = {
     .get_element = ut_memory_mapped_file_get_element,
+    .get_data = ut_memory_mapped_file_get_const_data,
     .take_data = ut_memory_mapped_file_take_data};
 
 static UtListInterface list_interface = {
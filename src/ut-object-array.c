@@ -1,17 +1,41 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut-list-private.h"
 #include "ut-object-subarray.h"
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
   UtObject **data;
   size_t data_length;
+  size_t data_allocated;
 } UtObjectArray;
 
+static void set_allocated(UtObjectArray *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(UtObject *) * allocated);
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtObjectArray *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static UtObject *ut_object_array_get_element(UtObject *object, size_t index) {
   UtObjectArray *self = (UtObjectArray *)object;
   return self->data[index];
@@ -21,12 +45,11 @@ static void ut_object_array_insert(UtObject *object, size_t index,
                                    UtObject *item) {
   UtObjectArray *self = (UtObjectArray *)object;
   assert(index <= self->data_length);
-  self->data_length++;
-  self->data = realloc(self->data, sizeof(UtObject *) * self->data_length);
-  for (size_t i = self->data_length - 1; i > index; i--) {
-    self->data[i] = self->data[i - 1];
-  }
+  grow(self, self->data_length + 1);
+  memmove(self->data + index + 1, self->data + index,
+          sizeof(UtObject *) * (self->data_length - index));
   self->data[index] = ut_object_ref(item);
+  self->data_length++;
 }
 
 static void ut_object_array_remove(UtObject *object, size_t index,
@@ -34,14 +57,15 @@ static void ut_object_array_remove(UtObject *object, size_t index,
   UtObjectArray *self = (UtObjectArray *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
+  if (count == 0) {
+    return;
+  }
   for (size_t i = index; i < index + count; i++) {
     ut_object_unref(self->data[i]);
   }
-  for (size_t i = index; i < self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
-  }
+  memmove(self->data + index, self->data + index + count,
+          sizeof(UtObject *) * (self->data_length - index - count));
   self->data_length -= count;
-  self->data = realloc(self->data, sizeof(UtObject *) * self->data_length);
 }
 
 static void ut_object_array_resize(UtObject *object, size_t length) {
@@ -49,7 +73,7 @@ static void ut_object_array_resize(UtObject *object, size_t length) {
   for (size_t i = length; i < self->data_length; i++) {
     ut_object_unref(self->data[i]);
   }
-  self->data = realloc(self->data, sizeof(UtObject *) * length);
+  grow(self, length);
   for (size_t i = self->data_length; i < length; i++) {
     self->data[i] = NULL;
   }
@@ -77,6 +101,7 @@ static UtObject *ut_object_array_copy(UtObject *object) {
   UtObjectArray *copy = (UtObjectArray *)ut_object_array_new();
   copy->data = malloc(sizeof(UtObject *) * self->data_length);
   copy->data_length = self->data_length;
+  copy->data_allocated = self->data_length;
   for (size_t i = 0; i < self->data_length; i++) {
     copy->data[i] = ut_object_ref(self->data[i]);
   }
@@ -195,6 +220,26 @@ UtObject *ut_object_array_new_from_elements_take(UtObject *item0, ...) {
   return object;
 }
 
+void ut_object_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_object_array(object));
+  UtObjectArray *self = (UtObjectArray *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_object_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_object_array(object));
+  UtObjectArray *self = (UtObjectArray *)object;
+  if (self->data_length == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->data_allocated = 0;
+  } else if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_object_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
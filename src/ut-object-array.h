@@ -26,5 +26,12 @@ UtObject *ut_object_array_new_from_elements(UtObject *item0, ...);
 /// !return-type UtObjectArray
 UtObject *ut_object_array_new_from_elements_take(UtObject *item0, ...);
 
+/// Ensures [object] has space for at least [length] values, so it can grow to
+/// this length without reallocating.
+void ut_object_array_reserve(UtObject *object, size_t length);
+
+/// Frees any space in [object] that isn't being used by its current values.
+void ut_object_array_shrink_to_fit(UtObject *object);
+
 /// Returns [true] if [object] is a [UtObjectArray].
 bool ut_object_is_object_array(UtObject *object);
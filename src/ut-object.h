@@ -48,6 +48,7 @@ char *ut_object_to_string(UtObject *object);
 bool ut_object_equal(UtObject *object, UtObject *other);
 
 /// Returns a hash value for this object.
+/// Objects that are equal must return the same hash value.
 int ut_object_get_hash(UtObject *object);
 
 /// Increase the reference count on this object.
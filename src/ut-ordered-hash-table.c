@@ -1,21 +1,45 @@
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "ut-map-private.h"
 #include "ut.h"
 
+// Items are stored in insertion order in a dense array. A separate open
+// addressing table maps key hashes to positions in that array.
+
+// Index slot values that don't refer to an item.
+#define INDEX_EMPTY 0
+#define INDEX_REMOVED SIZE_MAX
+
+#define MINIMUM_INDEXES_LENGTH 8
+
 typedef struct _UtOrderedHashTableItem UtOrderedHashTableItem;
 
 typedef struct {
   UtObject object;
-  UtOrderedHashTableItem *items;
+
+  // Items in insertion order, removed items are NULL.
+  UtOrderedHashTableItem **items;
+  size_t items_length;
+  size_t items_allocated;
+
+  // Number of non-NULL items.
+  size_t length;
+
+  // Open addressing table, each slot contains an item position + 1.
+  size_t *indexes;
+  size_t indexes_length;
+
+  // Number of slots that are INDEX_REMOVED.
+  size_t n_removed_indexes;
 } UtOrderedHashTable;
 
 struct _UtOrderedHashTableItem {
   UtObject object;
   UtObject *key;
   UtObject *value;
-  UtOrderedHashTableItem *next;
+  size_t hash;
 };
 
 static UtObject *ut_ordered_hash_table_item_get_key(UtObject *object) {
@@ -36,7 +60,6 @@ static void ut_ordered_hash_table_item_cleanup(UtObject *object) {
   UtOrderedHashTableItem *self = (UtOrderedHashTableItem *)object;
   ut_object_unref(self->key);
   ut_object_unref(self->value);
-  self->next = NULL;
 }
 
 static UtObjectInterface item_object_interface = {
@@ -44,94 +67,182 @@ static UtObjectInterface item_object_interface = {
     .cleanup = ut_ordered_hash_table_item_cleanup,
     .interfaces = {{&ut_map_item_id, &map_item_interface}, {NULL, NULL}}};
 
-static UtOrderedHashTableItem *item_new(UtObject *key, UtObject *value) {
+static UtOrderedHashTableItem *item_new(UtObject *key, UtObject *value,
+                                        size_t hash) {
   UtOrderedHashTableItem *item = (UtOrderedHashTableItem *)ut_object_new(
       sizeof(UtOrderedHashTableItem), &item_object_interface);
   item->key = ut_object_ref(key);
   item->value = ut_object_ref(value);
+  item->hash = hash;
   return item;
 }
 
-static UtOrderedHashTableItem *lookup(UtOrderedHashTable *self, UtObject *key,
-                                      UtOrderedHashTableItem **prev_item) {
-  UtOrderedHashTableItem *prev_item_ = NULL;
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = item->next) {
-    if (ut_object_equal(item->key, key)) {
-      if (prev_item != NULL) {
-        *prev_item = prev_item_;
+// Mix the bits of the object hash so simple hashes (e.g. integers) spread
+// across the table.
+static size_t get_hash(UtObject *key) {
+  uint32_t h = (uint32_t)ut_object_get_hash(key);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+// Returns the slot in the index table that contains [key], or the slot it
+// should be inserted in if not present.
+static size_t find_slot(UtOrderedHashTable *self, UtObject *key, size_t hash,
+                        bool *found) {
+  size_t mask = self->indexes_length - 1;
+  size_t insert_slot = SIZE_MAX;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    size_t index = self->indexes[slot];
+    if (index == INDEX_EMPTY) {
+      *found = false;
+      return insert_slot != SIZE_MAX ? insert_slot : slot;
+    } else if (index == INDEX_REMOVED) {
+      if (insert_slot == SIZE_MAX) {
+        insert_slot = slot;
       }
+    } else {
+      UtOrderedHashTableItem *item = self->items[index - 1];
+      if (item->hash == hash && ut_object_equal(item->key, key)) {
+        *found = true;
+        return slot;
+      }
+    }
+  }
+}
+
+// Rebuilds the index table with [indexes_length] slots, compacting out any
+// removed items.
+static void rebuild(UtOrderedHashTable *self, size_t indexes_length) {
+  size_t j = 0;
+  for (size_t i = 0; i < self->items_length; i++) {
+    if (self->items[i] != NULL) {
+      self->items[j] = self->items[i];
+      j++;
+    }
+  }
+  self->items_length = j;
+
+  free(self->indexes);
+  self->indexes_length = indexes_length;
+  self->indexes = calloc(indexes_length, sizeof(size_t));
+  self->n_removed_indexes = 0;
+  size_t mask = indexes_length - 1;
+  for (size_t i = 0; i < self->items_length; i++) {
+    size_t slot = self->items[i]->hash & mask;
+    while (self->indexes[slot] != INDEX_EMPTY) {
+      slot = (slot + 1) & mask;
+    }
+    self->indexes[slot] = i + 1;
+  }
+}
 
-      return item;
+// Ensure there is space for one more item.
+static void reserve(UtOrderedHashTable *self) {
+  // Keep the index table at most 2/3 full (including removed slots).
+  size_t n_used = self->length + self->n_removed_indexes + 1;
+  if (n_used * 3 > self->indexes_length * 2) {
+    size_t indexes_length = MINIMUM_INDEXES_LENGTH;
+    while ((self->length + 1) * 3 > indexes_length) {
+      indexes_length *= 2;
     }
-    prev_item_ = item;
+    rebuild(self, indexes_length);
+  }
+
+  if (self->items_length >= self->items_allocated) {
+    self->items_allocated = self->items_allocated == 0
+                                ? MINIMUM_INDEXES_LENGTH
+                                : self->items_allocated * 2;
+    self->items = realloc(self->items, sizeof(UtOrderedHashTableItem *) *
+                                           self->items_allocated);
+  }
+}
+
+static UtOrderedHashTableItem *lookup(UtOrderedHashTable *self, UtObject *key) {
+  if (self->length == 0) {
+    return NULL;
   }
-  return NULL;
+
+  bool found;
+  size_t slot = find_slot(self, key, get_hash(key), &found);
+  return found ? self->items[self->indexes[slot] - 1] : NULL;
 }
 
 size_t ut_ordered_hash_table_get_length(UtObject *object) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
-  size_t length = 0;
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = item->next) {
-    length++;
-  }
-  return length;
+  return self->length;
 }
 
 static void ut_ordered_hash_table_insert(UtObject *object, UtObject *key,
                                          UtObject *value) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
 
-  UtOrderedHashTableItem *prev_item;
-  UtOrderedHashTableItem *existing_item = lookup(self, key, &prev_item);
+  size_t hash = get_hash(key);
+  reserve(self);
+  bool found;
+  size_t slot = find_slot(self, key, hash, &found);
 
-  UtOrderedHashTableItem *item = item_new(key, value);
-  if (existing_item == NULL) {
-    item->next = self->items;
-    self->items = item;
+  UtOrderedHashTableItem *item = item_new(key, value, hash);
+  if (found) {
+    // Replace the existing item, keeping the original position.
+    size_t index = self->indexes[slot] - 1;
+    ut_object_unref((UtObject *)self->items[index]);
+    self->items[index] = item;
   } else {
-    item->next = existing_item->next;
-    if (prev_item != NULL) {
-      prev_item->next = item;
-    } else {
-      self->items = item;
+    if (self->indexes[slot] == INDEX_REMOVED) {
+      self->n_removed_indexes--;
     }
-
-    existing_item->next = NULL;
-    ut_object_unref((UtObject *)existing_item);
+    self->items[self->items_length] = item;
+    self->items_length++;
+    self->indexes[slot] = self->items_length;
+    self->length++;
   }
 }
 
 static UtObject *ut_ordered_hash_table_lookup(UtObject *object, UtObject *key) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
-  UtOrderedHashTableItem *item = lookup(self, key, NULL);
+  UtOrderedHashTableItem *item = lookup(self, key);
   return item != NULL ? item->value : NULL;
 }
 
 static void ut_ordered_hash_table_remove(UtObject *object, UtObject *key) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
-  UtOrderedHashTableItem *prev_item;
-  UtOrderedHashTableItem *item = lookup(self, key, &prev_item);
-  if (item == NULL) {
+  if (self->length == 0) {
     return;
   }
-  if (prev_item != NULL) {
-    prev_item->next = item->next;
-  } else {
-    self->items = item->next;
+
+  bool found;
+  size_t slot = find_slot(self, key, get_hash(key), &found);
+  if (!found) {
+    return;
   }
 
-  item->next = NULL;
-  ut_object_unref((UtObject *)item);
+  size_t index = self->indexes[slot] - 1;
+  ut_object_unref((UtObject *)self->items[index]);
+  self->items[index] = NULL;
+  self->indexes[slot] = INDEX_REMOVED;
+  self->n_removed_indexes++;
+  self->length--;
+
+  // Drop trailing removed items so a remove after an insert doesn't leave a
+  // gap.
+  while (self->items_length > 0 &&
+         self->items[self->items_length - 1] == NULL) {
+    self->items_length--;
+  }
 }
 
 static UtObject *ut_ordered_hash_table_get_items(UtObject *object) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
   UtObject *items = ut_object_array_new();
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = item->next) {
-    ut_list_prepend(items, (UtObject *)item);
+  for (size_t i = 0; i < self->items_length; i++) {
+    UtOrderedHashTableItem *item = self->items[i];
+    if (item != NULL) {
+      ut_list_append(items, (UtObject *)item);
+    }
   }
   return items;
 }
@@ -139,9 +250,11 @@ static UtObject *ut_ordered_hash_table_get_items(UtObject *object) {
 static UtObject *ut_ordered_hash_table_get_keys(UtObject *object) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
   UtObject *keys = ut_object_array_new();
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = item->next) {
-    ut_list_prepend(keys, item->key);
+  for (size_t i = 0; i < self->items_length; i++) {
+    UtOrderedHashTableItem *item = self->items[i];
+    if (item != NULL) {
+      ut_list_append(keys, item->key);
+    }
   }
   return keys;
 }
@@ -149,9 +262,11 @@ static UtObject *ut_ordered_hash_table_get_keys(UtObject *object) {
 static UtObject *ut_ordered_hash_table_get_values(UtObject *object) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
   UtObject *values = ut_object_array_new();
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = item->next) {
-    ut_list_prepend(values, item->value);
+  for (size_t i = 0; i < self->items_length; i++) {
+    UtOrderedHashTableItem *item = self->items[i];
+    if (item != NULL) {
+      ut_list_append(values, item->value);
+    }
   }
   return values;
 }
@@ -167,14 +282,13 @@ static UtMapInterface map_interface = {
 
 static void ut_ordered_hash_table_cleanup(UtObject *object) {
   UtOrderedHashTable *self = (UtOrderedHashTable *)object;
-  UtOrderedHashTableItem *next_item;
-  for (UtOrderedHashTableItem *item = self->items; item != NULL;
-       item = next_item) {
-    next_item = item->next;
-    item->next = NULL;
-    ut_object_unref((UtObject *)item);
+  for (size_t i = 0; i < self->items_length; i++) {
+    ut_object_unref((UtObject *)self->items[i]);
   }
+  free(self->items);
   self->items = NULL;
+  free(self->indexes);
+  self->indexes = NULL;
 }
 
 static UtObjectInterface object_interface = {
@@ -188,6 +302,6 @@ UtObject *ut_ordered_hash_table_new() {
   return ut_object_new(sizeof(UtOrderedHashTable), &object_interface);
 }
 
-bool ut_object_is_ordered_hash_table_string(UtObject *object) {
+bool ut_object_is_ordered_hash_table(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
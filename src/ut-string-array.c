@@ -1,22 +1,47 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut-list-private.h"
 #include "ut-string-subarray.h"
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
+  // NULL terminated, so has space for one more than [data_allocated].
   char **data;
   size_t data_length;
+  size_t data_allocated;
 } UtStringArray;
 
+static void set_allocated(UtStringArray *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(char *) * (allocated + 1));
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtStringArray *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static void resize(UtStringArray *self, size_t length) {
   for (size_t i = length; i < self->data_length; i++) {
     free(self->data[i]);
   }
-  self->data = realloc(self->data, sizeof(char *) * (length + 1));
+  grow(self, length);
   for (size_t i = self->data_length; i < length; i++) {
     self->data[i] = ut_cstring_new("");
   }
@@ -25,13 +50,13 @@ static void resize(UtStringArray *self, size_t length) {
 }
 
 static void insert(UtStringArray *self, size_t index, const char *value) {
-  self->data_length++;
-  self->data = realloc(self->data, sizeof(char *) * (self->data_length + 1));
-  for (size_t i = self->data_length - 1; i > index; i--) {
-    self->data[i] = self->data[i - 1];
-  }
+  assert(index <= self->data_length);
+  grow(self, self->data_length + 1);
+  // Shift existing data up, including the NULL terminator.
+  memmove(self->data + index + 1, self->data + index,
+          sizeof(char *) * (self->data_length - index + 1));
   self->data[index] = ut_cstring_new(value);
-  self->data[self->data_length] = NULL;
+  self->data_length++;
 }
 
 static size_t ut_string_array_get_length(UtObject *object) {
@@ -53,7 +78,7 @@ static UtObject *ut_string_array_get_sublist(UtObject *object, size_t start,
 static UtObject *ut_string_array_copy(UtObject *object) {
   UtStringArray *self = (UtStringArray *)object;
   UtStringArray *copy = (UtStringArray *)ut_string_array_new();
-  copy->data = malloc(sizeof(char *) * (self->data_length + 1));
+  set_allocated(copy, self->data_length);
   copy->data_length = self->data_length;
   for (size_t i = 0; i < self->data_length; i++) {
     copy->data[i] = ut_cstring_new(self->data[i]);
@@ -74,10 +99,16 @@ static void ut_string_array_remove(UtObject *object, size_t index,
   UtStringArray *self = (UtStringArray *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
-  for (size_t i = index; i <= self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
+  if (count == 0) {
+    return;
   }
-  resize(self, self->data_length - count);
+  for (size_t i = index; i < index + count; i++) {
+    free(self->data[i]);
+  }
+  // Shift existing data down, including the NULL terminator.
+  memmove(self->data + index, self->data + index + count,
+          sizeof(char *) * (self->data_length - index - count + 1));
+  self->data_length -= count;
 }
 
 static void ut_string_array_resize(UtObject *object, size_t length) {
@@ -96,6 +127,7 @@ static char **ut_string_array_take_data(UtObject *object) {
   self->data = malloc(sizeof(char *) * 1);
   self->data[0] = NULL;
   self->data_length = 0;
+  self->data_allocated = 0;
   return value;
 }
 
@@ -108,6 +140,7 @@ static void ut_string_array_insert(UtObject *object, size_t index,
 static void ut_string_array_init(UtObject *object) {
   UtStringArray *self = (UtStringArray *)object;
   self->data = malloc(sizeof(char *) * 1);
+  self->data[0] = NULL;
 }
 
 static bool ut_string_array_equal(UtObject *object, UtObject *other) {
@@ -189,6 +222,22 @@ UtObject *ut_string_array_new_from_va_elements(const char *value, va_list ap) {
   return object;
 }
 
+void ut_string_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_string_array(object));
+  UtStringArray *self = (UtStringArray *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_string_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_string_array(object));
+  UtStringArray *self = (UtStringArray *)object;
+  if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_string_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
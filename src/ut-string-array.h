@@ -24,5 +24,12 @@ UtObject *ut_string_array_new_from_elements(const char *value, ...);
 /// !return-type UtStringArray
 UtObject *ut_string_array_new_from_va_elements(const char *value, va_list ap);
 
+/// Ensures [object] has space for at least [length] values, so it can grow to
+/// this length without reallocating.
+void ut_string_array_reserve(UtObject *object, size_t length);
+
+/// Frees any space in [object] that isn't being used by its current values.
+void ut_string_array_shrink_to_fit(UtObject *object);
+
 /// Returns [true] if [object] is a [UtStringArray].
 bool ut_object_is_string_array(UtObject *object);
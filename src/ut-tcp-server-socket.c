@@ -1,5 +1,10 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -11,6 +16,9 @@
 
 #include "ut.h"
 
+// Time to wait before accepting again when out of file descriptors.
+#define ACCEPT_RETRY_DELAY_MS 100
+
 typedef struct {
   UtObject object;
   sa_family_t family;
@@ -18,28 +26,85 @@ typedef struct {
   uint16_t port;
   UtObject *fd;
   UtObject *watch;
+  UtObject *retry_timer;
   UtObject *listen_callback_object;
   UtTcpServerSocketListenCallback listen_callback;
 } UtTcpServerSocket;
 
 static void ut_tcp_server_socket_cleanup(UtObject *object) {
   UtTcpServerSocket *self = (UtTcpServerSocket *)object;
+  if (self->watch != NULL) {
+    ut_event_loop_cancel_watch(self->watch);
+  }
+  if (self->retry_timer != NULL) {
+    ut_event_loop_cancel_timer(self->retry_timer);
+  }
   free(self->unix_path);
   ut_object_unref(self->fd);
   ut_object_unref(self->watch);
+  ut_object_unref(self->retry_timer);
   ut_object_weak_unref(&self->listen_callback_object);
 }
 
+static void listen_cb(UtObject *object);
+
+// Accepts a connection on [listen_fd] that is non-blocking and closed on exec.
+static int accept_nonblocking(int listen_fd) {
+#ifdef __linux__
+  return accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int fd = accept(listen_fd, NULL, NULL);
+  if (fd < 0) {
+    return fd;
+  }
+  int flags = fcntl(fd, F_GETFL);
+  assert(flags >= 0);
+  int result = fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  assert(result == 0);
+  result = fcntl(fd, F_SETFD, FD_CLOEXEC);
+  assert(result == 0);
+  return fd;
+#endif
+}
+
+static void retry_accept_cb(UtObject *object) {
+  UtTcpServerSocket *self = (UtTcpServerSocket *)object;
+  ut_object_unref(self->retry_timer);
+  self->retry_timer = NULL;
+  self->watch = ut_event_loop_add_read_watch(self->fd, object, listen_cb);
+}
+
 static void listen_cb(UtObject *object) {
   UtTcpServerSocket *self = (UtTcpServerSocket *)object;
 
-  int fd = accept(ut_file_descriptor_get_fd(self->fd), NULL, NULL);
-  assert(fd >= 0);
+  // Callbacks may drop the last reference to this socket.
+  UtObjectRef ref = ut_object_ref(object);
+
+  // Accept all pending connections.
+  while (self->watch != NULL) {
+    int fd = accept_nonblocking(ut_file_descriptor_get_fd(self->fd));
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+                 errno == ENOMEM) {
+        // The connection remains in the backlog, so stop watching until
+        // resources may have been freed otherwise this will be called
+        // continuously.
+        ut_event_loop_cancel_watch(self->watch);
+        ut_object_unref(self->watch);
+        self->watch = NULL;
+        self->retry_timer = ut_event_loop_add_delay_ms(ACCEPT_RETRY_DELAY_MS,
+                                                       object, retry_accept_cb);
+      }
+      return;
+    }
 
-  UtObjectRef fd_object = ut_file_descriptor_new(fd);
-  UtObjectRef child_socket = ut_tcp_socket_new_from_fd(fd_object);
-  if (self->listen_callback_object != NULL) {
-    self->listen_callback(self->listen_callback_object, child_socket);
+    UtObjectRef fd_object = ut_file_descriptor_new(fd);
+    UtObjectRef child_socket = ut_tcp_socket_new_from_fd(fd_object);
+    if (self->listen_callback_object != NULL) {
+      self->listen_callback(self->listen_callback_object, child_socket);
+    }
   }
 }
 
@@ -2,8 +2,24 @@
 
 #include "ut.h"
 
+// Amount of data to send when testing the write queue. This needs to be
+// bigger than the kernel socket buffers.
+#define LARGE_DATA_LENGTH (32 * 1024 * 1024)
+#define LARGE_DATA_BLOCK_LENGTH 65536
+
 static UtObject *listen_sockets = NULL;
 
+static UtObject *large_listen_socket = NULL;
+static UtObject *large_server_socket = NULL;
+static UtObject *large_socket = NULL;
+static size_t large_n_sent = 0;
+static size_t large_n_received = 0;
+static bool large_write_queue_full = false;
+static bool large_write_queue_was_full = false;
+static bool large_reading = false;
+
+static uint8_t get_large_data_byte(size_t offset) { return offset % 251; }
+
 // Echo all sent data.
 static size_t echo_read_cb(UtObject *object, UtObject *data, bool complete) {
   UtObject *socket = object;
@@ -16,11 +32,89 @@ static void echo_listen_cb(UtObject *object, UtObject *socket) {
   ut_input_stream_read(socket, socket, echo_read_cb);
 }
 
+static size_t large_read_cb(UtObject *object, UtObject *data, bool complete) {
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *d = ut_uint8_list_get_data(data);
+  for (size_t i = 0; i < data_length; i++) {
+    ut_assert_int_equal(d[i], get_large_data_byte(large_n_received + i));
+  }
+  large_n_received += data_length;
+  ut_assert_true(large_n_received <= LARGE_DATA_LENGTH);
+
+  if (large_n_received == LARGE_DATA_LENGTH) {
+    ut_assert_true(large_write_queue_was_full);
+    ut_assert_int_equal(ut_tcp_socket_get_write_queue_length(large_socket), 0);
+    ut_event_loop_return(NULL);
+  }
+
+  return data_length;
+}
+
+// Start reading once the sender has filled its write queue.
+static void start_large_read() {
+  if (!large_reading && large_server_socket != NULL &&
+      (large_write_queue_full || large_n_sent == LARGE_DATA_LENGTH)) {
+    large_reading = true;
+    ut_input_stream_read(large_server_socket, large_server_socket,
+                         large_read_cb);
+  }
+}
+
+static void large_listen_cb(UtObject *object, UtObject *socket) {
+  large_server_socket = ut_object_ref(socket);
+  start_large_read();
+}
+
+// Write blocks until the write queue is full.
+static void write_large_data() {
+  while (!large_write_queue_full && large_n_sent < LARGE_DATA_LENGTH) {
+    UtObjectRef block = ut_uint8_array_new_sized(LARGE_DATA_BLOCK_LENGTH);
+    uint8_t *data = ut_uint8_list_get_writable_data(block);
+    for (size_t i = 0; i < LARGE_DATA_BLOCK_LENGTH; i++) {
+      data[i] = get_large_data_byte(large_n_sent + i);
+    }
+    large_n_sent += LARGE_DATA_BLOCK_LENGTH;
+    ut_tcp_socket_send(large_socket, block);
+  }
+}
+
+static void large_write_queue_cb(UtObject *object, bool full) {
+  large_write_queue_full = full;
+  if (full) {
+    large_write_queue_was_full = true;
+    start_large_read();
+  } else {
+    write_large_data();
+  }
+}
+
+static void large_connect_cb(UtObject *object, UtObject *error) {
+  ut_assert_null_object(error);
+  write_large_data();
+  start_large_read();
+}
+
+// Send a large amount of data to a server that doesn't read until the write
+// queue is full.
+static void start_large_test() {
+  large_listen_socket = ut_tcp_server_socket_new_ipv4(0);
+  ut_assert_true(ut_tcp_server_socket_listen(
+      large_listen_socket, large_listen_socket, large_listen_cb, NULL));
+  uint16_t port = ut_tcp_server_socket_get_port(large_listen_socket);
+
+  UtObjectRef address = ut_ipv4_address_new_loopback();
+  large_socket = ut_tcp_socket_new(address, port);
+  ut_tcp_socket_set_write_queue_callback(large_socket, 1024 * 1024,
+                                         256 * 1024, large_socket,
+                                         large_write_queue_cb);
+  ut_tcp_socket_connect(large_socket, large_socket, large_connect_cb);
+}
+
 // Get the response from the echo server
 static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   ut_assert_uint8_list_equal_hex(data, "0123456789abcdef");
 
-  ut_event_loop_return(NULL);
+  start_large_test();
 
   return ut_list_get_length(data);
 }
@@ -54,6 +148,9 @@ int main(int argc, char **argv) {
   ut_event_loop_run();
 
   ut_object_unref(listen_sockets);
+  ut_object_unref(large_listen_socket);
+  ut_object_unref(large_server_socket);
+  ut_object_unref(large_socket);
 
   return 0;
 }
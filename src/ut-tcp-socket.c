@@ -9,8 +9,32 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include "ut-input-buffer.h"
 #include "ut.h"
 
+// Minimum space to read into.
+#define READ_BLOCK_SIZE 65536
+
+// Maximum number of file descriptors Linux allows in one message
+// (SCM_MAX_FD).
+#define MAX_FDS_PER_MESSAGE 253
+
+// Maximum number of queued blocks to combine into one send.
+#define MAX_SEND_BLOCKS 64
+
+typedef struct _WriteBlock WriteBlock;
+
+struct _WriteBlock {
+  UtObject *data;
+  const uint8_t *buffer;
+  size_t length;
+  size_t n_written;
+  UtObject *fds;
+  UtObject *callback_object;
+  UtOutputStreamCallback callback;
+  WriteBlock *next;
+};
+
 typedef struct {
   UtObject object;
   UtObject *address;
@@ -21,20 +45,53 @@ typedef struct {
   UtObject *connect_callback_object;
   UtTcpSocketConnectCallback connect_callback;
   UtObject *read_buffer;
-  size_t n_read;
   bool is_complete;
   UtObject *read_callback_object;
   UtInputStreamCallback read_callback;
+  UtObject *send_watch;
+  WriteBlock *blocks;
+  WriteBlock *last_block;
+  size_t write_queue_length;
+  size_t high_water_mark;
+  size_t low_water_mark;
+  bool write_queue_full;
+  UtObject *write_queue_callback_object;
+  UtTcpSocketWriteQueueCallback write_queue_callback;
 } UtTcpSocket;
 
+static void free_block(WriteBlock *block) {
+  ut_object_unref(block->data);
+  ut_object_unref(block->fds);
+  ut_object_weak_unref(&block->callback_object);
+  free(block);
+}
+
 static void ut_tcp_socket_cleanup(UtObject *object) {
   UtTcpSocket *self = (UtTcpSocket *)object;
+  if (self->write_watch != NULL) {
+    ut_event_loop_cancel_watch(self->write_watch);
+  }
+  if (self->read_watch != NULL) {
+    ut_event_loop_cancel_watch(self->read_watch);
+  }
+  if (self->send_watch != NULL) {
+    ut_event_loop_cancel_watch(self->send_watch);
+  }
   ut_object_unref(self->address);
   ut_object_unref(self->fd);
   ut_object_unref(self->write_watch);
   ut_object_weak_unref(&self->connect_callback_object);
   ut_object_unref(self->read_buffer);
+  ut_object_weak_unref(&self->read_callback_object);
   ut_object_unref(self->read_watch);
+  ut_object_unref(self->send_watch);
+  WriteBlock *next_block;
+  for (WriteBlock *b = self->blocks; b != NULL; b = next_block) {
+    next_block = b->next;
+    free_block(b);
+  }
+  self->blocks = NULL;
+  ut_object_weak_unref(&self->write_queue_callback_object);
 }
 
 static void connect_cb(UtObject *object, UtObject *error) {}
@@ -59,19 +116,13 @@ static void write_cb(UtObject *object) {
   }
 }
 
-static void read_cb(UtObject *object) {
-  UtTcpSocket *self = (UtTcpSocket *)object;
-
-  size_t block_size = 65535;
-  if (ut_list_get_length(self->read_buffer) < self->n_read + block_size) {
-    ut_list_resize(self->read_buffer, self->n_read + block_size);
-  }
-
+// Reads data into [buffer] along with any file descriptors sent with it.
+static ssize_t read_with_fds(UtTcpSocket *self, uint8_t *buffer,
+                             size_t buffer_length, UtObject **fds) {
   struct iovec iov;
-  iov.iov_base =
-      ut_uint8_list_get_writable_data(self->read_buffer) + self->n_read;
-  iov.iov_len = block_size;
-  uint8_t control_data[CMSG_SPACE(sizeof(int) * 1024)];
+  iov.iov_base = buffer;
+  iov.iov_len = buffer_length;
+  uint8_t control_data[CMSG_SPACE(sizeof(int) * MAX_FDS_PER_MESSAGE)];
   struct msghdr msg;
   msg.msg_name = NULL;
   msg.msg_namelen = 0;
@@ -81,9 +132,10 @@ static void read_cb(UtObject *object) {
   msg.msg_controllen = sizeof(control_data);
   msg.msg_flags = 0;
   ssize_t n_read = recvmsg(ut_file_descriptor_get_fd(self->fd), &msg, 0);
-  assert(n_read >= 0);
+  if (n_read < 0) {
+    return n_read;
+  }
 
-  UtObjectRef fds = NULL;
   for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
        cmsg = CMSG_NXTHDR(&msg, cmsg)) {
     if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
@@ -91,35 +143,65 @@ static void read_cb(UtObject *object) {
           cmsg->cmsg_len - ((uint8_t *)CMSG_DATA(cmsg) - (uint8_t *)cmsg);
       size_t cmsg_fds_length = data_length / sizeof(int);
       int cmsg_fds[cmsg_fds_length];
-      memcpy(cmsg_fds, CMSG_DATA(cmsg), cmsg->cmsg_len);
+      memcpy(cmsg_fds, CMSG_DATA(cmsg), sizeof(int) * cmsg_fds_length);
       for (size_t i = 0; i < cmsg_fds_length; i++) {
-        if (fds == NULL) {
-          fds = ut_list_new();
+        if (*fds == NULL) {
+          *fds = ut_list_new();
         }
-        ut_list_append_take(fds, ut_file_descriptor_new(cmsg_fds[i]));
+        ut_list_append_take(*fds, ut_file_descriptor_new(cmsg_fds[i]));
       }
     }
   }
 
+  return n_read;
+}
+
+static void read_cb(UtObject *object) {
+  UtTcpSocket *self = (UtTcpSocket *)object;
+
+  size_t buffer_length;
+  uint8_t *buffer = ut_input_buffer_get_write_space(
+      self->read_buffer, READ_BLOCK_SIZE, &buffer_length);
+
+  // Only Unix sockets can have file descriptors sent over them.
+  ssize_t n_read;
+  UtObjectRef fds = NULL;
+  if (ut_object_is_unix_socket_address(self->address)) {
+    n_read = read_with_fds(self, buffer, buffer_length, &fds);
+  } else {
+    n_read = recv(ut_file_descriptor_get_fd(self->fd), buffer, buffer_length,
+                  0);
+  }
+  if (n_read < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return;
+    }
+    // Treat errors (e.g. connection reset) as the end of the stream.
+    n_read = 0;
+  }
+  ut_input_buffer_commit(self->read_buffer, n_read);
+
+  // Callbacks may drop the last reference to this socket.
+  UtObjectRef ref = ut_object_ref(object);
+
+  // No more data will arrive, so stop polling.
   if (n_read == 0) {
     self->is_complete = true;
+    ut_event_loop_cancel_watch(self->read_watch);
   }
 
-  self->n_read += n_read;
-  UtObjectRef data = ut_list_get_sublist(self->read_buffer, 0, self->n_read);
   UtObjectRef data_with_fds = NULL;
   if (fds != NULL) {
-    data_with_fds = ut_uint8_array_with_fds_new(data, fds);
+    data_with_fds = ut_uint8_array_with_fds_new(self->read_buffer, fds);
   }
   size_t n_used =
       self->read_callback_object != NULL
           ? self->read_callback(self->read_callback_object,
-                                data_with_fds != NULL ? data_with_fds : data,
+                                data_with_fds != NULL ? data_with_fds
+                                                      : self->read_buffer,
                                 self->is_complete)
           : 0;
-  assert(n_used <= self->n_read);
-  ut_list_remove(self->read_buffer, 0, n_used);
-  self->n_read -= n_used;
+  ut_input_buffer_consume(self->read_buffer, n_used);
 }
 
 static void ut_tcp_socket_read(UtObject *object, UtObject *callback_object,
@@ -132,7 +214,7 @@ static void ut_tcp_socket_read(UtObject *object, UtObject *callback_object,
   ut_object_weak_ref(callback_object, &self->read_callback_object);
   self->read_callback = callback;
 
-  self->read_buffer = ut_uint8_array_new();
+  self->read_buffer = ut_input_buffer_new();
   self->read_watch = ut_event_loop_add_read_watch(self->fd, object, read_cb);
 }
 
@@ -144,62 +226,227 @@ static void ut_tcp_socket_close(UtObject *object) {
 static UtInputStreamInterface input_stream_interface = {
     .read = ut_tcp_socket_read, .close = ut_tcp_socket_close};
 
+// Notify when the write queue crosses the water marks.
+static void check_write_queue(UtTcpSocket *self) {
+  bool full;
+  if (!self->write_queue_full && self->high_water_mark > 0 &&
+      self->write_queue_length >= self->high_water_mark) {
+    full = true;
+  } else if (self->write_queue_full &&
+             self->write_queue_length <= self->low_water_mark) {
+    full = false;
+  } else {
+    return;
+  }
+
+  self->write_queue_full = full;
+  if (self->write_queue_callback_object != NULL &&
+      self->write_queue_callback != NULL) {
+    self->write_queue_callback(self->write_queue_callback_object, full);
+  }
+}
+
+// Remove the first block and notify that it is complete.
+static void complete_block(UtTcpSocket *self, UtObject *error) {
+  WriteBlock *block = self->blocks;
+  self->write_queue_length -= block->length - block->n_written;
+  self->blocks = block->next;
+  if (self->blocks == NULL) {
+    self->last_block = NULL;
+  }
+
+  if (block->callback_object != NULL && block->callback != NULL) {
+    block->callback(block->callback_object, error);
+  }
+
+  free_block(block);
+}
+
+// Send as much queued data as the socket will take. Blocks are combined into
+// a single message, except file descriptors which are only sent with the
+// first block in a message. Returns the error number if the send failed.
+static int send_blocks(UtTcpSocket *self) {
+  while (self->blocks != NULL) {
+    struct iovec iov[MAX_SEND_BLOCKS];
+    size_t iov_length = 0;
+    size_t n_to_send = 0;
+    WriteBlock *fds_block = NULL;
+    for (WriteBlock *block = self->blocks;
+         block != NULL && iov_length < MAX_SEND_BLOCKS; block = block->next) {
+      if (block->n_written == block->length) {
+        continue;
+      }
+      if (block->fds != NULL) {
+        if (iov_length > 0) {
+          break;
+        }
+        fds_block = block;
+      }
+      iov[iov_length].iov_base = (void *)(block->buffer + block->n_written);
+      iov[iov_length].iov_len = block->length - block->n_written;
+      n_to_send += iov[iov_length].iov_len;
+      iov_length++;
+    }
+    if (iov_length == 0) {
+      return 0;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_length;
+    UtObject *fds = fds_block != NULL ? fds_block->fds : NULL;
+    size_t fds_length = fds != NULL ? ut_list_get_length(fds) : 0;
+    uint8_t control_data[CMSG_SPACE(sizeof(int) * (fds_length + 1))];
+    if (fds_length > 0) {
+      memset(control_data, 0, sizeof(control_data));
+      msg.msg_control = control_data;
+      msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds_length);
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds_length);
+      int cmsg_fds[fds_length];
+      for (size_t i = 0; i < fds_length; i++) {
+        UtObjectRef fd = ut_list_get_element(fds, i);
+        cmsg_fds[i] = ut_file_descriptor_get_fd(fd);
+      }
+      memcpy(CMSG_DATA(cmsg), cmsg_fds, sizeof(cmsg_fds));
+    }
+
+    ssize_t n_sent =
+        sendmsg(ut_file_descriptor_get_fd(self->fd), &msg, MSG_NOSIGNAL);
+    if (n_sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+      }
+      return errno;
+    }
+
+    // File descriptors are sent with the first byte.
+    if (fds_block != NULL && n_sent > 0) {
+      ut_object_clear(&fds_block->fds);
+    }
+
+    size_t n_remaining = n_sent;
+    self->write_queue_length -= n_sent;
+    for (WriteBlock *block = self->blocks; n_remaining > 0;
+         block = block->next) {
+      size_t n_to_write = block->length - block->n_written;
+      size_t n = n_remaining < n_to_write ? n_remaining : n_to_write;
+      block->n_written += n;
+      n_remaining -= n;
+    }
+
+    // Drop completed blocks that don't need to be notified, others are done
+    // in send_cb.
+    while (self->blocks != NULL &&
+           self->blocks->n_written == self->blocks->length &&
+           self->blocks->callback == NULL) {
+      complete_block(self, NULL);
+    }
+
+    // Socket is full.
+    if ((size_t)n_sent < n_to_send) {
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+static void send_cb(UtObject *object) {
+  UtTcpSocket *self = (UtTcpSocket *)object;
+
+  // Keep alive while in callbacks.
+  UtObjectRef ref = ut_object_ref(object);
+
+  int error_code = send_blocks(self);
+  if (error_code != 0) {
+    UtObjectRef error = ut_system_error_new(error_code);
+    while (self->blocks != NULL) {
+      complete_block(self, error);
+    }
+  }
+
+  while (self->blocks != NULL &&
+         self->blocks->n_written == self->blocks->length) {
+    complete_block(self, NULL);
+  }
+
+  check_write_queue(self);
+
+  // Stop listening for write events when done.
+  if (self->blocks == NULL && self->send_watch != NULL) {
+    ut_event_loop_cancel_watch(self->send_watch);
+    ut_object_clear(&self->send_watch);
+  }
+}
+
 static void ut_tcp_socket_write(UtObject *object, UtObject *data,
                                 UtObject *callback_object,
                                 UtOutputStreamCallback callback) {
   UtTcpSocket *self = (UtTcpSocket *)object;
 
   UtObject *d;
-  UtObject *file_descriptors = NULL;
+  UtObject *fds = NULL;
   if (ut_object_is_uint8_array_with_fds(data)) {
     d = ut_uint8_array_with_fds_get_data(data);
-    file_descriptors = ut_uint8_array_with_fds_get_fds(data);
+    fds = ut_uint8_array_with_fds_get_fds(data);
+    if (ut_list_get_length(fds) == 0) {
+      fds = NULL;
+    }
   } else {
     d = data;
   }
 
-  ssize_t data_length = ut_list_get_length(d);
-  const uint8_t *buffer;
-  uint8_t *allocated_buffer = NULL;
-  buffer = ut_uint8_list_get_data(d);
-  if (buffer == NULL) {
-    allocated_buffer = ut_uint8_list_copy_data(d);
-    buffer = allocated_buffer;
-  }
-
-  if (file_descriptors != NULL && ut_list_get_length(file_descriptors) > 0) {
-    size_t file_descriptors_length = ut_list_get_length(file_descriptors);
-    struct iovec iov;
-    iov.iov_base = (void *)buffer;
-    iov.iov_len = data_length;
-    uint8_t control_data[CMSG_SPACE(sizeof(int) * file_descriptors_length)];
-    memset(control_data, 0, sizeof(control_data));
-    struct msghdr msg;
-    msg.msg_name = NULL;
-    msg.msg_namelen = 0;
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-    msg.msg_control = control_data;
-    msg.msg_controllen = sizeof(control_data);
-    msg.msg_flags = 0;
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type = SCM_RIGHTS;
-    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * file_descriptors_length);
-    int cmsg_fds[file_descriptors_length];
-    for (size_t i = 0; i < file_descriptors_length; i++) {
-      UtObjectRef fd = ut_list_get_element(file_descriptors, i);
-      cmsg_fds[i] = ut_file_descriptor_get_fd(fd);
-    }
-    memcpy(CMSG_DATA(cmsg), cmsg_fds, sizeof(cmsg_fds));
-    assert(sendmsg(ut_file_descriptor_get_fd(self->fd), &msg, 0) ==
-           data_length);
+  WriteBlock *block = malloc(sizeof(WriteBlock));
+  block->buffer = ut_uint8_list_get_data(d);
+  if (block->buffer != NULL) {
+    block->data = ut_object_ref(d);
   } else {
-    assert(send(ut_file_descriptor_get_fd(self->fd), buffer, data_length, 0) ==
-           data_length);
+    block->data = ut_list_copy(d);
+    block->buffer = ut_uint8_list_get_data(block->data);
+  }
+  block->length = ut_list_get_length(d);
+  block->n_written = 0;
+  block->fds = fds != NULL ? ut_object_ref(fds) : NULL;
+  ut_object_weak_ref(callback_object, &block->callback_object);
+  block->callback = callback;
+  block->next = NULL;
+  if (self->last_block != NULL) {
+    self->last_block->next = block;
+    self->last_block = block;
+  } else {
+    self->blocks = self->last_block = block;
+  }
+  self->write_queue_length += block->length;
+
+  // Try and send immediately, otherwise wait until the socket can take more
+  // data. Errors are reported from send_cb.
+  if (self->send_watch == NULL) {
+    send_blocks(self);
+  }
+
+  // The caller may modify the data after this call, so take a copy of
+  // anything not yet sent.
+  if (self->last_block == block && block->n_written < block->length &&
+      block->data == d && ut_list_is_mutable(d)) {
+    UtObject *copy = ut_uint8_array_new_from_data(
+        block->buffer + block->n_written, block->length - block->n_written);
+    ut_object_unref(block->data);
+    block->data = copy;
+    block->buffer = ut_uint8_list_get_data(copy);
+    block->length -= block->n_written;
+    block->n_written = 0;
   }
 
-  free(allocated_buffer);
+  if (self->blocks != NULL && self->send_watch == NULL) {
+    self->send_watch =
+        ut_event_loop_add_write_watch(self->fd, object, send_cb);
+  }
+
+  check_write_queue(self);
 }
 
 static UtOutputStreamInterface output_stream_interface = {
@@ -384,6 +631,27 @@ void ut_tcp_socket_send(UtObject *object, UtObject *data) {
   ut_output_stream_write(object, data);
 }
 
+void ut_tcp_socket_set_write_queue_callback(
+    UtObject *object, size_t high_water_mark, size_t low_water_mark,
+    UtObject *callback_object, UtTcpSocketWriteQueueCallback callback) {
+  assert(ut_object_is_tcp_socket(object));
+  UtTcpSocket *self = (UtTcpSocket *)object;
+
+  assert(low_water_mark < high_water_mark);
+
+  self->high_water_mark = high_water_mark;
+  self->low_water_mark = low_water_mark;
+  ut_object_weak_unref(&self->write_queue_callback_object);
+  ut_object_weak_ref(callback_object, &self->write_queue_callback_object);
+  self->write_queue_callback = callback;
+}
+
+size_t ut_tcp_socket_get_write_queue_length(UtObject *object) {
+  assert(ut_object_is_tcp_socket(object));
+  UtTcpSocket *self = (UtTcpSocket *)object;
+  return self->write_queue_length;
+}
+
 bool ut_object_is_tcp_socket(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
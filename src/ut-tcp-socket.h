@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "ut-object.h"
@@ -11,6 +12,11 @@
 /// !arg-type error UtError
 typedef void (*UtTcpSocketConnectCallback)(UtObject *object, UtObject *error);
 
+/// Method called when the amount of data waiting to be sent reaches the high
+/// water mark ([full] is [true]) and when it drops back to the low water mark
+/// ([full] is [false]).
+typedef void (*UtTcpSocketWriteQueueCallback)(UtObject *object, bool full);
+
 /// Creates a new TCP socket from an existing socket [fd].
 ///
 /// !arg-type fd UtFileDescriptor
@@ -45,5 +51,15 @@ uint16_t ut_tcp_socket_get_local_port(UtObject *object);
 /// !arg-type data UtUint8List
 void ut_tcp_socket_send(UtObject *object, UtObject *data);
 
+/// Set [callback] to be called when the data waiting to be sent reaches
+/// [high_water_mark] bytes, and again when it drops to [low_water_mark] bytes.
+/// This allows producers to stop writing until the receiver catches up.
+void ut_tcp_socket_set_write_queue_callback(
+    UtObject *object, size_t high_water_mark, size_t low_water_mark,
+    UtObject *callback_object, UtTcpSocketWriteQueueCallback callback);
+
+/// Returns the number of bytes waiting to be sent.
+size_t ut_tcp_socket_get_write_queue_length(UtObject *object);
+
 /// Returns [true] if [object] is a [UtTcpSocket].
 bool ut_object_is_tcp_socket(UtObject *object);
@@ -23,6 +23,9 @@ typedef struct {
 
 static void ut_udp_socket_cleanup(UtObject *object) {
   UtUdpSocket *self = (UtUdpSocket *)object;
+  if (self->watch != NULL) {
+    ut_event_loop_cancel_watch(self->watch);
+  }
   ut_object_unref(self->fd);
   ut_object_unref(self->watch);
   ut_object_unref(self->read_buffer);
@@ -39,5 +39,12 @@ UtObject *ut_uint16_array_new_from_va_elements(size_t length, va_list ap);
 /// !return-type UtUint8Array UtError
 UtObject *ut_uint16_array_new_from_hex_string(const char *hex);
 
+/// Ensures [object] has space for at least [length] values, so it can grow to
+/// this length without reallocating.
+void ut_uint16_array_reserve(UtObject *object, size_t length);
+
+/// Frees any space in [object] that isn't being used by its current values.
+void ut_uint16_array_shrink_to_fit(UtObject *object);
+
 /// Returns [true] if [object] is a [UtUint16Array].
 bool ut_object_is_uint16_array(UtObject *object);
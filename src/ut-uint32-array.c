@@ -2,20 +2,45 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ut-uint32-subarray.h"
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
   uint32_t *data;
   size_t data_length;
+  size_t data_allocated;
 } UtUint32Array;
 
+static void set_allocated(UtUint32Array *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(uint32_t) * allocated);
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtUint32Array *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static void resize_list(UtUint32Array *self, size_t length) {
-  self->data = realloc(self->data, sizeof(uint32_t) * length);
-  for (size_t i = self->data_length; i < length; i++) {
-    self->data[i] = 0;
+  grow(self, length);
+  if (length > self->data_length) {
+    memset(self->data + self->data_length, 0,
+           sizeof(uint32_t) * (length - self->data_length));
   }
   self->data_length = length;
 }
@@ -40,6 +65,7 @@ static uint32_t *ut_uint32_array_take_data(UtObject *object) {
   uint32_t *result = self->data;
   self->data = NULL;
   self->data_length = 0;
+  self->data_allocated = 0;
   return result;
 }
 
@@ -47,19 +73,17 @@ static void ut_uint32_array_insert(UtObject *object, size_t index,
                                    const uint32_t *data, size_t data_length) {
   UtUint32Array *self = (UtUint32Array *)object;
 
-  size_t n_after = self->data_length - index;
-  resize_list(self, self->data_length + data_length);
-
-  // Shift existing data up
-  for (size_t i = 0; i < n_after; i++) {
-    size_t new_index = self->data_length - 1 - i;
-    self->data[new_index] = self->data[new_index - data_length];
+  if (data_length == 0) {
+    return;
   }
 
-  // Insert new data
-  for (size_t i = 0; i < data_length; i++) {
-    self->data[index + i] = data[i];
-  }
+  size_t n_after = self->data_length - index;
+  grow(self, self->data_length + data_length);
+
+  memmove(self->data + index + data_length, self->data + index,
+          sizeof(uint32_t) * n_after);
+  memcpy(self->data + index, data, sizeof(uint32_t) * data_length);
+  self->data_length += data_length;
 }
 
 static void ut_uint32_array_insert_object(UtObject *object, size_t index,
@@ -74,10 +98,12 @@ static void ut_uint32_array_remove(UtObject *object, size_t index,
   UtUint32Array *self = (UtUint32Array *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
-  for (size_t i = index; i < self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
+  if (count == 0) {
+    return;
   }
-  resize_list(self, self->data_length - count);
+  memmove(self->data + index, self->data + index + count,
+          sizeof(uint32_t) * (self->data_length - index - count));
+  self->data_length -= count;
 }
 
 static void ut_uint32_array_resize(UtObject *object, size_t length) {
@@ -177,11 +203,9 @@ UtObject *ut_uint32_array_new_sized(size_t length) {
   UtObject *object = ut_uint32_array_new();
   UtUint32Array *self = (UtUint32Array *)object;
 
-  self->data = malloc(sizeof(uint32_t) * length);
+  self->data = calloc(length, sizeof(uint32_t));
   self->data_length = length;
-  for (size_t i = 0; i < length; i++) {
-    self->data[i] = 0;
-  }
+  self->data_allocated = length;
 
   return object;
 }
@@ -206,6 +230,26 @@ UtObject *ut_uint32_array_new_from_va_elements(size_t length, va_list ap) {
   return object;
 }
 
+void ut_uint32_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_uint32_array(object));
+  UtUint32Array *self = (UtUint32Array *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_uint32_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_uint32_array(object));
+  UtUint32Array *self = (UtUint32Array *)object;
+  if (self->data_length == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->data_allocated = 0;
+  } else if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_uint32_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures the throughput of appending to and consuming from a UtUint8Array.
+
+#define TOTAL_LENGTH (64 * 1024 * 1024)
+
+static void report(const char *name, double duration) {
+  printf("%-24s %8.1f MB/s\n", name, TOTAL_LENGTH / duration / 1e6);
+}
+
+static void benchmark_append(size_t chunk_length, bool reserve) {
+  uint8_t *chunk = calloc(chunk_length, sizeof(uint8_t));
+  UtObjectRef array = ut_uint8_array_new();
+  if (reserve) {
+    ut_uint8_array_reserve(array, TOTAL_LENGTH);
+  }
+
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < TOTAL_LENGTH; i += chunk_length) {
+    ut_uint8_list_append_block(array, chunk, chunk_length);
+  }
+  double duration = ut_benchmark_get_time() - start;
+  free(chunk);
+
+  char name[64];
+  snprintf(name, sizeof(name), "append %zi%s", chunk_length,
+           reserve ? " (reserved)" : "");
+  report(name, duration);
+}
+
+static void benchmark_stream(size_t chunk_length) {
+  uint8_t *chunk = calloc(chunk_length, sizeof(uint8_t));
+  UtObjectRef array = ut_uint8_array_new();
+
+  // Append a chunk and consume part of the buffer, as a stream reader does.
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < TOTAL_LENGTH; i += chunk_length) {
+    ut_uint8_list_append_block(array, chunk, chunk_length);
+    if (ut_list_get_length(array) >= chunk_length * 4) {
+      ut_list_remove(array, 0, chunk_length * 3);
+    }
+  }
+  double duration = ut_benchmark_get_time() - start;
+  free(chunk);
+
+  char name[64];
+  snprintf(name, sizeof(name), "stream %zi", chunk_length);
+  report(name, duration);
+}
+
+int main(int argc, char **argv) {
+  benchmark_append(1, false);
+  benchmark_append(1, true);
+  benchmark_append(4096, false);
+  benchmark_append(4096, true);
+  benchmark_stream(4096);
+
+  return 0;
+}
@@ -158,6 +158,55 @@ static void test_get_int64() {
                       -0x123456789abcdef0);
 }
 
+static void test_insert_remove() {
+  UtObjectRef array = ut_uint8_array_new_from_hex_string("00010203");
+  UtObjectRef insert = ut_uint8_array_new_from_hex_string("aabb");
+  ut_list_insert_list(array, 2, insert);
+  ut_assert_uint8_list_equal_hex(array, "0001aabb0203");
+  ut_list_remove(array, 1, 3);
+  ut_assert_uint8_list_equal_hex(array, "000203");
+  ut_list_resize(array, 5);
+  ut_assert_uint8_list_equal_hex(array, "0002030000");
+  ut_list_remove(array, 0, 5);
+  ut_assert_uint8_list_equal_hex(array, "");
+}
+
+static void test_many() {
+  UtObjectRef array = ut_uint8_array_new();
+  for (size_t i = 0; i < 100000; i++) {
+    ut_uint8_list_append(array, i);
+  }
+  ut_assert_int_equal(ut_list_get_length(array), 100000);
+
+  // Consume from the front, as a stream buffer would.
+  for (size_t i = 0; i < 100; i++) {
+    ut_assert_int_equal(ut_uint8_list_get_element(array, 0), (i * 1000) & 0xff);
+    ut_list_remove(array, 0, 1000);
+  }
+  ut_assert_int_equal(ut_list_get_length(array), 0);
+}
+
+static void test_reserve() {
+  UtObjectRef array = ut_uint8_array_new();
+  ut_uint8_array_reserve(array, 1024);
+  ut_assert_int_equal(ut_list_get_length(array), 0);
+  uint8_t *data = ut_uint8_list_get_writable_data(array);
+  for (size_t i = 0; i < 1024; i++) {
+    ut_uint8_list_append(array, 0x42);
+  }
+  // Data didn't move as enough space was reserved.
+  ut_assert_true(ut_uint8_list_get_writable_data(array) == data);
+
+  ut_list_resize(array, 2);
+  ut_uint8_array_shrink_to_fit(array);
+  ut_assert_uint8_list_equal_hex(array, "4242");
+  ut_list_clear(array);
+  ut_uint8_array_shrink_to_fit(array);
+  ut_assert_uint8_list_equal_hex(array, "");
+  ut_uint8_list_append(array, 0x01);
+  ut_assert_uint8_list_equal_hex(array, "01");
+}
+
 int main(int argc, char **argv) {
   UtObjectRef array0 = ut_uint8_array_new();
   ut_assert_uint8_list_equal_hex(array0, "");
@@ -216,5 +265,9 @@ int main(int argc, char **argv) {
   test_append_int64();
   test_get_int64();
 
+  test_insert_remove();
+  test_many();
+  test_reserve();
+
   return 0;
 }
@@ -7,16 +7,40 @@
 #include "ut-uint8-subarray.h"
 #include "ut.h"
 
+#define MINIMUM_ALLOCATED_LENGTH 16
+
 typedef struct {
   UtObject object;
   uint8_t *data;
   size_t data_length;
+  size_t data_allocated;
 } UtUint8Array;
 
+static void set_allocated(UtUint8Array *self, size_t allocated) {
+  self->data = realloc(self->data, sizeof(uint8_t) * allocated);
+  self->data_allocated = allocated;
+}
+
+// Grow geometrically so repeated appends take amortized constant time.
+static void grow(UtUint8Array *self, size_t length) {
+  if (length <= self->data_allocated) {
+    return;
+  }
+  size_t allocated = self->data_allocated * 2;
+  if (allocated < MINIMUM_ALLOCATED_LENGTH) {
+    allocated = MINIMUM_ALLOCATED_LENGTH;
+  }
+  if (allocated < length) {
+    allocated = length;
+  }
+  set_allocated(self, allocated);
+}
+
 static void resize_list(UtUint8Array *self, size_t length) {
-  self->data = realloc(self->data, sizeof(uint8_t) * length);
-  for (size_t i = self->data_length; i < length; i++) {
-    self->data[i] = 0;
+  grow(self, length);
+  if (length > self->data_length) {
+    memset(self->data + self->data_length, 0,
+           sizeof(uint8_t) * (length - self->data_length));
   }
   self->data_length = length;
 }
@@ -53,6 +77,7 @@ static uint8_t *ut_uint8_array_take_data(UtObject *object) {
   uint8_t *result = self->data;
   self->data = NULL;
   self->data_length = 0;
+  self->data_allocated = 0;
   return result;
 }
 
@@ -62,19 +87,17 @@ static void ut_uint8_array_insert(UtObject *object, size_t index,
 
   assert(index <= self->data_length);
 
-  size_t n_after = self->data_length - index;
-  resize_list(self, self->data_length + data_length);
-
-  // Shift existing data up
-  for (size_t i = 0; i < n_after; i++) {
-    size_t new_index = self->data_length - 1 - i;
-    self->data[new_index] = self->data[new_index - data_length];
+  if (data_length == 0) {
+    return;
   }
 
-  // Insert new data
-  for (size_t i = 0; i < data_length; i++) {
-    self->data[index + i] = data[i];
-  }
+  size_t n_after = self->data_length - index;
+  grow(self, self->data_length + data_length);
+
+  memmove(self->data + index + data_length, self->data + index,
+          sizeof(uint8_t) * n_after);
+  memcpy(self->data + index, data, sizeof(uint8_t) * data_length);
+  self->data_length += data_length;
 }
 
 static void ut_uint8_array_append(UtObject *object, const uint8_t *data,
@@ -94,28 +117,28 @@ static void ut_uint8_array_insert_list(UtObject *object, size_t index,
                                        UtObject *list) {
   UtUint8Array *self = (UtUint8Array *)object;
 
-  if (ut_object_is_uint8_array(list)) {
-    UtUint8Array *l = (UtUint8Array *)list;
-    ut_uint8_array_insert(object, index, l->data, l->data_length);
-  } else if (ut_object_implements_uint8_list(list)) {
-    size_t l_length = ut_list_get_length(list);
-    size_t orig_data_length = self->data_length;
-    resize_list(self, self->data_length + l_length);
-
-    // Shift existing data up
-    for (size_t i = index; i < orig_data_length; i++) {
-      size_t new_index = self->data_length - i - 1;
-      size_t old_index = new_index - l_length;
-      self->data[new_index] = self->data[old_index];
-    }
+  assert(ut_object_implements_uint8_list(list));
+  assert(index <= self->data_length);
 
-    // Insert new data
-    for (size_t i = 0; i < l_length; i++) {
-      self->data[index + i] = ut_uint8_list_get_element(list, i);
-    }
-  } else {
-    assert(false);
+  size_t l_length = ut_list_get_length(list);
+  const uint8_t *l_data = ut_uint8_list_get_data(list);
+  if (l_data != NULL) {
+    ut_uint8_array_insert(object, index, l_data, l_length);
+    return;
   }
+
+  if (l_length == 0) {
+    return;
+  }
+
+  size_t n_after = self->data_length - index;
+  grow(self, self->data_length + l_length);
+  memmove(self->data + index + l_length, self->data + index,
+          sizeof(uint8_t) * n_after);
+  for (size_t i = 0; i < l_length; i++) {
+    self->data[index + i] = ut_uint8_list_get_element(list, i);
+  }
+  self->data_length += l_length;
 }
 
 static void ut_uint8_array_remove(UtObject *object, size_t index,
@@ -123,10 +146,12 @@ static void ut_uint8_array_remove(UtObject *object, size_t index,
   UtUint8Array *self = (UtUint8Array *)object;
   assert(index <= self->data_length);
   assert(index + count <= self->data_length);
-  for (size_t i = index; i < self->data_length - count; i++) {
-    self->data[i] = self->data[i + count];
+  if (count == 0) {
+    return;
   }
-  resize_list(self, self->data_length - count);
+  memmove(self->data + index, self->data + index + count,
+          sizeof(uint8_t) * (self->data_length - index - count));
+  self->data_length -= count;
 }
 
 static void ut_uint8_array_resize(UtObject *object, size_t length) {
@@ -162,16 +187,17 @@ static void ut_uint8_array_write(UtObject *object, UtObject *data,
                                  UtOutputStreamCallback callback) {
   UtUint8Array *self = (UtUint8Array *)object;
 
-  if (ut_object_is_uint8_array(data)) {
-    ut_uint8_array_append(object, ut_uint8_list_get_writable_data(data),
-                          ut_uint8_array_get_length(data));
+  size_t data_length = ut_list_get_length(data);
+  const uint8_t *contents = ut_uint8_list_get_data(data);
+  if (contents != NULL) {
+    ut_uint8_array_append(object, contents, data_length);
   } else {
-    size_t data_length = ut_list_get_length(data);
     size_t start = self->data_length;
-    resize_list(self, self->data_length + data_length);
+    grow(self, self->data_length + data_length);
     for (size_t i = 0; i < data_length; i++) {
       self->data[start + i] = ut_uint8_list_get_element(data, i);
     }
+    self->data_length += data_length;
   }
 
   if (callback != NULL) {
@@ -254,11 +280,9 @@ UtObject *ut_uint8_array_new_sized(size_t length) {
   UtObject *object = ut_uint8_array_new();
   UtUint8Array *self = (UtUint8Array *)object;
 
-  self->data = malloc(sizeof(uint8_t) * length);
+  self->data = calloc(length, sizeof(uint8_t));
   self->data_length = length;
-  for (size_t i = 0; i < length; i++) {
-    self->data[i] = 0;
-  }
+  self->data_allocated = length;
 
   return object;
 }
@@ -269,10 +293,9 @@ UtObject *ut_uint8_array_new_from_data(const uint8_t *data,
   UtUint8Array *self = (UtUint8Array *)object;
 
   self->data = malloc(sizeof(uint8_t) * data_length);
+  memcpy(self->data, data, sizeof(uint8_t) * data_length);
   self->data_length = data_length;
-  for (size_t i = 0; i < data_length; i++) {
-    self->data[i] = data[i];
-  }
+  self->data_allocated = data_length;
 
   return object;
 }
@@ -319,6 +342,26 @@ UtObject *ut_uint8_array_new_from_hex_string(const char *hex) {
   return ut_object_ref(object);
 }
 
+void ut_uint8_array_reserve(UtObject *object, size_t length) {
+  assert(ut_object_is_uint8_array(object));
+  UtUint8Array *self = (UtUint8Array *)object;
+  if (length > self->data_allocated) {
+    set_allocated(self, length);
+  }
+}
+
+void ut_uint8_array_shrink_to_fit(UtObject *object) {
+  assert(ut_object_is_uint8_array(object));
+  UtUint8Array *self = (UtUint8Array *)object;
+  if (self->data_length == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->data_allocated = 0;
+  } else if (self->data_allocated > self->data_length) {
+    set_allocated(self, self->data_length);
+  }
+}
+
 bool ut_object_is_uint8_array(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ut-input-buffer.h"
 #include "ut-uint8-subarray.h"
 #include "ut.h"
 
@@ -132,7 +133,8 @@ UtObject *ut_uint8_subarray_new(UtObject *parent, size_t start, size_t length) {
   UtObject *object = ut_object_new(sizeof(UtUint8Subarray), &object_interface);
   UtUint8Subarray *self = (UtUint8Subarray *)object;
 
-  assert(parent != NULL && ut_object_is_uint8_array(parent));
+  assert(parent != NULL && (ut_object_is_uint8_array(parent) ||
+                            ut_object_is_input_buffer(parent)));
   size_t parent_length = ut_list_get_length(parent);
   assert(start + length <= parent_length);
 
@@ -54,6 +54,8 @@
 #include "asn1/ut-asn1-utf8-string-type.h"
 #include "asn1/ut-asn1-value-constraint.h"
 #include "asn1/ut-asn1-visible-string-type.h"
+#include "checksum/ut-adler32.h"
+#include "checksum/ut-crc32.h"
 #include "dbus/ut-dbus-array.h"
 #include "dbus/ut-dbus-client.h"
 #include "dbus/ut-dbus-dict.h"
@@ -67,6 +69,7 @@
 #include "deflate/ut-deflate-decoder.h"
 #include "deflate/ut-deflate-encoder.h"
 #include "deflate/ut-deflate-error.h"
+#include "deflate/ut-deflate-parallel-decoder.h"
 #include "dns/ut-dns-client.h"
 #include "gif/ut-gif-decoder.h"
 #include "gif/ut-gif-encoder.h"
@@ -163,5 +163,45 @@ int main(int argc, char **argv) {
   ut_assert_cstring_equal(ut_string_get_text(short_write_result_string),
                           "hello");
 
+  // Preset dictionary "hello world ".
+  UtObjectRef dictionary_data = ut_uint8_list_new_from_hex_string(
+      "78bb1e88047dcbc0ce060069e708d9");
+  UtObjectRef dictionary =
+      ut_uint8_list_new_from_hex_string("68656c6c6f20776f726c6420");
+  UtObjectRef dictionary_data_stream =
+      ut_list_input_stream_new(dictionary_data);
+  UtObjectRef dictionary_decoder =
+      ut_zlib_decoder_new(dictionary_data_stream);
+  ut_zlib_decoder_set_dictionary(dictionary_decoder, dictionary);
+  UtObjectRef dictionary_result =
+      ut_input_stream_read_sync(dictionary_decoder);
+  ut_assert_is_not_error(dictionary_result);
+  UtObjectRef dictionary_result_string =
+      ut_string_new_from_utf8(dictionary_result);
+  ut_assert_cstring_equal(ut_string_get_text(dictionary_result_string),
+                          "hello world hello world");
+
+  // Preset dictionary not provided.
+  UtObjectRef no_dictionary_data_stream =
+      ut_list_input_stream_new(dictionary_data);
+  UtObjectRef no_dictionary_decoder =
+      ut_zlib_decoder_new(no_dictionary_data_stream);
+  UtObjectRef no_dictionary_result =
+      ut_input_stream_read_sync(no_dictionary_decoder);
+  ut_assert_is_error_with_description(no_dictionary_result,
+                                      "Zlib data requires a preset dictionary");
+
+  // Preset dictionary doesn't match.
+  UtObjectRef wrong_dictionary = ut_uint8_list_new_from_hex_string("00");
+  UtObjectRef wrong_dictionary_data_stream =
+      ut_list_input_stream_new(dictionary_data);
+  UtObjectRef wrong_dictionary_decoder =
+      ut_zlib_decoder_new(wrong_dictionary_data_stream);
+  ut_zlib_decoder_set_dictionary(wrong_dictionary_decoder, wrong_dictionary);
+  UtObjectRef wrong_dictionary_result =
+      ut_input_stream_read_sync(wrong_dictionary_decoder);
+  ut_assert_is_error_with_description(
+      wrong_dictionary_result, "Zlib preset dictionary checksum mismatch");
+
   return 0;
 }
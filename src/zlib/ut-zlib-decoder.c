@@ -21,20 +21,13 @@ typedef struct {
   DecoderState state;
   uint16_t window_size;
   UtZlibCompressionLevel compression_level;
+  UtObject *dictionary;
   uint32_t dictionary_checksum;
   uint32_t checksum;
   UtObject *deflate_decoder;
   UtObject *error;
 } UtZlibDecoder;
 
-static uint32_t adler32(uint32_t checksum, uint8_t value) {
-  uint32_t s1 = checksum & 0xffff;
-  uint32_t s2 = checksum >> 16;
-  s1 = (s1 + value) % 65521;
-  s2 = (s2 + s1) % 65521;
-  return s2 << 16 | s1;
-}
-
 static void set_error(UtZlibDecoder *self, const char *description) {
   if (self->state == DECODER_STATE_ERROR) {
     return;
@@ -76,10 +69,7 @@ static size_t deflate_read_cb(UtObject *object, UtObject *data, bool complete) {
     n_used = data_length;
   }
 
-  for (size_t i = 0; i < n_used; i++) {
-    self->checksum =
-        adler32(self->checksum, ut_uint8_list_get_element(data, i));
-  }
+  self->checksum = ut_adler32_update_list(self->checksum, data, 0, n_used);
 
   if (complete) {
     self->state = DECODER_STATE_CHECKSUM;
@@ -137,23 +127,22 @@ static size_t decode_header(UtZlibDecoder *self, UtObject *data) {
   return offset;
 }
 
-static size_t decode_dictionary(UtZlibDecoder *self, UtObject *data) {
-  size_t data_length = ut_list_get_length(data);
-
-  size_t offset = 0;
-  while (self->checksum != self->dictionary_checksum && offset < data_length) {
-    uint8_t value = ut_uint8_list_get_element(data, offset++);
-    self->checksum = adler32(self->checksum, value);
+static size_t decode_dictionary(UtZlibDecoder *self) {
+  if (self->dictionary == NULL) {
+    set_error(self, "Zlib data requires a preset dictionary");
+    return 0;
   }
-
-  if (self->checksum != self->dictionary_checksum) {
+  if (ut_adler32_update_list(1, self->dictionary, 0,
+                             ut_list_get_length(self->dictionary)) !=
+      self->dictionary_checksum) {
+    set_error(self, "Zlib preset dictionary checksum mismatch");
     return 0;
   }
 
-  self->checksum = 1;
+  ut_deflate_decoder_set_dictionary(self->deflate_decoder, self->dictionary);
   self->state = DECODER_STATE_COMPRESSED_DATA;
 
-  return offset;
+  return 0;
 }
 
 static size_t decode_checksum(UtZlibDecoder *self, UtObject *data) {
@@ -186,7 +175,7 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
       n_used = decode_header(self, d);
       break;
     case DECODER_STATE_DICTIONARY:
-      n_used = decode_dictionary(self, d);
+      n_used = decode_dictionary(self);
       break;
     case DECODER_STATE_COMPRESSED_DATA:
       n_used = ut_writable_input_stream_write(self->deflate_input_stream, d,
@@ -227,6 +216,7 @@ static void ut_zlib_decoder_cleanup(UtObject *object) {
   ut_object_unref(self->deflate_input_stream);
   ut_object_weak_unref(&self->callback_object);
   ut_object_unref(self->deflate_decoder);
+  ut_object_unref(self->dictionary);
   ut_object_unref(self->error);
 }
 
@@ -266,6 +256,14 @@ UtObject *ut_zlib_decoder_new(UtObject *input_stream) {
   return object;
 }
 
+void ut_zlib_decoder_set_dictionary(UtObject *object, UtObject *dictionary) {
+  assert(ut_object_is_zlib_decoder(object));
+  UtZlibDecoder *self = (UtZlibDecoder *)object;
+  assert(self->state == DECODER_STATE_HEADER);
+  ut_object_unref(self->dictionary);
+  self->dictionary = ut_object_ref(dictionary);
+}
+
 UtZlibCompressionLevel ut_zlib_decoder_get_compression_level(UtObject *object) {
   assert(ut_object_is_zlib_decoder(object));
   UtZlibDecoder *self = (UtZlibDecoder *)object;
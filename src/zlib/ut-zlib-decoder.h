@@ -12,6 +12,14 @@
 /// !return-type UtZlibDecoder
 UtObject *ut_zlib_decoder_new(UtObject *input_stream);
 
+/// Sets the preset [dictionary] to use if the data requires one.
+/// Decoding fails if the data requires a dictionary and none is set, or the
+/// checksum of [dictionary] doesn't match the one in the data.
+/// Must be called before reading.
+///
+/// !arg-type dictionary UtUint8List
+void ut_zlib_decoder_set_dictionary(UtObject *object, UtObject *dictionary);
+
 /// Gets the compression level reported in the data.
 /// Only valid once the decompression is complete.
 UtZlibCompressionLevel ut_zlib_decoder_get_compression_level(UtObject *object);
@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "ut-benchmark.h"
+#include "ut.h"
+
+// Measures compression of many small JSON messages, comparing a new encoder
+// for each message with a reused encoder and a preset dictionary.
+
+#define N_MESSAGES 2000
+
+// Generate a JSON message of around 200 bytes.
+static UtObject *make_message(size_t index) {
+  const char *names[] = {"alice", "bob", "carol", "dave", "eve", "frank"};
+  const char *states[] = {"active", "idle", "offline"};
+  ut_cstring_ref text = ut_cstring_new_printf(
+      "{\"id\": %zi, \"user\": \"%s\", \"status\": \"%s\", "
+      "\"timestamp\": %u, \"location\": {\"latitude\": %u.%u, "
+      "\"longitude\": %u.%u}, \"tags\": [\"%s\", \"%s\"], \"score\": %u}",
+      index, names[ut_benchmark_get_random() % 6],
+      states[ut_benchmark_get_random() % 3],
+      1700000000 + ut_benchmark_get_random(), ut_benchmark_get_random() % 90,
+      ut_benchmark_get_random(), ut_benchmark_get_random() % 180,
+      ut_benchmark_get_random(), names[ut_benchmark_get_random() % 6],
+      states[ut_benchmark_get_random() % 3], ut_benchmark_get_random() % 1000);
+  UtObjectRef string = ut_string_new(text);
+  return ut_string_get_utf8(string);
+}
+
+// Data that commonly appears in messages, used as a preset dictionary.
+static UtObject *make_dictionary() {
+  UtObjectRef string = ut_string_new(
+      "\"offline\"\"idle\"\"frank\"\"eve\"\"dave\"\"carol\"\"bob\"\"alice\""
+      "{\"id\": , \"user\": \"\", \"status\": \"active\", \"timestamp\": 17"
+      ", \"location\": {\"latitude\": , \"longitude\": }, \"tags\": [\"\", "
+      "\"\"], \"score\": }");
+  return ut_string_get_utf8(string);
+}
+
+// Check [encoded_data] decodes to [data].
+static void check_message(UtObject *encoded_data, UtObject *dictionary,
+                          UtObject *data) {
+  UtObjectRef encoded_data_stream = ut_list_input_stream_new(encoded_data);
+  UtObjectRef decoder = ut_zlib_decoder_new(encoded_data_stream);
+  if (dictionary != NULL) {
+    ut_zlib_decoder_set_dictionary(decoder, dictionary);
+  }
+  UtObjectRef decoded_data = ut_input_stream_read_sync(decoder);
+  ut_assert_equal(decoded_data, data);
+}
+
+static void print_result(const char *name, UtObject *messages,
+                         size_t encoded_length, double duration) {
+  size_t data_length = 0;
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    UtObject *message = ut_object_list_get_element(messages, i);
+    data_length += ut_list_get_length(message);
+  }
+  printf("%-10s %6zi -> %6zi bytes: ratio %5.2f, %6.1f us/message\n", name,
+         data_length / N_MESSAGES, encoded_length / N_MESSAGES,
+         (double)data_length / encoded_length, duration / N_MESSAGES * 1e6);
+}
+
+static void benchmark_new(UtObject *messages) {
+  UtObjectRef results = ut_object_list_new();
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    UtObject *message = ut_object_list_get_element(messages, i);
+    UtObjectRef data_stream = ut_list_input_stream_new(message);
+    UtObjectRef encoder = ut_zlib_encoder_new(data_stream);
+    ut_list_append_take(results, ut_input_stream_read_sync(encoder));
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  size_t encoded_length = 0;
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    UtObject *result = ut_object_list_get_element(results, i);
+    UtObject *message = ut_object_list_get_element(messages, i);
+    check_message(result, NULL, message);
+    encoded_length += ut_list_get_length(result);
+  }
+  print_result("new", messages, encoded_length, duration);
+}
+
+static void benchmark_reset(const char *name, UtObject *messages,
+                            UtObject *dictionary) {
+  UtObjectRef empty_data = ut_uint8_list_new();
+  UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
+  UtObjectRef encoder = ut_zlib_encoder_new(empty_data_stream);
+
+  UtObjectRef results = ut_object_list_new();
+  double start = ut_benchmark_get_time();
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    UtObject *message = ut_object_list_get_element(messages, i);
+    UtObjectRef data_stream = ut_list_input_stream_new(message);
+    ut_zlib_encoder_reset(encoder, data_stream);
+    if (dictionary != NULL) {
+      ut_zlib_encoder_set_dictionary(encoder, dictionary);
+    }
+    ut_list_append_take(results, ut_input_stream_read_sync(encoder));
+  }
+  double duration = ut_benchmark_get_time() - start;
+
+  size_t encoded_length = 0;
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    UtObject *result = ut_object_list_get_element(results, i);
+    UtObject *message = ut_object_list_get_element(messages, i);
+    check_message(result, dictionary, message);
+    encoded_length += ut_list_get_length(result);
+  }
+  print_result(name, messages, encoded_length, duration);
+}
+
+int main(int argc, char **argv) {
+  UtObjectRef messages = ut_object_list_new();
+  for (size_t i = 0; i < N_MESSAGES; i++) {
+    ut_list_append_take(messages, make_message(i));
+  }
+  UtObjectRef dictionary = make_dictionary();
+
+  benchmark_new(messages);
+  benchmark_reset("reset", messages, NULL);
+  benchmark_reset("dictionary", messages, dictionary);
+
+  return 0;
+}
@@ -10,6 +10,58 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
   return ut_list_get_length(data);
 }
 
+// Encode [data] with [encoder], using [dictionary] if not NULL.
+static UtObject *encode(UtObject *encoder, UtObject *data,
+                        UtObject *dictionary) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  ut_zlib_encoder_reset(encoder, data_stream);
+  if (dictionary != NULL) {
+    ut_zlib_encoder_set_dictionary(encoder, dictionary);
+  }
+  return ut_input_stream_read_sync(encoder);
+}
+
+// Decode [data], using [dictionary] if not NULL.
+static UtObject *decode(UtObject *data, UtObject *dictionary) {
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef decoder = ut_zlib_decoder_new(data_stream);
+  if (dictionary != NULL) {
+    ut_zlib_decoder_set_dictionary(decoder, dictionary);
+  }
+  return ut_input_stream_read_sync(decoder);
+}
+
+static void test_dictionary() {
+  UtObjectRef empty_data = ut_uint8_list_new();
+  UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
+  UtObjectRef encoder = ut_zlib_encoder_new(empty_data_stream);
+
+  // Dictionary is indicated in the header, followed by its checksum.
+  UtObjectRef dictionary = get_utf8_data("hello world ");
+  UtObjectRef data = get_utf8_data("hello world hello world");
+  UtObjectRef result = encode(encoder, data, dictionary);
+  ut_assert_is_not_error(result);
+  ut_assert_int_equal(ut_uint8_list_get_element(result, 1) & 0x20, 0x20);
+  ut_assert_int_equal(ut_uint8_list_get_uint32_be(result, 2),
+                      ut_adler32_update_list(1, dictionary, 0, 12));
+  UtObjectRef decoded_data = decode(result, dictionary);
+  ut_assert_is_not_error(decoded_data);
+  ut_assert_equal(decoded_data, data);
+
+  // Encoding again without the dictionary gives a new stream.
+  UtObjectRef result_without_dictionary = encode(encoder, data, NULL);
+  UtObjectRef data_stream = ut_list_input_stream_new(data);
+  UtObjectRef new_encoder = ut_zlib_encoder_new(data_stream);
+  UtObjectRef new_encoder_result = ut_input_stream_read_sync(new_encoder);
+  ut_assert_equal(result_without_dictionary, new_encoder_result);
+  ut_assert_true(ut_list_get_length(result) <
+                 ut_list_get_length(result_without_dictionary));
+  UtObjectRef decoded_data_without_dictionary =
+      decode(result_without_dictionary, NULL);
+  ut_assert_is_not_error(decoded_data_without_dictionary);
+  ut_assert_equal(decoded_data_without_dictionary, data);
+}
+
 int main(int argc, char **argv) {
   UtObjectRef empty_data = ut_uint8_list_new();
   UtObjectRef empty_data_stream = ut_list_input_stream_new(empty_data);
@@ -116,5 +168,7 @@ int main(int argc, char **argv) {
   ut_assert_uint8_list_equal_hex(short_write_result,
                                  "789ccb48cdc9c90700062c0215");
 
+  test_dictionary();
+
   return 0;
 }
@@ -18,6 +18,10 @@ typedef struct {
   // Checksum calculated of uncompressed data.
   uint32_t checksum;
 
+  // Checksum of the preset dictionary, if one is used.
+  bool has_dictionary;
+  uint32_t dictionary_checksum;
+
   UtObject *deflate_input_stream;
   UtObject *deflate_encoder;
 
@@ -55,6 +59,9 @@ static void write_header(UtZlibEncoder *self, uint8_t compression_method,
   assert(encode_window_size(window_size, &window_size_value));
   uint8_t cmf = window_size_value << 4 | compression_method;
   uint8_t flags = compression_level << 6;
+  if (self->has_dictionary) {
+    flags |= 0x20;
+  }
 
   uint16_t header_check = (cmf << 8 | flags) % 31;
   if (header_check != 0) {
@@ -63,14 +70,9 @@ static void write_header(UtZlibEncoder *self, uint8_t compression_method,
 
   ut_uint8_list_append(self->buffer, cmf);
   ut_uint8_list_append(self->buffer, flags);
-}
-
-static uint32_t adler32(uint32_t checksum, uint8_t value) {
-  uint32_t s1 = checksum & 0xffff;
-  uint32_t s2 = checksum >> 16;
-  s1 = (s1 + value) % 65521;
-  s2 = (s2 + s1) % 65521;
-  return s2 << 16 | s1;
+  if (self->has_dictionary) {
+    ut_uint8_list_append_uint32_be(self->buffer, self->dictionary_checksum);
+  }
 }
 
 static size_t deflate_read_cb(UtObject *object, UtObject *data, bool complete) {
@@ -91,10 +93,7 @@ static size_t read_cb(UtObject *object, UtObject *data, bool complete) {
 
   size_t n = ut_writable_input_stream_write(self->deflate_input_stream, data,
                                             complete);
-  for (size_t i = 0; i < n; i++) {
-    self->checksum =
-        adler32(self->checksum, ut_uint8_list_get_element(data, i));
-  }
+  self->checksum = ut_adler32_update_list(self->checksum, data, 0, n);
 
   if (complete) {
     // Write the checksum.
@@ -179,13 +178,52 @@ UtObject *ut_zlib_encoder_new_full(UtZlibCompressionLevel compression_level,
 
   self->input_stream = ut_object_ref(input_stream);
 
-  self->deflate_encoder = ut_deflate_encoder_new_with_window_size(
-      window_size, self->deflate_input_stream);
+  // The zlib levels match the deflate levels.
+  self->deflate_encoder = ut_deflate_encoder_new_full(
+      (UtDeflateCompressionLevel)compression_level, window_size,
+      self->deflate_input_stream);
   ut_input_stream_read(self->deflate_encoder, object, deflate_read_cb);
 
   return object;
 }
 
+void ut_zlib_encoder_set_dictionary(UtObject *object, UtObject *dictionary) {
+  assert(ut_object_is_zlib_encoder(object));
+  UtZlibEncoder *self = (UtZlibEncoder *)object;
+
+  assert(self->callback == NULL);
+  assert(!self->has_dictionary);
+
+  self->has_dictionary = true;
+  self->dictionary_checksum = ut_adler32_update_list(
+      1, dictionary, 0, ut_list_get_length(dictionary));
+  ut_deflate_encoder_set_dictionary(self->deflate_encoder, dictionary);
+}
+
+void ut_zlib_encoder_reset(UtObject *object, UtObject *input_stream) {
+  assert(ut_object_is_zlib_encoder(object));
+  UtZlibEncoder *self = (UtZlibEncoder *)object;
+
+  assert(input_stream != NULL);
+  assert(input_stream != self->input_stream);
+
+  ut_input_stream_close(self->input_stream);
+  ut_object_unref(self->input_stream);
+  self->input_stream = ut_object_ref(input_stream);
+  ut_object_weak_unref(&self->callback_object);
+  self->callback = NULL;
+
+  self->has_dictionary = false;
+  self->written_header = false;
+  ut_list_clear(self->buffer);
+
+  // The deflate encoder keeps its state, only the stream feeding it is new.
+  ut_object_unref(self->deflate_input_stream);
+  self->deflate_input_stream = ut_writable_input_stream_new();
+  ut_deflate_encoder_reset(self->deflate_encoder, self->deflate_input_stream);
+  ut_input_stream_read(self->deflate_encoder, object, deflate_read_cb);
+}
+
 bool ut_object_is_zlib_encoder(UtObject *object) {
   return ut_object_is_type(object, &object_interface);
 }
@@ -21,5 +21,19 @@ UtObject *ut_zlib_encoder_new(UtObject *input_stream);
 UtObject *ut_zlib_encoder_new_full(UtZlibCompressionLevel compression_level,
                                    size_t window_size, UtObject *input_stream);
 
+/// Sets [dictionary] as data that precedes the data to compress, so matches
+/// can refer to it. The same dictionary must be given to the decoder with
+/// [ut_zlib_decoder_set_dictionary]. Must be called before reading.
+///
+/// !arg-type dictionary UtUint8List
+void ut_zlib_encoder_set_dictionary(UtObject *object, UtObject *dictionary);
+
+/// Resets the encoder to compress a new [input_stream], keeping the
+/// compression level and window size. Reusing an encoder avoids allocating
+/// new hash tables and buffers for each message. Any dictionary is cleared.
+///
+/// !arg-type input_stream UtInputStream
+void ut_zlib_encoder_reset(UtObject *object, UtObject *input_stream);
+
 /// Returns [true] if [object] is a [UtZLibEncoder].
 bool ut_object_is_zlib_encoder(UtObject *object);